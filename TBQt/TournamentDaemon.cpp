@@ -7,6 +7,7 @@
 #include "../tournamentd/tournament.hpp"
 
 #include <cstdlib>
+#include <mutex>
 #include <thread>
 
 struct TournamentDaemon::impl
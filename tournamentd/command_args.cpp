@@ -0,0 +1,830 @@
+#include "command_args.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+const char* arg_type_name(arg_type type)
+{
+    switch(type)
+    {
+    case arg_type::integer:
+        return "integer";
+    case arg_type::count:
+        return "non-negative integer";
+    case arg_type::number:
+        return "number";
+    case arg_type::boolean:
+        return "bool";
+    case arg_type::string:
+        return "string";
+    case arg_type::array:
+        return "array";
+    case arg_type::object:
+        return "object";
+    case arg_type::any:
+        return "any";
+    }
+    return "unknown";
+}
+
+// SAX handler filling command_args from a request line, without building a document
+// only array and object arguments are built as documents, in place where they are kept
+class command_args_parser : public nlohmann::json_sax<nlohmann::json>
+{
+    command_args& args;
+
+    // top-level member being parsed
+    std::string member;
+    bool in_object {};
+
+    // arrays and objects being built inside a member (nullptr where skipped), and where the next object member goes
+    std::vector<nlohmann::json*> stack;
+    nlohmann::json* pending {};
+
+    // add a value inside an array or object being built, returning where it went
+    nlohmann::json* add(nlohmann::json&& value)
+    {
+        auto* top(this->stack.back());
+        if(top == nullptr)
+        {
+            return nullptr;
+        }
+        if(top->is_array())
+        {
+            top->push_back(std::move(value));
+            return &top->back();
+        }
+        *this->pending = std::move(value);
+        return this->pending;
+    }
+
+    // arguments must be one object
+    bool top_level()
+    {
+        if(!this->in_object)
+        {
+            this->args.fail("arguments must be an object");
+            return false;
+        }
+        return true;
+    }
+
+    bool start(nlohmann::json::value_t type)
+    {
+        if(!this->in_object)
+        {
+            if(type != nlohmann::json::value_t::object)
+            {
+                return this->top_level();
+            }
+            this->in_object = true;
+            return true;
+        }
+
+        if(this->stack.empty())
+        {
+            this->stack.push_back(this->args.set_structured(this->member, type));
+        }
+        else
+        {
+            this->stack.push_back(this->add(nlohmann::json(type)));
+        }
+        return true;
+    }
+
+    bool end()
+    {
+        if(!this->stack.empty())
+        {
+            this->stack.pop_back();
+        }
+        return true;
+    }
+
+public:
+    explicit command_args_parser(command_args& a) : args(a)
+    {
+    }
+
+    bool null() override
+    {
+        if(!this->stack.empty())
+        {
+            this->add(nullptr);
+            return true;
+        }
+        if(!this->top_level())
+        {
+            return false;
+        }
+        this->args.set_null(this->member);
+        return true;
+    }
+
+    bool boolean(bool v) override
+    {
+        if(!this->stack.empty())
+        {
+            this->add(v);
+            return true;
+        }
+        if(!this->top_level())
+        {
+            return false;
+        }
+        this->args.set_boolean(this->member, v);
+        return true;
+    }
+
+    bool number_integer(number_integer_t v) override
+    {
+        if(!this->stack.empty())
+        {
+            this->add(v);
+            return true;
+        }
+        if(!this->top_level())
+        {
+            return false;
+        }
+        this->args.set_integer(this->member, v);
+        return true;
+    }
+
+    bool number_unsigned(number_unsigned_t v) override
+    {
+        if(!this->stack.empty())
+        {
+            this->add(v);
+            return true;
+        }
+        if(!this->top_level())
+        {
+            return false;
+        }
+        this->args.set_unsigned(this->member, v);
+        return true;
+    }
+
+    bool number_float(number_float_t v, const string_t& /* s */) override
+    {
+        if(!this->stack.empty())
+        {
+            this->add(v);
+            return true;
+        }
+        if(!this->top_level())
+        {
+            return false;
+        }
+        this->args.set_number(this->member, v);
+        return true;
+    }
+
+    bool string(string_t& v) override
+    {
+        if(!this->stack.empty())
+        {
+            this->add(std::move(v));
+            return true;
+        }
+        if(!this->top_level())
+        {
+            return false;
+        }
+        this->args.set_string(this->member, std::move(v));
+        return true;
+    }
+
+    bool binary(binary_t& /* v */) override
+    {
+        return false;
+    }
+
+    bool start_object(std::size_t /* elements */) override
+    {
+        return this->start(nlohmann::json::value_t::object);
+    }
+
+    bool key(string_t& k) override
+    {
+        if(this->stack.empty())
+        {
+            this->member = std::move(k);
+        }
+        else if(this->stack.back() != nullptr)
+        {
+            this->pending = &(*this->stack.back())[k];
+        }
+        return true;
+    }
+
+    bool end_object() override
+    {
+        return this->end();
+    }
+
+    bool start_array(std::size_t /* elements */) override
+    {
+        return this->start(nlohmann::json::value_t::array);
+    }
+
+    bool end_array() override
+    {
+        return this->end();
+    }
+
+    bool parse_error(std::size_t /* position */, const std::string& /* last_token */, const nlohmann::detail::exception& ex) override
+    {
+        this->args.fail(std::string("invalid arguments: ") + ex.what());
+        return false;
+    }
+};
+
+void command_args::begin(const arg_list& args, bool keep)
+{
+    // forget anything from a previous parse, keeping string capacity
+    this->schema = args;
+    this->slots.resize(static_cast<std::size_t>(args.last - args.first));
+    for(auto& s : this->slots)
+    {
+        s.present = false;
+        s.defaulted = false;
+        s.string.clear();
+        s.json = nullptr;
+    }
+    this->has_echo_value = false;
+    this->echo_value = nullptr;
+    this->has_authenticate_value = false;
+    this->authenticate_value = 0;
+    this->error_message.clear();
+    this->input_value = nullptr;
+    this->keep_input = keep;
+    if(keep)
+    {
+        this->input_value = nlohmann::json::object();
+    }
+}
+
+// check required arguments and fill in defaults
+bool command_args::finish()
+{
+    if(this->keep_input && !this->has_echo_value)
+    {
+        auto echo_it(this->input_value.find("echo"));
+        if(echo_it != this->input_value.end())
+        {
+            this->has_echo_value = true;
+            this->echo_value = *echo_it;
+        }
+    }
+
+    if(!this->error_message.empty())
+    {
+        return false;
+    }
+
+    for(auto spec(this->schema.first); spec != this->schema.last; ++spec)
+    {
+        auto& s(this->slots[static_cast<std::size_t>(spec - this->schema.first)]);
+        if(s.present)
+        {
+            continue;
+        }
+        if(spec->required)
+        {
+            this->fail(std::string("missing ") + spec->name);
+            return false;
+        }
+        if(spec->default_value != nullptr)
+        {
+            switch(spec->type)
+            {
+            case arg_type::integer:
+                s.integer = std::strtoll(spec->default_value, nullptr, 10);
+                break;
+            case arg_type::count:
+                s.count = std::strtoull(spec->default_value, nullptr, 10);
+                break;
+            case arg_type::number:
+                s.number = std::strtod(spec->default_value, nullptr);
+                break;
+            case arg_type::boolean:
+                s.boolean = std::strcmp(spec->default_value, "true") == 0;
+                break;
+            case arg_type::string:
+                s.string = nlohmann::json::parse(spec->default_value).get<std::string>();
+                break;
+            default:
+                s.json = nlohmann::json::parse(spec->default_value);
+                break;
+            }
+            s.defaulted = true;
+        }
+    }
+    return true;
+}
+
+// keep only the first problem
+void command_args::fail(std::string message)
+{
+    if(this->error_message.empty())
+    {
+        this->error_message = std::move(message);
+    }
+}
+
+std::size_t command_args::find(const std::string& name) const
+{
+    for(auto spec(this->schema.first); spec != this->schema.last; ++spec)
+    {
+        if(name == spec->name)
+        {
+            return static_cast<std::size_t>(spec - this->schema.first);
+        }
+    }
+    return not_found;
+}
+
+const command_args::slot& command_args::get(const arg_spec* spec) const
+{
+    // fields are checked against their schema at compile time, but not against the command they are used for
+    if(spec < this->schema.first || spec >= this->schema.last)
+    {
+        throw std::logic_error(std::string("argument not in schema: ") + spec->name);
+    }
+
+    const auto& s(this->slots[static_cast<std::size_t>(spec - this->schema.first)]);
+    if(!s.present && !s.defaulted)
+    {
+        throw std::logic_error(std::string("argument not sent: ") + spec->name);
+    }
+    return s;
+}
+
+bool command_args::sent(const arg_spec* spec) const
+{
+    return spec >= this->schema.first && spec < this->schema.last && this->slots[static_cast<std::size_t>(spec - this->schema.first)].present;
+}
+
+void command_args::set_integer(const std::string& name, std::int64_t value)
+{
+    if(this->keep_input)
+    {
+        this->input_value[name] = value;
+    }
+
+    if(name == "echo")
+    {
+        this->has_echo_value = true;
+        this->echo_value = value;
+        return;
+    }
+    auto index(this->find(name));
+    if(name == "authenticate")
+    {
+        this->has_authenticate_value = true;
+        this->authenticate_value = value;
+        if(index == not_found)
+        {
+            return;
+        }
+    }
+    else if(index == not_found)
+    {
+        return;
+    }
+
+    auto& s(this->slots[index]);
+    switch(this->schema.first[index].type)
+    {
+    case arg_type::integer:
+        s.integer = value;
+        break;
+    case arg_type::count:
+        if(value < 0)
+        {
+            this->fail("argument " + name + " must be of type " + arg_type_name(arg_type::count));
+            return;
+        }
+        s.count = static_cast<std::uint64_t>(value);
+        break;
+    case arg_type::number:
+        s.number = static_cast<double>(value);
+        break;
+    case arg_type::any:
+        s.json = value;
+        break;
+    default:
+        this->fail("argument " + name + " must be of type " + arg_type_name(this->schema.first[index].type));
+        return;
+    }
+    s.present = true;
+}
+
+void command_args::set_unsigned(const std::string& name, std::uint64_t value)
+{
+    // anything in range of a signed integer is accepted as one
+    if(value <= static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max()))
+    {
+        this->set_integer(name, static_cast<std::int64_t>(value));
+        return;
+    }
+
+    if(this->keep_input)
+    {
+        this->input_value[name] = value;
+    }
+
+    if(name == "echo")
+    {
+        this->has_echo_value = true;
+        this->echo_value = value;
+        return;
+    }
+
+    auto index(this->find(name));
+    if(name == "authenticate" || (index != not_found && this->schema.first[index].type == arg_type::integer))
+    {
+        this->fail("argument " + name + " is out of range");
+        return;
+    }
+    if(index == not_found)
+    {
+        return;
+    }
+
+    auto& s(this->slots[index]);
+    switch(this->schema.first[index].type)
+    {
+    case arg_type::count:
+        s.count = value;
+        break;
+    case arg_type::number:
+        s.number = static_cast<double>(value);
+        break;
+    case arg_type::any:
+        s.json = value;
+        break;
+    default:
+        this->fail("argument " + name + " must be of type " + arg_type_name(this->schema.first[index].type));
+        return;
+    }
+    s.present = true;
+}
+
+void command_args::set_number(const std::string& name, double value)
+{
+    if(this->keep_input)
+    {
+        this->input_value[name] = value;
+    }
+
+    if(name == "echo")
+    {
+        this->has_echo_value = true;
+        this->echo_value = value;
+        return;
+    }
+    if(name == "authenticate")
+    {
+        this->fail("argument authenticate must be of type " + std::string(arg_type_name(arg_type::integer)));
+        return;
+    }
+
+    auto index(this->find(name));
+    if(index == not_found)
+    {
+        return;
+    }
+
+    auto& s(this->slots[index]);
+    switch(this->schema.first[index].type)
+    {
+    case arg_type::number:
+        s.number = value;
+        break;
+    case arg_type::any:
+        s.json = value;
+        break;
+    default:
+        this->fail("argument " + name + " must be of type " + arg_type_name(this->schema.first[index].type));
+        return;
+    }
+    s.present = true;
+}
+
+void command_args::set_boolean(const std::string& name, bool value)
+{
+    if(this->keep_input)
+    {
+        this->input_value[name] = value;
+    }
+
+    if(name == "echo")
+    {
+        this->has_echo_value = true;
+        this->echo_value = value;
+        return;
+    }
+    if(name == "authenticate")
+    {
+        this->fail("argument authenticate must be of type " + std::string(arg_type_name(arg_type::integer)));
+        return;
+    }
+
+    auto index(this->find(name));
+    if(index == not_found)
+    {
+        return;
+    }
+
+    auto& s(this->slots[index]);
+    switch(this->schema.first[index].type)
+    {
+    case arg_type::boolean:
+        s.boolean = value;
+        break;
+    case arg_type::any:
+        s.json = value;
+        break;
+    default:
+        this->fail("argument " + name + " must be of type " + arg_type_name(this->schema.first[index].type));
+        return;
+    }
+    s.present = true;
+}
+
+void command_args::set_string(const std::string& name, std::string&& value)
+{
+    if(this->keep_input)
+    {
+        this->input_value[name] = value;
+    }
+
+    if(name == "echo")
+    {
+        this->has_echo_value = true;
+        this->echo_value = std::move(value);
+        return;
+    }
+    if(name == "authenticate")
+    {
+        this->fail("argument authenticate must be of type " + std::string(arg_type_name(arg_type::integer)));
+        return;
+    }
+
+    auto index(this->find(name));
+    if(index == not_found)
+    {
+        return;
+    }
+
+    auto& s(this->slots[index]);
+    switch(this->schema.first[index].type)
+    {
+    case arg_type::string:
+        s.string = std::move(value);
+        break;
+    case arg_type::any:
+        s.json = std::move(value);
+        break;
+    default:
+        this->fail("argument " + name + " must be of type " + arg_type_name(this->schema.first[index].type));
+        return;
+    }
+    s.present = true;
+}
+
+void command_args::set_null(const std::string& name)
+{
+    if(this->keep_input)
+    {
+        this->input_value[name] = nullptr;
+    }
+
+    if(name == "echo")
+    {
+        this->has_echo_value = true;
+        this->echo_value = nullptr;
+        return;
+    }
+    if(name == "authenticate")
+    {
+        this->fail("argument authenticate must be of type " + std::string(arg_type_name(arg_type::integer)));
+        return;
+    }
+
+    auto index(this->find(name));
+    if(index == not_found)
+    {
+        return;
+    }
+
+    auto& s(this->slots[index]);
+    if(this->schema.first[index].type != arg_type::any)
+    {
+        this->fail("argument " + name + " must be of type " + arg_type_name(this->schema.first[index].type));
+        return;
+    }
+    s.json = nullptr;
+    s.present = true;
+}
+
+nlohmann::json* command_args::set_structured(const std::string& name, nlohmann::json::value_t type)
+{
+    // kept input is built once, in place
+    nlohmann::json* target(nullptr);
+    if(this->keep_input)
+    {
+        target = &this->input_value[name];
+        *target = nlohmann::json(type);
+    }
+
+    if(name == "echo")
+    {
+        this->has_echo_value = !this->keep_input;
+        if(!this->keep_input)
+        {
+            this->echo_value = nlohmann::json(type);
+            target = &this->echo_value;
+        }
+        return target;
+    }
+    if(name == "authenticate")
+    {
+        this->fail("argument authenticate must be of type " + std::string(arg_type_name(arg_type::integer)));
+        return target;
+    }
+
+    auto index(this->find(name));
+    if(index == not_found)
+    {
+        return target;
+    }
+
+    auto& s(this->slots[index]);
+    auto spec_type(this->schema.first[index].type);
+    auto matches(spec_type == arg_type::any || (spec_type == arg_type::array && type == nlohmann::json::value_t::array) || (spec_type == arg_type::object && type == nlohmann::json::value_t::object));
+    if(!matches)
+    {
+        this->fail("argument " + name + " must be of type " + arg_type_name(spec_type));
+        return target;
+    }
+
+    s.present = true;
+    if(target == nullptr)
+    {
+        s.json = nlohmann::json(type);
+        target = &s.json;
+    }
+    return target;
+}
+
+bool command_args::parse(const arg_list& args, bool keep, const char* first, const char* last)
+{
+    this->begin(args, keep);
+    if(first != last)
+    {
+        command_args_parser parser(*this);
+        if(!nlohmann::json::sax_parse(first, last, &parser))
+        {
+            this->fail("invalid arguments");
+        }
+    }
+    return this->finish();
+}
+
+bool command_args::parse(const arg_list& args, bool keep, const nlohmann::json& in)
+{
+    this->begin(args, keep);
+    if(!in.is_null() && !in.is_object())
+    {
+        this->fail("arguments must be an object");
+    }
+    else if(in.is_object())
+    {
+        for(auto it(in.begin()); it != in.end(); ++it)
+        {
+            const auto& value(it.value());
+            switch(value.type())
+            {
+            case nlohmann::json::value_t::number_integer:
+                this->set_integer(it.key(), value.get<std::int64_t>());
+                break;
+            case nlohmann::json::value_t::number_unsigned:
+                this->set_unsigned(it.key(), value.get<std::uint64_t>());
+                break;
+            case nlohmann::json::value_t::number_float:
+                this->set_number(it.key(), value.get<double>());
+                break;
+            case nlohmann::json::value_t::boolean:
+                this->set_boolean(it.key(), value.get<bool>());
+                break;
+            case nlohmann::json::value_t::string:
+                this->set_string(it.key(), std::string(value.get_ref<const std::string&>()));
+                break;
+            case nlohmann::json::value_t::array:
+            case nlohmann::json::value_t::object:
+            {
+                auto* target(this->set_structured(it.key(), value.type()));
+                if(target != nullptr)
+                {
+                    *target = value;
+                }
+                break;
+            }
+            case nlohmann::json::value_t::binary:
+                this->fail("invalid arguments");
+                break;
+            default:
+                this->set_null(it.key());
+                break;
+            }
+        }
+    }
+    return this->finish();
+}
+
+const std::string& command_args::error() const
+{
+    return this->error_message;
+}
+
+std::int64_t command_args::get(arg_field<arg_type::integer> field) const
+{
+    return this->get(field.spec).integer;
+}
+
+std::uint64_t command_args::get(arg_field<arg_type::count> field) const
+{
+    return this->get(field.spec).count;
+}
+
+double command_args::get(arg_field<arg_type::number> field) const
+{
+    return this->get(field.spec).number;
+}
+
+bool command_args::get(arg_field<arg_type::boolean> field) const
+{
+    return this->get(field.spec).boolean;
+}
+
+const std::string& command_args::get(arg_field<arg_type::string> field) const
+{
+    return this->get(field.spec).string;
+}
+
+// arrays and objects of a kept input are only in the input
+const nlohmann::json& command_args::get(arg_field<arg_type::array> field) const
+{
+    const auto& s(this->get(field.spec));
+    return this->keep_input && s.present ? this->input_value.at(field.spec->name) : s.json;
+}
+
+const nlohmann::json& command_args::get(arg_field<arg_type::object> field) const
+{
+    const auto& s(this->get(field.spec));
+    return this->keep_input && s.present ? this->input_value.at(field.spec->name) : s.json;
+}
+
+const nlohmann::json& command_args::get(arg_field<arg_type::any> field) const
+{
+    const auto& s(this->get(field.spec));
+    return this->keep_input && s.present ? this->input_value.at(field.spec->name) : s.json;
+}
+
+bool command_args::has_echo() const
+{
+    return this->has_echo_value;
+}
+
+const nlohmann::json& command_args::echo() const
+{
+    return this->echo_value;
+}
+
+bool command_args::has_authenticate() const
+{
+    return this->has_authenticate_value;
+}
+
+std::int64_t command_args::authenticate() const
+{
+    return this->authenticate_value;
+}
+
+void command_args::set_authenticate(std::int64_t code)
+{
+    this->has_authenticate_value = true;
+    this->authenticate_value = code;
+}
+
+const nlohmann::json& command_args::input() const
+{
+    return this->input_value;
+}
@@ -0,0 +1,181 @@
+#pragma once
+#include "nlohmann/json.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// type of a command argument, checked when the request is parsed
+enum class arg_type
+{
+    integer, // any integer
+    count, // non-negative integer
+    number, // integer or floating point
+    boolean,
+    string,
+    array,
+    object,
+    any // any JSON value, including null
+};
+
+// name of an argument type, for documentation and error messages
+const char* arg_type_name(arg_type type);
+
+// one argument in a command's schema (or one field of its output, for documentation)
+struct arg_spec
+{
+    const char* name;
+    arg_type type;
+    bool required;
+
+    // JSON text of the value used when the argument is not sent, or nullptr if there is none
+    const char* default_value;
+
+    const char* description;
+};
+
+// a command's arguments, in the order they are documented
+struct arg_list
+{
+    const arg_spec* first;
+    const arg_spec* last;
+};
+
+template<std::size_t N>
+arg_list make_arg_list(const arg_spec (&specs)[N])
+{
+    return arg_list { specs, specs + N };
+}
+
+// one argument of one schema, read from command_args as its type. made by make_arg_field
+template<arg_type Type>
+struct arg_field
+{
+    const arg_spec* spec;
+};
+
+// utility: compare argument names at compile time
+constexpr bool arg_name_equal(const char* a, const char* b)
+{
+    return *a == *b && (*a == '\0' || arg_name_equal(a + 1, b + 1));
+}
+
+// utility: position of a named argument in a schema, failing to compile if it is not there
+template<std::size_t N>
+constexpr std::size_t arg_index(const arg_spec (&specs)[N], const char* name, std::size_t i = 0)
+{
+    return i == N ? throw std::logic_error("argument not in schema") : arg_name_equal(specs[i].name, name) ? i : arg_index(specs, name, i + 1);
+}
+
+// field for the named argument of a schema. initializing a constexpr variable with it fails to compile if the schema has no such argument, or gives it another type
+template<arg_type Type, std::size_t N>
+constexpr arg_field<Type> make_arg_field(const arg_spec (&specs)[N], const char* name)
+{
+    return specs[arg_index(specs, name)].type == Type ? arg_field<Type> { &specs[arg_index(specs, name)] } : throw std::logic_error("argument has another type");
+}
+
+// arguments of one command, checked against its schema and parsed straight from the request line
+// "echo" (any type) and "authenticate" (integer) are accepted by every command, whether or not the schema lists them
+// other members not in the schema are ignored
+class command_args
+{
+    friend class command_args_parser;
+
+    // schema position of a member not in the schema
+    static const std::size_t not_found = static_cast<std::size_t>(-1);
+
+    struct slot
+    {
+        bool present {};
+        bool defaulted {};
+
+        // value of a scalar argument, by its type
+        union
+        {
+            std::int64_t integer {};
+            std::uint64_t count;
+            double number;
+            bool boolean;
+        };
+
+        std::string string;
+        nlohmann::json json;
+    };
+
+    // one slot for each argument in the schema
+    arg_list schema {};
+    std::vector<slot> slots;
+
+    bool has_echo_value {};
+    nlohmann::json echo_value;
+    bool has_authenticate_value {};
+    std::int64_t authenticate_value {};
+
+    // whole input object, for commands that pass it on
+    bool keep_input {};
+    nlohmann::json input_value;
+
+    // first problem found, reported once parsing is done
+    std::string error_message;
+
+    void begin(const arg_list& args, bool keep);
+    bool finish();
+    void fail(std::string message);
+
+    // schema position of a member name, or not_found
+    std::size_t find(const std::string& name) const;
+
+    // slot of a field, which must be in this schema, and sent or defaulted
+    const slot& get(const arg_spec* spec) const;
+    bool sent(const arg_spec* spec) const;
+
+    // accept a top-level member. set_structured returns where to build an array or object, or nullptr to skip it
+    void set_integer(const std::string& name, std::int64_t value);
+    void set_unsigned(const std::string& name, std::uint64_t value);
+    void set_number(const std::string& name, double value);
+    void set_boolean(const std::string& name, bool value);
+    void set_string(const std::string& name, std::string&& value);
+    void set_null(const std::string& name);
+    nlohmann::json* set_structured(const std::string& name, nlohmann::json::value_t type);
+
+public:
+    // parse arguments from JSON text (empty for none) against a schema, optionally keeping the whole input object
+    // returns false, with error() set, if the text is not an object or an argument is missing or has the wrong type
+    bool parse(const arg_list& args, bool keep_input, const char* first, const char* last);
+
+    // the same, for arguments already parsed into a document
+    bool parse(const arg_list& args, bool keep_input, const nlohmann::json& in);
+
+    // problem found by parse, as a protocol error message
+    const std::string& error() const;
+
+    // was argument sent (not just defaulted)
+    template<arg_type Type>
+    bool has(arg_field<Type> field) const
+    {
+        return this->sent(field.spec);
+    }
+
+    // argument value, or its default if not sent. the field must be from the schema these arguments were parsed against
+    std::int64_t get(arg_field<arg_type::integer> field) const;
+    std::uint64_t get(arg_field<arg_type::count> field) const;
+    double get(arg_field<arg_type::number> field) const;
+    bool get(arg_field<arg_type::boolean> field) const;
+    const std::string& get(arg_field<arg_type::string> field) const;
+    const nlohmann::json& get(arg_field<arg_type::array> field) const;
+    const nlohmann::json& get(arg_field<arg_type::object> field) const;
+    const nlohmann::json& get(arg_field<arg_type::any> field) const;
+
+    // echo, sent back with the response
+    bool has_echo() const;
+    const nlohmann::json& echo() const;
+
+    // authentication code
+    bool has_authenticate() const;
+    std::int64_t authenticate() const;
+    void set_authenticate(std::int64_t code);
+
+    // whole input object (every member, including ones not in the schema), if kept
+    const nlohmann::json& input() const;
+};
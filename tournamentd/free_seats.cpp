@@ -0,0 +1,220 @@
+#include "free_seats.hpp"
+#include <stdexcept>
+
+// ----- internal
+
+bool free_seats::is_live(const entry& e) const
+{
+    if(e.seat.table_number >= this->slots.size() || e.seat.seat_number >= this->slots[e.seat.table_number].size())
+    {
+        return false;
+    }
+
+    const auto& s(this->slots[e.seat.table_number][e.seat.seat_number]);
+    return s.free && s.stamp == e.stamp;
+}
+
+free_seats::slot& free_seats::slot_for(const td::seat& seat)
+{
+    if(seat.table_number >= this->slots.size())
+    {
+        this->slots.resize(seat.table_number + 1);
+        this->table_free.resize(seat.table_number + 1, 0);
+    }
+
+    auto& table(this->slots[seat.table_number]);
+    if(seat.seat_number >= table.size())
+    {
+        table.resize(seat.seat_number + 1, slot { false, 0 });
+    }
+
+    return table[seat.seat_number];
+}
+
+// mark seat free, returning the queue entry that refers to it
+free_seats::entry free_seats::make_free(const td::seat& seat)
+{
+    auto& s(this->slot_for(seat));
+    if(s.free)
+    {
+        throw std::logic_error("seat is already free");
+    }
+
+    // new stamp, so any older queue entry for this seat stays stale
+    s.free = true;
+    s.stamp++;
+    this->table_free[seat.table_number]++;
+    this->live++;
+    return entry { seat, s.stamp };
+}
+
+// mark seat occupied. its queue entry becomes stale
+void free_seats::make_occupied(const td::seat& seat)
+{
+    this->slots[seat.table_number][seat.seat_number].free = false;
+    this->table_free[seat.table_number]--;
+    this->live--;
+}
+
+void free_seats::drop_stale_front()
+{
+    while(!this->queue.empty() && !this->is_live(this->queue.front()))
+    {
+        this->queue.pop_front();
+    }
+}
+
+// rebuild the queue once stale entries outnumber live ones
+void free_seats::compact()
+{
+    if(this->queue.size() <= this->live * 2 + 16)
+    {
+        return;
+    }
+
+    std::deque<entry> compacted;
+    for(const auto& e : this->queue)
+    {
+        if(this->is_live(e))
+        {
+            compacted.push_back(e);
+        }
+    }
+    this->queue.swap(compacted);
+}
+
+// ----- queries
+
+std::size_t free_seats::size() const
+{
+    return this->live;
+}
+
+bool free_seats::empty() const
+{
+    return this->live == 0;
+}
+
+std::size_t free_seats::count_at(std::size_t table) const
+{
+    return table < this->table_free.size() ? this->table_free[table] : 0;
+}
+
+bool free_seats::contains(const td::seat& seat) const
+{
+    return seat.table_number < this->slots.size() &&
+           seat.seat_number < this->slots[seat.table_number].size() &&
+           this->slots[seat.table_number][seat.seat_number].free;
+}
+
+std::vector<td::seat> free_seats::ordered() const
+{
+    std::vector<td::seat> ret;
+    ret.reserve(this->live);
+    for(const auto& e : this->queue)
+    {
+        if(this->is_live(e))
+        {
+            ret.push_back(e.seat);
+        }
+    }
+    return ret;
+}
+
+// ----- modifiers
+
+void free_seats::push_back(const td::seat& seat)
+{
+    this->queue.push_back(this->make_free(seat));
+}
+
+void free_seats::push_front(const td::seat& seat)
+{
+    this->queue.push_front(this->make_free(seat));
+}
+
+const td::seat& free_seats::front()
+{
+    this->drop_stale_front();
+    return this->queue.front().seat;
+}
+
+td::seat free_seats::pop_front()
+{
+    this->drop_stale_front();
+    auto seat(this->queue.front().seat);
+    this->queue.pop_front();
+    this->make_occupied(seat);
+    return seat;
+}
+
+td::seat free_seats::take_at(std::size_t table, std::size_t index)
+{
+    if(index >= this->count_at(table))
+    {
+        throw std::out_of_range("no such free seat at table");
+    }
+
+    const auto& seats(this->slots[table]);
+    for(std::size_t s(0); s < seats.size(); s++)
+    {
+        if(seats[s].free && index-- == 0)
+        {
+            td::seat seat(table, s);
+            this->make_occupied(seat);
+            this->compact();
+            return seat;
+        }
+    }
+
+    throw std::logic_error("free seat count out of sync");
+}
+
+bool free_seats::erase(const td::seat& seat)
+{
+    if(!this->contains(seat))
+    {
+        return false;
+    }
+
+    this->make_occupied(seat);
+    this->compact();
+    return true;
+}
+
+void free_seats::erase_table(std::size_t table)
+{
+    if(table >= this->slots.size())
+    {
+        return;
+    }
+
+    for(auto& s : this->slots[table])
+    {
+        s.free = false;
+    }
+    this->live -= this->table_free[table];
+    this->table_free[table] = 0;
+    this->compact();
+}
+
+void free_seats::assign(const std::vector<td::seat>& seats)
+{
+    this->clear();
+    for(const auto& seat : seats)
+    {
+        // tolerate duplicates in stored state, keeping the first
+        if(!this->contains(seat))
+        {
+            this->push_back(seat);
+        }
+    }
+}
+
+void free_seats::clear()
+{
+    this->queue.clear();
+    this->slots.clear();
+    this->table_free.clear();
+    this->live = 0;
+}
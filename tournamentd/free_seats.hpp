@@ -0,0 +1,84 @@
+#pragma once
+#include "types.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// empty seats, in the order they should be filled, indexed by table
+// seats are taken from the front, or from a given table in O(1). seats taken out of order
+// leave stale entries in the queue, which are skipped and periodically compacted away
+class free_seats
+{
+    // queue entry, live only while its seat is free and its stamp matches the seat's
+    struct entry
+    {
+        td::seat seat;
+        std::uint32_t stamp;
+    };
+
+    // per seat: whether free, and stamp of its newest queue entry
+    struct slot
+    {
+        bool free;
+        std::uint32_t stamp;
+    };
+
+    // fill order, possibly including stale entries
+    std::deque<entry> queue;
+
+    // per table, per seat
+    std::vector<std::vector<slot>> slots;
+
+    // per table: free seat count
+    std::vector<std::size_t> table_free;
+
+    // total free seats
+    std::size_t live { 0 };
+
+    bool is_live(const entry& e) const;
+    slot& slot_for(const td::seat& seat);
+    entry make_free(const td::seat& seat);
+    void make_occupied(const td::seat& seat);
+    void drop_stale_front();
+    void compact();
+
+public:
+    // total free seats
+    std::size_t size() const;
+    bool empty() const;
+
+    // free seats at a table
+    std::size_t count_at(std::size_t table) const;
+
+    // whether seat is free
+    bool contains(const td::seat& seat) const;
+
+    // add a free seat to the back or front of the fill order. the seat must not already be free
+    void push_back(const td::seat& seat);
+    void push_front(const td::seat& seat);
+
+    // first free seat in fill order. must not be empty
+    const td::seat& front();
+
+    // take the first free seat in fill order. must not be empty
+    td::seat pop_front();
+
+    // take the index'th free seat at a table, counting by seat number, index < count_at(table)
+    // the choice depends only on which seats are free, never on history, so replays choose alike
+    td::seat take_at(std::size_t table, std::size_t index);
+
+    // remove a free seat, returning whether it was free
+    bool erase(const td::seat& seat);
+
+    // remove all free seats at a table
+    void erase_table(std::size_t table);
+
+    // replace contents with seats, in fill order
+    void assign(const std::vector<td::seat>& seats);
+
+    void clear();
+
+    // free seats in fill order
+    std::vector<td::seat> ordered() const;
+};
@@ -1,16 +1,27 @@
 #include "gameinfo.hpp"
 
 #include "datetime.hpp"
+#include "free_seats.hpp"
+#include "json_writer.hpp"
 #include "logger.hpp"
+#include "number_format.hpp"
+#include "player_handles.hpp"
+#include "table_occupancy.hpp"
 #include "nlohmann/json.hpp"
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cmath>
+#include <cstdint>
 #include <deque>
 #include <iomanip>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <numeric>
 #include <random>
 #include <sstream>
+#include <stdexcept>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -45,29 +56,49 @@ class gameinfo::impl
 
     // ----- configuration -----
 
-    // configuration: human-readable name of this tournament
-    std::string name;
+    // configuration that grows with the roster or the structure, changed only by configure()
+    // shared by this game, its snapshots and a batch's saved copy. configure() changes its own copy
+    struct configuration_data
+    {
+        // list of all known players (playing or not)
+        std::vector<td::player> players;
 
-    // configuration: list of all known players (playing or not)
-    std::vector<td::player> players;
+        // every player id seen, interned: id by handle, and handle by id. handles are never reused
+        std::vector<td::player_id_t> player_ids;
+        std::unordered_map<td::player_id_t, player_handle_t> player_handles;
 
-    // configuration: number of players per table
-    std::size_t table_capacity { 2 };
+        // index into players, by handle (or npos if not configured), and handle of each configured player
+        std::vector<std::size_t> player_slots;
+        std::vector<player_handle_t> roster;
 
-    // configuration: table names
-    std::vector<std::string> table_names;
+        // table names
+        std::vector<std::string> table_names;
 
-    // configuration: funding rules
-    std::vector<td::funding_source> funding_sources;
+        // funding rules
+        std::vector<td::funding_source> funding_sources;
 
-    // configuration: blind structure for this game
-    std::vector<td::blind_level> blind_levels;
+        // blind structure for this game
+        std::vector<td::blind_level> blind_levels;
 
-    // configuration: description of each chip (for display)
-    std::vector<td::chip> available_chips;
+        // description of each chip (for display)
+        std::vector<td::chip> available_chips;
 
-    // configuration: description of each named table (for display)
-    std::vector<td::table> available_tables;
+        // description of each named table (for display)
+        std::vector<td::table> available_tables;
+
+        // forced payout structure (regardless of number of players)
+        std::vector<td::monetary_value_nocurrency> forced_payouts;
+
+        // manually generated payout structures
+        std::vector<td::manual_payout> manual_payouts;
+    };
+    std::shared_ptr<const configuration_data> settings;
+
+    // configuration: human-readable name of this tournament
+    std::string name;
+
+    // configuration: number of players per table
+    std::size_t table_capacity { 2 };
 
     // configuration: payout policy
     td::payout_policy_t payout_policy { td::payout_policy_t::automatic };
@@ -78,12 +109,6 @@ class gameinfo::impl
     // configuration: automatic payout parameters
     td::automatic_payout_parameters automatic_payouts;
 
-    // configuration: forced payout structure (regardless of number of players)
-    std::vector<td::monetary_value_nocurrency> forced_payouts;
-
-    // configuration: manually generated payout structures
-    std::vector<td::manual_payout> manual_payouts;
-
     // configuration: how long after round starts should prev command go to the previous round (rather than restart)? (ms)
     long previous_blind_level_hold_duration { 2000 };
 
@@ -104,33 +129,36 @@ class gameinfo::impl
     // ---------- results ----------
 
     // finished out players in reverse order of bust out
-    std::deque<td::player_id_t> players_finished;
+    std::deque<player_handle_t> players_finished;
 
     // busted out players in order of bust out
     // TODO: make this a pair (buster and busted) to support knockout tournaments
-    std::deque<td::player_id_t> bust_history;
+    std::deque<player_handle_t> bust_history;
 
     // ---------- seating ----------
 
     // players seated in the game
-    std::unordered_map<td::player_id_t, td::seat> seats;
+    player_map<td::seat> seats;
 
-    // empty seats
-    std::deque<td::seat> empty_seats;
+    // empty seats, in fill order and indexed by table
+    free_seats empty_seats;
 
     // number of tables total
     std::size_t table_count { 0 };
 
+    // players at each table, kept in step with seats
+    table_occupancy occupancy;
+
     // ---------- funding ----------
 
     // players who are both currently seated and bought in
-    std::unordered_set<td::player_id_t> buyins;
+    player_set buyins;
 
     // players who at one point have bought in
-    std::unordered_set<td::player_id_t> unique_entries;
+    player_set unique_entries;
 
     // ordered list of each entry (buyin or rebuy)
-    std::deque<td::player_id_t> entries;
+    std::vector<player_handle_t> entries;
 
     // payout structure
     std::vector<td::monetary_value_nocurrency> payouts;
@@ -173,63 +201,350 @@ class gameinfo::impl
     // represents a time duration
     using duration_t = std::chrono::milliseconds;
 
+    // time to use instead of the system clock, when replaying a journal
+    time_point_t clock_override;
+
+    // ----- batching -----
+
+    // automatic rebalancing is deferred until the end of a batch
+    bool rebalance_deferred { false };
+
+    // a player busted while rebalancing was deferred
+    bool rebalance_pending { false };
+
+    // ----- derived state cache -----
+
+    // parts of the game a mutation can change, each invalidating the derived state built from it
+    enum changed_t
+    {
+        changed_configuration = 1 << 0,
+        changed_seating = 1 << 1,
+        changed_funding = 1 << 2,
+        changed_results = 1 << 3,
+        changed_all = changed_configuration | changed_seating | changed_funding | changed_results
+    };
+
+    // a derived state section and its serialized text. never changed once built
+    struct cached_section
+    {
+        nlohmann::json value;
+        std::string text;
+    };
+
+    // where one section is built, at most once. shared by the game and every snapshot taken until the section's inputs change
+    // so whichever thread first serializes it builds it, and the others reuse it
+    struct cache_slot
+    {
+        std::mutex mutex;
+        std::unique_ptr<const cached_section> section;
+    };
+
+    // derived state sections
+    enum section_t
+    {
+        section_counts,
+        section_buyin_text,
+        section_results,
+        section_seated_players,
+        section_seating_chart,
+        section_tables_playing,
+        section_count
+    };
+
+    // parts of the game each section is built from
+    static unsigned section_inputs(std::size_t section)
+    {
+        static const unsigned inputs[section_count] = {
+            changed_seating | changed_funding,
+            changed_configuration,
+            changed_configuration | changed_funding | changed_results,
+            changed_configuration | changed_seating | changed_funding,
+            changed_configuration | changed_seating,
+            changed_configuration | changed_seating
+        };
+        return inputs[section];
+    }
+
+    static std::array<std::shared_ptr<cache_slot>, section_count> empty_slots()
+    {
+        std::array<std::shared_ptr<cache_slot>, section_count> ret;
+        for(auto& slot : ret)
+        {
+            slot = std::make_shared<cache_slot>();
+        }
+        return ret;
+    }
+
+    // the slot of each section. replaced (only by the game) when its inputs change, and copied into snapshots
+    std::array<std::shared_ptr<cache_slot>, section_count> slots { empty_slots() };
+
+    // number of sections built, by this game and every copy of it
+    std::shared_ptr<std::atomic<std::size_t>> sections_built { std::make_shared<std::atomic<std::size_t>>(0) };
+
+    // formats *_text fields, with the locale resolved once
+    number_format numbers;
+
+    // reused by write_state, to sort seats by player id without allocating. copies start empty
+    struct seats_scratch
+    {
+        std::mutex mutex;
+        std::vector<std::pair<const td::player_id_t*, td::seat>> seats;
+
+        seats_scratch() = default;
+        seats_scratch(const seats_scratch& /* other */)
+        {
+        }
+        seats_scratch& operator=(const seats_scratch& /* other */)
+        {
+            return *this;
+        }
+    };
+    mutable seats_scratch seats_by_id;
+
     // ----- private methods -----
 
-    // utility: return whether a player exists (by id)
-    bool player_exists(const td::player_id_t& player_id) const
+    // derived state built from the changed parts must be rebuilt: start those sections over in new, empty slots
+    // snapshots already taken keep the old slots, which still match their copy of the game
+    void invalidate(unsigned changed)
     {
-        return std::find_if(this->players.begin(), this->players.end(), [player_id](const td::player& item)
+        for(std::size_t i(0); i < section_count; i++)
         {
-            return item.player_id == player_id;
-        }) != this->players.end();
+            if(section_inputs(i) & changed)
+            {
+                this->slots[i] = std::make_shared<cache_slot>();
+            }
+        }
     }
 
-    // utility: return a player's name by id
-    std::string player_name(const td::player_id_t& player_id) const
+    // set state dirty, invalidating derived state built from the changed parts
+    void touch(unsigned changed)
     {
-        auto player_it(std::find_if(this->players.begin(), this->players.end(), [player_id](const td::player& item)
+        this->dirty = true;
+        this->invalidate(changed);
+    }
+
+    // return a derived state section, building it if nothing sharing its slot has yet
+    template<typename F>
+    const cached_section& cached(section_t section, F build) const
+    {
+        auto& slot(*this->slots[section]);
+        std::lock_guard<std::mutex> lock(slot.mutex);
+        if(!slot.section)
         {
-            return item.player_id == player_id;
-        }));
-        if(player_it == this->players.end())
+            auto value(build());
+            auto text(value.dump());
+            slot.section.reset(new cached_section { std::move(value), std::move(text) });
+            (*this->sections_built)++;
+        }
+        return *slot.section;
+    }
+
+    // current time, from the system clock unless overridden
+    time_point_t now() const
+    {
+        return this->clock_override != time_point_t() ? this->clock_override : sc::now();
+    }
+
+    // utility: return handle for a player id, interning it if new
+    player_handle_t intern_player(configuration_data& s, const td::player_id_t& player_id)
+    {
+        auto handle_it(s.player_handles.find(player_id));
+        if(handle_it != s.player_handles.end())
+        {
+            return handle_it->second;
+        }
+
+        auto handle(static_cast<player_handle_t>(s.player_ids.size()));
+        if(handle == invalid_player_handle)
+        {
+            throw std::runtime_error("too many player ids");
+        }
+        s.player_ids.push_back(player_id);
+        s.player_slots.push_back(std::string::npos);
+        s.player_handles.emplace(player_id, handle);
+        return handle;
+    }
+
+    // utility: return handle for a known player id, throwing if never seen
+    player_handle_t player_handle(const td::player_id_t& player_id) const
+    {
+        auto handle_it(this->settings->player_handles.find(player_id));
+        if(handle_it == this->settings->player_handles.end())
         {
             throw std::runtime_error("failed to look up player: " + player_id);
         }
-        return player_it->name;
+        return handle_it->second;
     }
 
-    // utility: return a description of a player, by id
-    std::string player_description(const td::player_id_t& player_id) const
+    // utility: return a player by handle, or nullptr if not configured
+    const td::player* find_player(player_handle_t handle) const
     {
-        return player_id + " (" + this->player_name(player_id) + ")";
+        auto slot(this->settings->player_slots[handle]);
+        return slot == std::string::npos ? nullptr : &this->settings->players[slot];
     }
 
-    // utility: arrange tables with lists of players
-    std::vector<std::vector<td::player_id_t>> players_at_tables() const
+    // utility: return whether a player exists (by handle)
+    bool player_exists(player_handle_t handle) const
     {
-        // build up two vectors, outer = tables, inner = players per table
-        std::vector<std::vector<td::player_id_t>> ret(this->table_count);
+        return this->settings->player_slots[handle] != std::string::npos;
+    }
 
-        for(const auto& seat : this->seats)
+    // utility: return a player's name by handle
+    const std::string& player_name(player_handle_t handle) const
+    {
+        this->require_player(handle);
+        return this->find_player(handle)->name;
+    }
+
+    // utility: throw unless a player is configured (by handle)
+    void require_player(player_handle_t handle) const
+    {
+        if(!this->player_exists(handle))
         {
-            ret[seat.second.table_number].push_back(seat.first);
+            throw std::runtime_error("failed to look up player: " + this->settings->player_ids[handle]);
         }
+    }
 
-        for(std::size_t i(0); i < ret.size(); i++)
+    // utility: bring handles up to date after players changes. roster still holds the handles from before the change
+    // only slots whose player id changed are unmapped and interned again; the rest keep their handles
+    void index_players(configuration_data& s)
+    {
+        // unmap players whose slot now holds someone else, or is gone
+        for(std::size_t i(0); i < s.roster.size(); i++)
         {
-            logger(ll::debug) << "table " << i << " has " << ret[i].size() << " players\n";
+            auto handle(s.roster[i]);
+            if(i >= s.players.size() || s.player_ids[handle] != s.players[i].player_id)
+            {
+                if(s.player_slots[handle] == i)
+                {
+                    s.player_slots[handle] = std::string::npos;
+                }
+                s.roster[i] = invalid_player_handle;
+            }
         }
+        s.roster.resize(s.players.size(), invalid_player_handle);
+
+        // map the changed slots. front to back, so the first of any duplicate ids wins, and a duplicate left unmapped above takes its next slot
+        for(std::size_t i(0); i < s.players.size(); i++)
+        {
+            if(s.roster[i] == invalid_player_handle)
+            {
+                s.roster[i] = this->intern_player(s, s.players[i].player_id);
+            }
+
+            auto& slot(s.player_slots[s.roster[i]]);
+            if(slot == std::string::npos || slot > i)
+            {
+                slot = i;
+            }
+        }
+    }
+
+    // utility: return a description of a player, by handle
+    std::string player_description(player_handle_t handle) const
+    {
+        return this->settings->player_ids[handle] + " (" + this->player_name(handle) + ")";
+    }
 
+    // utility: convert handle-keyed state to and from its JSON form, keyed by player id
+    nlohmann::json player_json(const player_map<td::seat>& value) const
+    {
+        auto ret(nlohmann::json::object());
+        for(const auto& item : value)
+        {
+            ret[this->settings->player_ids[item.first]] = item.second;
+        }
+        return ret;
+    }
+
+    nlohmann::json player_json(const player_set& value) const
+    {
+        auto ret(nlohmann::json::array());
+        for(auto handle : value)
+        {
+            ret.push_back(this->settings->player_ids[handle]);
+        }
         return ret;
     }
 
+    template<typename T>
+    nlohmann::json player_json(const T& value) const
+    {
+        auto ret(nlohmann::json::array());
+        for(auto handle : value)
+        {
+            ret.push_back(this->settings->player_ids[handle]);
+        }
+        return ret;
+    }
+
+    void from_player_json(configuration_data& s, const nlohmann::json& j, player_map<td::seat>& value)
+    {
+        value.clear();
+        for(auto it(j.begin()); it != j.end(); ++it)
+        {
+            value.insert(std::make_pair(this->intern_player(s, it.key()), it.value().get<td::seat>()));
+        }
+    }
+
+    void from_player_json(configuration_data& s, const nlohmann::json& j, player_set& value)
+    {
+        value.clear();
+        for(const auto& item : j)
+        {
+            value.insert(this->intern_player(s, item.get<td::player_id_t>()));
+        }
+    }
+
+    template<typename T>
+    void from_player_json(configuration_data& s, const nlohmann::json& j, T& value)
+    {
+        value.clear();
+        for(const auto& item : j)
+        {
+            value.push_back(this->intern_player(s, item.get<td::player_id_t>()));
+        }
+    }
+
+    // utility: load handle-keyed state from JSON if present, like update_value(..., false)
+    template<typename T>
+    bool update_player_value(configuration_data& s, const nlohmann::json& j, const char* key, T& value)
+    {
+        auto it(j.find(key));
+        if(it == j.end())
+        {
+            return false;
+        }
+
+        this->from_player_json(s, *it, value);
+        this->dirty = true;
+        return true;
+    }
+
+    // utility: rebuild table occupancy after seats or tables change wholesale
+    void index_seats()
+    {
+        auto tables(this->table_count);
+        for(const auto& seat : this->seats)
+        {
+            tables = std::max(tables, seat.second.table_number + 1);
+        }
+
+        this->occupancy.clear();
+        this->occupancy.resize(tables);
+        for(const auto& seat : this->seats)
+        {
+            this->occupancy.add(seat.second, seat.first);
+        }
+    }
+
     // utility: return name of given table number or seat number
     std::string table_name(std::size_t table_number) const
     {
-        if(this->table_names.size() > table_number)
+        if(this->settings->table_names.size() > table_number)
         {
             // return table name (throws out_of_range if not enough table names configured, which shouldnt happen given above check)
-            return this->table_names.at(table_number);
+            return this->settings->table_names.at(table_number);
         }
         else
         {
@@ -253,11 +568,11 @@ class gameinfo::impl
         }
 
         // find denomination in available_chips
-        auto it(std::find_if(this->available_chips.begin(), this->available_chips.end(), [denomination](const td::chip& c)
+        auto it(std::find_if(this->settings->available_chips.begin(), this->settings->available_chips.end(), [denomination](const td::chip& c)
         {
             return c.denomination == denomination;
         }));
-        if(it == this->available_chips.end())
+        if(it == this->settings->available_chips.end())
         {
             throw td::protocol_error("denomination not found in chip set");
         }
@@ -268,15 +583,15 @@ class gameinfo::impl
     // return a default funding source of the given type. used for quick setup and structure generator
     td::funding_source_id_t source_for_type(const td::funding_source_type_t& type) const
     {
-        if(this->funding_sources.empty())
+        if(this->settings->funding_sources.empty())
         {
             throw td::protocol_error("tried to look up a funding source with none defined");
         }
 
         // simple: return the first source that matches
-        for(td::funding_source_id_t src(0); src < this->funding_sources.size(); src++)
+        for(td::funding_source_id_t src(0); src < this->settings->funding_sources.size(); src++)
         {
-            if(this->funding_sources[src].type == type)
+            if(this->settings->funding_sources[src].type == type)
             {
                 return src;
             }
@@ -288,47 +603,35 @@ class gameinfo::impl
 
     // move a player to a specific table
     // returns player's original seat and new seat
-    td::player_movement move_player(const td::player_id_t& player_id, std::size_t table)
+    td::player_movement move_player(player_handle_t player_id, std::size_t table)
     {
+        this->require_player(player_id);
         logger(ll::info) << "moving player " << this->player_description(player_id) << " to table " << table << '\n';
 
-        // build up a list of candidate seats
-        std::vector<std::deque<td::seat>::iterator> candidates;
-        for(auto seat_it(this->empty_seats.begin()); seat_it != this->empty_seats.end(); seat_it++)
-        {
-            if(seat_it->table_number == table)
-            {
-                // store iterator itself
-                candidates.push_back(seat_it);
-                logger(ll::info) << "candidate table " << seat_it->table_number << ", seat " << seat_it->seat_number << '\n';
-            }
-        }
-
-        logger(ll::info) << "choosing from " << candidates.size() << " free seats\n";
+        auto candidates(this->empty_seats.count_at(table));
+        logger(ll::info) << "choosing from " << candidates << " free seats\n";
 
         // we should always have at least one seat free
-        if(candidates.empty())
+        if(candidates == 0)
         {
             throw td::protocol_error("tried to move player to a full table");
         }
 
         // pick one at random
-        auto index(std::uniform_int_distribution<std::size_t>(0, candidates.size() - 1)(this->random_engine));
-        auto to_seat_it(candidates[index]);
+        auto index(std::uniform_int_distribution<std::size_t>(0, candidates - 1)(this->random_engine));
 
         // set state dirty
-        this->dirty = true;
+        this->touch(changed_seating);
 
-        // move player
+        // move player, freeing the original seat
         auto player_seat_it(this->seats.find(player_id));
         auto from_seat(player_seat_it->second);
-        player_seat_it->second = *to_seat_it;
-
-        // update empty seats. push_back invalidates all iterators, so we cannot use to_seat_it after calling it
-        this->empty_seats.erase(to_seat_it);
+        player_seat_it->second = this->empty_seats.take_at(table, index);
         this->empty_seats.push_back(from_seat);
+        this->occupancy.remove(from_seat);
+        this->occupancy.add(player_seat_it->second, player_id);
 
-        td::player_movement movement(player_id,
+        td::player_movement movement(this->settings->player_ids[player_id],
                                      this->player_name(player_id),
                                      this->table_name(from_seat.table_number),
                                      this->seat_name(from_seat.seat_number),
@@ -340,13 +643,11 @@ class gameinfo::impl
 
     // move a player to the table with the smallest number of players, optionally avoiding a particular table
     // returns player's movement
-    td::player_movement move_player(const td::player_id_t& player_id, const std::unordered_set<std::size_t>& avoid_tables)
+    td::player_movement move_player(player_handle_t player_id, const std::unordered_set<std::size_t>& avoid_tables)
     {
+        this->require_player(player_id);
         logger(ll::info) << "moving player " << this->player_description(player_id) << " to a free table\n";
 
-        // build players-per-table vector
-        auto ppt(this->players_at_tables());
-
         // find first table not in avoid set
         std::size_t smallest_table(0);
         while(avoid_tables.find(smallest_table) != avoid_tables.end())
@@ -354,12 +655,12 @@ class gameinfo::impl
             smallest_table++;
         }
 
-        // find smallest table not in avoid set
+        // find smallest table not in avoid set. every table has table_capacity seats, so the smallest has the most free
         auto table(smallest_table);
-        while(table < ppt.size())
+        while(table < this->table_count)
         {
             // if current table is smaller and not in avoid_tables set
-            if((ppt[table].size() < ppt[smallest_table].size()) && (avoid_tables.find(table) == avoid_tables.end()))
+            if((this->empty_seats.count_at(table) > this->empty_seats.count_at(smallest_table)) && (avoid_tables.find(table) == avoid_tables.end()))
             {
                 smallest_table = table;
             }
@@ -367,7 +668,7 @@ class gameinfo::impl
         }
 
         // make sure at least one candidate table
-        if(smallest_table >= ppt.size())
+        if(smallest_table >= this->table_count)
         {
             throw td::protocol_error("tried to move player to another table but no candidate tables");
         }
@@ -376,7 +677,7 @@ class gameinfo::impl
     }
 
     // seat a player, returning the seat. this may cause a table to be added!
-    td::seat seat_player(const td::player_id_t& player_id)
+    td::seat seat_player(player_handle_t player_id)
     {
         auto seat_it(this->seats.find(player_id));
         if(seat_it != this->seats.end())
@@ -385,7 +686,7 @@ class gameinfo::impl
         }
 
         // set state dirty
-        this->dirty = true;
+        this->touch(changed_seating);
 
         // if there are no empty seats, we need to add a table
         if(this->empty_seats.empty())
@@ -397,22 +698,25 @@ class gameinfo::impl
             }
 
             // add a table full of new seats
+            std::vector<td::seat> new_seats;
             for(std::size_t s(0); s < this->table_capacity; s++)
             {
-                this->empty_seats.emplace_back(this->table_count, s);
+                new_seats.emplace_back(this->table_count, s);
             }
 
             // randomize seats
-            std::shuffle(this->empty_seats.begin(), this->empty_seats.end(), this->random_engine);
+            std::shuffle(new_seats.begin(), new_seats.end(), this->random_engine);
+            this->empty_seats.assign(new_seats);
 
             // increment number of tables
             this->table_count++;
+            this->occupancy.resize(this->table_count);
         }
 
         // move seat definition from empty_seats to seats, seating player
-        auto seat(this->empty_seats.front());
+        auto seat(this->empty_seats.pop_front());
         this->seats.insert(std::make_pair(player_id, seat));
-        this->empty_seats.pop_front();
+        this->occupancy.add(seat, player_id);
 
         // return the seat used
         return seat;
@@ -421,21 +725,23 @@ class gameinfo::impl
     // ensure this->seats and this->empty_seats respect this->table_capacity configuration
     std::vector<td::player_movement> validate_table_capacity()
     {
-        // return value is any movements that have to happen
+        // return value is any movements that have to happen, and who they move
         std::vector<td::player_movement> movements;
+        std::vector<player_handle_t> moved;
 
         // set state dirty
-        this->dirty = true;
+        this->touch(changed_seating);
 
         // create a new list of empty seats
-        this->empty_seats.clear();
+        std::vector<td::seat> all_seats;
         for(size_t t(0); t < this->table_count; t++)
         {
             for(size_t s(0); s < this->table_capacity; s++)
             {
-                this->empty_seats.emplace_back(t, s);
+                all_seats.emplace_back(t, s);
             }
         }
+        this->empty_seats.assign(all_seats);
 
         // unseat any players with seat number > table_capacity
         for(auto seat_it(this->seats.begin()); seat_it != this->seats.end(); /* do not increment */)
@@ -445,35 +751,42 @@ class gameinfo::impl
                 // player is sitting in a seat that no longer exists.
 
                 // prepare half a player_movement
-                td::player_movement m(seat_it->first,
+                td::player_movement m(this->settings->player_ids[seat_it->first],
                                       this->player_name(seat_it->first),
                                       this->table_name(seat_it->second.table_number),
                                       this->seat_name(seat_it->second.seat_number));
                 movements.push_back(m);
+                moved.push_back(seat_it->first);
 
                 // remove player and add seat to the end of the empty list
-                this->seats.erase(seat_it++);
+                seat_it = this->seats.erase(seat_it);
             }
             else
             {
                 // player is in a seat that still exists.
 
                 // remove from the new list of empty seats
-                this->empty_seats.erase(std::remove(this->empty_seats.begin(), this->empty_seats.end(), seat_it->second), this->empty_seats.end());
+                this->empty_seats.erase(seat_it->second);
 
                 // incrememnt and continue iterating
                 seat_it++;
             }
         }
 
+        this->index_seats();
+
         // randomize empty seats
-        std::shuffle(this->empty_seats.begin(), this->empty_seats.end(), this->random_engine);
+        auto remaining(this->empty_seats.ordered());
+        std::shuffle(remaining.begin(), remaining.end(), this->random_engine);
+        this->empty_seats.assign(remaining);
 
         // add unseated players back to valid empty_seats
-        for(auto& movement : movements)
+        for(std::size_t i(0); i < movements.size(); i++)
         {
+            auto& movement(movements[i]);
+
             // seat the player
-            auto seat(this->seat_player(movement.player_id));
+            auto seat(this->seat_player(moved[i]));
 
             // complete the movement
             movement.to_table_name = this->table_name(seat.table_number);
@@ -492,7 +805,7 @@ class gameinfo::impl
     // utility: start a blind level
     void start_blind_level(std::size_t blind_level, duration_t offset)
     {
-        if(blind_level >= this->blind_levels.size())
+        if(blind_level >= this->settings->blind_levels.size())
         {
             throw td::protocol_error("not enough blind levels configured");
         }
@@ -501,10 +814,10 @@ class gameinfo::impl
         this->dirty = true;
 
         this->current_blind_level = blind_level;
-        duration_t blind_level_duration(this->blind_levels[blind_level].duration);
+        duration_t blind_level_duration(this->settings->blind_levels[blind_level].duration);
         duration_t time_remaining(blind_level_duration - offset);
-        duration_t break_time_remaining(this->blind_levels[blind_level].break_duration);
-        this->end_of_round = sc::now() + time_remaining;
+        duration_t break_time_remaining(this->settings->blind_levels[blind_level].break_duration);
+        this->end_of_round = this->now() + time_remaining;
         this->end_of_break = this->end_of_round + break_time_remaining;
     }
 
@@ -541,7 +854,7 @@ class gameinfo::impl
     //  25/100/500/1000/5000
     std::vector<td::blind_level> gen_count_blind_levels(std::size_t count, long level_duration, long chip_up_break_duration, double blind_increase_factor, td::ante_type_t antes, double ante_sb_ratio) const
     {
-        if(this->available_chips.empty())
+        if(this->settings->available_chips.empty())
         {
             throw td::protocol_error("tried to create a blind structure without chips defined");
         }
@@ -551,7 +864,7 @@ class gameinfo::impl
         logger(ll::info) << "ante_sb_ratio: " << ante_sb_ratio << '\n';
 
         // store last round denomination (to check when it changes)
-        auto last_round_denom(this->available_chips.begin()->denomination);
+        auto last_round_denom(this->settings->available_chips.begin()->denomination);
 
         // starting small blind = smallest denomination
         auto ideal_small(static_cast<double>(last_round_denom));
@@ -562,7 +875,7 @@ class gameinfo::impl
         for(size_t i(1); i < count + 1; i++)
         {
             // calculate nearest chip denomination
-            auto round_denom(calculate_round_denomination(ideal_small, this->available_chips));
+            auto round_denom(calculate_round_denomination(ideal_small, this->settings->available_chips));
 
             // round up to get little blind
             const auto little_blind(static_cast<unsigned long>(std::ceil(ideal_small / round_denom) * round_denom));
@@ -577,12 +890,12 @@ class gameinfo::impl
                 auto ideal_ante(ante_sb_ratio * little_blind);
 
                 // only have an ante if ideal >= minimal chip denomination
-                if(ideal_ante >= this->available_chips[0].denomination)
+                if(ideal_ante >= this->settings->available_chips[0].denomination)
                 {
                     if(antes == td::ante_type_t::traditional)
                     {
                         // calculate nearest chip denomination
-                        round_denom = calculate_round_denomination(ideal_ante, this->available_chips);
+                        round_denom = calculate_round_denomination(ideal_ante, this->settings->available_chips);
 
                         // round up to get ante
                         ante = static_cast<unsigned long>(std::ceil(ideal_ante / round_denom) * round_denom);
@@ -638,19 +951,19 @@ public:
         {
             // force payout:
             // overrides everyting. disregard number of players
-            if(this->forced_payouts.empty())
+            if(this->settings->forced_payouts.empty())
             {
                 logger(ll::warning) << "payout_policy is forced but no forced_payouts exist. falling back to automatic payouts\n";
             }
             else
             {
-                logger(ll::info) << "applying forced payout: " << this->forced_payouts.size() << " seats will be paid\n";
+                logger(ll::info) << "applying forced payout: " << this->settings->forced_payouts.size() << " seats will be paid\n";
 
                 // set state dirty
-                this->dirty = true;
+                this->touch(changed_results);
 
                 // use the payout structure specified in forced_payouts
-                this->payouts = this->forced_payouts;
+                this->payouts = this->settings->forced_payouts;
                 return;
             }
         }
@@ -658,11 +971,11 @@ public:
         {
             // manual payout:
             // look for a payout list given this number of unique entries
-            auto manual_payout_it(std::find_if(this->manual_payouts.begin(), this->manual_payouts.end(), [count_entries](const td::manual_payout& item)
+            auto manual_payout_it(std::find_if(this->settings->manual_payouts.begin(), this->settings->manual_payouts.end(), [count_entries](const td::manual_payout& item)
             {
                 return item.buyins_count == count_entries;
             }));
-            if(manual_payout_it == this->manual_payouts.end())
+            if(manual_payout_it == this->settings->manual_payouts.end())
             {
                 logger(ll::warning) << "payout_policy is manual but no payout list with " << count_entries << " entries exists. falling back to automatic payouts\n";
             }
@@ -671,7 +984,7 @@ public:
                 logger(ll::info) << "applying manual payout for " << count_entries << " entries: " << manual_payout_it->payouts.size() << " seats will be paid\n";
 
                 // set state dirty
-                this->dirty = true;
+                this->touch(changed_results);
 
                 // use found payout structure
                 this->payouts = manual_payout_it->payouts;
@@ -688,7 +1001,7 @@ public:
         }
 
         // set state dirty
-        this->dirty = true;
+        this->touch(changed_results);
 
         // resize our payout structure
         this->payouts.resize(seats_paid);
@@ -771,14 +1084,19 @@ public:
     {
         logger(ll::info) << "loading tournament configuration\n";
 
+        // snapshots may share the current configuration, so change a copy
+        auto editing(std::make_shared<configuration_data>(*this->settings));
+        this->settings = editing;
+        auto& s(*editing);
+
         if(update_value(config, "name", this->name, this->dirty))
         {
             logger(ll::info) << "configuration changed: name -> " << this->name << '\n';
         }
 
-        if(update_value(config, "funding_sources", this->funding_sources, this->dirty))
+        if(update_value(config, "funding_sources", s.funding_sources, this->dirty))
         {
-            logger(ll::info) << "configuration changed: funding_sources -> " << this->funding_sources.size() << " sources\n";
+            logger(ll::info) << "configuration changed: funding_sources -> " << s.funding_sources.size() << " sources\n";
         }
 
         if(update_value(config, "previous_blind_level_hold_duration", this->previous_blind_level_hold_duration, this->dirty))
@@ -802,26 +1120,27 @@ public:
             logger(ll::info) << "configuration changed: final_table_policy -> " << this->final_table_policy << '\n';
         }
 
-        if(update_value(config, "available_chips", this->available_chips, this->dirty))
+        if(update_value(config, "available_chips", s.available_chips, this->dirty))
         {
-            logger(ll::info) << "configuration changed: available_chips -> " << this->available_chips.size() << " chips\n";
+            logger(ll::info) << "configuration changed: available_chips -> " << s.available_chips.size() << " chips\n";
 
             // always sort chips by denomination
-            std::sort(this->available_chips.begin(), this->available_chips.end(),
+            std::sort(s.available_chips.begin(), s.available_chips.end(),
                       [](const td::chip& c0, const td::chip& c1)
             {
                 return c0.denomination < c1.denomination;
             });
         }
 
-        if(update_value(config, "available_tables", this->available_tables, this->dirty))
+        if(update_value(config, "available_tables", s.available_tables, this->dirty))
         {
-            logger(ll::info) << "configuration changed: available_tables -> " << this->available_tables.size() << " named tables\n";
+            logger(ll::info) << "configuration changed: available_tables -> " << s.available_tables.size() << " named tables\n";
         }
 
-        if(update_value(config, "players", this->players, this->dirty))
+        if(update_value(config, "players", s.players, this->dirty))
         {
-            logger(ll::info) << "configuration changed: players -> " << this->players.size() << " players\n";
+            logger(ll::info) << "configuration changed: players -> " << s.players.size() << " players\n";
+            this->index_players(s);
 
             // changing players is dangerous, since any removed players might be in existing game state. check one by one
             if(!this->seats.empty() || !this->players_finished.empty() || !this->bust_history.empty() || !this->buyins.empty() || !this->unique_entries.empty() || !this->entries.empty())
@@ -831,7 +1150,7 @@ public:
                 // remove missing players from internal state
 
                 // remove missing players from seats map
-                for(auto i(this->seats.begin()), last(this->seats.end()); i != last;)
+                for(auto i(this->seats.begin()); i != this->seats.end();)
                 {
                     if(!this->player_exists(i->first))
                     {
@@ -843,43 +1162,27 @@ public:
                     }
                 }
 
-                // remove missing players from buyins set
-                for(auto i(this->buyins.begin()), last(this->buyins.end()); i != last;)
-                {
-                    if(!this->player_exists(*i))
-                    {
-                        i = this->buyins.erase(i);
-                    }
-                    else
-                    {
-                        ++i;
-                    }
-                }
-
-                // remove missing players from unique_entries set
-                for(auto i(this->unique_entries.begin()), last(this->unique_entries.end()); i != last;)
+                // remove missing players from buyins and unique_entries sets
+                for(player_handle_t handle(0); handle < s.player_ids.size(); handle++)
                 {
-                    if(!this->player_exists(*i))
-                    {
-                        i = this->unique_entries.erase(i);
-                    }
-                    else
+                    if(!this->player_exists(handle))
                     {
-                        ++i;
+                        this->buyins.erase(handle);
+                        this->unique_entries.erase(handle);
                     }
                 }
 
-                this->players_finished.erase(std::remove_if(this->players_finished.begin(), this->players_finished.end(), [this](const td::player_id_t& p)
+                this->players_finished.erase(std::remove_if(this->players_finished.begin(), this->players_finished.end(), [this](player_handle_t p)
                 {
                     return !this->player_exists(p);
                 }),
                                              this->players_finished.end());
-                this->bust_history.erase(std::remove_if(this->bust_history.begin(), this->bust_history.end(), [this](const td::player_id_t& p)
+                this->bust_history.erase(std::remove_if(this->bust_history.begin(), this->bust_history.end(), [this](player_handle_t p)
                 {
                     return !this->player_exists(p);
                 }),
                                          this->bust_history.end());
-                this->entries.erase(std::remove_if(this->entries.begin(), this->entries.end(), [this](const td::player_id_t& p)
+                this->entries.erase(std::remove_if(this->entries.begin(), this->entries.end(), [this](player_handle_t p)
                 {
                     return !this->player_exists(p);
                 }),
@@ -906,9 +1209,9 @@ public:
             }
         }
 
-        if(update_value(config, "table_names", this->table_names, this->dirty))
+        if(update_value(config, "table_names", s.table_names, this->dirty))
         {
-            logger(ll::info) << "configuration changed: table_names -> " << this->table_names.size() << '\n';
+            logger(ll::info) << "configuration changed: table_names -> " << s.table_names.size() << '\n';
         }
 
         // recalculate for any configuration that could alter payouts
@@ -934,16 +1237,16 @@ public:
             recalculate = true;
         }
 
-        if(update_value(config, "forced_payouts", this->forced_payouts, this->dirty))
+        if(update_value(config, "forced_payouts", s.forced_payouts, this->dirty))
         {
-            logger(ll::info) << "configuration changed: forced_payouts -> " << this->forced_payouts.size() << " forced payouts\n";
+            logger(ll::info) << "configuration changed: forced_payouts -> " << s.forced_payouts.size() << " forced payouts\n";
 
             recalculate = true;
         }
 
-        if(update_value(config, "manual_payouts", this->manual_payouts, this->dirty))
+        if(update_value(config, "manual_payouts", s.manual_payouts, this->dirty))
         {
-            logger(ll::info) << "configuration changed: manual_payouts -> " << this->manual_payouts.size() << " manual payouts\n";
+            logger(ll::info) << "configuration changed: manual_payouts -> " << s.manual_payouts.size() << " manual payouts\n";
 
             recalculate = true;
         }
@@ -955,9 +1258,9 @@ public:
         }
 
         // stop the game when reconfiguring blind levels
-        if(update_value(config, "blind_levels", this->blind_levels, this->dirty))
+        if(update_value(config, "blind_levels", s.blind_levels, this->dirty))
         {
-            logger(ll::info) << "configuration changed: blind_levels -> " << this->blind_levels.size() << " blind levels\n";
+            logger(ll::info) << "configuration changed: blind_levels -> " << s.blind_levels.size() << " blind levels\n";
 
             if(this->is_started())
             {
@@ -966,33 +1269,35 @@ public:
         }
 
         // ensure we have at least one blind level, the setup level
-        if(this->blind_levels.empty())
+        if(s.blind_levels.empty())
         {
             this->dirty = true;
-            logger(ll::info) << "configuration validated: blind_levels -> " << this->blind_levels.size() << " blind levels\n";
+            logger(ll::info) << "configuration validated: blind_levels -> " << s.blind_levels.size() << " blind levels\n";
 
-            this->blind_levels.resize(1);
+            s.blind_levels.resize(1);
         }
 
         // can also load state (useful for loading from snapshot)
 
-        if(update_value(config, "seats", this->seats, this->dirty, false))
+        if(this->update_player_value(s, config, "seats", this->seats))
         {
             logger(ll::info) << "state changed: seats -> " << this->seats.size() << "\n";
         }
 
-        if(update_value(config, "players_finished", this->players_finished, this->dirty, false))
+        if(this->update_player_value(s, config, "players_finished", this->players_finished))
         {
             logger(ll::info) << "state changed: players_finished -> " << this->players_finished.size() << "\n";
         }
 
-        if(update_value(config, "bust_history", this->bust_history, this->dirty, false))
+        if(this->update_player_value(s, config, "bust_history", this->bust_history))
         {
             logger(ll::info) << "state changed: bust_history -> " << this->bust_history.size() << "\n";
         }
 
-        if(update_value(config, "empty_seats", this->empty_seats, this->dirty, false))
+        std::vector<td::seat> empty_seats;
+        if(update_value(config, "empty_seats", empty_seats, this->dirty, false))
         {
+            this->empty_seats.assign(empty_seats);
             logger(ll::info) << "state changed: empty_seats -> " << this->empty_seats.size() << "\n";
         }
 
@@ -1001,17 +1306,20 @@ public:
             logger(ll::info) << "state changed: table_count -> " << this->table_count << "\n";
         }
 
-        if(update_value(config, "buyins", this->buyins, this->dirty, false))
+        // seats or tables may have changed above
+        this->index_seats();
+
+        if(this->update_player_value(s, config, "buyins", this->buyins))
         {
             logger(ll::info) << "state changed: buyins -> " << this->buyins.size() << "\n";
         }
 
-        if(update_value(config, "unique_entries", this->unique_entries, this->dirty, false))
+        if(this->update_player_value(s, config, "unique_entries", this->unique_entries))
         {
             logger(ll::info) << "state changed: unique_entries -> " << this->unique_entries.size() << "\n";
         }
 
-        if(update_value(config, "entries", this->entries, this->dirty, false))
+        if(this->update_player_value(s, config, "entries", this->entries))
         {
             logger(ll::info) << "state changed: entries -> " << this->entries.size() << "\n";
         }
@@ -1070,6 +1378,9 @@ public:
         {
             logger(ll::info) << "state changed: paused_time -> " << datetime(this->paused_time) << "\n";
         }
+
+        // any of the above may feed derived state
+        this->invalidate(changed_all);
     }
 
     // dump configuration to JSON
@@ -1078,22 +1389,22 @@ public:
         logger(ll::debug) << "dumping tournament configuration\n";
 
         config["name"] = this->name;
-        config["players"] = this->players;
+        config["players"] = this->settings->players;
         config["table_capacity"] = this->table_capacity;
-        config["table_names"] = this->table_names;
+        config["table_names"] = this->settings->table_names;
         config["payout_policy"] = this->payout_policy;
         config["payout_currency"] = this->payout_currency;
         config["automatic_payouts"] = this->automatic_payouts;
-        config["forced_payouts"] = this->forced_payouts;
-        config["manual_payouts"] = this->manual_payouts;
+        config["forced_payouts"] = this->settings->forced_payouts;
+        config["manual_payouts"] = this->settings->manual_payouts;
         config["previous_blind_level_hold_duration"] = this->previous_blind_level_hold_duration;
         config["rebalance_policy"] = this->rebalance_policy;
         config["background_color"] = this->background_color;
         config["final_table_policy"] = this->final_table_policy;
-        config["funding_sources"] = this->funding_sources;
-        config["blind_levels"] = this->blind_levels;
-        config["available_chips"] = this->available_chips;
-        config["available_tables"] = this->available_tables;
+        config["funding_sources"] = this->settings->funding_sources;
+        config["blind_levels"] = this->settings->blind_levels;
+        config["available_chips"] = this->settings->available_chips;
+        config["available_tables"] = this->settings->available_tables;
     }
 
     // dump state to JSON
@@ -1101,14 +1412,14 @@ public:
     {
         logger(ll::debug) << "dumping tournament state\n";
 
-        state["seats"] = this->seats;
-        state["players_finished"] = this->players_finished;
-        state["bust_history"] = this->bust_history;
-        state["empty_seats"] = this->empty_seats;
+        state["seats"] = this->player_json(this->seats);
+        state["players_finished"] = this->player_json(this->players_finished);
+        state["bust_history"] = this->player_json(this->bust_history);
+        state["empty_seats"] = this->empty_seats.ordered();
         state["table_count"] = this->table_count;
-        state["buyins"] = this->buyins;
-        state["unique_entries"] = this->unique_entries;
-        state["entries"] = this->entries;
+        state["buyins"] = this->player_json(this->buyins);
+        state["unique_entries"] = this->player_json(this->unique_entries);
+        state["entries"] = this->player_json(this->entries);
         state["payouts"] = this->payouts;
         state["total_chips"] = this->total_chips;
         state["total_cost"] = this->total_cost;
@@ -1129,241 +1440,554 @@ public:
 
         state["name"] = this->name;
         state["background_color"] = this->background_color;
-        state["funding_sources"] = this->funding_sources;
-        state["available_chips"] = this->available_chips;
-        state["available_tables"] = this->available_tables;
+        state["funding_sources"] = this->settings->funding_sources;
+        state["available_chips"] = this->settings->available_chips;
+        state["available_tables"] = this->settings->available_tables;
         state["payout_currency"] = this->payout_currency;
     }
 
-    // calculate derived state and dump to JSON
-    void dump_derived_state(nlohmann::json& state) const
+    // clock-dependent derived state. empty text and a phase of none leave the matching fields out
+    struct clock_state
     {
-        logger(ll::debug) << "dumping tournament derived state\n";
+        enum phase_t
+        {
+            none,
+            in_round,
+            in_break
+        };
 
-        auto now(sc::now());
+        time_point_t current_time;
+        bool has_elapsed_time { false };
+        duration_t::rep elapsed_time { 0 };
+        duration_t::rep action_clock_time_remaining { 0 };
+        bool running { false };
+        phase_t phase { none };
+        duration_t::rep clock_remaining { 0 };
+        std::string current_round_number_text;
+        std::string current_round_text;
+        std::string next_round_text;
+    };
+
+    clock_state derived_clock() const
+    {
+        clock_state clock;
+        auto now(this->now());
 
         // set current time (for synchronization)
-        state["current_time"] = now;
+        clock.current_time = now;
 
         // set elapsed_time if we are past the tournament start
         if(this->tournament_start != time_point_t() && this->tournament_start < now)
         {
-            auto elapsed_time(std::chrono::duration_cast<duration_t>(now - this->tournament_start));
-            state["elapsed_time"] = elapsed_time.count();
+            clock.has_elapsed_time = true;
+            clock.elapsed_time = std::chrono::duration_cast<duration_t>(now - this->tournament_start).count();
         }
 
         // set action clock if ticking
         if(this->end_of_action_clock != time_point_t() && this->end_of_action_clock > now)
         {
-            auto action_clock_time_remaining(std::chrono::duration_cast<duration_t>(this->end_of_action_clock - now));
-            state["action_clock_time_remaining"] = action_clock_time_remaining.count();
-        }
-        else
-        {
-            state["action_clock_time_remaining"] = 0;
+            clock.action_clock_time_remaining = std::chrono::duration_cast<duration_t>(this->end_of_action_clock - now).count();
         }
 
         // set running (vs paused)
-        state["running"] = this->end_of_break != time_point_t() && !this->is_paused();
-
-        std::ostringstream os;
-        os.imbue(std::locale(""));
+        clock.running = this->end_of_break != time_point_t() && !this->is_paused();
 
         // current round number as text
         if(this->is_started())
         {
-            os << this->current_blind_level;
-            state["current_round_number_text"] = os.str();
-            os.str("");
+            clock.current_round_number_text = this->numbers.format(this->current_blind_level);
         }
 
         // set time remaining based on current clock
         if(this->end_of_round != time_point_t() && now < this->end_of_round)
         {
             // within round, set time remaining
-            auto time_remaining(std::chrono::duration_cast<duration_t>(this->end_of_round - now));
-            state["time_remaining"] = time_remaining.count();
-            state["clock_remaining"] = time_remaining.count();
-            state["on_break"] = false;
+            clock.phase = clock_state::in_round;
+            clock.clock_remaining = std::chrono::duration_cast<duration_t>(this->end_of_round - now).count();
 
-            if(this->current_blind_level < this->blind_levels.size())
+            if(this->current_blind_level < this->settings->blind_levels.size())
             {
                 // set current round description
-                os << this->blind_levels[this->current_blind_level];
-                state["current_round_text"] = os.str();
-                os.str("");
+                clock.current_round_text = this->numbers.format(this->settings->blind_levels[this->current_blind_level]);
 
                 // set next round description
-                if(this->current_blind_level + 1 < this->blind_levels.size())
+                if(this->current_blind_level + 1 < this->settings->blind_levels.size())
                 {
-                    if(this->blind_levels[this->current_blind_level].break_duration == 0)
+                    if(this->settings->blind_levels[this->current_blind_level].break_duration == 0)
                     {
-                        os << this->blind_levels[this->current_blind_level + 1];
+                        clock.next_round_text = this->numbers.format(this->settings->blind_levels[this->current_blind_level + 1]);
                     }
-                    else if(this->current_blind_level + 1 < this->blind_levels.size())
+                    else
                     {
-                        os << "BREAK"; // TODO: i18n
+                        clock.next_round_text = "BREAK"; // TODO: i18n
                     }
-                    state["next_round_text"] = os.str();
-                    os.str("");
                 }
             }
         }
         else if(this->end_of_break != time_point_t() && now < this->end_of_break)
         {
-            // within break, set break time remaining
-            auto break_time_remaining(std::chrono::duration_cast<duration_t>(this->end_of_break - now));
-            state["break_time_remaining"] = break_time_remaining.count();
-            state["clock_remaining"] = break_time_remaining.count();
-            state["on_break"] = true;
+            // within break, set break time remaining
+            clock.phase = clock_state::in_break;
+            clock.clock_remaining = std::chrono::duration_cast<duration_t>(this->end_of_break - now).count();
+
+            // set current round description as break
+            clock.current_round_text = "BREAK"; // TODO: i18n
+
+            // set next round description
+            if(this->current_blind_level + 1 < this->settings->blind_levels.size())
+            {
+                clock.next_round_text = this->numbers.format(this->settings->blind_levels[this->current_blind_level + 1]);
+            }
+        }
+
+        return clock;
+    }
+
+    // counts as text
+    const cached_section& derived_counts() const
+    {
+        return this->cached(section_counts, [this]() -> nlohmann::json
+        {
+            nlohmann::json ret(nlohmann::json::object());
+
+            // players left text
+            if(!this->seats.empty())
+            {
+                ret["players_left_text"] = this->numbers.format(this->seats.size());
+            }
+
+            // unique_entries text
+            if(!this->unique_entries.empty())
+            {
+                ret["unique_entries_text"] = this->numbers.format(this->unique_entries.size());
+            }
+
+            // entries text
+            if(!this->entries.empty())
+            {
+                ret["entries_text"] = this->numbers.format(this->entries.size());
+            }
+
+            // average stack text
+            if(!this->buyins.empty())
+            {
+                ret["average_stack_text"] = this->numbers.format(this->total_chips / this->buyins.size());
+            }
+
+            return ret;
+        });
+    }
+
+    // buyin text
+    const cached_section& derived_buyin_text() const
+    {
+        return this->cached(section_buyin_text, [this]() -> nlohmann::json
+        {
+            // amounts are floating point, still formatted by iostreams
+            std::ostringstream os;
+            os.imbue(this->numbers.locale());
+
+            auto src_it(std::find_if(this->settings->funding_sources.begin(), this->settings->funding_sources.end(), [](const td::funding_source& s)
+            {
+                return s.type == td::funding_source_type_t::buyin;
+            }));
+            if(src_it != this->settings->funding_sources.end())
+            {
+                os << src_it->name << ": " << src_it->cost.currency << src_it->cost.amount;
+                if(src_it->commission.amount != 0.0)
+                {
+                    if(src_it->commission.currency == src_it->cost.currency)
+                    {
+                        os << '+' << src_it->commission.amount;
+                    }
+                    else
+                    {
+                        os << '+' << src_it->commission.currency << src_it->commission.amount;
+                    }
+                }
+            }
+            else
+            {
+                os << "NO BUYIN"; // TODO: i18n
+            }
+            return os.str();
+        });
+    }
+
+    // results
+    const cached_section& derived_results() const
+    {
+        return this->cached(section_results, [this]() -> nlohmann::json
+        {
+            std::vector<td::result> results;
+            // do players currently playing first
+            for(size_t j(0); j < this->buyins.size(); j++)
+            {
+                td::result result(j + 1);
+                if(j < this->payouts.size())
+                {
+                    result.payout = this->payouts[j];
+                }
+                results.push_back(result);
+            }
+            // then do players out, in reverse bustout order
+            for(size_t i(0); i < this->players_finished.size(); i++)
+            {
+                auto player_id(this->players_finished[i]);
+                size_t j(this->buyins.size() + i);
+
+                td::result result(j + 1, this->player_name(player_id));
+                if(j < this->payouts.size())
+                {
+                    result.payout = this->payouts[j];
+                }
+                results.push_back(result);
+            }
+            return results;
+        });
+    }
+
+    // seated players
+    const cached_section& derived_seated_players() const
+    {
+        return this->cached(section_seated_players, [this]() -> nlohmann::json
+        {
+            std::vector<td::seated_player> seated_players;
+            for(std::size_t i(0); i < this->settings->players.size(); i++)
+            {
+                const auto& p(this->settings->players[i]);
+                auto handle(this->settings->roster[i]);
+                auto buyin(this->buyins.count(handle) != 0);
+                auto seat(this->seats.find(handle));
+                if(seat == this->seats.end())
+                {
+                    td::seated_player seated_player(p.player_id,
+                                                    buyin,
+                                                    this->player_name(handle));
+                    seated_players.push_back(seated_player);
+                }
+                else
+                {
+                    td::seated_player seated_player(p.player_id,
+                                                    buyin,
+                                                    this->player_name(handle),
+                                                    this->table_name(seat->second.table_number),
+                                                    this->seat_name(seat->second.seat_number),
+                                                    seat->second);
+                    seated_players.push_back(seated_player);
+                }
+            }
+            return seated_players;
+        });
+    }
+
+    // seating chart
+    const cached_section& derived_seating_chart() const
+    {
+        return this->cached(section_seating_chart, [this]() -> nlohmann::json
+        {
+            std::vector<td::seating_chart_entry> seating_chart;
+            for(const auto& s : this->seats)
+            {
+                td::seating_chart_entry seating_entry(this->player_name(s.first), this->table_name(s.second.table_number), this->seat_name(s.second.seat_number));
+                seating_chart.push_back(seating_entry);
+            }
+
+            // "empty" seated players for seating chart
+            for(const auto& s : this->empty_seats.ordered())
+            {
+                td::seating_chart_entry seating_entry(this->table_name(s.table_number), this->seat_name(s.seat_number));
+                seating_chart.push_back(seating_entry);
+            }
+            return seating_chart;
+        });
+    }
+
+    // table names in play
+    const cached_section& derived_tables_playing() const
+    {
+        return this->cached(section_tables_playing, [this]() -> nlohmann::json
+        {
+            std::vector<std::string> tables_playing(this->table_count);
+            for(size_t i(0); i < this->table_count; i++)
+            {
+                tables_playing[i] = this->table_name(i);
+            }
+            return tables_playing;
+        });
+    }
+
+    // calculate derived state and dump to JSON
+    void dump_derived_state(nlohmann::json& state) const
+    {
+        logger(ll::debug) << "dumping tournament derived state\n";
+
+        auto clock(this->derived_clock());
+        state["current_time"] = clock.current_time;
+        if(clock.has_elapsed_time)
+        {
+            state["elapsed_time"] = clock.elapsed_time;
+        }
+        state["action_clock_time_remaining"] = clock.action_clock_time_remaining;
+        state["running"] = clock.running;
+        if(!clock.current_round_number_text.empty())
+        {
+            state["current_round_number_text"] = clock.current_round_number_text;
+        }
+        if(clock.phase == clock_state::in_round)
+        {
+            state["time_remaining"] = clock.clock_remaining;
+            state["clock_remaining"] = clock.clock_remaining;
+            state["on_break"] = false;
+        }
+        else if(clock.phase == clock_state::in_break)
+        {
+            state["break_time_remaining"] = clock.clock_remaining;
+            state["clock_remaining"] = clock.clock_remaining;
+            state["on_break"] = true;
+        }
+        if(!clock.current_round_text.empty())
+        {
+            state["current_round_text"] = clock.current_round_text;
+        }
+        if(!clock.next_round_text.empty())
+        {
+            state["next_round_text"] = clock.next_round_text;
+        }
+
+        const auto& counts(this->derived_counts().value);
+        for(auto it(counts.begin()); it != counts.end(); ++it)
+        {
+            state[it.key()] = it.value();
+        }
 
-            // set current round description as break
-            state["current_round_text"] = "BREAK"; // TODO: i18n
+        state["buyin_text"] = this->derived_buyin_text().value;
+        state["results"] = this->derived_results().value;
+        state["seated_players"] = this->derived_seated_players().value;
+        state["seating_chart"] = this->derived_seating_chart().value;
+        state["tables_playing"] = this->derived_tables_playing().value;
+    }
 
-            // set next round description
-            if(this->current_blind_level + 1 < this->blind_levels.size())
-            {
-                os << this->blind_levels[this->current_blind_level + 1];
-                state["next_round_text"] = os.str();
-                os.str("");
-            }
+    // utility: write a count text from derived_counts(), if present
+    static void write_count(json_writer& w, const nlohmann::json& counts, const char* key)
+    {
+        auto it(counts.find(key));
+        if(it != counts.end())
+        {
+            w.key(key).value(it->get_ref<const std::string&>());
         }
+    }
 
-        // players left text
-        if(!this->seats.empty())
+    // utility: write a player id array
+    template<typename T>
+    void write_player_ids(json_writer& w, const T& value) const
+    {
+        w.begin_array();
+        for(auto handle : value)
         {
-            os << this->seats.size();
-            state["players_left_text"] = os.str();
-            os.str("");
+            w.value(this->settings->player_ids[handle]);
         }
+        w.end_array();
+    }
 
-        // unique_entries text
-        if(!this->unique_entries.empty())
+    // utility: write a currency-keyed map, in key order
+    static void write_currency_map(json_writer& w, const std::unordered_map<std::string, double>& value)
+    {
+        std::vector<const std::unordered_map<std::string, double>::value_type*> items;
+        items.reserve(value.size());
+        for(const auto& item : value)
         {
-            os << this->unique_entries.size();
-            state["unique_entries_text"] = os.str();
-            os.str("");
+            items.push_back(&item);
         }
+        std::sort(items.begin(), items.end(), [](const std::unordered_map<std::string, double>::value_type* i0, const std::unordered_map<std::string, double>::value_type* i1)
+        {
+            return i0->first < i1->first;
+        });
 
-        // entries text
-        if(!this->entries.empty())
+        w.begin_object();
+        for(auto item : items)
         {
-            os << this->entries.size();
-            state["entries_text"] = os.str();
-            os.str("");
+            w.key(item->first).value(item->second);
         }
+        w.end_object();
+    }
+
+    // write state, configuration state and derived state together as one JSON object, without building a document
+    // produces the same text as dumping all three into one nlohmann::json, so keys are written in sorted order
+    void write_state(json_writer& w) const
+    {
+        logger(ll::debug) << "writing tournament state\n";
+
+        auto clock(this->derived_clock());
+        const auto& counts(this->derived_counts().value);
 
-        // average stack text
-        if(!this->buyins.empty())
+        // seats are keyed by player id
+        std::lock_guard<std::mutex> lock(this->seats_by_id.mutex);
+        auto& seats_by_id(this->seats_by_id.seats);
+        seats_by_id.clear();
+        for(const auto& item : this->seats)
         {
-            os << this->total_chips / this->buyins.size();
-            state["average_stack_text"] = os.str();
-            os.str("");
+            seats_by_id.emplace_back(&this->settings->player_ids[item.first], item.second);
         }
+        std::sort(seats_by_id.begin(), seats_by_id.end(), [](const std::pair<const td::player_id_t*, td::seat>& i0, const std::pair<const td::player_id_t*, td::seat>& i1)
+        {
+            return *i0.first < *i1.first;
+        });
 
-        // buyin text
-        auto src_it(std::find_if(this->funding_sources.begin(), this->funding_sources.end(), [](const td::funding_source& s)
+        w.begin_object();
+        w.key("action_clock_time_remaining").value(clock.action_clock_time_remaining);
+        w.key("available_chips").begin_array();
+        for(const auto& chip : this->settings->available_chips)
         {
-            return s.type == td::funding_source_type_t::buyin;
-        }));
-        if(src_it != this->funding_sources.end())
+            td::write_json(w, chip);
+        }
+        w.end_array();
+        w.key("available_tables").begin_array();
+        for(const auto& table : this->settings->available_tables)
         {
-            os << src_it->name << ": " << src_it->cost.currency << src_it->cost.amount;
-            if(src_it->commission.amount != 0.0)
-            {
-                if(src_it->commission.currency == src_it->cost.currency)
-                {
-                    os << '+' << src_it->commission.amount;
-                }
-                else
-                {
-                    os << '+' << src_it->commission.currency << src_it->commission.amount;
-                }
-            }
+            td::write_json(w, table);
         }
-        else
+        w.end_array();
+        write_count(w, counts, "average_stack_text");
+        w.key("background_color").value(this->background_color);
+        if(clock.phase == clock_state::in_break)
         {
-            os << "NO BUYIN"; // TODO: i18n
+            w.key("break_time_remaining").value(clock.clock_remaining);
         }
-        state["buyin_text"] = os.str();
-        os.str("");
-
-        // results
-        std::vector<td::result> results;
-        // do players currently playing first
-        for(size_t j(0); j < this->buyins.size(); j++)
+        w.key("bust_history");
+        this->write_player_ids(w, this->bust_history);
+        w.key("buyin_text").raw(this->derived_buyin_text().text);
+        w.key("buyins");
+        this->write_player_ids(w, this->buyins);
+        if(clock.phase != clock_state::none)
         {
-            td::result result(j + 1);
-            if(j < this->payouts.size())
-            {
-                result.payout = this->payouts[j];
-            }
-            results.push_back(result);
+            w.key("clock_remaining").value(clock.clock_remaining);
         }
-        // then do players out, in reverse bustout order
-        for(size_t i(0); i < this->players_finished.size(); i++)
+        w.key("current_blind_level").value(this->current_blind_level);
+        if(!clock.current_round_number_text.empty())
         {
-            auto player_id(this->players_finished[i]);
-            size_t j(this->buyins.size() + i);
-
-            td::result result(j + 1, this->player_name(player_id));
-            if(j < this->payouts.size())
-            {
-                result.payout = this->payouts[j];
-            }
-            results.push_back(result);
+            w.key("current_round_number_text").value(clock.current_round_number_text);
         }
-        state["results"] = results;
-
-        // seated players
-        std::vector<td::seated_player> seated_players;
-        for(const auto& p : this->players)
+        if(!clock.current_round_text.empty())
         {
-            auto buyin(this->buyins.find(p.player_id));
-            auto seat(this->seats.find(p.player_id));
-            if(seat == this->seats.end())
-            {
-                td::seated_player seated_player(p.player_id,
-                                                buyin != this->buyins.end(),
-                                                this->player_name(p.player_id));
-                seated_players.push_back(seated_player);
-            }
-            else
-            {
-                td::seated_player seated_player(p.player_id,
-                                                buyin != this->buyins.end(),
-                                                this->player_name(p.player_id),
-                                                this->table_name(seat->second.table_number),
-                                                this->seat_name(seat->second.seat_number),
-                                                seat->second);
-                seated_players.push_back(seated_player);
-            }
+            w.key("current_round_text").value(clock.current_round_text);
         }
-        state["seated_players"] = seated_players;
-
-        // seating chart
-        std::vector<td::seating_chart_entry> seating_chart;
-        for(const auto& s : this->seats)
+        w.key("current_time");
+        td::write_json(w, clock.current_time);
+        if(clock.has_elapsed_time)
         {
-            td::seating_chart_entry seating_entry(this->player_name(s.first), this->table_name(s.second.table_number), this->seat_name(s.second.seat_number));
-            seating_chart.push_back(seating_entry);
+            w.key("elapsed_time").value(clock.elapsed_time);
         }
-
-        // "empty" seated players for seating chart
-        for(const auto& s : this->empty_seats)
+        w.key("empty_seats").begin_array();
+        for(const auto& seat : this->empty_seats.ordered())
+        {
+            td::write_json(w, seat);
+        }
+        w.end_array();
+        w.key("end_of_action_clock");
+        td::write_json(w, this->end_of_action_clock);
+        w.key("end_of_break");
+        td::write_json(w, this->end_of_break);
+        w.key("end_of_round");
+        td::write_json(w, this->end_of_round);
+        w.key("entries");
+        this->write_player_ids(w, this->entries);
+        write_count(w, counts, "entries_text");
+        w.key("funding_sources").begin_array();
+        for(const auto& source : this->settings->funding_sources)
+        {
+            td::write_json(w, source);
+        }
+        w.end_array();
+        w.key("name").value(this->name);
+        if(!clock.next_round_text.empty())
+        {
+            w.key("next_round_text").value(clock.next_round_text);
+        }
+        if(clock.phase != clock_state::none)
+        {
+            w.key("on_break").value(clock.phase == clock_state::in_break);
+        }
+        w.key("paused_time");
+        td::write_json(w, this->paused_time);
+        w.key("payout_currency").value(this->payout_currency);
+        w.key("payouts").begin_array();
+        for(const auto& payout : this->payouts)
+        {
+            td::write_json(w, payout);
+        }
+        w.end_array();
+        w.key("players_finished");
+        this->write_player_ids(w, this->players_finished);
+        write_count(w, counts, "players_left_text");
+        w.key("results").raw(this->derived_results().text);
+        w.key("running").value(clock.running);
+        w.key("seated_players").raw(this->derived_seated_players().text);
+        w.key("seating_chart").raw(this->derived_seating_chart().text);
+        w.key("seats").begin_object();
+        for(const auto& item : seats_by_id)
+        {
+            w.key(*item.first);
+            td::write_json(w, item.second);
+        }
+        w.end_object();
+        w.key("table_count").value(this->table_count);
+        w.key("tables_playing").raw(this->derived_tables_playing().text);
+        if(clock.phase == clock_state::in_round)
         {
-            td::seating_chart_entry seating_entry(this->table_name(s.table_number), this->seat_name(s.seat_number));
-            seating_chart.push_back(seating_entry);
+            w.key("time_remaining").value(clock.clock_remaining);
         }
-        state["seating_chart"] = seating_chart;
+        w.key("total_chips").value(this->total_chips);
+        w.key("total_commission");
+        write_currency_map(w, this->total_commission);
+        w.key("total_cost");
+        write_currency_map(w, this->total_cost);
+        w.key("total_equity").value(this->total_equity);
+        w.key("tournament_start");
+        td::write_json(w, this->tournament_start);
+        w.key("unique_entries");
+        this->write_player_ids(w, this->unique_entries);
+        write_count(w, counts, "unique_entries_text");
+        w.end_object();
+    }
+
+    // random number engine state, so that a restored game draws the same seats as the original
+    void dump_random_state(nlohmann::json& snapshot) const
+    {
+        std::ostringstream os;
+        os << this->random_engine;
+        snapshot["random_engine"] = os.str();
+    }
 
-        // table names in play
-        std::vector<std::string> tables_playing(this->table_count);
-        for(size_t i(0); i < this->table_count; i++)
+    void load_random_state(const nlohmann::json& snapshot)
+    {
+        auto it(snapshot.find("random_engine"));
+        if(it != snapshot.end())
         {
-            tables_playing[i] = this->table_name(i);
+            std::istringstream is(it->get<std::string>());
+            is >> this->random_engine;
         }
-        state["tables_playing"] = tables_playing;
+    }
+
+    // use given time instead of the system clock, or the system clock again if epoch
+    void set_clock_override(const time_point_t& now)
+    {
+        this->clock_override = now;
+    }
+
+    // copy with its clock stopped at the current time, sharing configuration and derived state slots with this one
+    // nothing is built here: whichever thread first serializes a section fills its slot
+    std::unique_ptr<impl> snapshot() const
+    {
+        std::unique_ptr<impl> copy(new impl(*this));
+        copy->clock_override = this->now();
+        return copy;
+    }
+
+    // number of derived state sections built so far
+    std::size_t derived_sections_built() const
+    {
+        return *this->sections_built;
     }
 
     // has internal state been updated since last check?
@@ -1383,7 +2007,7 @@ public:
     void reset_state()
     {
         // set state dirty
-        this->dirty = true;
+        this->touch(changed_all);
 
         // clear results
         this->players_finished.clear();
@@ -1393,6 +2017,7 @@ public:
         this->seats.clear();
         this->empty_seats.clear();
         this->table_count = 0;
+        this->occupancy.clear();
 
         // clear all funding
         this->buyins.clear();
@@ -1408,9 +2033,37 @@ public:
         this->stop();
     }
 
+    // collapse movement chains (A->B, B->C to A->C), so each player moves once, in order of their first move
+    // players who end up back where they started do not move at all
     static std::vector<td::player_movement>& minimize_player_movements(std::vector<td::player_movement>& movements)
     {
-        // TODO: collapse any movement chains (A->B, B->C to A->C)
+        std::unordered_map<td::player_id_t, std::size_t> first_movement;
+        std::vector<td::player_movement> collapsed;
+        collapsed.reserve(movements.size());
+
+        for(auto& movement : movements)
+        {
+            auto it(first_movement.find(movement.player_id));
+            if(it == first_movement.end())
+            {
+                first_movement.emplace(movement.player_id, collapsed.size());
+                collapsed.push_back(std::move(movement));
+            }
+            else
+            {
+                auto& first(collapsed[it->second]);
+                first.to_table_name = std::move(movement.to_table_name);
+                first.to_seat_name = std::move(movement.to_seat_name);
+            }
+        }
+
+        collapsed.erase(std::remove_if(collapsed.begin(), collapsed.end(), [](const td::player_movement& m)
+        {
+            return m.from_table_name == m.to_table_name && m.from_seat_name == m.to_seat_name;
+        }),
+                        collapsed.end());
+
+        movements.swap(collapsed);
         return movements;
     }
 
@@ -1447,10 +2100,7 @@ public:
         if(tables_needed != this->table_count)
         {
             // set state dirty
-            this->dirty = true;
-
-            // reset empty seats
-            this->empty_seats.clear();
+            this->touch(changed_seating);
 
             // set new number of tables
             this->table_count = tables_needed;
@@ -1460,52 +2110,105 @@ public:
             logger(ll::info) << "prefer: " << preferred_seats << " seats per table\n";
 
             // build up preferred seat list
+            std::vector<td::seat> all_seats;
             for(std::size_t t(0); t < this->table_count; t++)
             {
                 for(std::size_t s(0); s < preferred_seats; s++)
                 {
-                    this->empty_seats.emplace_back(t, s);
+                    all_seats.emplace_back(t, s);
                 }
             }
 
-            // store iterator to start of extra seats
-            auto extra_it(this->empty_seats.end());
+            // store offset to start of extra seats
+            auto extra_offset(all_seats.size());
 
             // add remaining seats, up to table capacity
             for(std::size_t t(0); t < this->table_count; t++)
             {
                 for(std::size_t s(preferred_seats); s < this->table_capacity; s++)
                 {
-                    this->empty_seats.emplace_back(t, s);
+                    all_seats.emplace_back(t, s);
                 }
             }
 
             // randomize preferred then extra seats separately
-            std::shuffle(this->empty_seats.begin(), extra_it, this->random_engine);
-            std::shuffle(extra_it, this->empty_seats.end(), this->random_engine);
+            std::shuffle(all_seats.begin(), all_seats.begin() + extra_offset, this->random_engine);
+            std::shuffle(all_seats.begin() + extra_offset, all_seats.end(), this->random_engine);
+            this->empty_seats.assign(all_seats);
+
+            // each table takes a balanced share of the seated players. larger shares go to the tables where
+            // the most players can stay, so that as few players as possible move
+            std::vector<std::size_t> staying(this->table_count);
+            for(const auto& p : this->seats)
+            {
+                if(p.second.table_number < this->table_count && p.second.seat_number < this->table_capacity)
+                {
+                    staying[p.second.table_number]++;
+                }
+            }
+            std::vector<std::size_t> by_staying(this->table_count);
+            std::iota(by_staying.begin(), by_staying.end(), 0);
+            std::stable_sort(by_staying.begin(), by_staying.end(), [&staying](std::size_t t0, std::size_t t1)
+            {
+                return staying[t0] > staying[t1];
+            });
+            std::vector<std::size_t> share(this->table_count, this->seats.size() / this->table_count);
+            for(std::size_t i(0); i < this->seats.size() % this->table_count; i++)
+            {
+                share[by_staying[i]]++;
+            }
 
-            // re-seat players and record movements
-            std::unordered_map<td::player_id_t, td::seat> new_seats;
+            // players stay in their seats while their table's share allows
+            player_map<td::seat> new_seats;
+            std::vector<player_handle_t> moving;
             for(const auto& p : this->seats)
             {
-                // seat player and remove from empty list
-                auto seat(this->empty_seats.front());
-                new_seats.insert(std::make_pair(p.first, seat));
-                this->empty_seats.pop_front();
+                auto table(p.second.table_number);
+                if(table < this->table_count && p.second.seat_number < this->table_capacity && share[table] != 0)
+                {
+                    share[table]--;
+                    new_seats.insert(p);
+                    this->empty_seats.erase(p.second);
+                }
+                else
+                {
+                    moving.push_back(p.first);
+                }
+            }
+
+            // the rest take the first seats in fill order at tables with share left, and record movements
+            std::size_t moved(0);
+            for(const auto& seat : this->empty_seats.ordered())
+            {
+                if(moved == moving.size())
+                {
+                    break;
+                }
+
+                if(share[seat.table_number] == 0)
+                {
+                    continue;
+                }
 
-                // record movement
-                movements.emplace_back(p.first,
-                                       this->player_name(p.first),
-                                       this->table_name(p.second.table_number),
-                                       this->seat_name(p.second.seat_number),
+                share[seat.table_number]--;
+                this->empty_seats.erase(seat);
+
+                auto player_id(moving[moved++]);
+                const auto& from_seat(this->seats.find(player_id)->second);
+                new_seats.insert(std::make_pair(player_id, seat));
+                movements.emplace_back(this->settings->player_ids[player_id],
+                                       this->player_name(player_id),
+                                       this->table_name(from_seat.table_number),
+                                       this->seat_name(from_seat.seat_number),
                                        this->table_name(seat.table_number),
                                        this->seat_name(seat.seat_number));
             }
 
             // swap
             std::swap(new_seats, this->seats);
+            this->index_seats();
 
-            logger(ll::info) << "created " << this->empty_seats.size() << " empty seats for " << max_expected << " expected players, re-seating " << new_seats.size() << " players\n";
+            logger(ll::info) << "created " << this->empty_seats.size() << " empty seats for " << max_expected << " expected players, re-seating " << moving.size() << " of " << this->seats.size() << " players\n";
         }
 
         return minimize_player_movements(movements);
@@ -1513,14 +2216,19 @@ public:
 
     // add player to an existing game
     std::pair<std::string, td::seated_player> add_player(const td::player_id_t& player_id)
+    {
+        return this->add_player(this->player_handle(player_id));
+    }
+
+    std::pair<std::string, td::seated_player> add_player(player_handle_t player_id)
     {
         // find player in existing seating plan
         auto seat_it(this->seats.find(player_id));
         if(seat_it != this->seats.end())
         {
             // create a seated player struct
-            td::seated_player seated(player_id,
-                                     this->buyins.find(player_id) != this->buyins.end(),
+            td::seated_player seated(this->settings->player_ids[player_id],
+                                     this->buyins.count(player_id) != 0,
                                      this->player_name(player_id),
                                      this->table_name(seat_it->second.table_number),
                                      this->seat_name(seat_it->second.seat_number),
@@ -1531,14 +2239,15 @@ public:
         }
         else
         {
+            this->require_player(player_id);
             logger(ll::info) << "adding player " << this->player_description(player_id) << " to game\n";
 
             // seat the player
             auto seat(this->seat_player(player_id));
 
             // create a seated_player struct
-            td::seated_player seated(player_id,
-                                     this->buyins.find(player_id) != this->buyins.end(),
+            td::seated_player seated(this->settings->player_ids[player_id],
+                                     this->buyins.count(player_id) != 0,
                                      this->player_name(player_id),
                                      this->table_name(seat.table_number),
                                      this->seat_name(seat.seat_number),
@@ -1552,6 +2261,12 @@ public:
     // remove a player
     void remove_player(const td::player_id_t& player_id)
     {
+        this->remove_player(this->player_handle(player_id));
+    }
+
+    void remove_player(player_handle_t player_id)
+    {
+        this->require_player(player_id);
         logger(ll::info) << "removing player " << this->player_description(player_id) << " from game\n";
 
         auto seat_it(this->seats.find(player_id));
@@ -1561,25 +2276,36 @@ public:
         }
 
         // set state dirty
-        this->dirty = true;
+        this->touch(changed_seating);
 
         // remove player and add seat to the end of the empty list
         auto seat(seat_it->second);
         this->empty_seats.push_front(seat);
+        this->occupancy.remove(seat);
         this->seats.erase(seat_it);
     }
 
     // remove a player
     std::vector<td::player_movement> bust_player(const td::player_id_t& player_id)
+    {
+        auto handle_it(this->settings->player_handles.find(player_id));
+        if(handle_it == this->settings->player_handles.end())
+        {
+            throw td::protocol_error("tried to bust player not bought in");
+        }
+        return this->bust_player(handle_it->second);
+    }
+
+    std::vector<td::player_movement> bust_player(player_handle_t player_id)
     {
         // check whether player is bought in
-        if(this->buyins.find(player_id) == this->buyins.end())
+        if(this->buyins.count(player_id) == 0)
         {
             throw td::protocol_error("tried to bust player not bought in");
         }
 
         // set state dirty
-        this->dirty = true;
+        this->touch(changed_seating | changed_funding | changed_results);
 
         // remove the player
         this->remove_player(player_id);
@@ -1593,7 +2319,48 @@ public:
         // mark as no longer bought in
         this->buyins.erase(player_id);
 
-        // try to break table or rebalance
+        // try to break table or rebalance, unless deferred to the end of a batch
+        std::vector<td::player_movement> movements;
+        if(this->rebalance_deferred)
+        {
+            logger(ll::debug) << "rebalancing deferred until end of batch\n";
+            this->rebalance_pending = true;
+        }
+        else
+        {
+            movements = this->rebalance_after_bust();
+        }
+
+        // collect bought-in players still seated
+        std::vector<player_handle_t> playing;
+        for(const auto& s : this->seats)
+        {
+            if(this->buyins.count(s.first) != 0)
+            {
+                playing.push_back(s.first);
+            }
+        }
+
+        // if only one bought-in players still seated
+        if(playing.size() == 1)
+        {
+            auto first_place_player_id(playing.front());
+
+            // bust player
+            this->bust_player(first_place_player_id);
+
+            logger(ll::info) << "winning player " << this->player_description(first_place_player_id) << '\n';
+
+            // stop the game
+            this->stop();
+        }
+
+        return minimize_player_movements(movements);
+    }
+
+    // break tables or rebalance after a player busts out, according to rebalance policy
+    std::vector<td::player_movement> rebalance_after_bust()
+    {
         std::vector<td::player_movement> movements;
 
         switch(this->rebalance_policy)
@@ -1617,47 +2384,32 @@ public:
             break;
         }
 
-        // collect bought-in players still seated
-        struct collector
-        {
-            const std::unordered_set<td::player_id_t>* container;
-            std::vector<td::player_id_t> playing;
-            collector(const std::unordered_set<td::player_id_t>& c) : container(&c) {}
-            void operator()(const std::pair<td::player_id_t, td::seat>& s)
-            {
-                if(container->find(s.first) != container->end())
-                {
-                    playing.push_back(s.first);
-                }
-            }
-            operator std::vector<td::player_id_t>() const
-            {
-                return playing;
-            }
-        };
-        std::vector<td::player_id_t> playing(std::for_each(this->seats.begin(), this->seats.end(), collector(this->buyins)));
-
-        // if only one bought-in players still seated
-        if(playing.size() == 1)
-        {
-            const auto& first_place_player_id(playing.front());
-
-            // bust player
-            this->bust_player(first_place_player_id);
-
-            logger(ll::info) << "winning player " << this->player_description(first_place_player_id) << '\n';
-
-            // stop the game
-            this->stop();
-        }
+        return movements;
+    }
 
-        return minimize_player_movements(movements);
+    // start a batch of commands: defer automatic rebalancing until its end
+    void begin_batch()
+    {
+        this->rebalance_deferred = true;
+        this->rebalance_pending = false;
     }
 
-    template<typename T>
-    static constexpr bool has_lower_size(const T& i0, const T& i1)
+    // end a batch of commands, rebalancing once if any player busted during it
+    std::vector<td::player_movement> end_batch()
     {
-        return i0.size() < i1.size();
+        this->rebalance_deferred = false;
+
+        std::vector<td::player_movement> movements;
+        if(this->rebalance_pending)
+        {
+            this->rebalance_pending = false;
+            if(!this->seats.empty())
+            {
+                movements = this->rebalance_after_bust();
+                minimize_player_movements(movements);
+            }
+        }
+        return movements;
     }
 
     // try to break tables, then rebalance seating
@@ -1679,14 +2431,7 @@ public:
                 auto break_table(this->table_count - 1);
 
                 // get each player found to be sitting at the breaking table
-                std::vector<td::player_id_t> to_move;
-                for(auto& seat : this->seats)
-                {
-                    if(seat.second.table_number == break_table)
-                    {
-                        to_move.push_back(seat.first);
-                    }
-                }
+                auto to_move(this->occupancy.players_at(break_table));
 
                 // move each player in list
                 const std::unordered_set<std::size_t> avoid = { break_table };
@@ -1696,17 +2441,14 @@ public:
                 }
 
                 // set state dirty
-                this->dirty = true;
+                this->touch(changed_seating);
 
                 // decrement number of tables
                 this->table_count--;
+                this->occupancy.resize(this->table_count);
 
                 // prune empty table from our open seat list, no need to seat people at unused tables
-                this->empty_seats.erase(std::remove_if(this->empty_seats.begin(), this->empty_seats.end(), [&break_table](const td::seat& seat)
-                {
-                    return seat.table_number == break_table;
-                }),
-                                        this->empty_seats.end());
+                this->empty_seats.erase_table(break_table);
 
                 logger(ll::info) << "broken table " << break_table << ". " << this->seats.size() << " players now at " << this->table_count << " tables\n";
             }
@@ -1716,6 +2458,9 @@ public:
             {
                 logger(ll::info) << "randomizing remaining seats\n";
 
+                // set state dirty
+                this->touch(changed_seating);
+
                 // get the current list of seats
                 std::vector<td::seat> to;
                 to.reserve(this->seats.size());
@@ -1731,7 +2476,7 @@ public:
                 for(auto& s : this->seats)
                 {
                     // add a new movement
-                    td::player_movement movement(s.first,
+                    td::player_movement movement(this->settings->player_ids[s.first],
                                                  this->player_name(s.first),
                                                  this->table_name(s.second.table_number),
                                                  this->seat_name(s.second.seat_number),
@@ -1744,36 +2489,28 @@ public:
                     s.second = to.back();
                     to.pop_back();
                 }
+                this->index_seats();
             }
         }
 
-        // build players-per-table vector
-        auto ppt(this->players_at_tables());
-        if(!ppt.empty())
+        if(this->occupancy.table_count() != 0)
         {
             logger(ll::info) << "attempting to rebalance tables\n";
 
-            // find smallest and largest tables
-            auto fewest_it(std::min_element(ppt.begin(), ppt.end(), has_lower_size<std::vector<td::player_id_t>>));
-            auto most_it(std::max_element(ppt.begin(), ppt.end(), has_lower_size<std::vector<td::player_id_t>>));
-
             // if fewest has two fewer players than most (e.g. 6 vs 8), then rebalance
-            while(!most_it->empty() && fewest_it->size() < most_it->size() - 1)
+            auto fewest(this->occupancy.fewest());
+            auto most(this->occupancy.most());
+            while(this->occupancy.count_at(most) != 0 && this->occupancy.count_at(fewest) < this->occupancy.count_at(most) - 1)
             {
-                logger(ll::info) << "largest table has " << most_it->size() << " players and smallest table has " << fewest_it->size() << " players\n";
+                logger(ll::info) << "largest table has " << this->occupancy.count_at(most) << " players and smallest table has " << this->occupancy.count_at(fewest) << " players\n";
 
                 // pick a random player at the table with the most players
-                auto index(std::uniform_int_distribution<std::size_t>(0, most_it->size() - 1)(this->random_engine));
-                auto random_player((*most_it)[index]);
+                auto index(std::uniform_int_distribution<std::size_t>(0, this->occupancy.count_at(most) - 1)(this->random_engine));
+                movements.push_back(this->move_player(this->occupancy.player_at(most, index), fewest));
 
-                // subtract iterator to find table number
-                auto table(static_cast<std::size_t>(fewest_it - ppt.begin()));
-                movements.push_back(this->move_player(random_player, table));
-
-                // update our lists to stay consistent
-                (*most_it)[index] = most_it->back();
-                most_it->pop_back();
-                fewest_it->push_back(random_player);
+                // occupancy is updated by the move, find smallest and largest tables again
+                fewest = this->occupancy.fewest();
+                most = this->occupancy.most();
             }
         }
 
@@ -1783,19 +2520,24 @@ public:
     // fund a player, (re-)buyin or addon
     void fund_player(const td::player_id_t& player_id, const td::funding_source_id_t& src)
     {
-        if(src >= this->funding_sources.size())
+        this->fund_player(this->player_handle(player_id), src);
+    }
+
+    void fund_player(player_handle_t player_id, const td::funding_source_id_t& src)
+    {
+        if(src >= this->settings->funding_sources.size())
         {
             throw td::protocol_error("invalid funding source");
         }
 
-        td::funding_source& source(this->funding_sources[src]);
+        const td::funding_source& source(this->settings->funding_sources[src]);
 
         if(this->current_blind_level > source.forbid_after_blind_level)
         {
             throw td::protocol_error("too late in the game for this funding source");
         }
 
-        if(source.type != td::funding_source_type_t::buyin && this->unique_entries.find(player_id) == this->unique_entries.end())
+        if(source.type != td::funding_source_type_t::buyin && this->unique_entries.count(player_id) == 0)
         {
             throw td::protocol_error("tried a non-buyin funding source but not bought in yet");
         }
@@ -1805,10 +2547,11 @@ public:
             throw td::protocol_error("tried re-buying before tournamnet start");
         }
 
+        this->require_player(player_id);
         logger(ll::info) << "funding player " << this->player_description(player_id) << " with " << source.name << '\n';
 
         // set state dirty
-        this->dirty = true;
+        this->touch(changed_funding | changed_results);
 
         if(source.type == td::funding_source_type_t::buyin)
         {
@@ -1850,25 +2593,25 @@ public:
     //  25/100/500/1000/5000
     std::vector<td::player_chips> chips_for_buyin(const td::funding_source_id_t& src, std::size_t max_expected) const
     {
-        if(src >= this->funding_sources.size())
+        if(src >= this->settings->funding_sources.size())
         {
             throw td::protocol_error("invalid funding source");
         }
 
-        const td::funding_source& source(this->funding_sources[src]);
+        const td::funding_source& source(this->settings->funding_sources[src]);
 
-        if(this->available_chips.empty())
+        if(this->settings->available_chips.empty())
         {
             throw td::protocol_error("tried to calculate chips for a buyin without chips defined");
         }
 
-        if(this->blind_levels.size() < 2)
+        if(this->settings->blind_levels.size() < 2)
         {
             throw td::protocol_error("tried to calcualate chips for a buyin without at least one blind level defined");
         }
 
         // ensure our smallest available chip can play the smallest small blind
-        if(this->available_chips[0].denomination > this->blind_levels[1].little_blind)
+        if(this->settings->available_chips[0].denomination > this->settings->blind_levels[1].little_blind)
         {
             throw td::protocol_error("smallest chip available is larger than the smallest little blind");
         }
@@ -1878,16 +2621,16 @@ public:
 
         // step 1: fund using highest denominaton chips available
         auto remain(source.chips);
-        auto cit(this->available_chips.rbegin());
+        auto cit(this->settings->available_chips.rbegin());
         while(remain > 0)
         {
             // find highest denomination chip less than what remains
-            while(cit != this->available_chips.rend() && cit->denomination > remain)
+            while(cit != this->settings->available_chips.rend() && cit->denomination > remain)
             {
                 cit++;
             }
 
-            if(cit == this->available_chips.rend())
+            if(cit == this->settings->available_chips.rend())
             {
                 throw td::protocol_error("buyin is not a multiple of the smallest chip available");
             }
@@ -1915,7 +2658,7 @@ public:
 
             // step 2: loop through and shoot for stacks of at least 8
             const unsigned long target(8);
-            for(auto cit1(this->available_chips.rbegin()), cit0(cit1 + 1); cit0 != this->available_chips.rend(); cit1++, cit0++)
+            for(auto cit1(this->settings->available_chips.rbegin()), cit0(cit1 + 1); cit0 != this->settings->available_chips.rend(); cit1++, cit0++)
             {
                 auto d0(cit0->denomination);
                 auto d1(cit1->denomination);
@@ -1976,7 +2719,7 @@ public:
     // quickly set up a game (plan, seat, and buyin, using optional funding source)
     std::vector<td::seated_player> quick_setup()
     {
-        if(this->funding_sources.empty())
+        if(this->settings->funding_sources.empty())
         {
             throw td::protocol_error("cannot quick setup with no funding sources");
         }
@@ -1991,10 +2734,11 @@ public:
 
         // seat and fund all players
         std::vector<td::seated_player> seated_players;
-        for(const auto& p : this->players)
+        for(std::size_t i(0); i < this->settings->players.size(); i++)
         {
-            auto seat(this->seat_player(p.player_id));
-            this->fund_player(p.player_id, src);
+            const auto& p(this->settings->players[i]);
+            auto seat(this->seat_player(this->settings->roster[i]));
+            this->fund_player(this->settings->roster[i], src);
 
             // build a seated_player object with numeric seat position
             td::seated_player sp(p.player_id, true, p.name, this->table_name(seat.table_number), this->seat_name(seat.seat_number), seat);
@@ -2021,7 +2765,7 @@ public:
             throw td::protocol_error("tournament already started");
         }
 
-        if(this->blind_levels.size() < 2)
+        if(this->settings->blind_levels.size() < 2)
         {
             throw td::protocol_error("cannot start without blind levels configured");
         }
@@ -2035,7 +2779,7 @@ public:
         this->dirty = true;
 
         // set tournament start time
-        this->tournament_start = sc::now();
+        this->tournament_start = this->now();
     }
 
     void start(const time_point_t& starttime)
@@ -2045,7 +2789,7 @@ public:
             throw td::protocol_error("tournament already started");
         }
 
-        if(this->blind_levels.size() < 2)
+        if(this->settings->blind_levels.size() < 2)
         {
             throw td::protocol_error("cannot start without blind levels configured");
         }
@@ -2101,7 +2845,7 @@ public:
         this->dirty = true;
 
         // save time the clock was paused
-        this->paused_time = sc::now();
+        this->paused_time = this->now();
     }
 
     // resume
@@ -2123,7 +2867,7 @@ public:
         this->dirty = true;
 
         // increment end_of_xxx based on time elapsed since we paused
-        auto now(sc::now());
+        auto now(this->now());
         this->end_of_round += now - this->paused_time;
         this->end_of_break += now - this->paused_time;
 
@@ -2152,7 +2896,7 @@ public:
             throw td::protocol_error("tournament not started");
         }
 
-        if(this->current_blind_level + 1 < this->blind_levels.size())
+        if(this->current_blind_level + 1 < this->settings->blind_levels.size())
         {
             logger(ll::info) << "setting next blind level from " << this->current_blind_level << " to " << this->current_blind_level + 1 << '\n';
 
@@ -2171,14 +2915,14 @@ public:
             throw td::protocol_error("tournament not started");
         }
 
-        if(this->current_blind_level >= this->blind_levels.size())
+        if(this->current_blind_level >= this->settings->blind_levels.size())
         {
             throw td::protocol_error("current blind level out of bounds");
         }
 
         // calculate elapsed time in this blind level
-        auto time_remaining(std::chrono::duration_cast<duration_t>(this->end_of_round - sc::now()));
-        auto blind_level_elapsed_time(this->blind_levels[this->current_blind_level].duration - time_remaining.count());
+        auto time_remaining(std::chrono::duration_cast<duration_t>(this->end_of_round - this->now()));
+        auto blind_level_elapsed_time(this->settings->blind_levels[this->current_blind_level].duration - time_remaining.count());
 
         // if elapsed time > 2 seconds, just restart current blind level
         if(blind_level_elapsed_time > this->previous_blind_level_hold_duration || this->current_blind_level == 1)
@@ -2201,10 +2945,11 @@ public:
     void update()
     {
         // if not paused, and after end of break, increment blind level
-        if(!this->is_paused() && this->end_of_break != time_point_t() && sc::now() >= this->end_of_break)
+        // after a stall, or when replaying the journal, several levels may have ended: advance through each, as if on time
+        while(!this->is_paused() && this->end_of_break != time_point_t() && this->now() >= this->end_of_break)
         {
-            // advance to next blind
-            auto offset(std::chrono::duration_cast<duration_t>(this->end_of_break - sc::now()));
+            // advance to next blind, counting the time since the break ended as already played
+            auto offset(std::chrono::duration_cast<duration_t>(this->now() - this->end_of_break));
             if(!this->next_blind_level(offset))
             {
                 // if we're at the last blind level, stop the tournament
@@ -2213,12 +2958,38 @@ public:
         }
 
         // if the action clock has expired, reset it so that a new one can be called without the client having to manually reset it
-        if(this->end_of_action_clock != time_point_t() && this->end_of_action_clock <= sc::now())
+        if(this->end_of_action_clock != time_point_t() && this->end_of_action_clock <= this->now())
         {
             this->reset_action_clock();
         }
     }
 
+    // next time the game state changes on its own, or epoch if none
+    time_point_t next_deadline() const
+    {
+        auto now(this->now());
+        time_point_t deadline;
+        auto consider([&now, &deadline](const time_point_t& tp)
+        {
+            if(tp != time_point_t() && tp > now && (deadline == time_point_t() || tp < deadline))
+            {
+                deadline = tp;
+            }
+        });
+
+        // end of round starts the break, end of break advances the blind level (or starts a scheduled tournament)
+        if(!this->is_paused())
+        {
+            consider(this->end_of_round);
+            consider(this->end_of_break);
+        }
+
+        // expiring action clock is reset
+        consider(this->end_of_action_clock);
+
+        return deadline;
+    }
+
     // set the action clock (when someone 'needs the clock called on them'
     void set_action_clock(long duration_milliseconds)
     {
@@ -2227,7 +2998,7 @@ public:
             // set state dirty
             this->dirty = true;
 
-            this->end_of_action_clock = sc::now() + duration_t(duration_milliseconds);
+            this->end_of_action_clock = this->now() + duration_t(duration_milliseconds);
         }
         else
         {
@@ -2263,7 +3034,7 @@ public:
             throw td::protocol_error("tried to create a blind structure without specifying number of expected buyins");
         }
 
-        if(this->available_chips.empty())
+        if(this->settings->available_chips.empty())
         {
             throw td::protocol_error("tried to create a blind structure without chips defined");
         }
@@ -2279,19 +3050,19 @@ public:
         if(expected_buyins > 0)
         {
             const auto src(this->source_for_type(td::funding_source_type_t::buyin));
-            chips_in_play += this->funding_sources[src].chips * expected_buyins;
+            chips_in_play += this->settings->funding_sources[src].chips * expected_buyins;
         }
 
         if(expected_rebuys > 0)
         {
             const auto src(this->source_for_type(td::funding_source_type_t::rebuy));
-            chips_in_play += this->funding_sources[src].chips * expected_rebuys;
+            chips_in_play += this->settings->funding_sources[src].chips * expected_rebuys;
         }
 
         if(expected_addons > 0)
         {
             const auto src(this->source_for_type(td::funding_source_type_t::addon));
-            chips_in_play += this->funding_sources[src].chips * expected_addons;
+            chips_in_play += this->settings->funding_sources[src].chips * expected_addons;
         }
 
         if(chips_in_play == 0)
@@ -2309,7 +3080,7 @@ public:
         auto count(rounds_in_play + rounds_in_play / 10 + 1);
 
         // first round small blind = smallest chip denomination
-        auto first_round_sb(this->available_chips.begin()->denomination);
+        auto first_round_sb(this->settings->available_chips.begin()->denomination);
 
         // last round small blind
         auto last_round_sb(chips_in_play / (bb_at_end * 2));
@@ -2330,8 +3101,11 @@ public:
         return this->gen_count_blind_levels(static_cast<std::size_t>(count), level_duration, chip_up_break_duration, blind_increase_factor, antes, ante_sb_ratio);
     }
 
-    impl() : blind_levels(1)
+    impl()
     {
+        auto s(std::make_shared<configuration_data>());
+        s->blind_levels.resize(1);
+        this->settings = s;
     }
 };
 
@@ -2339,8 +3113,40 @@ gameinfo::gameinfo() : pimpl(new impl())
 {
 }
 
+gameinfo::gameinfo(std::unique_ptr<impl> copy) : pimpl(std::move(copy))
+{
+}
+
 gameinfo::~gameinfo() = default;
 
+// start a batch of commands, deferring automatic rebalancing. if can_roll_back, save all configuration and state first
+void gameinfo::begin_batch(bool can_roll_back)
+{
+    this->pimpl->begin_batch();
+    if(can_roll_back)
+    {
+        this->saved.reset(new impl(*this->pimpl));
+    }
+}
+
+// restore configuration and state saved at the start of the batch
+void gameinfo::roll_back_batch()
+{
+    if(!this->saved)
+    {
+        throw std::logic_error("no batch to roll back");
+    }
+    logger(ll::info) << "rolling back batch\n";
+    this->pimpl = std::move(this->saved);
+}
+
+// end a batch of commands, returning any movements from the deferred rebalance
+std::vector<td::player_movement> gameinfo::end_batch()
+{
+    this->saved.reset();
+    return this->pimpl->end_batch();
+}
+
 // load configuration from JSON (object or file)
 void gameinfo::configure(const nlohmann::json& config)
 {
@@ -2371,7 +3177,42 @@ void gameinfo::dump_derived_state(nlohmann::json& state) const
     this->pimpl->dump_derived_state(state);
 }
 
+// write state, configuration state and derived state as one JSON object, the same text as dumping all three
+void gameinfo::write_state(json_writer& writer) const
+{
+    this->pimpl->write_state(writer);
+}
+
+// dump random number engine state to JSON, for snapshots
+void gameinfo::dump_random_state(nlohmann::json& snapshot) const
+{
+    this->pimpl->dump_random_state(snapshot);
+}
+
+// restore random number engine state from JSON, if present
+void gameinfo::load_random_state(const nlohmann::json& snapshot)
+{
+    this->pimpl->load_random_state(snapshot);
+}
+
+// use given time instead of the system clock, or the system clock again if epoch
+void gameinfo::set_clock_override(const std::chrono::system_clock::time_point& now)
+{
+    this->pimpl->set_clock_override(now);
+}
+
+// independent copy of configuration and state, its clock stopped at the time of the copy
+std::shared_ptr<const gameinfo> gameinfo::snapshot() const
+{
+    return std::shared_ptr<const gameinfo>(new gameinfo(this->pimpl->snapshot()));
+}
+
 // has internal state been updated since last check?
+std::size_t gameinfo::derived_sections_built() const
+{
+    return this->pimpl->derived_sections_built();
+}
+
 bool gameinfo::state_is_dirty()
 {
     return this->pimpl->state_is_dirty();
@@ -2495,6 +3336,12 @@ void gameinfo::update()
     this->pimpl->update();
 }
 
+// next time the game state changes on its own, or epoch if none
+std::chrono::system_clock::time_point gameinfo::next_deadline() const
+{
+    return this->pimpl->next_deadline();
+}
+
 // set the action clock (when someone 'needs the clock called on them'
 void gameinfo::set_action_clock(long duration_milliseconds)
 {
@@ -1,11 +1,13 @@
 #pragma once
 #include "nlohmann/json_fwd.hpp"
 #include "types.hpp"
+#include <chrono>
 #include <memory>
 #include <string>
 #include <vector>
 
 class datetime;
+class json_writer;
 
 class gameinfo
 {
@@ -13,6 +15,12 @@ class gameinfo
     class impl;
     std::unique_ptr<impl> pimpl;
 
+    // copy saved at the start of a batch, for roll back
+    std::unique_ptr<impl> saved;
+
+    // wrap a copy (for snapshot)
+    explicit gameinfo(std::unique_ptr<impl> copy);
+
 public:
     gameinfo();
     ~gameinfo();
@@ -38,6 +46,24 @@ public:
     // calculate derived state and dump to JSON
     void dump_derived_state(nlohmann::json& state) const;
 
+    // write state, configuration state and derived state as one JSON object, the same text as dumping all three
+    void write_state(json_writer& writer) const;
+
+    // random number engine state, dumped to and loaded from snapshots
+    void dump_random_state(nlohmann::json& snapshot) const;
+    void load_random_state(const nlohmann::json& snapshot);
+
+    // use given time instead of the system clock (when replaying a journal), or the system clock again if epoch
+    void set_clock_override(const std::chrono::system_clock::time_point& now);
+
+    // independent copy of configuration and state, its clock stopped at the time of the copy
+    // for other threads to read and serialize, even at the same time, while this one carries on
+    // derived state is not built here, but by the first thread to serialize it, and shared until its inputs change
+    std::shared_ptr<const gameinfo> snapshot() const;
+
+    // number of derived state sections built so far, by this game and every copy of it
+    std::size_t derived_sections_built() const;
+
     // has internal state been updated since last check?
     bool state_is_dirty();
 
@@ -64,6 +90,18 @@ public:
     // returns description of movements
     std::vector<td::player_movement> rebalance_seating();
 
+    // ----- batching -----
+
+    // start a batch of commands, deferring automatic rebalancing to its end. if can_roll_back, save all configuration and state first
+    void begin_batch(bool can_roll_back);
+
+    // restore configuration and state saved at the start of the batch
+    void roll_back_batch();
+
+    // end a batch of commands
+    // returns any player movements from one rebalance, if players busted during the batch
+    std::vector<td::player_movement> end_batch();
+
     // ----- funding -----
 
     // fund a player, (re-)buyin or addon
@@ -111,6 +149,9 @@ public:
     // update game state
     void update();
 
+    // next time the game state changes on its own (end of round or break, action clock expiry), or epoch if none
+    std::chrono::system_clock::time_point next_deadline() const;
+
     // set the action clock (when someone 'needs the clock called on them'
     void set_action_clock(long duration_milliseconds);
 
@@ -0,0 +1,346 @@
+#include "journal.hpp"
+#include "logger.hpp"
+#include <cerrno> // for errno
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+static int open_append(const char* path, bool truncate)
+{
+    return ::_open(path, _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY | (truncate ? _O_TRUNC : 0), _S_IREAD | _S_IWRITE);
+}
+static long write_fd(int fd, const char* data, std::size_t size)
+{
+    return ::_write(fd, data, static_cast<unsigned int>(size));
+}
+static int sync_fd(int fd)
+{
+    return ::_commit(fd);
+}
+static int close_fd(int fd)
+{
+    return ::_close(fd);
+}
+#else
+static int open_append(const char* path, bool truncate)
+{
+    return ::open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC | (truncate ? O_TRUNC : 0), 0600);
+}
+static long write_fd(int fd, const char* data, std::size_t size)
+{
+    return ::write(fd, data, size);
+}
+static int sync_fd(int fd)
+{
+    return ::fsync(fd);
+}
+static int close_fd(int fd)
+{
+    return ::close(fd);
+}
+#endif
+
+struct journal::impl
+{
+    // entries appended up to a rotation, or since the last one
+    struct segment
+    {
+        std::string data;
+        std::size_t entries {};
+
+        // once written and synced, move the file here and start a new one
+        std::string rotate_to;
+    };
+
+    // a function waiting for entries to be durable
+    struct waiter
+    {
+        std::uint64_t appended;
+        std::function<void()> fn;
+    };
+
+    std::string path;
+
+    // owned by the writer thread, or by whoever holds the mutex while it is idle
+    int fd;
+
+    // entries taken from a segment whose write failed part way, retried with the next
+    std::string unwritten;
+
+    // guards everything below it
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    // entries not yet taken by the writer thread. never empty: appends go to the last segment
+    std::deque<segment> segments { 1 };
+
+    // functions waiting for entries to be durable, in the order registered
+    std::deque<waiter> waiters;
+
+    // entries appended ever, entries written and synced (or failed) ever, and entries appended since open, truncate or rotate
+    std::uint64_t appended {};
+    std::uint64_t completed {};
+    std::size_t entries {};
+
+    bool writing {};
+    bool stopping {};
+
+    // declared last, so everything it uses exists before it starts
+    std::thread thread;
+
+    explicit impl(const std::string& p) : path(p), fd(open_append(p.c_str(), false))
+    {
+        if(this->fd < 0)
+        {
+            throw std::system_error(errno, std::system_category(), "open");
+        }
+        logger(ll::debug) << "opened journal " << this->path << '\n';
+        this->thread = std::thread(&impl::run, this);
+    }
+
+    ~impl()
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->wake.notify_all();
+        this->thread.join();
+        close_fd(this->fd);
+    }
+
+    // is there a segment for the writer thread. caller holds the mutex
+    bool has_work() const
+    {
+        const auto& front(this->segments.front());
+        return !front.data.empty() || !front.rotate_to.empty() || this->segments.size() > 1;
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        for(;;)
+        {
+            this->wake.wait(lock, [this] { return this->stopping || this->has_work(); });
+            if(!this->has_work())
+            {
+                // stopping, nothing left to write
+                return;
+            }
+
+            // take the oldest segment, leaving appends to go on while we write. a rotated segment is never the last one
+            segment taken(std::move(this->segments.front()));
+            if(this->segments.size() > 1)
+            {
+                this->segments.pop_front();
+            }
+            else
+            {
+                this->segments.front() = segment();
+            }
+            this->writing = true;
+            lock.unlock();
+
+            // entries in this pass are synced together
+            this->unwritten.append(taken.data);
+            this->write_unwritten();
+            if(!taken.rotate_to.empty())
+            {
+                this->rotate_file(taken.rotate_to);
+            }
+
+            // whatever waited for these entries can go on, even if they failed to write
+            std::vector<std::function<void()>> ready;
+            lock.lock();
+            this->completed += taken.entries;
+            this->writing = false;
+            while(!this->waiters.empty() && this->waiters.front().appended <= this->completed)
+            {
+                ready.push_back(std::move(this->waiters.front().fn));
+                this->waiters.pop_front();
+            }
+            lock.unlock();
+
+            for(auto& fn : ready)
+            {
+                fn();
+            }
+
+            lock.lock();
+            this->done.notify_all();
+        }
+    }
+
+    // write and sync everything unwritten, keeping whatever failed to write for the next pass. writer thread
+    void write_unwritten()
+    {
+        if(this->unwritten.empty())
+        {
+            return;
+        }
+
+        try
+        {
+            std::size_t written(0);
+            while(written < this->unwritten.size())
+            {
+                auto len(write_fd(this->fd, this->unwritten.data() + written, this->unwritten.size() - written));
+                if(len < 0)
+                {
+                    if(errno == EINTR)
+                    {
+                        continue;
+                    }
+                    this->unwritten.erase(0, written);
+                    throw std::system_error(errno, std::system_category(), "write");
+                }
+                written += static_cast<std::size_t>(len);
+            }
+            this->unwritten.clear();
+
+            if(sync_fd(this->fd) != 0)
+            {
+                throw std::system_error(errno, std::system_category(), "fsync");
+            }
+        }
+        catch(const std::exception& e)
+        {
+            logger(ll::error) << "failed to sync journal " << this->path << ": " << e.what() << '\n';
+        }
+    }
+
+    // move the journal file aside and start a new one. writer thread
+    void rotate_file(const std::string& previous_path)
+    {
+        close_fd(this->fd);
+        std::remove(previous_path.c_str());
+        if(std::rename(this->path.c_str(), previous_path.c_str()) != 0)
+        {
+            logger(ll::warning) << "failed to rotate journal " << this->path << '\n';
+        }
+
+        // if this fails, every later write fails and is logged
+        this->fd = open_append(this->path.c_str(), false);
+        if(this->fd < 0)
+        {
+            logger(ll::error) << "failed to reopen journal " << this->path << '\n';
+        }
+    }
+};
+
+journal::journal(const std::string& path) : pimpl(new impl(path))
+{
+}
+
+journal::~journal() = default;
+
+// call handler with each complete entry of the journal file at path
+std::size_t journal::read(const std::string& path, const std::function<void(const std::string&)>& handle_entry)
+{
+    std::ifstream stream(path, std::ios::binary);
+    std::size_t count(0);
+    std::string entry;
+    while(std::getline(stream, entry))
+    {
+        // entry without a newline was torn by a crash
+        if(stream.eof())
+        {
+            logger(ll::warning) << "ignoring partial entry at end of journal " << path << '\n';
+            break;
+        }
+        handle_entry(entry);
+        count++;
+    }
+    return count;
+}
+
+// append an entry
+void journal::append(const std::string& entry)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->pimpl->mutex);
+        auto& back(this->pimpl->segments.back());
+        back.data.append(entry);
+        back.data.push_back('\n');
+        back.entries++;
+        this->pimpl->appended++;
+        this->pimpl->entries++;
+    }
+    this->pimpl->wake.notify_all();
+}
+
+// call fn once every entry appended so far is durable
+void journal::when_durable(std::function<void()> fn)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->pimpl->mutex);
+        if(this->pimpl->completed < this->pimpl->appended)
+        {
+            this->pimpl->waiters.push_back({ this->pimpl->appended, std::move(fn) });
+            return;
+        }
+    }
+    fn();
+}
+
+// block until every entry appended so far is durable
+void journal::sync()
+{
+    std::unique_lock<std::mutex> lock(this->pimpl->mutex);
+    auto target(this->pimpl->appended);
+    this->pimpl->done.wait(lock, [this, target] { return this->pimpl->completed >= target; });
+}
+
+// move entries appended so far to previous_path once they are durable
+void journal::rotate(const std::string& previous_path)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->pimpl->mutex);
+        this->pimpl->segments.back().rotate_to = previous_path;
+        this->pimpl->segments.emplace_back();
+        this->pimpl->entries = 0;
+    }
+    this->pimpl->wake.notify_all();
+}
+
+// number of entries appended since open, truncate or rotate
+std::size_t journal::size() const
+{
+    std::lock_guard<std::mutex> lock(this->pimpl->mutex);
+    return this->pimpl->entries;
+}
+
+// discard all entries
+void journal::truncate()
+{
+    // wait for the writer thread to go idle, so the file is ours
+    std::unique_lock<std::mutex> lock(this->pimpl->mutex);
+    this->pimpl->done.wait(lock, [this] { return !this->pimpl->writing && !this->pimpl->has_work(); });
+
+    auto fd(open_append(this->pimpl->path.c_str(), true));
+    if(fd < 0)
+    {
+        throw std::system_error(errno, std::system_category(), "open");
+    }
+    close_fd(this->pimpl->fd);
+    this->pimpl->fd = fd;
+    this->pimpl->unwritten.clear();
+    this->pimpl->entries = 0;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+
+// append-only log of one-line entries, written and made durable in groups on a background thread, so the caller never waits for storage
+class journal
+{
+    // pimpl
+    struct impl;
+    std::unique_ptr<impl> pimpl;
+
+public:
+    // open journal at path for appending, creating it if needed
+    explicit journal(const std::string& path);
+
+    // finish writing and syncing every appended entry, then stop
+    ~journal();
+
+    // Non-copyable, non-movable (manages unique resources)
+    journal(const journal&) = delete;
+    journal& operator=(const journal&) = delete;
+    journal(journal&&) = delete;
+    journal& operator=(journal&&) = delete;
+
+    // call handler with each complete entry of the journal file at path, in order. a partially written last entry is ignored
+    // returns number of entries read
+    static std::size_t read(const std::string& path, const std::function<void(const std::string&)>& handle_entry);
+
+    // append an entry, which must not contain a newline. it is written and synced together with any others appended meanwhile
+    void append(const std::string& entry);
+
+    // call fn once every entry appended so far is durable (or failed to write, which is logged): on the journal's thread, or right away if nothing is waiting
+    void when_durable(std::function<void()> fn);
+
+    // block until every entry appended so far is durable
+    void sync();
+
+    // move entries appended so far to previous_path once they are durable, replacing any file there. later entries start a new file at path
+    void rotate(const std::string& previous_path);
+
+    // number of entries appended since the journal was opened, truncated or rotated
+    std::size_t size() const;
+
+    // discard all entries, once a checkpoint holds their effects
+    void truncate();
+};
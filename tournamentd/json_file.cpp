@@ -0,0 +1,64 @@
+#include "json_file.hpp"
+#include <fstream>
+#include <iterator>
+
+// CBOR self-describe tag (55799), marking the start of a CBOR file
+static const char CBOR_MAGIC[] = { '\xd9', '\xd9', '\xf7' };
+
+static bool ends_with(const std::string& str, const std::string& suffix)
+{
+    return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// format to write to a file, by its name. reading never looks at the name
+json_file_format json_file_format_for(const std::string& path)
+{
+    return ends_with(path, ".cbor") ? json_file_format::cbor : json_file_format::text;
+}
+
+// read a JSON text or CBOR file: CBOR if it starts with the self-describe tag, otherwise JSON text, whatever the file is called
+bool load_json_file(const std::string& path, nlohmann::json& data)
+{
+    std::ifstream stream(path, std::ios::binary);
+    if(!stream.good())
+    {
+        return false;
+    }
+
+    // read the whole file with one allocation
+    std::string contents;
+    stream.seekg(0, std::ios::end);
+    auto size(stream.tellg());
+    stream.seekg(0, std::ios::beg);
+    if(size > 0)
+    {
+        contents.resize(static_cast<std::size_t>(size));
+        stream.read(&contents[0], size);
+        contents.resize(static_cast<std::size_t>(stream.gcount()));
+    }
+
+    if(contents.compare(0, sizeof(CBOR_MAGIC), CBOR_MAGIC, sizeof(CBOR_MAGIC)) == 0)
+    {
+        data = nlohmann::json::from_cbor(contents.begin(), contents.end(), true, true, nlohmann::json::cbor_tag_handler_t::ignore);
+    }
+    else
+    {
+        data = nlohmann::json::parse(contents.begin(), contents.end());
+    }
+    return true;
+}
+
+// serialize data in the given format
+std::string serialize_json(const nlohmann::json& data, json_file_format format)
+{
+    if(format == json_file_format::cbor)
+    {
+        std::string bytes(std::begin(CBOR_MAGIC), std::end(CBOR_MAGIC));
+        nlohmann::json::to_cbor(data, bytes);
+        return bytes;
+    }
+    else
+    {
+        return data.dump();
+    }
+}
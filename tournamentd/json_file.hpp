@@ -0,0 +1,20 @@
+#pragma once
+#include "nlohmann/json.hpp"
+#include <string>
+
+// formats for configuration and snapshot files
+enum class json_file_format
+{
+    text,
+    cbor
+};
+
+// format to write to a file, by its name: ".cbor" files are CBOR, anything else is JSON text. only a hint for writing
+json_file_format json_file_format_for(const std::string& path);
+
+// read a JSON text or CBOR file, detecting the format from its contents alone: CBOR must begin with the self-describe tag
+// returns false if the file can not be opened, throws if its contents can not be parsed
+bool load_json_file(const std::string& path, nlohmann::json& data);
+
+// serialize data in the given format. CBOR begins with the self-describe tag, so readers can tell it from text
+std::string serialize_json(const nlohmann::json& data, json_file_format format);
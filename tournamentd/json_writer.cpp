@@ -0,0 +1,289 @@
+#include "json_writer.hpp"
+#include "nlohmann/json.hpp"
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+// shortest round-trip formatting, the same nlohmann::json uses for numbers. it is not public library API, so this is the only place it is reached
+static char* format_double(char* first, char* last, double d)
+{
+    return nlohmann::detail::to_chars(first, last, d);
+}
+
+// length of the well-formed UTF-8 sequence at s, or 0 if there is none. the same rules nlohmann::json's serializer applies
+static std::size_t utf8_sequence_length(const unsigned char* s, std::size_t remaining)
+{
+    unsigned char low(0x80), high(0xbf);
+    std::size_t length;
+    if(s[0] >= 0xc2 && s[0] <= 0xdf)
+    {
+        length = 2;
+    }
+    else if(s[0] >= 0xe0 && s[0] <= 0xef)
+    {
+        length = 3;
+        if(s[0] == 0xe0)
+        {
+            low = 0xa0;
+        }
+        else if(s[0] == 0xed)
+        {
+            high = 0x9f;
+        }
+    }
+    else if(s[0] >= 0xf0 && s[0] <= 0xf4)
+    {
+        length = 4;
+        if(s[0] == 0xf0)
+        {
+            low = 0x90;
+        }
+        else if(s[0] == 0xf4)
+        {
+            high = 0x8f;
+        }
+    }
+    else
+    {
+        return 0;
+    }
+
+    if(remaining < length || s[1] < low || s[1] > high)
+    {
+        return 0;
+    }
+    for(std::size_t i(2); i < length; i++)
+    {
+        if(s[i] < 0x80 || s[i] > 0xbf)
+        {
+            return 0;
+        }
+    }
+    return length;
+}
+
+// let the DOM serializer throw its own type_error for the string, so both paths fail identically
+[[noreturn]] static void throw_invalid_utf8(const char* s, std::size_t length)
+{
+    nlohmann::json(std::string(s, length)).dump();
+    throw std::logic_error("json_writer: invalid UTF-8");
+}
+
+json_writer::json_writer(std::string& o) : out(o)
+{
+}
+
+// write the separator needed before a value or key at the current position
+void json_writer::separate()
+{
+    if(this->after_key)
+    {
+        this->after_key = false;
+        return;
+    }
+
+    if(this->depth != 0)
+    {
+        auto bit(1ULL << (this->depth - 1));
+        if(this->nonempty & bit)
+        {
+            this->out.push_back(',');
+        }
+        this->nonempty |= bit;
+    }
+}
+
+void json_writer::close(char c)
+{
+    if(this->depth == 0)
+    {
+        throw std::logic_error("json_writer: nothing to close");
+    }
+
+    this->depth--;
+    this->nonempty &= ~(1ULL << this->depth);
+    this->out.push_back(c);
+}
+
+void json_writer::append_integer(unsigned long long value, bool negative)
+{
+    char digits[24];
+    std::size_t length(0);
+    do
+    {
+        digits[length++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while(value != 0);
+
+    if(negative)
+    {
+        this->out.push_back('-');
+    }
+    while(length != 0)
+    {
+        this->out.push_back(digits[--length]);
+    }
+}
+
+// escape as nlohmann::json::dump() does without ensure_ascii: quotes, backslashes and control characters only. invalid UTF-8 throws as dump() does
+void json_writer::append_string(const char* s, std::size_t length)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    this->out.push_back('"');
+    for(std::size_t i(0); i < length; i++)
+    {
+        auto c(static_cast<unsigned char>(s[i]));
+        switch(c)
+        {
+        case '\b':
+            this->out.append("\\b");
+            break;
+        case '\t':
+            this->out.append("\\t");
+            break;
+        case '\n':
+            this->out.append("\\n");
+            break;
+        case '\f':
+            this->out.append("\\f");
+            break;
+        case '\r':
+            this->out.append("\\r");
+            break;
+        case '"':
+            this->out.append("\\\"");
+            break;
+        case '\\':
+            this->out.append("\\\\");
+            break;
+        default:
+            if(c < 0x20)
+            {
+                this->out.append("\\u00");
+                this->out.push_back(hex[c >> 4]);
+                this->out.push_back(hex[c & 0xf]);
+            }
+            else if(c < 0x80)
+            {
+                this->out.push_back(static_cast<char>(c));
+            }
+            else
+            {
+                auto sequence(utf8_sequence_length(reinterpret_cast<const unsigned char*>(s) + i, length - i));
+                if(sequence == 0)
+                {
+                    throw_invalid_utf8(s, length);
+                }
+                this->out.append(s + i, sequence);
+                i += sequence - 1;
+            }
+            break;
+        }
+    }
+    this->out.push_back('"');
+}
+
+json_writer& json_writer::begin_object()
+{
+    this->separate();
+    if(this->depth == 64)
+    {
+        throw std::logic_error("json_writer: nested too deeply");
+    }
+    this->depth++;
+    this->out.push_back('{');
+    return *this;
+}
+
+json_writer& json_writer::end_object()
+{
+    this->close('}');
+    return *this;
+}
+
+json_writer& json_writer::begin_array()
+{
+    this->separate();
+    if(this->depth == 64)
+    {
+        throw std::logic_error("json_writer: nested too deeply");
+    }
+    this->depth++;
+    this->out.push_back('[');
+    return *this;
+}
+
+json_writer& json_writer::end_array()
+{
+    this->close(']');
+    return *this;
+}
+
+json_writer& json_writer::key(const char* k)
+{
+    this->separate();
+    this->append_string(k, std::strlen(k));
+    this->out.push_back(':');
+    this->after_key = true;
+    return *this;
+}
+
+json_writer& json_writer::key(const std::string& k)
+{
+    this->separate();
+    this->append_string(k.data(), k.size());
+    this->out.push_back(':');
+    this->after_key = true;
+    return *this;
+}
+
+json_writer& json_writer::value(std::nullptr_t)
+{
+    this->separate();
+    this->out.append("null");
+    return *this;
+}
+
+json_writer& json_writer::value(bool b)
+{
+    this->separate();
+    this->out.append(b ? "true" : "false");
+    return *this;
+}
+
+json_writer& json_writer::value(double d)
+{
+    this->separate();
+    if(!std::isfinite(d))
+    {
+        this->out.append("null");
+        return *this;
+    }
+
+    char buffer[64];
+    auto end(format_double(buffer, buffer + sizeof(buffer), d));
+    this->out.append(buffer, static_cast<std::size_t>(end - buffer));
+    return *this;
+}
+
+json_writer& json_writer::value(const char* s)
+{
+    this->separate();
+    this->append_string(s, std::strlen(s));
+    return *this;
+}
+
+json_writer& json_writer::value(const std::string& s)
+{
+    this->separate();
+    this->append_string(s.data(), s.size());
+    return *this;
+}
+
+json_writer& json_writer::raw(const std::string& json_text)
+{
+    this->separate();
+    this->out.append(json_text);
+    return *this;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+// writes JSON text straight into a string, without building a document first
+// the text matches nlohmann::json::dump() of the same document, as long as object keys are written in sorted order
+// like dump(), a string that is not valid UTF-8 throws nlohmann::json::type_error
+class json_writer
+{
+    std::string& out;
+
+    // per nesting level (up to 64): whether the open object or array has anything in it yet
+    std::uint64_t nonempty { 0 };
+    std::size_t depth { 0 };
+
+    // a key was just written, so its value needs no separator
+    bool after_key { false };
+
+    void separate();
+    void close(char c);
+    void append_integer(unsigned long long value, bool negative);
+    void append_string(const char* s, std::size_t length);
+
+public:
+    // append to out, which may be reused between documents to avoid allocation
+    explicit json_writer(std::string& out);
+
+    json_writer& begin_object();
+    json_writer& end_object();
+    json_writer& begin_array();
+    json_writer& end_array();
+
+    json_writer& key(const char* k);
+    json_writer& key(const std::string& k);
+
+    json_writer& value(std::nullptr_t);
+    json_writer& value(bool b);
+    json_writer& value(double d);
+    json_writer& value(const char* s);
+    json_writer& value(const std::string& s);
+
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value, json_writer&>::type value(T i)
+    {
+        this->separate();
+        if(i < 0)
+        {
+            // negate in unsigned arithmetic, so the most negative value works too
+            this->append_integer(0ULL - static_cast<unsigned long long>(i), true);
+        }
+        else
+        {
+            this->append_integer(static_cast<unsigned long long>(i), false);
+        }
+        return *this;
+    }
+
+    // write text already serialized as a JSON value
+    json_writer& raw(const std::string& json_text);
+};
@@ -0,0 +1,320 @@
+#include "logger.hpp"
+#include "datetime.hpp"
+#include "outputdebugstringbuf.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// how long the writer sleeps when nobody wakes it
+static const auto WRITE_INTERVAL(std::chrono::milliseconds(20));
+
+// records one thread may have waiting. more than this are dropped, and counted
+static const std::size_t RING_SIZE(512);
+
+namespace
+{
+    struct record
+    {
+        std::chrono::system_clock::time_point time;
+        const char* function;
+        ll level;
+        std::string text;
+    };
+
+    // single-producer, single-consumer ring of records. the logging thread writes at head, the writer reads at tail
+    // slots keep their strings, so a thread that logs steadily stops allocating
+    struct ring
+    {
+        record slots[RING_SIZE];
+        std::atomic<std::size_t> head { 0 };
+        std::atomic<std::size_t> tail { 0 };
+
+        // records the logging thread dropped because the ring was full, since the writer last looked
+        std::atomic<std::uint64_t> dropped { 0 };
+
+        // set when the owning thread exits. the writer frees the ring once it is empty
+        std::atomic<bool> retired { false };
+    };
+
+    // background thread that collects records from every ring and writes them in time order
+    class writer
+    {
+        // guards everything below it
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable written;
+        std::vector<std::shared_ptr<ring>> rings;
+        bool signalled {};
+
+        // flush() asks for a pass by bumping requested, and waits for completed to catch up
+        std::uint64_t requested {};
+        std::uint64_t completed {};
+
+        // records dropped by every thread since the process started
+        std::uint64_t dropped_total {};
+
+        // declared last, so everything it uses exists before it starts
+        std::thread thread;
+
+        // move every waiting record out of the given ring
+        static void take(ring& r, std::vector<record>& out, std::vector<std::string>& spare)
+        {
+            auto tail(r.tail.load(std::memory_order_relaxed));
+            auto head(r.head.load(std::memory_order_acquire));
+            for(; tail != head; tail++)
+            {
+                // leave an empty buffer from an earlier pass in the slot, if there is one
+                auto& slot(r.slots[tail % RING_SIZE]);
+                std::string text;
+                if(!spare.empty())
+                {
+                    text.swap(spare.back());
+                    spare.pop_back();
+                }
+                text.swap(slot.text);
+                out.push_back(record { slot.time, slot.function, slot.level, std::move(text) });
+            }
+            r.tail.store(tail, std::memory_order_release);
+        }
+
+        static void write(std::vector<record>& records, std::vector<std::string>& spare)
+        {
+            if(records.empty())
+            {
+                return;
+            }
+
+            // each ring is in order already; merge them
+            std::stable_sort(records.begin(), records.end(), [](const record& a, const record& b) { return a.time < b.time; });
+
+            static const char* level_string[] = { " DEBUG ", " INFO ", " WARNING ", " ERROR " };
+            std::ostream os(debugstreambuf());
+            os << datetime::local << datetime::setf("%Y-%m-%d %H:%M:%S%f");
+            for(auto& rec : records)
+            {
+                os << datetime(rec.time) << level_string[static_cast<std::size_t>(rec.level)] << rec.function << ": " << rec.text;
+
+                // keep the buffer for the next pass
+                if(spare.size() < RING_SIZE)
+                {
+                    rec.text.clear();
+                    spare.push_back(std::move(rec.text));
+                }
+            }
+            os.flush();
+            records.clear();
+        }
+
+        void run()
+        {
+            std::vector<std::shared_ptr<ring>> current;
+            std::vector<record> records;
+            std::vector<std::string> spare;
+
+            std::unique_lock<std::mutex> lock(this->mutex);
+            for(;;)
+            {
+                this->wake.wait_for(lock, WRITE_INTERVAL, [this] { return this->signalled; });
+                this->signalled = false;
+                auto pass(this->requested);
+                current = this->rings;
+                lock.unlock();
+
+                std::uint64_t dropped(0);
+                for(auto& r : current)
+                {
+                    take(*r, records, spare);
+                    dropped += r->dropped.exchange(0, std::memory_order_relaxed);
+                }
+
+                // report drops in the log itself, whichever levels are enabled
+                if(dropped != 0)
+                {
+                    records.push_back(record { std::chrono::system_clock::now(), "logger", ll::warning, "dropped " + std::to_string(dropped) + " records, logged faster than they could be written\n" });
+                }
+                write(records, spare);
+                current.clear();
+
+                lock.lock();
+                this->dropped_total += dropped;
+
+                // a retired ring gets no more records, so once empty it can go
+                this->rings.erase(std::remove_if(this->rings.begin(), this->rings.end(), [](const std::shared_ptr<ring>& r)
+                {
+                    return r->retired.load(std::memory_order_acquire) && r->tail.load(std::memory_order_relaxed) == r->head.load(std::memory_order_acquire);
+                }), this->rings.end());
+
+                this->completed = pass;
+                this->written.notify_all();
+            }
+        }
+
+    public:
+        writer() : thread(&writer::run, this)
+        {
+            // the writer lives until the process ends, but whatever is waiting should reach the output first
+            std::atexit([]
+            {
+                logstream::flush();
+            });
+        }
+
+        // give the writer a ring to read from
+        void add(const std::shared_ptr<ring>& r)
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->rings.push_back(r);
+        }
+
+        // start a pass now rather than at the next interval
+        void notify()
+        {
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->signalled = true;
+            }
+            this->wake.notify_one();
+        }
+
+        // start a pass and wait for it to finish
+        void flush()
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            auto pass(++this->requested);
+            this->signalled = true;
+            this->wake.notify_one();
+            this->written.wait(lock, [this, pass] { return this->completed >= pass; });
+        }
+
+        // records dropped so far, as of the last pass
+        std::uint64_t dropped()
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->dropped_total;
+        }
+    };
+
+    // never destroyed: threads may still log while static objects are torn down
+    writer& get_writer()
+    {
+        static auto w(new writer());
+        return *w;
+    }
+
+    // this thread's ring, registered with the writer the first time the thread logs
+    struct thread_ring
+    {
+        std::shared_ptr<ring> r;
+
+        thread_ring() : r(std::make_shared<ring>())
+        {
+            get_writer().add(this->r);
+        }
+
+        ~thread_ring()
+        {
+            this->r->retired.store(true, std::memory_order_release);
+        }
+    };
+
+    ring& this_thread_ring()
+    {
+        static thread_local thread_ring tr;
+        return *tr.r;
+    }
+
+    // this thread's spare record buffer, traded with a ring slot each time a record is committed
+    std::string& this_thread_text()
+    {
+        static thread_local std::string text;
+        return text;
+    }
+}
+
+#if !defined(DEBUG)
+std::atomic<unsigned> logstream::mask(std::numeric_limits<unsigned>::max() - 1);
+#else
+std::atomic<unsigned> logstream::mask(std::numeric_limits<unsigned>::max());
+#endif
+
+logstream::recordbuf::int_type logstream::recordbuf::overflow(int_type c)
+{
+    if(!traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        this->text.push_back(traits_type::to_char_type(c));
+    }
+    return traits_type::not_eof(c);
+}
+
+std::streamsize logstream::recordbuf::xsputn(const char* s, std::streamsize n)
+{
+    this->text.append(s, static_cast<std::size_t>(n));
+    return n;
+}
+
+logstream::logstream(const char* function, ll level) : std::ostream(nullptr), time(std::chrono::system_clock::now()), function(function), level(level)
+{
+    this->buf.text.swap(this_thread_text());
+    this->rdbuf(&this->buf);
+}
+
+logstream::~logstream()
+{
+    auto& r(this_thread_ring());
+
+    // the writer only falls this far behind if this thread logs faster than the output takes it. rather than wait, drop the record and count it
+    auto head(r.head.load(std::memory_order_relaxed));
+    if(head - r.tail.load(std::memory_order_acquire) >= RING_SIZE)
+    {
+        r.dropped.fetch_add(1, std::memory_order_relaxed);
+        this->buf.text.clear();
+        this->buf.text.swap(this_thread_text());
+        get_writer().notify();
+        return;
+    }
+
+    auto& slot(r.slots[head % RING_SIZE]);
+    slot.time = this->time;
+    slot.function = this->function;
+    slot.level = this->level;
+    slot.text.swap(this->buf.text);
+    r.head.store(head + 1, std::memory_order_release);
+
+    // hand back whatever buffer the slot held, for this thread's next record
+    this->buf.text.clear();
+    this->buf.text.swap(this_thread_text());
+
+    // errors go out now. otherwise, wake the writer once the ring is half full
+    if(this->level == ll::error || head + 1 - r.tail.load(std::memory_order_relaxed) == RING_SIZE / 2)
+    {
+        get_writer().notify();
+    }
+}
+
+// set enabled logs
+void logstream::set_enabled(std::initializer_list<ll> logs)
+{
+    unsigned m(0);
+    for(auto level : logs)
+    {
+        m |= 1U << static_cast<unsigned>(level);
+    }
+    mask.store(m, std::memory_order_relaxed);
+}
+
+void logstream::flush()
+{
+    get_writer().flush();
+}
+
+std::uint64_t logstream::dropped()
+{
+    return get_writer().dropped();
+}
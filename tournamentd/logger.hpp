@@ -1,9 +1,11 @@
 #pragma once
-#include "datetime.hpp"
-#include "outputdebugstringbuf.hpp"
-#include <fstream>
-#include <limits>
-#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <ostream>
+#include <streambuf>
+#include <string>
 
 // Macro to include current function in log
 #if __STDC_VERSION__ < 199901L && __cplusplus < 201103L
@@ -13,7 +15,18 @@
 #define __func__ "<unknown>"
 #endif
 #endif
-#define logger(...) logstream(__func__, __VA_ARGS__)
+
+// levels below this are compiled out, arguments and all. by default only DEBUG builds keep debug logs
+#if !defined(LOGGER_MIN_LEVEL)
+#if defined(DEBUG)
+#define LOGGER_MIN_LEVEL 0
+#else
+#define LOGGER_MIN_LEVEL 1
+#endif
+#endif
+
+// the level is checked first, so nothing after the << is evaluated for a disabled level
+#define logger(level) !logstream::enabled(level) ? (void)0 : logstream::voidify() & logstream(__func__, level)
 #define logger_enable(...) logstream::set_enabled({ __VA_ARGS__ })
 
 enum class ll
@@ -24,60 +37,57 @@ enum class ll
     error = 3
 };
 
-template<typename T>
-class basic_logstream : public std::basic_ostream<T>
+// formats one log record on the calling thread, then hands it to a background thread when the statement ends
+// records wait in a ring buffer per thread: no lock is taken, and the timestamp is formatted and written to debugstreambuf() by the background thread
+// if a thread's ring is full, its record is dropped rather than waited on. the background thread logs how many it dropped
+class logstream : public std::ostream
 {
-    // global mutex to serialize access to basic_logstream and members
-    static std::mutex mutex;
+    // appends to text
+    class recordbuf : public std::streambuf
+    {
+    public:
+        std::string text;
 
-    // lock held for the life of the object to serialize basic_logstream creation and limit number globally to one
-    std::lock_guard<std::mutex> lock;
+    protected:
+        int_type overflow(int_type c) override;
+        std::streamsize xsputn(const char* s, std::streamsize n) override;
+    };
+
+    recordbuf buf;
+    std::chrono::system_clock::time_point time;
+    const char* function;
+    ll level;
 
     // bitmask enabling each log level
-    static unsigned mask;
+    static std::atomic<unsigned> mask;
 
-    // private constructor constructs given streambuf, function name, and log level
-    explicit basic_logstream(std::basic_streambuf<T>* sb, const char* function, ll level) : std::basic_ostream<T>(nullptr), lock(mutex)
-    {
-        // set the streambuf only if given loglevel is allowed by the global mask
-        if((1 << static_cast<size_t>(level)) & mask)
-        {
-            this->rdbuf(sb);
-        }
+public:
+    // start a record for the given function name and log level. use the logger() macro rather than this directly
+    logstream(const char* function, ll level);
 
-        // prepend the time, log level, and function
-        static const char* level_string[] = { " DEBUG ", " INFO ", " WARNING ", " ERROR " };
-        *this << datetime::local << datetime::setf("%Y-%m-%d %H:%M:%S%f") << datetime::now() << level_string[static_cast<size_t>(level)] << function << ": ";
-    }
+    // hand the record to the background thread
+    ~logstream();
 
-public:
-    // public constructor creates a debugstreambuf and constructs given function name and logger level
-    explicit basic_logstream(const char* function, ll level = ll::debug) : basic_logstream(debugstreambuf(), function, level)
+    // is the given level compiled in and enabled
+    static bool enabled(ll level)
     {
+        return static_cast<int>(level) >= LOGGER_MIN_LEVEL && (mask.load(std::memory_order_relaxed) & (1U << static_cast<unsigned>(level))) != 0;
     }
 
     // set enabled logs
-    static void set_enabled(std::initializer_list<ll> logs)
-    {
-        // synchronize access to global mask
-        std::lock_guard<std::mutex> set_lock(basic_logstream<T>::mutex);
+    static void set_enabled(std::initializer_list<ll> logs);
 
-        mask = 0;
-        for(auto level : logs)
+    // wait until every record logged so far, on any thread, has been written or dropped
+    static void flush();
+
+    // number of records dropped so far because their thread's ring was full
+    static std::uint64_t dropped();
+
+    // lets the logger() macro discard the stream in either branch of its conditional
+    struct voidify
+    {
+        void operator&(const std::ostream&) const
         {
-            mask |= 1 << static_cast<size_t>(level);
         }
-    }
+    };
 };
-
-// specializations
-typedef basic_logstream<char> logstream;
-typedef basic_logstream<wchar_t> wlogstream;
-
-// class variables
-template<typename T> std::mutex basic_logstream<T>::mutex;
-#if !defined(DEBUG)
-template<typename T> unsigned basic_logstream<T>::mask = std::numeric_limits<unsigned>::max() - 1;
-#else
-template<typename T> unsigned basic_logstream<T>::mask = std::numeric_limits<unsigned>::max();
-#endif
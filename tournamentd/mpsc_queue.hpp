@@ -0,0 +1,104 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+
+// unbounded multiple-producer, single-consumer queue
+// push never blocks or takes a lock: one atomic exchange links the new node. only one thread may pop
+// the consumer may sleep in wait_for; a producer takes the lock only to wake a consumer that is asleep
+template<typename T>
+class mpsc_queue
+{
+    struct node
+    {
+        std::atomic<node*> next { nullptr };
+        T value;
+
+        node() = default;
+        explicit node(T&& v) : value(std::move(v))
+        {
+        }
+    };
+
+    // producers link onto head. the consumer owns tail, a node whose value has already been taken (or the initial stub)
+    std::atomic<node*> head;
+    node* tail;
+
+    // for a sleeping consumer
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<bool> waiting { false };
+    bool signalled { false };
+
+public:
+    mpsc_queue() : head(new node()), tail(head.load())
+    {
+    }
+
+    ~mpsc_queue()
+    {
+        while(this->tail != nullptr)
+        {
+            auto next(this->tail->next.load());
+            delete this->tail;
+            this->tail = next;
+        }
+    }
+
+    // Non-copyable, non-movable (shared between threads)
+    mpsc_queue(const mpsc_queue&) = delete;
+    mpsc_queue& operator=(const mpsc_queue&) = delete;
+    mpsc_queue(mpsc_queue&&) = delete;
+    mpsc_queue& operator=(mpsc_queue&&) = delete;
+
+    // add a value. any thread
+    void push(T value)
+    {
+        auto n(new node(std::move(value)));
+        auto prev(this->head.exchange(n));
+        prev->next.store(n);
+
+        // the consumer sets waiting before its last look, so either it sees this node or we see it waiting
+        if(this->waiting.load())
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->signalled = true;
+            this->wake.notify_one();
+        }
+    }
+
+    // take the oldest value, returning false if there is none. consumer only
+    // a push still in progress on another thread may not be seen until it completes
+    bool pop(T& value)
+    {
+        auto next(this->tail->next.load(std::memory_order_acquire));
+        if(next == nullptr)
+        {
+            return false;
+        }
+
+        value = std::move(next->value);
+        delete this->tail;
+        this->tail = next;
+        return true;
+    }
+
+    // is there a value to pop. consumer only
+    bool empty() const
+    {
+        return this->tail->next.load() == nullptr;
+    }
+
+    // sleep until a value is pushed or the timeout expires. consumer only
+    template<typename Rep, typename Period>
+    void wait_for(const std::chrono::duration<Rep, Period>& timeout)
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->waiting.store(true);
+        this->wake.wait_for(lock, timeout, [this] { return this->signalled || !this->empty(); });
+        this->waiting.store(false);
+        this->signalled = false;
+    }
+};
@@ -0,0 +1,87 @@
+#include "number_format.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+
+static std::locale preferred_locale()
+{
+    try
+    {
+        return std::locale("");
+    }
+    catch(const std::runtime_error& e)
+    {
+        logger(ll::warning) << "could not load the preferred locale, using the classic locale: " << e.what() << '\n';
+        return std::locale::classic();
+    }
+}
+
+number_format::number_format() : number_format(preferred_locale())
+{
+}
+
+number_format::number_format(const std::locale& l) : loc(l)
+{
+    const auto& punct(std::use_facet<std::numpunct<char>>(this->loc));
+    this->grouping = punct.grouping();
+    this->thousands_sep = punct.thousands_sep();
+}
+
+const std::locale& number_format::locale() const
+{
+    return this->loc;
+}
+
+void number_format::append(std::string& out, unsigned long long value) const
+{
+    // 20 digits and up to 19 separators, built least significant first
+    char reversed[40];
+    std::size_t length(0);
+
+    // grouping gives group sizes from the right, the last one repeating. a size of zero or CHAR_MAX ends grouping
+    std::size_t group_index(0);
+    auto group_size([this](std::size_t index) -> int
+    {
+        if(this->grouping.empty())
+        {
+            return 0;
+        }
+        auto size(static_cast<int>(this->grouping[std::min(index, this->grouping.size() - 1)]));
+        return size == CHAR_MAX ? 0 : size;
+    });
+    auto size(group_size(group_index));
+    int in_group(0);
+
+    do
+    {
+        if(size > 0 && in_group == size)
+        {
+            reversed[length++] = this->thousands_sep;
+            in_group = 0;
+            size = group_size(++group_index);
+        }
+        reversed[length++] = static_cast<char>('0' + value % 10);
+        in_group++;
+        value /= 10;
+    } while(value != 0);
+
+    out.reserve(out.size() + length);
+    while(length != 0)
+    {
+        out.push_back(reversed[--length]);
+    }
+}
+
+void number_format::append(std::string& out, const td::blind_level& level) const
+{
+    this->append(out, level.little_blind);
+    out.push_back('/');
+    this->append(out, level.big_blind);
+    if(level.ante_type != td::ante_type_t::none)
+    {
+        // TODO: i18n
+        out.append("\nAnte: ");
+        this->append(out, level.ante);
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "types.hpp"
+#include <locale>
+#include <string>
+
+// formats numbers for display text with a locale's digit grouping, without iostreams
+// the locale is resolved once, at construction
+class number_format
+{
+    std::locale loc;
+    std::string grouping;
+    char thousands_sep;
+
+public:
+    // the user's preferred locale, or the classic locale if it cannot be resolved
+    number_format();
+    explicit number_format(const std::locale& loc);
+
+    // the resolved locale, for anything still formatted through iostreams
+    const std::locale& locale() const;
+
+    // append an integer, as an ostream imbued with the locale would write it
+    void append(std::string& out, unsigned long long value) const;
+
+    // append blind level text, as operator<< would write it
+    void append(std::string& out, const td::blind_level& level) const;
+
+    // convenience: format as a new string
+    template<typename T>
+    std::string format(const T& value) const
+    {
+        std::string ret;
+        this->append(ret, value);
+        return ret;
+    }
+};
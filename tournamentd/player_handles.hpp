@@ -0,0 +1,332 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// compact handle for a player id, interned once. handles index flat arrays
+typedef std::uint32_t player_handle_t;
+static const player_handle_t invalid_player_handle = std::numeric_limits<player_handle_t>::max();
+
+// map from player handle to value, stored flat by handle. iterates in handle order
+template<typename T>
+class player_map
+{
+public:
+    typedef std::pair<player_handle_t, T> value_type;
+
+private:
+    // one slot per handle, first is the slot's handle if present or invalid_player_handle if not
+    std::vector<value_type> slots;
+    std::size_t present { 0 };
+
+    template<typename V, typename It>
+    class basic_iterator
+    {
+        It it;
+        It last;
+
+        void skip()
+        {
+            while(this->it != this->last && this->it->first == invalid_player_handle)
+            {
+                ++this->it;
+            }
+        }
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef typename std::remove_const<V>::type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef V* pointer;
+        typedef V& reference;
+
+        basic_iterator(It i, It l) : it(i), last(l)
+        {
+            this->skip();
+        }
+
+        // iterator converts to const_iterator
+        template<typename V2, typename It2>
+        basic_iterator(const basic_iterator<V2, It2>& other) : it(other.base()), last(other.base_end())
+        {
+        }
+
+        V& operator*() const
+        {
+            return *this->it;
+        }
+
+        V* operator->() const
+        {
+            return &*this->it;
+        }
+
+        basic_iterator& operator++()
+        {
+            ++this->it;
+            this->skip();
+            return *this;
+        }
+
+        basic_iterator operator++(int)
+        {
+            auto ret(*this);
+            ++*this;
+            return ret;
+        }
+
+        bool operator==(const basic_iterator& other) const
+        {
+            return this->it == other.it;
+        }
+
+        bool operator!=(const basic_iterator& other) const
+        {
+            return this->it != other.it;
+        }
+
+        It base() const
+        {
+            return this->it;
+        }
+
+        It base_end() const
+        {
+            return this->last;
+        }
+    };
+
+public:
+    typedef basic_iterator<value_type, typename std::vector<value_type>::iterator> iterator;
+    typedef basic_iterator<const value_type, typename std::vector<value_type>::const_iterator> const_iterator;
+
+    iterator begin()
+    {
+        return iterator(this->slots.begin(), this->slots.end());
+    }
+
+    iterator end()
+    {
+        return iterator(this->slots.end(), this->slots.end());
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(this->slots.begin(), this->slots.end());
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(this->slots.end(), this->slots.end());
+    }
+
+    std::size_t size() const
+    {
+        return this->present;
+    }
+
+    bool empty() const
+    {
+        return this->present == 0;
+    }
+
+    std::size_t count(player_handle_t handle) const
+    {
+        return handle < this->slots.size() && this->slots[handle].first != invalid_player_handle ? 1 : 0;
+    }
+
+    iterator find(player_handle_t handle)
+    {
+        return this->count(handle) ? iterator(this->slots.begin() + handle, this->slots.end()) : this->end();
+    }
+
+    const_iterator find(player_handle_t handle) const
+    {
+        return this->count(handle) ? const_iterator(this->slots.begin() + handle, this->slots.end()) : this->end();
+    }
+
+    // insert value, if handle not already present. returns whether inserted
+    bool insert(const value_type& value)
+    {
+        if(value.first >= this->slots.size())
+        {
+            this->slots.resize(static_cast<std::size_t>(value.first) + 1, value_type(invalid_player_handle, T()));
+        }
+
+        auto& slot(this->slots[value.first]);
+        if(slot.first != invalid_player_handle)
+        {
+            return false;
+        }
+
+        slot = value;
+        this->present++;
+        return true;
+    }
+
+    // erase at position, returning the position after it
+    iterator erase(iterator pos)
+    {
+        auto it(this->slots.begin() + (pos.base() - this->slots.begin()));
+        it->first = invalid_player_handle;
+        it->second = T();
+        this->present--;
+        return iterator(it + 1, this->slots.end());
+    }
+
+    std::size_t erase(player_handle_t handle)
+    {
+        if(!this->count(handle))
+        {
+            return 0;
+        }
+        this->erase(this->find(handle));
+        return 1;
+    }
+
+    void clear()
+    {
+        this->slots.clear();
+        this->present = 0;
+    }
+
+    void swap(player_map& other)
+    {
+        this->slots.swap(other.slots);
+        std::swap(this->present, other.present);
+    }
+};
+
+template<typename T>
+void swap(player_map<T>& a, player_map<T>& b)
+{
+    a.swap(b);
+}
+
+// set of player handles, stored as one flag per handle. iterates in handle order
+class player_set
+{
+    std::vector<bool> members;
+    std::size_t present { 0 };
+
+public:
+    class const_iterator
+    {
+        const std::vector<bool>* members;
+        std::size_t index;
+
+        void skip()
+        {
+            while(this->index < this->members->size() && !(*this->members)[this->index])
+            {
+                this->index++;
+            }
+        }
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef player_handle_t value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const player_handle_t* pointer;
+        typedef player_handle_t reference;
+
+        const_iterator(const std::vector<bool>& m, std::size_t i) : members(&m), index(i)
+        {
+            this->skip();
+        }
+
+        player_handle_t operator*() const
+        {
+            return static_cast<player_handle_t>(this->index);
+        }
+
+        const_iterator& operator++()
+        {
+            this->index++;
+            this->skip();
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            auto ret(*this);
+            ++*this;
+            return ret;
+        }
+
+        bool operator==(const const_iterator& other) const
+        {
+            return this->index == other.index;
+        }
+
+        bool operator!=(const const_iterator& other) const
+        {
+            return this->index != other.index;
+        }
+    };
+
+    const_iterator begin() const
+    {
+        return const_iterator(this->members, 0);
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(this->members, this->members.size());
+    }
+
+    std::size_t size() const
+    {
+        return this->present;
+    }
+
+    bool empty() const
+    {
+        return this->present == 0;
+    }
+
+    std::size_t count(player_handle_t handle) const
+    {
+        return handle < this->members.size() && this->members[handle] ? 1 : 0;
+    }
+
+    // insert handle, returning whether inserted
+    bool insert(player_handle_t handle)
+    {
+        if(handle >= this->members.size())
+        {
+            this->members.resize(static_cast<std::size_t>(handle) + 1, false);
+        }
+
+        if(this->members[handle])
+        {
+            return false;
+        }
+
+        this->members[handle] = true;
+        this->present++;
+        return true;
+    }
+
+    std::size_t erase(player_handle_t handle)
+    {
+        if(!this->count(handle))
+        {
+            return 0;
+        }
+
+        this->members[handle] = false;
+        this->present--;
+        return 1;
+    }
+
+    void clear()
+    {
+        this->members.clear();
+        this->present = 0;
+    }
+};
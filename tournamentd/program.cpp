@@ -21,7 +21,9 @@ public:
             "Usage: tournamentd [options]\n"
             " -c, --conf FILE\tInitialize configuration from file\n"
             " -a, --auth CODE\tPre-authorize client authentication code.\n"
-            " -n, --name NAME\tPublish Bonjour service with given name (default: tournamentd)\n";
+            " -n, --name NAME\tPublish Bonjour service with given name (default: tournamentd)\n"
+            " -k, --keyframe SECONDS\tInterval between full keyframes for delta-mode clients (default: 30)\n"
+            " --commands\tPrint the command reference (as in tournamentd.md) and exit\n";
 
         // parse command-line
         for(auto it(cmdline.begin() + 1); it != cmdline.end();)
@@ -69,6 +71,24 @@ public:
                     std::exit(EXIT_FAILURE);
                 }
             }
+            else if(cmd == "-k" || cmd == "--keyframe")
+            {
+                if(it != cmdline.end())
+                {
+                    this->tourney.set_keyframe_interval(std::stol(*it++));
+                }
+                else
+                {
+                    std::cerr << "No parameter for " << cmd << "\n"
+                              << usage;
+                    std::exit(EXIT_FAILURE);
+                }
+            }
+            else if(cmd == "--commands")
+            {
+                std::cout << tournament::command_reference();
+                std::exit(EXIT_SUCCESS);
+            }
             else if(cmd == "-h" || cmd == "--help")
             {
                 std::cerr << usage;
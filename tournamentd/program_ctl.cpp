@@ -1,3 +1,4 @@
+#include "json_file.hpp"
 #include "nlohmann/json.hpp"
 #include "program.hpp"
 #include "socket.hpp"
@@ -30,21 +31,18 @@ static long long_arg(std::vector<std::string>::const_iterator& it, const std::ve
     }
 }
 
-// Read JSON from a file with error handling
+// Read JSON (text or CBOR) from a file with error handling
 static nlohmann::json read_json_file(const std::string& filename)
 {
-    std::ifstream file(filename);
-    if(!file.is_open())
-    {
-        throw std::invalid_argument("Cannot open file: '" + filename + "'");
-    }
-
     nlohmann::json json_data;
     try
     {
-        file >> json_data;
+        if(!load_json_file(filename, json_data))
+        {
+            throw std::invalid_argument("Cannot open file: '" + filename + "'");
+        }
     }
-    catch(const std::exception& e)
+    catch(const nlohmann::json::exception& e)
     {
         throw std::invalid_argument("Invalid JSON in file '" + filename + "': " + e.what());
     }
@@ -52,6 +50,25 @@ static nlohmann::json read_json_file(const std::string& filename)
     return json_data;
 }
 
+// Convert a configuration or snapshot file between JSON text and CBOR, by output file name
+static void convert_json_file(const std::string& input_filename, const std::string& output_filename)
+{
+    auto json_data(read_json_file(input_filename));
+    auto format(json_file_format_for(output_filename));
+
+    std::ofstream file(output_filename, std::ios::binary);
+    if(!file.is_open())
+    {
+        throw std::runtime_error("Cannot open file: '" + output_filename + "'");
+    }
+
+    file << (format == json_file_format::cbor ? serialize_json(json_data, format) : json_data.dump(4) + '\n');
+    if(!file)
+    {
+        throw std::runtime_error("Cannot write file: '" + output_filename + "'");
+    }
+}
+
 static socketstream make_stream(const std::string& server, const std::string& port, const std::string& unix_path = std::string())
 {
     if(unix_path.empty())
@@ -160,7 +177,8 @@ public:
             "\tset_action_clock <duration_ms>: Set action clock\n"
             "\n"
             " Utilities:\n"
-            "\tchips_for_buyin <source_id> <max_players>: Calculate chip distribution\n";
+            "\tchips_for_buyin <source_id> <max_players>: Calculate chip distribution\n"
+            "\tconvert <input_file> <output_file>: Convert a config or snapshot file between JSON and CBOR (.cbor)\n";
 
         // parse command-line
         try
@@ -190,6 +208,13 @@ public:
                     std::cerr << usage;
                     std::exit(EXIT_SUCCESS);
                 }
+                else if(opt == "convert")
+                {
+                    // local file conversion, no server needed
+                    auto input_filename = string_arg(it, cmdline.end());
+                    auto output_filename = string_arg(it, cmdline.end());
+                    convert_json_file(input_filename, output_filename);
+                }
                 else
                 {
                     // make a stream, given server and port, or unix_path
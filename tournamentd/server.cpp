@@ -1,18 +1,456 @@
 #include "server.hpp"
 #include "logger.hpp"
 #include "socket.hpp"
-#include "socketstream.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <deque>
+#include <map>
 #include <set>
+#include <sstream>
+#include <streambuf>
+#include <unordered_map>
+
+// queued output at which a client is considered slow
+static constexpr std::size_t CLIENT_OUTPUT_SOFT_LIMIT = 1024 * 1024;
+
+// queued output at which a client is disconnected immediately
+static constexpr std::size_t CLIENT_OUTPUT_HARD_LIMIT = 16 * 1024 * 1024;
+
+// how long a client may stay over the soft limit before it is disconnected
+static constexpr std::chrono::seconds CLIENT_SLOW_TIMEOUT(30);
+
+// longest line of input accepted from a client
+static constexpr std::size_t CLIENT_INPUT_LIMIT = 1024 * 1024;
+
+// one connected client: a non-blocking socket, framed input and a bounded output queue
+// handlers see it as an iostream whose input is complete lines and whose output is queued
+class client_connection : public std::streambuf
+{
+public:
+    // responses are never dropped. a complete state message replaces any older unsent state message on the same channel, complete or incremental
+    enum class message_kind
+    {
+        response,
+        complete_state,
+        incremental_state
+    };
+
+private:
+    struct message
+    {
+        std::shared_ptr<const std::string> data;
+        message_kind kind;
+        server::channel_mask channels;
+    };
+
+    // output written by a handler, not yet queued
+    std::string response;
+
+    int_type overflow(int_type c) override
+    {
+        if(!traits_type::eq_int_type(c, traits_type::eof()))
+        {
+            this->response.push_back(traits_type::to_char_type(c));
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override
+    {
+        this->response.append(s, static_cast<std::size_t>(n));
+        return n;
+    }
+
+    int sync() override
+    {
+        this->commit();
+        return 0;
+    }
+
+    int_type underflow() override
+    {
+        // get area only ever holds complete lines, set up by handle_input()
+        return traits_type::eof();
+    }
+
+public:
+    common_socket sock;
+    std::iostream stream;
+
+    // identity and broadcast subscriptions
+    server::client_id id;
+    server::channel_mask channels { server::default_channel };
+
+    // received input, and how much of it has been searched for a newline
+    std::string input;
+    std::size_t scanned {};
+
+    // queued output. the front message may be partially sent
+    std::deque<message> output;
+    std::size_t output_offset {};
+    std::size_t output_bytes {};
+
+    // when this client went over the soft limit
+    bool slow {};
+    std::chrono::steady_clock::time_point slow_since;
+
+    // flush remaining output, then close
+    bool closing {};
+
+    // close at next opportunity
+    bool dead {};
+
+    client_connection(const common_socket& s, server::client_id i) : sock(s), stream(this), id(i)
+    {
+    }
+
+    // queue handler output as a response
+    void commit()
+    {
+        if(!this->response.empty())
+        {
+            this->queue(std::make_shared<const std::string>(std::move(this->response)), message_kind::response, 0);
+            this->response.clear();
+        }
+    }
+
+    // queue a message
+    void queue(const std::shared_ptr<const std::string>& data, message_kind kind, server::channel_mask channels)
+    {
+        if(this->dead)
+        {
+            return;
+        }
+
+        if(kind == message_kind::complete_state)
+        {
+            auto it(this->output.begin());
+            if(this->output_offset > 0)
+            {
+                ++it;
+            }
+            while(it != this->output.end())
+            {
+                if(it->kind != message_kind::response && (it->channels & channels) != 0)
+                {
+                    logger(ll::debug) << "conflating stale state message for " << this->sock << '\n';
+                    this->output_bytes -= it->data->size();
+                    it = this->output.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+
+        this->output_bytes += data->size();
+        this->output.push_back(message { data, kind, channels });
+    }
+
+    // send as much queued output as the socket will take, straight from the shared buffers. returns true if output remains
+    bool flush()
+    {
+        std::array<common_socket::const_buffer, 16> bufs;
+        while(!this->dead && !this->output.empty())
+        {
+            // gather queued messages
+            std::size_t count(0);
+            auto offset(this->output_offset);
+            for(auto it(this->output.begin()); it != this->output.end() && count < bufs.size(); ++it, ++count)
+            {
+                bufs[count] = common_socket::const_buffer { it->data->data() + offset, it->data->size() - offset };
+                offset = 0;
+            }
+
+            auto len(this->sock.send(bufs.data(), count));
+            if(len < 0)
+            {
+                logger(ll::info) << "closing client connection: send failed\n";
+                this->dead = true;
+            }
+            else if(len == 0)
+            {
+                return true;
+            }
+            else
+            {
+                // retire completely sent messages
+                auto sent(static_cast<std::size_t>(len));
+                this->output_bytes -= sent;
+                while(sent > 0)
+                {
+                    auto remaining(this->output.front().data->size() - this->output_offset);
+                    if(sent < remaining)
+                    {
+                        this->output_offset += sent;
+                        break;
+                    }
+                    sent -= remaining;
+                    this->output.pop_front();
+                    this->output_offset = 0;
+                }
+            }
+        }
+        return false;
+    }
+
+    // read available input, up to the input limit. returns -1 if the peer is gone, 0 if drained, 1 if more may be available
+    int receive()
+    {
+        char buf[4096];
+        while(this->input.size() <= CLIENT_INPUT_LIMIT)
+        {
+            auto len(this->sock.recv(buf, sizeof(buf)));
+            if(len < 0)
+            {
+                return -1;
+            }
+            if(len == 0)
+            {
+                return 0;
+            }
+            this->input.append(buf, static_cast<std::size_t>(len));
+        }
+        return 1;
+    }
+
+    // handle each complete line of input
+    void handle_input(const std::function<bool(std::iostream&)>& handle_client)
+    {
+        std::size_t begin(0);
+        while(!this->dead && !this->closing)
+        {
+            auto nl(this->input.find('\n', std::max(begin, this->scanned)));
+            if(nl == std::string::npos)
+            {
+                this->scanned = this->input.size();
+                break;
+            }
+
+            // present one line to the handler
+            auto* base(&this->input[0]);
+            this->setg(base + begin, base + begin, base + nl + 1);
+            this->stream.clear();
+            if(handle_client(this->stream))
+            {
+                logger(ll::info) << "closing client connection gracefully\n";
+                this->closing = true;
+            }
+            this->commit();
+
+            // skip the line if the handler did not consume anything
+            auto used(static_cast<std::size_t>(this->gptr() - (base + begin)));
+            if(used == 0)
+            {
+                logger(ll::warning) << "client handler did not consume input, discarding line\n";
+                used = nl + 1 - begin;
+            }
+            begin += used;
+        }
+
+        this->setg(nullptr, nullptr, nullptr);
+        this->discard_input(begin);
+    }
+
+    // handle each complete line of input in place, without copying it out of the receive buffer
+    void handle_lines(const std::function<bool(server::line_view, std::ostream&)>& handle_line)
+    {
+        std::size_t begin(0);
+        while(!this->dead && !this->closing)
+        {
+            auto nl(this->input.find('\n', std::max(begin, this->scanned)));
+            if(nl == std::string::npos)
+            {
+                this->scanned = this->input.size();
+                break;
+            }
+
+            // present one line to the handler, without its line ending
+            server::line_view line { this->input.data() + begin, nl - begin };
+            if(handle_line(line, this->stream))
+            {
+                logger(ll::info) << "closing client connection gracefully\n";
+                this->closing = true;
+            }
+            this->commit();
+            begin = nl + 1;
+        }
+
+        this->discard_input(begin);
+    }
+
+    // remove handled input from the receive buffer
+    void discard_input(std::size_t handled)
+    {
+        this->input.erase(0, handled);
+        this->scanned = this->scanned > handled ? this->scanned - handled : 0;
+
+        if(this->input.size() > CLIENT_INPUT_LIMIT)
+        {
+            logger(ll::warning) << "closing client connection: input line too long\n";
+            this->dead = true;
+        }
+    }
+
+    // enforce output queue limits
+    void check_limits()
+    {
+        if(this->output_bytes > CLIENT_OUTPUT_HARD_LIMIT)
+        {
+            logger(ll::warning) << "closing client connection: " << this->output_bytes << " bytes queued\n";
+            this->dead = true;
+        }
+        else if(this->output_bytes > CLIENT_OUTPUT_SOFT_LIMIT)
+        {
+            auto now(std::chrono::steady_clock::now());
+            if(!this->slow)
+            {
+                logger(ll::warning) << "client " << this->sock << " is falling behind: " << this->output.size() << " messages, " << this->output_bytes << " bytes queued\n";
+                this->slow = true;
+                this->slow_since = now;
+            }
+            else if(now - this->slow_since > CLIENT_SLOW_TIMEOUT)
+            {
+                logger(ll::warning) << "closing client connection: slow consumer\n";
+                this->dead = true;
+            }
+        }
+        else
+        {
+            this->slow = false;
+        }
+    }
+};
 
 struct server::impl
 {
-    std::set<common_socket> all;
+    socket_poller poller;
     std::set<common_socket> listeners;
-    std::set<common_socket> clients;
+    std::map<common_socket, std::unique_ptr<client_connection>> clients;
+    std::unordered_map<client_id, client_connection*> clients_by_id;
+    client_id next_client_id { 1 };
+
+    // look up a live client by id
+    client_connection* find(client_id id) const
+    {
+        auto it(this->clients_by_id.find(id));
+        return (it == this->clients_by_id.end() || it->second->dead) ? nullptr : it->second;
+    }
+
+    // queue a message to a client and try to send it
+    void send(client_connection& conn, const std::shared_ptr<const std::string>& message, channel_mask channels, bool complete)
+    {
+        conn.queue(message, complete ? client_connection::message_kind::complete_state : client_connection::message_kind::incremental_state, channels);
+        this->flush(conn);
+    }
+
+    // try to send queued output, asking the poller to report writability if some remains
+    void flush(client_connection& conn)
+    {
+        auto pending(conn.flush());
+        this->poller.want_writable(conn.sock, pending);
+        conn.check_limits();
+        if(conn.closing && !pending)
+        {
+            conn.dead = true;
+        }
+    }
+
+    // remove closed connections
+    void sweep()
+    {
+        auto it(this->clients.begin());
+        while(it != this->clients.end())
+        {
+            if(it->second->dead)
+            {
+                this->poller.remove(it->first);
+                this->clients_by_id.erase(it->second->id);
+                it = this->clients.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    // poll clients with given timeout, greeting new clients and passing each client with received input to a handler
+    bool poll(const std::function<bool(client_id, std::ostream&)>& handle_new_client, const std::function<void(client_connection&)>& handle_input, long usec)
+    {
+        // handle each ready socket
+        for(const auto& ev : this->poller.wait(usec))
+        {
+            if(this->listeners.find(ev.sock) != this->listeners.end())
+            {
+                // accept all pending clients from listening socket
+                for(auto client(ev.sock.accept()); client.valid(); client = ev.sock.accept())
+                {
+                    logger(ll::info) << "new client connection\n";
+
+                    // client i/o never blocks the game loop
+                    client.set_nonblocking(true);
+                    std::unique_ptr<client_connection> conn(new client_connection(client, this->next_client_id++));
+                    this->clients_by_id.emplace(conn->id, conn.get());
+                    auto& c(*conn);
+                    this->poller.add(client);
+                    this->clients.emplace(client, std::move(conn));
+
+                    // greet new client
+                    auto reject(handle_new_client(c.id, c.stream));
+                    c.commit();
+                    this->flush(c);
+                    c.dead = c.dead || reject;
+                }
+            }
+            else
+            {
+                auto it(this->clients.find(ev.sock));
+                if(it == this->clients.end())
+                {
+                    continue;
+                }
+                auto& conn(*it->second);
+
+                if(ev.readable && !conn.dead)
+                {
+                    logger(ll::debug) << "handling client communication\n";
+
+                    // drain the socket, handling complete lines as they arrive
+                    int status;
+                    do
+                    {
+                        status = conn.receive();
+                        handle_input(conn);
+                    }
+                    while(status > 0 && !conn.dead && !conn.closing);
+
+                    if(status < 0 && !conn.dead)
+                    {
+                        logger(ll::info) << "closing client connection: connection closed by peer\n";
+                        conn.dead = true;
+                    }
+                }
+
+                if(!conn.dead)
+                {
+                    this->flush(conn);
+                }
+            }
+        }
+
+        this->sweep();
+        return false;
+    }
 };
 
+constexpr server::channel_mask server::default_channel;
+
 server::server() : pimpl(new impl())
 {
+    logger(ll::debug) << "server using " << this->pimpl->poller.backend() << " poller\n";
 }
 
 server::~server() = default;
@@ -23,7 +461,7 @@ void server::listen(const char* unix_socket_path, const char* inet_service)
     // erase any existing listeners
     for(const auto& it : this->pimpl->listeners)
     {
-        this->pimpl->all.erase(it);
+        this->pimpl->poller.remove(it);
     }
 
     // clear set of iterators
@@ -33,100 +471,165 @@ void server::listen(const char* unix_socket_path, const char* inet_service)
     {
         // add socket to listen for ipv4
         inet4_socket sock4(nullptr, inet_service);
-        this->pimpl->all.insert(sock4);
-        this->pimpl->listeners.insert(sock4);
+        this->add_listener(sock4);
 
         // add socket to listen for ipv6
         inet6_socket sock6(nullptr, inet_service);
-        this->pimpl->all.insert(sock6);
-        this->pimpl->listeners.insert(sock6);
+        this->add_listener(sock6);
     }
 
     if(unix_socket_path != nullptr)
     {
         // add unix socket
         unix_socket socku(unix_socket_path);
-        this->pimpl->all.insert(socku);
-        this->pimpl->listeners.insert(socku);
+        this->add_listener(socku);
     }
 }
 
-// close client connection
-void server::close(const common_socket& sock)
+// add a listening socket. listeners are non-blocking so pending connections can be drained
+void server::add_listener(common_socket& sock)
 {
-    this->pimpl->clients.erase(sock);
-    this->pimpl->all.erase(sock);
+    sock.set_nonblocking(true);
+    this->pimpl->poller.add(sock);
+    this->pimpl->listeners.insert(sock);
 }
 
 // poll the server with given timeout
 bool server::poll(const std::function<bool(std::ostream&)>& handle_new_client, const std::function<bool(std::iostream&)>& handle_client, long usec)
 {
-    auto selected(common_socket::select(this->pimpl->all, usec));
+    auto greeter([&handle_new_client](client_id /* client */, std::ostream& os)
+    {
+        return handle_new_client(os);
+    });
+    auto handler([&handle_client](client_id /* client */, std::iostream& ios)
+    {
+        return handle_client(ios);
+    });
+    return this->poll(greeter, handler, usec);
+}
 
-    // handle each selected socket
-    auto it(selected.begin());
-    while(it != selected.end())
+// poll the server with given timeout, passing client ids to handlers
+bool server::poll(const std::function<bool(client_id, std::ostream&)>& handle_new_client, const std::function<bool(client_id, std::iostream&)>& handle_client, long usec)
+{
+    return this->pimpl->poll(handle_new_client, [&handle_client](client_connection& conn)
     {
-        auto sock(it++);
+        conn.handle_input([&handle_client, &conn](std::iostream& ios)
+        {
+            return handle_client(conn.id, ios);
+        });
+    }, usec);
+}
 
-        if(this->pimpl->listeners.find(*sock) != this->pimpl->listeners.end())
+// poll the server with given timeout, passing each line of client input in place
+bool server::poll(const std::function<bool(client_id, std::ostream&)>& handle_new_client, const std::function<bool(client_id, line_view, std::ostream&)>& handle_line, long usec)
+{
+    return this->pimpl->poll(handle_new_client, [&handle_line](client_connection& conn)
+    {
+        conn.handle_lines([&handle_line, &conn](line_view line, std::ostream& os)
         {
-            logger(ll::info) << "new client connection\n";
+            return handle_line(conn.id, line, os);
+        });
+    }, usec);
+}
 
-            // accept new client from listening socket
-            const auto& client(sock->accept());
+// broadcast state message to clients on the given channels
+void server::broadcast(std::string message, channel_mask channels, bool complete)
+{
+    // every client shares one copy of the message
+    message.push_back('\n');
+    auto shared(std::make_shared<const std::string>(std::move(message)));
 
-            // greet new client
-            socketstream ss(client);
-            if(!handle_new_client(ss) && ss.good())
-            {
-                // if all is well, add to our lists
-                this->pimpl->clients.insert(client);
-                this->pimpl->all.insert(client);
-            }
-        }
-        else
+    for(auto& client : this->pimpl->clients)
+    {
+        auto& conn(*client.second);
+        if(!conn.dead && (conn.channels & channels) != 0)
         {
-            logger(ll::debug) << "handling client communication\n";
+            this->pimpl->send(conn, shared, channels, complete);
+        }
+    }
+}
 
-            // handle client i/o
-            socketstream ss(*sock);
-            auto in_avail(ss.rdbuf()->in_avail());
-            while(in_avail > 0 && ss.good())
-            {
-                if(handle_client(ss))
-                {
-                    logger(ll::info) << "closing client connection gracefully\n";
-                    this->close(*sock);
-                }
+// send a state message to one client
+void server::send(client_id client, std::string message, channel_mask channel, bool complete)
+{
+    auto* conn(this->pimpl->find(client));
+    if(conn != nullptr)
+    {
+        message.push_back('\n');
+        this->pimpl->send(*conn, std::make_shared<const std::string>(std::move(message)), channel, complete);
+    }
+}
 
-                // keep checking until no pending io
-                in_avail = ss.rdbuf()->in_avail();
-            }
+// send a command response to one client
+void server::respond(client_id client, std::string message)
+{
+    auto* conn(this->pimpl->find(client));
+    if(conn != nullptr)
+    {
+        message.push_back('\n');
+        conn->queue(std::make_shared<const std::string>(std::move(message)), client_connection::message_kind::response, 0);
+        this->pimpl->flush(*conn);
+    }
+}
 
-            if(!ss.good())
-            {
-                logger(ll::info) << "closing client connection: stream error\n";
-                this->close(*sock);
-            }
-            else if(in_avail < 0)
-            {
-                logger(ll::info) << "closing client connection: no input available\n";
-                this->close(*sock);
-            }
-        }
+// disconnect a client once everything queued for it is sent
+void server::close(client_id client)
+{
+    auto* conn(this->pimpl->find(client));
+    if(conn != nullptr)
+    {
+        logger(ll::info) << "closing client connection gracefully\n";
+        conn->closing = true;
+        this->pimpl->flush(*conn);
+    }
+}
+
+// make a poll in progress return
+void server::wake()
+{
+    this->pimpl->poller.wake();
+}
+
+// set the channels a client is subscribed to
+void server::subscribe(client_id client, channel_mask channels)
+{
+    auto* conn(this->pimpl->find(client));
+    if(conn != nullptr)
+    {
+        conn->channels = channels;
     }
+}
+
+// get the channels a client is subscribed to
+server::channel_mask server::subscriptions(client_id client) const
+{
+    auto* conn(this->pimpl->find(client));
+    return conn == nullptr ? 0 : conn->channels;
+}
 
+// is any client subscribed to any of the given channels
+bool server::has_subscribers(channel_mask channels) const
+{
+    for(const auto& client : this->pimpl->clients)
+    {
+        if(!client.second->dead && (client.second->channels & channels) != 0)
+        {
+            return true;
+        }
+    }
     return false;
 }
 
-// broadcast message to all clients
-void server::broadcast(const std::string& message) const
+// per-client output queue depth
+std::vector<server::queue_depth> server::queue_depths() const
 {
+    std::vector<queue_depth> depths;
+    depths.reserve(this->pimpl->clients.size());
     for(const auto& client : this->pimpl->clients)
     {
-        // handle client i/o
-        socketstream ss(client);
-        ss << message << std::endl;
+        std::ostringstream name;
+        name << client.first;
+        depths.push_back(queue_depth { name.str(), client.second->output.size(), client.second->output_bytes });
     }
+    return depths;
 }
@@ -1,8 +1,10 @@
 #pragma once
+#include <cstdint>
 #include <functional>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <vector>
 
 class common_socket;
 
@@ -12,10 +14,17 @@ class server
     struct impl;
     std::unique_ptr<impl> pimpl;
 
-    // close client connection
-    void close(const common_socket& sock);
+    // add a listening socket
+    void add_listener(common_socket& sock);
 
 public:
+    // clients are identified by a number unique for the lifetime of the server
+    typedef std::size_t client_id;
+
+    // broadcasts go to clients subscribed to any of the given channels. clients start on the default channel
+    typedef std::uint32_t channel_mask;
+    static constexpr channel_mask default_channel = 1;
+
     server();
     ~server();
 
@@ -28,9 +37,47 @@ public:
     // listen on given unix socket path and optional internet service
     void listen(const char* unix_socket_path, const char* inet_service = nullptr);
 
+    // a complete line of client input without its line ending, pointing into the client's receive buffer. valid only during the handler call
+    struct line_view
+    {
+        const char* data;
+        std::size_t size;
+    };
+
     // poll the server with given timeout, handling both new clients and clients with input
     bool poll(const std::function<bool(std::ostream&)>& handle_new_client, const std::function<bool(std::iostream&)>& handle_client, long usec = -1);
+    bool poll(const std::function<bool(client_id, std::ostream&)>& handle_new_client, const std::function<bool(client_id, std::iostream&)>& handle_client, long usec = -1);
+    bool poll(const std::function<bool(client_id, std::ostream&)>& handle_new_client, const std::function<bool(client_id, line_view, std::ostream&)>& handle_line, long usec = -1);
+
+    // broadcast state message to clients on the given channels. the message is serialized once and shared by every client's queue
+    // a complete message replaces any older message on the same channel that a client has not yet been sent. an incremental one is only replaced by a complete one
+    void broadcast(std::string message, channel_mask channels = default_channel, bool complete = true);
+
+    // send a state message to one client, as if broadcast on the given channel
+    void send(client_id client, std::string message, channel_mask channel = default_channel, bool complete = true);
+
+    // send a command response to one client. responses are never dropped or replaced
+    void respond(client_id client, std::string message);
+
+    // disconnect a client once everything queued for it is sent
+    void close(client_id client);
+
+    // make a poll in progress return, or the next one if none is. the only member that may be called from another thread
+    void wake();
+
+    // set and get the channels a client is subscribed to
+    void subscribe(client_id client, channel_mask channels);
+    channel_mask subscriptions(client_id client) const;
+
+    // is any client subscribed to any of the given channels
+    bool has_subscribers(channel_mask channels) const;
 
-    // broadcast message to all clients
-    void broadcast(const std::string& message) const;
+    // per-client output queue depth, for monitoring
+    struct queue_depth
+    {
+        std::string client;
+        std::size_t messages;
+        std::size_t bytes;
+    };
+    std::vector<queue_depth> queue_depths() const;
 };
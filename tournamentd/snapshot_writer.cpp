@@ -0,0 +1,238 @@
+#include "snapshot_writer.hpp"
+#include "json_file.hpp"
+#include "logger.hpp"
+#include "scope_timer.hpp"
+#include <atomic>
+#include <cerrno> // for errno
+#include <condition_variable>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+static int open_truncate(const char* path)
+{
+    return ::_open(path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+}
+static long write_fd(int fd, const char* data, std::size_t size)
+{
+    return ::_write(fd, data, static_cast<unsigned int>(size));
+}
+static int sync_fd(int fd)
+{
+    return ::_commit(fd);
+}
+static int close_fd(int fd)
+{
+    return ::_close(fd);
+}
+static void replace_file(const std::string& from, const std::string& to)
+{
+    if(::MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) == 0)
+    {
+        throw std::system_error(static_cast<int>(::GetLastError()), std::system_category(), "MoveFileEx");
+    }
+}
+#else
+static int open_truncate(const char* path)
+{
+    return ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+}
+static long write_fd(int fd, const char* data, std::size_t size)
+{
+    return ::write(fd, data, size);
+}
+static int sync_fd(int fd)
+{
+    return ::fsync(fd);
+}
+static int close_fd(int fd)
+{
+    return ::close(fd);
+}
+static void replace_file(const std::string& from, const std::string& to)
+{
+    if(::rename(from.c_str(), to.c_str()) != 0)
+    {
+        throw std::system_error(errno, std::system_category(), "rename");
+    }
+
+    // sync the directory, so the rename itself survives power loss
+    auto slash(to.find_last_of('/'));
+    auto dir(slash == std::string::npos ? std::string(".") : slash == 0 ? std::string("/") : to.substr(0, slash));
+    auto fd(::open(dir.c_str(), O_RDONLY | O_CLOEXEC));
+    if(fd >= 0)
+    {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+#endif
+
+// write a whole file and sync it to storage
+static void write_file(const std::string& path, const std::string& contents)
+{
+    auto fd(open_truncate(path.c_str()));
+    if(fd < 0)
+    {
+        throw std::system_error(errno, std::system_category(), "open");
+    }
+
+    std::size_t written(0);
+    while(written < contents.size())
+    {
+        auto len(write_fd(fd, contents.data() + written, contents.size() - written));
+        if(len < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            auto error(errno);
+            close_fd(fd);
+            throw std::system_error(error, std::system_category(), "write");
+        }
+        written += static_cast<std::size_t>(len);
+    }
+
+    if(sync_fd(fd) != 0)
+    {
+        auto error(errno);
+        close_fd(fd);
+        throw std::system_error(error, std::system_category(), "fsync");
+    }
+
+    if(close_fd(fd) != 0)
+    {
+        throw std::system_error(errno, std::system_category(), "close");
+    }
+}
+
+struct snapshot_writer::impl
+{
+    std::string path;
+
+    // sequence of the snapshot at path
+    std::atomic<std::uint64_t> durable;
+
+    // guards everything below it
+    std::mutex mutex;
+    std::condition_variable wake;
+
+    // newest snapshot not yet started, if queued_sequence > started_sequence
+    nlohmann::json queued;
+    std::uint64_t queued_sequence {};
+    std::uint64_t started_sequence {};
+    bool writing {};
+    bool stopping {};
+
+    // declared last, so everything it uses exists before it starts
+    std::thread thread;
+
+    impl(const std::string& p, std::uint64_t sequence) : path(p), durable(sequence), thread(&impl::run, this)
+    {
+    }
+
+    ~impl()
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->wake.notify_all();
+        this->thread.join();
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        for(;;)
+        {
+            this->wake.wait(lock, [this] { return this->stopping || this->queued_sequence > this->started_sequence; });
+            if(this->queued_sequence == this->started_sequence)
+            {
+                // stopping, nothing left to write
+                return;
+            }
+
+            // take the snapshot, leaving the slot free for the next one while we write
+            nlohmann::json snapshot;
+            snapshot.swap(this->queued);
+            auto sequence(this->queued_sequence);
+            this->started_sequence = sequence;
+            this->writing = true;
+            lock.unlock();
+
+            this->write_snapshot(snapshot, sequence);
+
+            lock.lock();
+            this->writing = false;
+            this->wake.notify_all();
+        }
+    }
+
+    // write to a temporary file, then replace the snapshot, so the snapshot is always complete
+    void write_snapshot(const nlohmann::json& snapshot, std::uint64_t sequence)
+    {
+        try
+        {
+            scope_timer timer;
+            timer.set_message("snapshot written in: ");
+
+            auto temp_path(this->path + ".tmp");
+            write_file(temp_path, serialize_json(snapshot, json_file_format_for(this->path)));
+            replace_file(temp_path, this->path);
+            this->durable = sequence;
+
+            logger(ll::info) << "saved snapshot to " << this->path << '\n';
+        }
+        catch(const std::exception& e)
+        {
+            logger(ll::error) << "failed to save snapshot to " << this->path << ": " << e.what() << '\n';
+        }
+    }
+};
+
+snapshot_writer::snapshot_writer(const std::string& path, std::uint64_t sequence) : pimpl(new impl(path, sequence))
+{
+}
+
+snapshot_writer::~snapshot_writer() = default;
+
+// queue a snapshot to be written, replacing any queued snapshot not yet started
+void snapshot_writer::write(nlohmann::json snapshot, std::uint64_t sequence)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->pimpl->mutex);
+        if(this->pimpl->queued_sequence > this->pimpl->started_sequence)
+        {
+            logger(ll::debug) << "coalescing snapshot " << this->pimpl->queued_sequence << " into " << sequence << '\n';
+        }
+        this->pimpl->queued = std::move(snapshot);
+        this->pimpl->queued_sequence = sequence;
+    }
+    this->pimpl->wake.notify_all();
+}
+
+// sequence of the newest snapshot completely written, synced and renamed into place
+std::uint64_t snapshot_writer::durable_sequence() const
+{
+    return this->pimpl->durable;
+}
+
+// block until every queued snapshot is written
+void snapshot_writer::flush()
+{
+    std::unique_lock<std::mutex> lock(this->pimpl->mutex);
+    this->pimpl->wake.wait(lock, [this] { return !this->pimpl->writing && this->pimpl->queued_sequence == this->pimpl->started_sequence; });
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "nlohmann/json.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// writes snapshots to a file on a background thread, so the caller never waits for storage
+class snapshot_writer
+{
+    // pimpl
+    struct impl;
+    std::unique_ptr<impl> pimpl;
+
+public:
+    // start a writer for the snapshot file at path, where a snapshot with the given sequence may already be
+    explicit snapshot_writer(const std::string& path, std::uint64_t sequence = 0);
+
+    // finish writing any queued snapshot, then stop
+    ~snapshot_writer();
+
+    // Non-copyable, non-movable (manages unique resources)
+    snapshot_writer(const snapshot_writer&) = delete;
+    snapshot_writer& operator=(const snapshot_writer&) = delete;
+    snapshot_writer(snapshot_writer&&) = delete;
+    snapshot_writer& operator=(snapshot_writer&&) = delete;
+
+    // queue a snapshot to be written, replacing any queued snapshot not yet started
+    // sequence identifies the snapshot, and must increase with each call
+    void write(nlohmann::json snapshot, std::uint64_t sequence);
+
+    // sequence of the newest snapshot completely written, synced and renamed into place
+    std::uint64_t durable_sequence() const;
+
+    // block until every queued snapshot is written
+    void flush();
+};
@@ -1,6 +1,7 @@
 #include "socket.hpp"
 #include "logger.hpp"
 #include "shared_instance.hpp"
+#include <atomic>
 #include <cassert>
 #include <cerrno> // for errno
 #include <chrono>
@@ -8,6 +9,7 @@
 #include <iterator>
 #include <system_error>
 #include <thread>
+#include <unordered_map>
 
 #if defined(_WIN32)
 #define STRICT 1
@@ -26,6 +28,7 @@ typedef int socklen_t;
 #include <netinet/in.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <unistd.h>
 using SOCKET = int;
@@ -33,6 +36,9 @@ static const SOCKET INVALID_SOCKET = -1;
 static const int SOCKET_ERROR = -1;
 #define SOCKET_ERRNO() errno
 #endif
+#if defined(__linux__)
+#include <sys/epoll.h>
+#endif
 
 class eai_error_category : public std::error_category
 {
@@ -94,11 +100,26 @@ struct addrinfo_ptr
     }
 };
 
+// set fd blocking mode
+static void set_fd_nonblocking(SOCKET fd, bool nonblocking)
+{
+    unsigned long mode(nonblocking ? 1 : 0);
+#if defined(_WIN32)
+    if(::ioctlsocket(fd, FIONBIO, &mode) != 0) // NOLINT(cppcoreguidelines-pro-type-vararg)
+#else
+    if(::ioctl(fd, FIONBIO, &mode) != 0) // NOLINT(cppcoreguidelines-pro-type-vararg)
+#endif
+    {
+        throw std::system_error(SOCKET_ERRNO(), std::system_category(), "ioctl");
+    }
+}
+
 // pimpl (fd wrapper)
 
 struct common_socket::impl
 {
     SOCKET fd;
+    bool nonblocking {};
 
     // construct with given fd
     explicit impl(SOCKET newfd) : fd(newfd)
@@ -181,7 +202,17 @@ common_socket common_socket::accept() const
     auto sock(::accept(this->pimpl->fd, static_cast<sockaddr*>(static_cast<void*>(&addr)), &addrlen));
     if(sock == INVALID_SOCKET)
     {
-        throw std::system_error(SOCKET_ERRNO(), std::system_category(), "accept");
+        int err = SOCKET_ERRNO();
+#if defined(_WIN32)
+        if(this->pimpl->nonblocking && (err == WSAEWOULDBLOCK || err == WSAECONNRESET))
+#else
+        if(this->pimpl->nonblocking && (err == EAGAIN || err == EWOULDBLOCK || err == ECONNABORTED))
+#endif
+        {
+            logger(ll::debug) << "accept: no pending connections\n";
+            return {};
+        }
+        throw std::system_error(err, std::system_category(), "accept");
     }
 
     logger(ll::debug) << "accepted connection on " << *this << '\n';
@@ -254,14 +285,10 @@ long common_socket::peek(void* buf, std::size_t bytes) const
     }
 
     // temporarily set socket to nonblocking
-    unsigned long nonblocking(1);
-#if defined(_WIN32)
-    if(::ioctlsocket(this->pimpl->fd, FIONBIO, &nonblocking) != 0) // NOLINT(cppcoreguidelines-pro-type-vararg)
-#else
-    if(::ioctl(this->pimpl->fd, FIONBIO, &nonblocking) != 0) // NOLINT(cppcoreguidelines-pro-type-vararg)
-#endif
+    auto was_blocking(!this->pimpl->nonblocking);
+    if(was_blocking)
     {
-        throw std::system_error(SOCKET_ERRNO(), std::system_category(), "ioctl");
+        set_fd_nonblocking(this->pimpl->fd, true);
     }
 
     // peek at bytes from a fd
@@ -276,14 +303,9 @@ long common_socket::peek(void* buf, std::size_t bytes) const
     int recv_errno = SOCKET_ERRNO();
 
     // set socket back to blocking
-    unsigned long blocking(0);
-#if defined(_WIN32)
-    if(::ioctlsocket(this->pimpl->fd, FIONBIO, &blocking) != 0) // NOLINT(cppcoreguidelines-pro-type-vararg)
-#else
-    if(::ioctl(this->pimpl->fd, FIONBIO, &blocking) != 0) // NOLINT(cppcoreguidelines-pro-type-vararg)
-#endif
+    if(was_blocking)
     {
-        throw std::system_error(SOCKET_ERRNO(), std::system_category(), "ioctl");
+        set_fd_nonblocking(this->pimpl->fd, false);
     }
 
     if(len == SOCKET_ERROR)
@@ -352,12 +374,22 @@ long common_socket::recv(void* buf, std::size_t bytes)
     {
         int err = SOCKET_ERRNO();
 #if defined(_WIN32)
+        if(err == WSAEWOULDBLOCK && this->pimpl->nonblocking)
+        {
+            logger(ll::debug) << "recv: no bytes available (WSAEWOULDBLOCK)\n";
+            return 0;
+        }
         if(err == WSAECONNRESET || err == WSAECONNABORTED)
         {
             logger(ll::debug) << "recv: connection reset/aborted\n";
             return -1;
         }
 #else
+        if((err == EAGAIN || err == EWOULDBLOCK) && this->pimpl->nonblocking)
+        {
+            logger(ll::debug) << "recv: no bytes available (EAGAIN)\n";
+            return 0;
+        }
         if(err == EPIPE || err == ECONNRESET)
         {
             logger(ll::debug) << "recv: broken pipe/connection reset\n";
@@ -367,6 +399,12 @@ long common_socket::recv(void* buf, std::size_t bytes)
         throw std::system_error(err, std::system_category(), "recv");
     }
 
+    if(len == 0 && this->pimpl->nonblocking)
+    {
+        logger(ll::debug) << "recv: received zero bytes: connection shutdown gracefully\n";
+        return -1;
+    }
+
     logger(ll::debug) << "received " << len << " bytes\n";
 
     return len;
@@ -384,6 +422,8 @@ long common_socket::send(const void* buf, std::size_t bytes)
     // write bytes to a fd
 #if defined(_WIN32)
     auto len(::send(this->pimpl->fd, static_cast<const char*>(buf), (int)bytes, 0));
+#elif defined(MSG_NOSIGNAL)
+    auto len(::send(this->pimpl->fd, buf, bytes, MSG_NOSIGNAL));
 #else
     auto len(::send(this->pimpl->fd, buf, bytes, 0));
 #endif
@@ -391,12 +431,22 @@ long common_socket::send(const void* buf, std::size_t bytes)
     {
         int err = SOCKET_ERRNO();
 #if defined(_WIN32)
+        if(err == WSAEWOULDBLOCK && this->pimpl->nonblocking)
+        {
+            logger(ll::debug) << "send: socket buffer full (WSAEWOULDBLOCK)\n";
+            return 0;
+        }
         if(err == WSAECONNRESET || err == WSAECONNABORTED || err == WSAESHUTDOWN)
         {
             logger(ll::debug) << "send: connection reset/aborted/shutdown\n";
             return -1;
         }
 #else
+        if((err == EAGAIN || err == EWOULDBLOCK) && this->pimpl->nonblocking)
+        {
+            logger(ll::debug) << "send: socket buffer full (EAGAIN)\n";
+            return 0;
+        }
         if(err == EPIPE || err == ECONNRESET)
         {
             logger(ll::debug) << "send: broken pipe/connection reset\n";
@@ -411,6 +461,83 @@ long common_socket::send(const void* buf, std::size_t bytes)
     return len;
 }
 
+long common_socket::send(const const_buffer* bufs, std::size_t count)
+{
+    if(!this->pimpl)
+    {
+        logger(ll::warning) << "sending to invalid socket impl\n";
+        return 0;
+    }
+
+#if defined(_WIN32)
+    std::vector<WSABUF> wsabufs(count);
+    for(std::size_t i(0); i < count; i++)
+    {
+        wsabufs[i].buf = const_cast<char*>(static_cast<const char*>(bufs[i].data)); // NOLINT(cppcoreguidelines-pro-type-const-cast)
+        wsabufs[i].len = static_cast<ULONG>(bufs[i].size);
+    }
+
+    DWORD sent(0);
+    auto ret(::WSASend(this->pimpl->fd, wsabufs.data(), static_cast<DWORD>(count), &sent, 0, nullptr, nullptr));
+    auto len(ret == 0 ? static_cast<long>(sent) : static_cast<long>(SOCKET_ERROR));
+#else
+    // copy the buffer descriptors (never the data) into an iovec array
+    static const std::size_t max_iov(64);
+    iovec iov[max_iov];
+    if(count > max_iov)
+    {
+        count = max_iov;
+    }
+    for(std::size_t i(0); i < count; i++)
+    {
+        iov[i].iov_base = const_cast<void*>(bufs[i].data); // NOLINT(cppcoreguidelines-pro-type-const-cast)
+        iov[i].iov_len = bufs[i].size;
+    }
+
+    msghdr msg {};
+    msg.msg_iov = static_cast<iovec*>(iov);
+    msg.msg_iovlen = static_cast<decltype(msg.msg_iovlen)>(count);
+#if defined(MSG_NOSIGNAL)
+    auto len(::sendmsg(this->pimpl->fd, &msg, MSG_NOSIGNAL));
+#else
+    auto len(::sendmsg(this->pimpl->fd, &msg, 0));
+#endif
+#endif
+
+    if(len == SOCKET_ERROR)
+    {
+        int err = SOCKET_ERRNO();
+#if defined(_WIN32)
+        if(err == WSAEWOULDBLOCK && this->pimpl->nonblocking)
+        {
+            logger(ll::debug) << "sendmsg: socket buffer full (WSAEWOULDBLOCK)\n";
+            return 0;
+        }
+        if(err == WSAECONNRESET || err == WSAECONNABORTED || err == WSAESHUTDOWN)
+        {
+            logger(ll::debug) << "sendmsg: connection reset/aborted/shutdown\n";
+            return -1;
+        }
+#else
+        if((err == EAGAIN || err == EWOULDBLOCK) && this->pimpl->nonblocking)
+        {
+            logger(ll::debug) << "sendmsg: socket buffer full (EAGAIN)\n";
+            return 0;
+        }
+        if(err == EPIPE || err == ECONNRESET)
+        {
+            logger(ll::debug) << "sendmsg: broken pipe/connection reset\n";
+            return -1;
+        }
+#endif
+        throw std::system_error(err, std::system_category(), "sendmsg");
+    }
+
+    logger(ll::debug) << "sent " << len << " bytes from " << count << " buffers\n";
+
+    return len;
+}
+
 // is socket listening
 bool common_socket::listening() const
 {
@@ -430,6 +557,26 @@ bool common_socket::listening() const
     return val != 0;
 }
 
+// does this object wrap an open socket
+bool common_socket::valid() const
+{
+    return static_cast<bool>(this->pimpl);
+}
+
+// switch socket between blocking and non-blocking mode
+void common_socket::set_nonblocking(bool nonblocking)
+{
+    if(!this->pimpl)
+    {
+        logger(ll::warning) << "setting blocking mode on invalid socket impl\n";
+        return;
+    }
+
+    logger(ll::debug) << "setting " << *this << (nonblocking ? " non-blocking\n" : " blocking\n");
+    set_fd_nonblocking(this->pimpl->fd, nonblocking);
+    this->pimpl->nonblocking = nonblocking;
+}
+
 bool common_socket::operator<(const common_socket& other) const
 {
     if(!this->pimpl || !other.pimpl)
@@ -693,3 +840,419 @@ inet4_socket::inet4_socket(const char* host, const char* service, bool connectin
 inet6_socket::inet6_socket(const char* host, const char* service, bool connecting) : inet_socket(host, service, PF_INET6, connecting)
 {
 }
+
+// a connected pair of non-blocking sockets: a byte written to one end makes the other readable
+
+struct wake_pair
+{
+    std::shared_ptr<socket_initializer> socket_subsystem;
+    SOCKET read_end { INVALID_SOCKET };
+    SOCKET write_end { INVALID_SOCKET };
+
+    wake_pair() : socket_subsystem(get_shared_instance<socket_initializer>())
+    {
+#if defined(_WIN32)
+        // no socketpair on Windows: connect two loopback sockets through a temporary listener
+        auto listener(::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+        sockaddr_in addr {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t addrlen(sizeof(addr));
+        auto* sa(static_cast<sockaddr*>(static_cast<void*>(&addr)));
+        if(listener == INVALID_SOCKET || ::bind(listener, sa, addrlen) == SOCKET_ERROR || ::listen(listener, 1) == SOCKET_ERROR || ::getsockname(listener, sa, &addrlen) == SOCKET_ERROR)
+        {
+            auto err(SOCKET_ERRNO());
+            ::closesocket(listener);
+            throw std::system_error(err, std::system_category(), "wake_pair: listen");
+        }
+        this->write_end = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if(this->write_end == INVALID_SOCKET || ::connect(this->write_end, sa, addrlen) == SOCKET_ERROR)
+        {
+            auto err(SOCKET_ERRNO());
+            ::closesocket(listener);
+            ::closesocket(this->write_end);
+            throw std::system_error(err, std::system_category(), "wake_pair: connect");
+        }
+        this->read_end = ::accept(listener, nullptr, nullptr);
+        ::closesocket(listener);
+        if(this->read_end == INVALID_SOCKET)
+        {
+            auto err(SOCKET_ERRNO());
+            ::closesocket(this->write_end);
+            throw std::system_error(err, std::system_category(), "wake_pair: accept");
+        }
+#else
+        SOCKET fds[2];
+        if(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == SOCKET_ERROR)
+        {
+            throw std::system_error(SOCKET_ERRNO(), std::system_category(), "socketpair");
+        }
+        this->read_end = fds[0];
+        this->write_end = fds[1];
+#endif
+        set_fd_nonblocking(this->read_end, true);
+        set_fd_nonblocking(this->write_end, true);
+    }
+
+    ~wake_pair()
+    {
+#if defined(_WIN32)
+        ::closesocket(this->read_end);
+        ::closesocket(this->write_end);
+#else
+        ::close(this->read_end);
+        ::close(this->write_end);
+#endif
+    }
+
+    wake_pair(const wake_pair&) = delete;
+    wake_pair& operator=(const wake_pair&) = delete;
+    wake_pair(wake_pair&&) = delete;
+    wake_pair& operator=(wake_pair&&) = delete;
+
+    void signal()
+    {
+        // a full buffer already wakes the reader, so a failed send needs no handling
+        char c(0);
+        (void)::send(this->write_end, &c, 1, 0);
+    }
+
+    void drain()
+    {
+        char buf[64];
+        while(::recv(this->read_end, buf, sizeof(buf), 0) > 0)
+        {
+        }
+    }
+};
+
+// poller backend interface
+
+struct socket_poller::impl
+{
+    struct registration
+    {
+        common_socket sock;
+        bool writable;
+    };
+
+    // registered sockets, keyed by fd
+    std::unordered_map<SOCKET, registration> registered;
+
+    // sockets found ready by the last wait, reused between calls
+    std::vector<event> ready;
+
+    // interrupts a wait from another thread. woken is set from a wake until the wait that sees it
+    wake_pair waker;
+    std::atomic<bool> woken { false };
+
+    // called by a backend when it finds the read end of the waker readable
+    void clear_wake()
+    {
+        // clear first: a wake from now on writes again, and is either drained here or seen by the next wait
+        this->woken.store(false);
+        this->waker.drain();
+    }
+
+    virtual ~impl() = default;
+    virtual const char* name() const = 0;
+    virtual void add(SOCKET fd) = 0;
+    virtual void remove(SOCKET fd) = 0;
+    virtual void modify(SOCKET fd, bool writable) = 0;
+    virtual void wait(long usec) = 0;
+};
+
+// select(2) backend: portable, level-triggered, limited to FD_SETSIZE
+
+struct socket_poller::select_impl : public socket_poller::impl
+{
+    const char* name() const override
+    {
+        return "select";
+    }
+
+    void add(SOCKET fd) override
+    {
+#if !defined(_WIN32)
+        // on unix, fd_set is a bitmap indexed by fd
+        if(fd >= FD_SETSIZE)
+        {
+            throw std::system_error(std::make_error_code(std::errc::too_many_files_open), "select: fd exceeds FD_SETSIZE");
+        }
+#else
+        if(this->registered.size() >= FD_SETSIZE)
+        {
+            throw std::system_error(std::make_error_code(std::errc::too_many_files_open), "select: too many sockets");
+        }
+        (void)fd;
+#endif
+    }
+
+    void remove(SOCKET /* fd */) override
+    {
+    }
+
+    void modify(SOCKET /* fd */, bool /* writable */) override
+    {
+    }
+
+    void wait(long usec) override
+    {
+        // the waker is always in the set, so it is never empty (which select rejects on Windows)
+        fd_set rfds;
+        fd_set wfds;
+        FD_ZERO(&rfds);
+        FD_ZERO(&wfds);
+        FD_SET(this->waker.read_end, &rfds);
+        auto max_fd(this->waker.read_end);
+        for(const auto& it : this->registered)
+        {
+            FD_SET(it.first, &rfds);
+            if(it.second.writable)
+            {
+                FD_SET(it.first, &wfds);
+            }
+            if(it.first > max_fd)
+            {
+                max_fd = it.first;
+            }
+        }
+
+        // set the timeout
+        timeval tv {};
+        tv.tv_sec = usec / 1000000;
+        tv.tv_usec = static_cast<int>(usec % 1000000);
+
+        // do the select
+        auto err(::select(static_cast<int>(max_fd + 1), &rfds, &wfds, nullptr, usec < 0 ? nullptr : &tv));
+        if(err == SOCKET_ERROR)
+        {
+            throw std::system_error(SOCKET_ERRNO(), std::system_category(), "select");
+        }
+
+        if(err > 0)
+        {
+            if(FD_ISSET(this->waker.read_end, &rfds) != 0)
+            {
+                this->clear_wake();
+            }
+
+            for(const auto& it : this->registered)
+            {
+                auto readable(FD_ISSET(it.first, &rfds) != 0);
+                auto writable(FD_ISSET(it.first, &wfds) != 0);
+                if(readable || writable)
+                {
+                    this->ready.push_back({ it.second.sock, readable, writable });
+                }
+            }
+        }
+    }
+};
+
+#if defined(__linux__)
+// epoll(7) backend: edge-triggered, readiness cost proportional to active sockets
+
+struct socket_poller::epoll_impl : public socket_poller::impl
+{
+    int epfd;
+    std::vector<epoll_event> events;
+
+    epoll_impl() : epfd(::epoll_create1(EPOLL_CLOEXEC)), events(64)
+    {
+        if(this->epfd == -1)
+        {
+            throw std::system_error(errno, std::system_category(), "epoll_create1");
+        }
+
+        // level-triggered, as it is drained completely each time
+        epoll_event ev {};
+        ev.events = EPOLLIN;
+        ev.data.fd = this->waker.read_end;
+        if(::epoll_ctl(this->epfd, EPOLL_CTL_ADD, this->waker.read_end, &ev) == -1)
+        {
+            auto err(errno);
+            ::close(this->epfd);
+            throw std::system_error(err, std::system_category(), "epoll_ctl");
+        }
+    }
+
+    ~epoll_impl() override
+    {
+        ::close(this->epfd);
+    }
+
+    epoll_impl(const epoll_impl&) = delete;
+    epoll_impl& operator=(const epoll_impl&) = delete;
+    epoll_impl(epoll_impl&&) = delete;
+    epoll_impl& operator=(epoll_impl&&) = delete;
+
+    const char* name() const override
+    {
+        return "epoll";
+    }
+
+    void control(int op, SOCKET fd, bool writable)
+    {
+        epoll_event ev {};
+        ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET | (writable ? static_cast<std::uint32_t>(EPOLLOUT) : 0U);
+        ev.data.fd = fd;
+        if(::epoll_ctl(this->epfd, op, fd, &ev) == -1)
+        {
+            throw std::system_error(errno, std::system_category(), "epoll_ctl");
+        }
+    }
+
+    void add(SOCKET fd) override
+    {
+        this->control(EPOLL_CTL_ADD, fd, false);
+    }
+
+    void remove(SOCKET fd) override
+    {
+        if(::epoll_ctl(this->epfd, EPOLL_CTL_DEL, fd, nullptr) == -1)
+        {
+            logger(ll::warning) << "epoll_ctl: could not remove fd " << fd << ": " << std::strerror(errno) << '\n';
+        }
+    }
+
+    void modify(SOCKET fd, bool writable) override
+    {
+        this->control(EPOLL_CTL_MOD, fd, writable);
+    }
+
+    void wait(long usec) override
+    {
+        // round up to whole milliseconds, so short timeouts never become busy loops
+        auto msec(usec < 0 ? -1 : static_cast<int>((usec + 999) / 1000));
+        auto count(::epoll_wait(this->epfd, this->events.data(), static_cast<int>(this->events.size()), msec));
+        if(count == -1)
+        {
+            throw std::system_error(errno, std::system_category(), "epoll_wait");
+        }
+
+        for(auto i(0); i < count; i++)
+        {
+            const auto& ev(this->events[static_cast<std::size_t>(i)]);
+            if(ev.data.fd == this->waker.read_end)
+            {
+                this->clear_wake();
+                continue;
+            }
+
+            auto it(this->registered.find(ev.data.fd));
+            if(it != this->registered.end())
+            {
+                // errors and hangups are reported as readable, so the next recv can observe them
+                auto readable((ev.events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0);
+                auto writable((ev.events & EPOLLOUT) != 0);
+                this->ready.push_back({ it->second.sock, readable, writable });
+            }
+        }
+
+        // grow event buffer if it filled up
+        if(static_cast<std::size_t>(count) == this->events.size())
+        {
+            this->events.resize(this->events.size() * 2);
+        }
+    }
+};
+#endif
+
+socket_poller::socket_poller(bool force_select)
+{
+#if defined(__linux__)
+    if(!force_select)
+    {
+        this->pimpl.reset(new epoll_impl());
+    }
+#else
+    (void)force_select;
+#endif
+    if(!this->pimpl)
+    {
+        this->pimpl.reset(new select_impl());
+    }
+
+    logger(ll::debug) << "created " << this->pimpl->name() << " socket poller\n";
+}
+
+socket_poller::~socket_poller() = default;
+
+// register socket for readability
+void socket_poller::add(const common_socket& sock)
+{
+    if(!sock.pimpl)
+    {
+        logger(ll::warning) << "adding invalid socket impl to poller\n";
+        return;
+    }
+
+    auto fd(sock.pimpl->fd);
+    if(this->pimpl->registered.find(fd) == this->pimpl->registered.end())
+    {
+        this->pimpl->add(fd);
+        this->pimpl->registered.emplace(fd, impl::registration { sock, false });
+    }
+}
+
+// unregister socket
+void socket_poller::remove(const common_socket& sock)
+{
+    if(!sock.pimpl)
+    {
+        return;
+    }
+
+    auto it(this->pimpl->registered.find(sock.pimpl->fd));
+    if(it != this->pimpl->registered.end())
+    {
+        this->pimpl->remove(it->first);
+        this->pimpl->registered.erase(it);
+    }
+}
+
+// also report writability of a registered socket
+void socket_poller::want_writable(const common_socket& sock, bool enable)
+{
+    if(!sock.pimpl)
+    {
+        return;
+    }
+
+    auto it(this->pimpl->registered.find(sock.pimpl->fd));
+    if(it != this->pimpl->registered.end() && it->second.writable != enable)
+    {
+        this->pimpl->modify(it->first, enable);
+        it->second.writable = enable;
+    }
+}
+
+// number of registered sockets
+std::size_t socket_poller::size() const
+{
+    return this->pimpl->registered.size();
+}
+
+// name of backend in use
+const char* socket_poller::backend() const
+{
+    return this->pimpl->name();
+}
+
+// interrupt a wait in progress, or the next one, from any thread
+void socket_poller::wake()
+{
+    if(!this->pimpl->woken.exchange(true))
+    {
+        this->pimpl->waker.signal();
+    }
+}
+
+// wait for ready sockets
+const std::vector<socket_poller::event>& socket_poller::wait(long usec)
+{
+    this->pimpl->ready.clear();
+    this->pimpl->wait(usec);
+    return this->pimpl->ready;
+}
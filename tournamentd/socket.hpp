@@ -3,11 +3,15 @@
 #include <cstdint>
 #include <memory>
 #include <set>
+#include <vector>
 
 class socket_initializer;
+class socket_poller;
 
 class common_socket
 {
+    friend class socket_poller;
+
     std::shared_ptr<socket_initializer> socket_subsystem;
 
 protected:
@@ -25,6 +29,7 @@ public:
     ~common_socket();
 
     // create a new socket by accepting on a listening socket
+    // a non-blocking listener returns an invalid socket if no connection is pending
     common_socket accept() const;
 
     // select on multiple sockets
@@ -33,13 +38,28 @@ public:
     // does socket have data available
     long peek(void* buf, std::size_t bytes) const;
 
-    // data transfer
+    // data transfer. returns -1 if the connection was closed
+    // a blocking recv returns 0 on orderly shutdown. a non-blocking socket instead returns 0 when it would block
     long recv(void* buf, std::size_t bytes);
     long send(const void* buf, std::size_t bytes);
 
+    // gathering send of several buffers in one call
+    struct const_buffer
+    {
+        const void* data;
+        std::size_t size;
+    };
+    long send(const const_buffer* bufs, std::size_t count);
+
     // is socket listening
     bool listening() const;
 
+    // does this object wrap an open socket
+    bool valid() const;
+
+    // switch socket between blocking and non-blocking mode
+    void set_nonblocking(bool nonblocking);
+
     // various operators
     bool operator<(const common_socket& other) const;
     bool operator==(const common_socket& other) const;
@@ -76,3 +96,54 @@ public:
     // create an inet6 socket by either connecting or binding/listening
     inet6_socket(const char* host, const char* service, bool connecting = false);
 };
+
+class socket_poller
+{
+    // pimpl (backend)
+    struct impl;
+    struct select_impl;
+#if defined(__linux__)
+    struct epoll_impl;
+#endif
+    std::unique_ptr<impl> pimpl;
+
+public:
+    // create a poller using the best available backend, or select if requested
+    explicit socket_poller(bool force_select = false);
+    ~socket_poller();
+
+    // Non-copyable, non-movable (manages unique resources)
+    socket_poller(const socket_poller&) = delete;
+    socket_poller& operator=(const socket_poller&) = delete;
+    socket_poller(socket_poller&&) = delete;
+    socket_poller& operator=(socket_poller&&) = delete;
+
+    // readiness of one socket, as reported by wait
+    struct event
+    {
+        common_socket sock;
+        bool readable;
+        bool writable;
+    };
+
+    // register and unregister sockets for readability
+    void add(const common_socket& sock);
+    void remove(const common_socket& sock);
+
+    // also report writability of a registered socket (used while it has output pending)
+    void want_writable(const common_socket& sock, bool enable);
+
+    // number of registered sockets
+    std::size_t size() const;
+
+    // name of backend in use
+    const char* backend() const;
+
+    // wait for ready sockets with given timeout. returned vector is reused by the next call
+    // the epoll backend is edge-triggered: callers must drain each readable socket before waiting again
+    // returns early, possibly with no events, if woken
+    const std::vector<event>& wait(long usec = -1);
+
+    // make a wait in progress return, or the next one if none is. the only member that may be called from another thread
+    void wake();
+};
@@ -0,0 +1,178 @@
+#include "table_occupancy.hpp"
+#include <stdexcept>
+
+// ----- internal
+
+void table_occupancy::move_bucket(std::size_t table, std::size_t from, std::size_t to)
+{
+    if(to >= this->buckets.size())
+    {
+        this->buckets.resize(to + 1);
+    }
+
+    this->buckets[from].erase(table);
+    this->buckets[to].insert(table);
+
+    if(to < this->min_count)
+    {
+        this->min_count = to;
+    }
+    if(to > this->max_count)
+    {
+        this->max_count = to;
+    }
+    this->settle();
+}
+
+// narrow min_count and max_count to non-empty buckets. counts change by one at a time, so this is amortized O(1)
+void table_occupancy::settle()
+{
+    if(this->tables.empty())
+    {
+        this->min_count = 0;
+        this->max_count = 0;
+        return;
+    }
+
+    while(this->buckets[this->min_count].empty())
+    {
+        this->min_count++;
+    }
+    while(this->buckets[this->max_count].empty())
+    {
+        this->max_count--;
+    }
+}
+
+// ----- tables
+
+std::size_t table_occupancy::table_count() const
+{
+    return this->tables.size();
+}
+
+void table_occupancy::resize(std::size_t table_count)
+{
+    if(this->buckets.empty())
+    {
+        this->buckets.resize(1);
+    }
+
+    while(this->tables.size() > table_count)
+    {
+        auto table(this->tables.size() - 1);
+        if(this->counts[table] != 0)
+        {
+            throw std::logic_error("tried to remove a table with players seated");
+        }
+        this->buckets[0].erase(table);
+        this->tables.pop_back();
+        this->counts.pop_back();
+    }
+
+    while(this->tables.size() < table_count)
+    {
+        this->buckets[0].insert(this->tables.size());
+        this->tables.emplace_back();
+        this->counts.push_back(0);
+        this->min_count = 0;
+    }
+
+    this->settle();
+}
+
+void table_occupancy::clear()
+{
+    this->tables.clear();
+    this->counts.clear();
+    this->buckets.clear();
+    this->min_count = 0;
+    this->max_count = 0;
+}
+
+// ----- seats
+
+void table_occupancy::add(const td::seat& seat, player_handle_t player)
+{
+    auto& table(this->tables.at(seat.table_number));
+    if(seat.seat_number >= table.size())
+    {
+        table.resize(seat.seat_number + 1, invalid_player_handle);
+    }
+
+    if(table[seat.seat_number] != invalid_player_handle)
+    {
+        throw std::logic_error("seat is already occupied");
+    }
+
+    table[seat.seat_number] = player;
+    auto& count(this->counts[seat.table_number]);
+    this->move_bucket(seat.table_number, count, count + 1);
+    count++;
+}
+
+void table_occupancy::remove(const td::seat& seat)
+{
+    auto& table(this->tables.at(seat.table_number));
+    if(seat.seat_number >= table.size() || table[seat.seat_number] == invalid_player_handle)
+    {
+        throw std::logic_error("seat is not occupied");
+    }
+
+    table[seat.seat_number] = invalid_player_handle;
+    auto& count(this->counts[seat.table_number]);
+    this->move_bucket(seat.table_number, count, count - 1);
+    count--;
+}
+
+// ----- queries
+
+std::size_t table_occupancy::count_at(std::size_t table) const
+{
+    return this->counts.at(table);
+}
+
+player_handle_t table_occupancy::player_at(std::size_t table, std::size_t index) const
+{
+    for(auto player : this->tables.at(table))
+    {
+        if(player != invalid_player_handle && index-- == 0)
+        {
+            return player;
+        }
+    }
+
+    throw std::out_of_range("no such player at table");
+}
+
+std::vector<player_handle_t> table_occupancy::players_at(std::size_t table) const
+{
+    std::vector<player_handle_t> ret;
+    ret.reserve(this->counts.at(table));
+    for(auto player : this->tables[table])
+    {
+        if(player != invalid_player_handle)
+        {
+            ret.push_back(player);
+        }
+    }
+    return ret;
+}
+
+std::size_t table_occupancy::fewest() const
+{
+    if(this->tables.empty())
+    {
+        throw std::out_of_range("no tables");
+    }
+    return *this->buckets[this->min_count].begin();
+}
+
+std::size_t table_occupancy::most() const
+{
+    if(this->tables.empty())
+    {
+        throw std::out_of_range("no tables");
+    }
+    return *this->buckets[this->max_count].begin();
+}
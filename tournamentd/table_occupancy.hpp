@@ -0,0 +1,53 @@
+#pragma once
+#include "player_handles.hpp"
+#include "types.hpp"
+#include <cstddef>
+#include <set>
+#include <vector>
+
+// players seated at each table, kept up to date seat by seat
+// tables are bucketed by player count, so the least and most full tables are found in O(1)
+class table_occupancy
+{
+    // per table, per seat number: seated player or invalid_player_handle
+    std::vector<std::vector<player_handle_t>> tables;
+
+    // per table: seated player count
+    std::vector<std::size_t> counts;
+
+    // per player count: tables with that count, ordered by table number
+    std::vector<std::set<std::size_t>> buckets;
+
+    // lowest and highest non-empty bucket
+    std::size_t min_count { 0 };
+    std::size_t max_count { 0 };
+
+    void move_bucket(std::size_t table, std::size_t from, std::size_t to);
+    void settle();
+
+public:
+    // number of tables
+    std::size_t table_count() const;
+
+    // add or remove tables at the end. removed tables must be empty
+    void resize(std::size_t table_count);
+
+    void clear();
+
+    // seat or unseat a player. table must exist
+    void add(const td::seat& seat, player_handle_t player);
+    void remove(const td::seat& seat);
+
+    // players seated at a table
+    std::size_t count_at(std::size_t table) const;
+
+    // the index'th player at a table, counting by seat number, index < count_at(table)
+    player_handle_t player_at(std::size_t table, std::size_t index) const;
+
+    // all players at a table, by seat number
+    std::vector<player_handle_t> players_at(std::size_t table) const;
+
+    // lowest-numbered table among those with the fewest or most players. there must be at least one table
+    std::size_t fewest() const;
+    std::size_t most() const;
+};
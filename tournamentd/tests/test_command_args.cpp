@@ -0,0 +1,201 @@
+#include "../command_args.hpp"
+#include "nlohmann/json.hpp"
+#include <Catch2/catch.hpp>
+#include <stdexcept>
+#include <string>
+
+static constexpr arg_spec test_specs[] = {
+    { "player_id", arg_type::string, true, nullptr, "Player" },
+    { "table", arg_type::integer, false, "-1", "Table" },
+    { "chips", arg_type::count, false, "100", "Chips" },
+    { "ratio", arg_type::number, false, "0.5", "Ratio" },
+    { "clear", arg_type::boolean, false, "false", "Clear" },
+    { "levels", arg_type::array, false, nullptr, "Levels" },
+    { "cost", arg_type::object, false, nullptr, "Cost" },
+    { "topic", arg_type::any, false, nullptr, "Topic" },
+};
+
+static constexpr auto player_id(make_arg_field<arg_type::string>(test_specs, "player_id"));
+static constexpr auto table(make_arg_field<arg_type::integer>(test_specs, "table"));
+static constexpr auto chips(make_arg_field<arg_type::count>(test_specs, "chips"));
+static constexpr auto ratio(make_arg_field<arg_type::number>(test_specs, "ratio"));
+static constexpr auto clear(make_arg_field<arg_type::boolean>(test_specs, "clear"));
+static constexpr auto levels(make_arg_field<arg_type::array>(test_specs, "levels"));
+static constexpr auto cost(make_arg_field<arg_type::object>(test_specs, "cost"));
+static constexpr auto topic(make_arg_field<arg_type::any>(test_specs, "topic"));
+
+// another schema, whose fields are not for the one above
+static constexpr arg_spec other_specs[] = {
+    { "player_id", arg_type::string, true, nullptr, "Player" }
+};
+static constexpr auto other_player_id(make_arg_field<arg_type::string>(other_specs, "player_id"));
+
+static bool parse_text(command_args& args, const std::string& text, bool keep_input = false)
+{
+    return args.parse(make_arg_list(test_specs), keep_input, text.data(), text.data() + text.size());
+}
+
+TEST_CASE("Command arguments parse against a schema", "[command_args]")
+{
+    command_args args;
+
+    SECTION("Typed values")
+    {
+        REQUIRE(parse_text(args, R"({"player_id":"p1","table":-3,"chips":5000,"ratio":2,"clear":true,"topic":null})"));
+        REQUIRE(args.error().empty());
+        REQUIRE(args.get(player_id) == "p1");
+        REQUIRE(args.get(table) == -3);
+        REQUIRE(args.get(chips) == 5000);
+        REQUIRE(args.get(ratio) == 2.0);
+        REQUIRE(args.get(clear));
+        REQUIRE(args.has(topic));
+        REQUIRE(args.get(topic).is_null());
+        REQUIRE_FALSE(args.has(levels));
+    }
+
+    SECTION("Defaults")
+    {
+        REQUIRE(parse_text(args, R"({"player_id":"p1"})"));
+        REQUIRE_FALSE(args.has(table));
+        REQUIRE(args.get(table) == -1);
+        REQUIRE(args.get(chips) == 100);
+        REQUIRE(args.get(ratio) == 0.5);
+        REQUIRE_FALSE(args.get(clear));
+
+        // no default, not sent
+        REQUIRE_THROWS_AS(args.get(levels), std::logic_error);
+    }
+
+    SECTION("Fields are read only from their own schema")
+    {
+        REQUIRE(parse_text(args, R"({"player_id":"p1"})"));
+        REQUIRE_THROWS_AS(args.get(other_player_id), std::logic_error);
+        REQUIRE_FALSE(args.has(other_player_id));
+    }
+
+    SECTION("Fields are found at compile time")
+    {
+        static_assert(player_id.spec == &test_specs[0], "field names its argument");
+        static_assert(topic.spec == &test_specs[7], "field names its argument");
+        REQUIRE(cost.spec->type == arg_type::object);
+    }
+
+    SECTION("Nested values")
+    {
+        REQUIRE(parse_text(args, R"({"player_id":"p1","levels":[{"little_blind":1,"big_blind":2},[],[1,[2.5,"x"]]],"cost":{"amount":20.5,"currency":"USD","tags":[true,null]}})"));
+        REQUIRE(args.get(levels) == nlohmann::json::parse(R"([{"little_blind":1,"big_blind":2},[],[1,[2.5,"x"]]])"));
+        REQUIRE(args.get(cost) == nlohmann::json::parse(R"({"amount":20.5,"currency":"USD","tags":[true,null]})"));
+    }
+
+    SECTION("Unknown members are ignored")
+    {
+        REQUIRE(parse_text(args, R"({"other":{"player_id":3},"player_id":"p1","more":[1,2]})"));
+        REQUIRE(args.get(player_id) == "p1");
+    }
+
+    SECTION("Missing required argument")
+    {
+        REQUIRE_FALSE(parse_text(args, R"({"table":1})"));
+        REQUIRE(args.error() == "missing player_id");
+    }
+
+    SECTION("Wrong type")
+    {
+        REQUIRE_FALSE(parse_text(args, R"({"player_id":7})"));
+        REQUIRE(args.error() == "argument player_id must be of type string");
+
+        REQUIRE_FALSE(parse_text(args, R"({"player_id":"p1","chips":-5})"));
+        REQUIRE(args.error() == "argument chips must be of type non-negative integer");
+
+        REQUIRE_FALSE(parse_text(args, R"({"player_id":"p1","table":1.5})"));
+        REQUIRE(args.error() == "argument table must be of type integer");
+
+        REQUIRE_FALSE(parse_text(args, R"({"player_id":"p1","cost":[]})"));
+        REQUIRE(args.error() == "argument cost must be of type object");
+    }
+
+    SECTION("Out of range")
+    {
+        REQUIRE_FALSE(parse_text(args, R"({"player_id":"p1","table":18446744073709551615})"));
+        REQUIRE(args.error() == "argument table is out of range");
+    }
+
+    SECTION("First error wins")
+    {
+        REQUIRE_FALSE(parse_text(args, R"({"clear":1,"player_id":2})"));
+        REQUIRE(args.error() == "argument clear must be of type bool");
+    }
+
+    SECTION("Echo and authenticate")
+    {
+        REQUIRE(parse_text(args, R"({"echo":{"id":[1,2]},"authenticate":1234,"player_id":"p1"})"));
+        REQUIRE(args.has_echo());
+        REQUIRE(args.echo() == nlohmann::json::parse(R"({"id":[1,2]})"));
+        REQUIRE(args.has_authenticate());
+        REQUIRE(args.authenticate() == 1234);
+
+        // echo is still captured when the arguments are rejected
+        REQUIRE_FALSE(parse_text(args, R"({"player_id":false,"echo":"e"})"));
+        REQUIRE(args.has_echo());
+        REQUIRE(args.echo() == "e");
+
+        REQUIRE_FALSE(parse_text(args, R"({"player_id":"p1","authenticate":"1234"})"));
+        REQUIRE(args.error() == "argument authenticate must be of type integer");
+    }
+
+    SECTION("Reparse resets state")
+    {
+        REQUIRE(parse_text(args, R"({"player_id":"p1","echo":1,"table":4})"));
+        REQUIRE(parse_text(args, R"({"player_id":"p2"})"));
+        REQUIRE_FALSE(args.has_echo());
+        REQUIRE_FALSE(args.has(table));
+        REQUIRE(args.get(table) == -1);
+    }
+
+    SECTION("Keep input")
+    {
+        REQUIRE(parse_text(args, R"({"player_id":"p1","extra":{"a":[1]},"cost":{"amount":1}})", true));
+        REQUIRE(args.input() == nlohmann::json::parse(R"({"player_id":"p1","extra":{"a":[1]},"cost":{"amount":1}})"));
+        REQUIRE(args.get(cost) == nlohmann::json::parse(R"({"amount":1})"));
+        REQUIRE(args.get(player_id) == "p1");
+    }
+
+    SECTION("Not an object")
+    {
+        REQUIRE_FALSE(parse_text(args, "[1,2]"));
+        REQUIRE(args.error() == "arguments must be an object");
+
+        REQUIRE_FALSE(parse_text(args, "\"p1\""));
+        REQUIRE(args.error() == "arguments must be an object");
+    }
+
+    SECTION("Invalid JSON")
+    {
+        REQUIRE_FALSE(parse_text(args, R"({"player_id":"p1")"));
+        REQUIRE(args.error().find("invalid arguments: ") == 0);
+    }
+
+    SECTION("Document matches text")
+    {
+        const std::string texts[] = {
+            R"({"player_id":"p1","table":2,"levels":[[1]],"echo":3})",
+            R"({"player_id":1})",
+            R"({"table":1})",
+            R"({"player_id":"p1","chips":-1})",
+            R"([])",
+        };
+        for(const auto& text : texts)
+        {
+            command_args from_document;
+            auto ok(parse_text(args, text));
+            REQUIRE(from_document.parse(make_arg_list(test_specs), false, nlohmann::json::parse(text)) == ok);
+            REQUIRE(from_document.error() == args.error());
+            REQUIRE(from_document.has_echo() == args.has_echo());
+            if(ok)
+            {
+                REQUIRE(from_document.get(player_id) == args.get(player_id));
+                REQUIRE(from_document.get(table) == args.get(table));
+            }
+        }
+    }
+}
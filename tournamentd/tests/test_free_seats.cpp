@@ -0,0 +1,66 @@
+#include "../free_seats.hpp"
+#include <Catch2/catch.hpp>
+#include <vector>
+
+TEST_CASE("Free seats fill order and table index", "[free_seats]")
+{
+    free_seats seats;
+    seats.assign({ td::seat(0, 2), td::seat(1, 0), td::seat(0, 0), td::seat(1, 3) });
+
+    REQUIRE(seats.size() == 4);
+    REQUIRE(seats.count_at(0) == 2);
+    REQUIRE(seats.count_at(1) == 2);
+    REQUIRE(seats.count_at(2) == 0);
+
+    SECTION("Seats are taken from the front in fill order")
+    {
+        REQUIRE(seats.pop_front() == td::seat(0, 2));
+        REQUIRE(seats.pop_front() == td::seat(1, 0));
+        REQUIRE(seats.count_at(0) == 1);
+        REQUIRE(seats.count_at(1) == 1);
+        REQUIRE(seats.ordered() == std::vector<td::seat>({ td::seat(0, 0), td::seat(1, 3) }));
+    }
+
+    SECTION("Seats taken at a table are counted by seat number and skipped in fill order")
+    {
+        REQUIRE(seats.take_at(0, 1) == td::seat(0, 2));
+        REQUIRE(seats.take_at(1, 0) == td::seat(1, 0));
+        REQUIRE_THROWS_AS(seats.take_at(1, 1), std::out_of_range);
+        REQUIRE(seats.size() == 2);
+        REQUIRE(seats.front() == td::seat(0, 0));
+        REQUIRE(seats.ordered() == std::vector<td::seat>({ td::seat(0, 0), td::seat(1, 3) }));
+    }
+
+    SECTION("A re-freed seat moves to its new place in fill order")
+    {
+        REQUIRE(seats.erase(td::seat(0, 2)));
+        REQUIRE_FALSE(seats.erase(td::seat(0, 2)));
+        seats.push_back(td::seat(0, 2));
+        seats.push_front(td::seat(2, 5));
+        REQUIRE(seats.contains(td::seat(2, 5)));
+        REQUIRE(seats.ordered() == std::vector<td::seat>({ td::seat(2, 5), td::seat(1, 0), td::seat(0, 0), td::seat(1, 3), td::seat(0, 2) }));
+        REQUIRE_THROWS_AS(seats.push_back(td::seat(1, 0)), std::logic_error);
+    }
+
+    SECTION("Erasing a table removes only its seats")
+    {
+        seats.erase_table(0);
+        REQUIRE(seats.size() == 2);
+        REQUIRE(seats.count_at(0) == 0);
+        REQUIRE_FALSE(seats.contains(td::seat(0, 0)));
+        REQUIRE(seats.ordered() == std::vector<td::seat>({ td::seat(1, 0), td::seat(1, 3) }));
+    }
+
+    SECTION("Churn keeps the queue consistent")
+    {
+        for(int i(0); i < 1000; i++)
+        {
+            auto seat(seats.take_at(i % 2, 0));
+            seats.push_back(seat);
+        }
+        REQUIRE(seats.size() == 4);
+        REQUIRE(seats.count_at(0) == 2);
+        REQUIRE(seats.count_at(1) == 2);
+        REQUIRE(seats.ordered().size() == 4);
+    }
+}
@@ -2,8 +2,12 @@
 #include "../gameinfo.hpp"
 #include "nlohmann/json.hpp"
 #include <Catch2/catch.hpp>
+#include <algorithm>
 #include <chrono>
+#include <map>
 #include <memory>
+#include <set>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -108,6 +112,65 @@ TEST_CASE("GameInfo JSON dumping", "[gameinfo][json_dump]")
         REQUIRE(derived_state.is_object());
     }
 
+    SECTION("Derived state follows changes")
+    {
+        gameinfo gi;
+        gi.configure({
+            { "players", { { { "player_id", "p1" }, { "name", "Player 1" } }, { { "player_id", "p2" }, { "name", "Player 2" } }, { { "player_id", "p3" }, { "name", "Player 3" } } } },
+            { "funding_sources", { { { "name", "Buy-in" }, { "type", 0 }, { "chips", 500 }, { "cost", { { "amount", 50.0 }, { "currency", "USD" } } } } } },
+            { "table_capacity", 8 }
+        });
+
+        nlohmann::json before;
+        gi.dump_derived_state(before);
+        REQUIRE(before.count("players_left_text") == 0);
+        REQUIRE(before["seating_chart"].empty());
+
+        // unchanged state gives the same derived state
+        nlohmann::json again;
+        gi.dump_derived_state(again);
+        REQUIRE(again["seated_players"] == before["seated_players"]);
+        REQUIRE(again["buyin_text"] == before["buyin_text"]);
+
+        // seating
+        gi.plan_seating(3);
+        gi.add_player("p1");
+        gi.add_player("p2");
+        nlohmann::json seated;
+        gi.dump_derived_state(seated);
+        REQUIRE(seated["players_left_text"] == "2");
+        REQUIRE(seated["seated_players"][0].count("table_name") == 1);
+        REQUIRE(seated["seated_players"][2].count("table_name") == 0);
+        REQUIRE(seated["tables_playing"].size() == 1);
+
+        // funding
+        gi.add_player("p3");
+        gi.fund_player("p1", 0);
+        gi.fund_player("p2", 0);
+        gi.fund_player("p3", 0);
+        nlohmann::json funded;
+        gi.dump_derived_state(funded);
+        REQUIRE(funded["entries_text"] == "3");
+        REQUIRE(funded["average_stack_text"] == "500");
+        REQUIRE(funded["results"].size() == 3);
+        REQUIRE(funded["seated_players"][0]["buyin"] == true);
+
+        // configuration
+        gi.configure({ { "players", { { { "player_id", "p1" }, { "name", "Renamed" } }, { { "player_id", "p2" }, { "name", "Player 2" } }, { { "player_id", "p3" }, { "name", "Player 3" } } } } });
+        nlohmann::json renamed;
+        gi.dump_derived_state(renamed);
+        REQUIRE(renamed["seated_players"][0]["player_name"] == "Renamed");
+
+        // results
+        gi.bust_player("p2");
+        nlohmann::json busted;
+        gi.dump_derived_state(busted);
+        REQUIRE(busted["results"].size() == 3);
+        REQUIRE(busted["results"][1]["name"] == "");
+        REQUIRE(busted["results"][2]["name"] == "Player 2");
+        REQUIRE(busted["players_left_text"] == "2");
+    }
+
     SECTION("Configuration roundtrip")
     {
         gameinfo gi1;
@@ -133,6 +196,47 @@ TEST_CASE("GameInfo JSON dumping", "[gameinfo][json_dump]")
         nlohmann::json state2;
         REQUIRE_NOTHROW(gi2.dump_state(state2));
     }
+
+    SECTION("State roundtrip")
+    {
+        gameinfo gi1;
+        nlohmann::json config = {
+            { "players", { { { "player_id", "p1" }, { "name", "Player 1" } }, { { "player_id", "p2" }, { "name", "Player 2" } }, { { "player_id", "p3" }, { "name", "Player 3" } } } },
+            { "funding_sources", { { { "name", "Buy-in" }, { "type", 0 }, { "chips", 1000 }, { "cost", { { "amount", 50.0 }, { "currency", "USD" } } } } } },
+            { "table_capacity", 4 }
+        };
+        gi1.configure(config);
+        gi1.plan_seating(3);
+        for(auto p : { "p3", "p1", "p2" })
+        {
+            gi1.add_player(p);
+            gi1.fund_player(p, 0);
+        }
+        gi1.bust_player("p3");
+
+        // player ids appear as ids in dumped state
+        nlohmann::json state1;
+        gi1.dump_state(state1);
+        REQUIRE(state1.at("seats").size() == 2);
+        REQUIRE(state1.at("seats").count("p1") == 1);
+        REQUIRE(state1.at("players_finished") == nlohmann::json { "p3" });
+        REQUIRE(state1.at("entries") == nlohmann::json { "p3", "p1", "p2" });
+        REQUIRE(state1.at("buyins").size() == 2);
+
+        // and load back into another game with a differently ordered roster
+        gameinfo gi2;
+        config["players"] = { config["players"][2], config["players"][0], config["players"][1] };
+        gi2.configure(config);
+        gi2.configure(state1);
+        nlohmann::json state2;
+        gi2.dump_state(state2);
+        REQUIRE(state2.at("seats") == state1.at("seats"));
+        REQUIRE(state2.at("players_finished") == state1.at("players_finished"));
+        REQUIRE(state2.at("entries") == state1.at("entries"));
+        REQUIRE(std::set<std::string>(state2.at("buyins").begin(), state2.at("buyins").end()) == std::set<std::string>(state1.at("buyins").begin(), state1.at("buyins").end()));
+        REQUIRE_THROWS(gi2.bust_player("p3"));
+        REQUIRE_NOTHROW(gi2.bust_player("p2"));
+    }
 }
 
 TEST_CASE("GameInfo state management", "[gameinfo][state]")
@@ -189,6 +293,111 @@ TEST_CASE("GameInfo state management", "[gameinfo][state]")
         REQUIRE_NOTHROW(gi.update());
         REQUIRE_NOTHROW(gi.update());
     }
+
+    SECTION("Snapshot")
+    {
+        gameinfo gi;
+        gi.set_clock_override(std::chrono::system_clock::time_point(std::chrono::milliseconds(1500000000000)));
+        nlohmann::json config = {
+            { "players", { { { "player_id", "p1" }, { "name", "Player 1" } }, { { "player_id", "p2" }, { "name", "Player 2" } } } },
+            { "table_capacity", 2 }
+        };
+        gi.configure(config);
+        gi.plan_seating(2);
+        gi.add_player("p1");
+
+        auto snapshot(gi.snapshot());
+        nlohmann::json before;
+        snapshot->dump_state(before);
+        snapshot->dump_derived_state(before);
+
+        // the copy is unaffected by later changes and by the clock moving on
+        gi.set_clock_override(std::chrono::system_clock::time_point(std::chrono::milliseconds(1500000060000)));
+        gi.add_player("p2");
+        nlohmann::json after;
+        snapshot->dump_state(after);
+        snapshot->dump_derived_state(after);
+        REQUIRE(after == before);
+        REQUIRE(after.at("current_time") == 1500000000000);
+        REQUIRE(after.at("seats").size() == 1);
+
+        nlohmann::json current;
+        gi.dump_state(current);
+        REQUIRE(current.at("seats").size() == 2);
+
+        // several threads may read one snapshot, building its derived state together
+        auto shared(gi.snapshot());
+        std::vector<nlohmann::json> derived(4);
+        std::vector<std::thread> readers;
+        for(auto& out : derived)
+        {
+            readers.emplace_back([&shared, &out]()
+            {
+                shared->dump_derived_state(out);
+            });
+        }
+        for(auto& reader : readers)
+        {
+            reader.join();
+        }
+        for(const auto& out : derived)
+        {
+            REQUIRE(out == derived.front());
+            REQUIRE(out.at("seated_players").size() == 2);
+        }
+    }
+
+    SECTION("Snapshots share derived state until it changes")
+    {
+        gameinfo gi;
+        gi.set_clock_override(std::chrono::system_clock::time_point(std::chrono::milliseconds(1500000000000)));
+        nlohmann::json config = {
+            { "players", { { { "player_id", "p1" }, { "name", "Player 1" } }, { { "player_id", "p2" }, { "name", "Player 2" } } } },
+            { "table_capacity", 2 }
+        };
+        gi.configure(config);
+        gi.plan_seating(2);
+        gi.add_player("p1");
+
+        // taking a snapshot builds nothing
+        auto first(gi.snapshot());
+        REQUIRE(first->derived_sections_built() == 0);
+        nlohmann::json before;
+        first->dump_derived_state(before);
+        auto built(first->derived_sections_built());
+        REQUIRE(built > 0);
+
+        // a snapshot for a clock-only broadcast builds nothing, before or after serializing
+        gi.set_clock_override(std::chrono::system_clock::time_point(std::chrono::milliseconds(1500000060000)));
+        auto second(gi.snapshot());
+        REQUIRE(second->derived_sections_built() == built);
+        nlohmann::json after;
+        second->dump_derived_state(after);
+        REQUIRE(second->derived_sections_built() == built);
+        REQUIRE(gi.derived_sections_built() == built);
+        REQUIRE(after.at("seated_players") == before.at("seated_players"));
+        REQUIRE(after.at("seating_chart") == before.at("seating_chart"));
+        REQUIRE(after.at("results") == before.at("results"));
+
+        // a change rebuilds what depends on it, once serialized, not when the snapshot is taken
+        gi.add_player("p2");
+        auto third(gi.snapshot());
+        REQUIRE(third->derived_sections_built() == built);
+        nlohmann::json changed;
+        third->dump_derived_state(changed);
+        REQUIRE(changed.at("seated_players").size() == 2);
+        auto rebuilt(third->derived_sections_built());
+        REQUIRE(rebuilt > built);
+
+        // the earlier snapshot keeps what was built for it, and the game shares the new sections
+        nlohmann::json earlier;
+        first->dump_derived_state(earlier);
+        REQUIRE(earlier.at("seated_players") == before.at("seated_players"));
+        nlohmann::json live;
+        gi.dump_derived_state(live);
+        REQUIRE(live.at("seated_players") == changed.at("seated_players"));
+        REQUIRE(gi.derived_sections_built() == rebuilt);
+    }
 }
 
 TEST_CASE("GameInfo player management", "[gameinfo][players]")
@@ -276,6 +485,71 @@ TEST_CASE("GameInfo player management", "[gameinfo][players]")
         // Bust non-existent player should throw
         REQUIRE_THROWS(gi.bust_player("nonexistent"));
     }
+
+    SECTION("Reconfigure players")
+    {
+        gameinfo gi;
+
+        nlohmann::json config = {
+            { "players", { { { "player_id", "p1" }, { "name", "Player 1" } }, { { "player_id", "p2" }, { "name", "Player 2" } }, { { "player_id", "p3" }, { "name", "Player 3" } } } },
+            { "table_capacity", 4 }
+        };
+        gi.configure(config);
+        gi.plan_seating(3);
+        REQUIRE(gi.add_player("p3").second.player_name == "Player 3");
+
+        // reorder, rename and remove players. lookups follow the new list
+        config["players"] = { { { "player_id", "p3" }, { "name", "Renamed 3" } }, { { "player_id", "p1" }, { "name", "Player 1" } } };
+        gi.configure(config);
+        REQUIRE(gi.add_player("p1").second.player_name == "Player 1");
+        REQUIRE_THROWS(gi.add_player("p2"));
+
+        nlohmann::json state;
+        gi.dump_derived_state(state);
+        std::map<std::string, std::string> names;
+        for(const auto& p : state.at("seated_players"))
+        {
+            names[p.at("player_id").get<std::string>()] = p.at("player_name").get<std::string>();
+        }
+        REQUIRE(names.size() == 2);
+        REQUIRE(names["p3"] == "Renamed 3");
+        REQUIRE(names["p1"] == "Player 1");
+    }
+
+    SECTION("Reconfigure one player at a time")
+    {
+        gameinfo gi;
+
+        nlohmann::json config = {
+            { "players", { { { "player_id", "p1" }, { "name", "First p1" } }, { { "player_id", "p2" }, { "name", "Player 2" } }, { { "player_id", "p1" }, { "name", "Second p1" } } } },
+            { "table_capacity", 4 }
+        };
+        gi.configure(config);
+        gi.plan_seating(4);
+
+        // the first of duplicate ids wins
+        REQUIRE(gi.add_player("p1").second.player_name == "First p1");
+
+        // replacing the first one leaves the duplicate in charge of its id
+        config["players"][0] = { { "player_id", "p4" }, { "name", "Player 4" } };
+        gi.configure(config);
+        REQUIRE(gi.add_player("p1").second.player_name == "Second p1");
+        REQUIRE(gi.add_player("p4").second.player_name == "Player 4");
+
+        // an appended player is found, and a changed id no longer is
+        config["players"].push_back({ { "player_id", "p5" }, { "name", "Player 5" } });
+        config["players"][1] = { { "player_id", "p6" }, { "name", "Player 6" } };
+        gi.configure(config);
+        REQUIRE(gi.add_player("p5").second.player_name == "Player 5");
+        REQUIRE(gi.add_player("p6").second.player_name == "Player 6");
+        REQUIRE_THROWS(gi.add_player("p2"));
+
+        // and an id moved back ahead of its duplicate wins again
+        config["players"][0] = { { "player_id", "p1" }, { "name", "Moved p1" } };
+        gi.configure(config);
+        REQUIRE(gi.add_player("p1").second.player_name == "Moved p1");
+        REQUIRE_THROWS(gi.add_player("p4"));
+    }
 }
 
 TEST_CASE("GameInfo seating management", "[gameinfo][seating]")
@@ -303,6 +577,55 @@ TEST_CASE("GameInfo seating management", "[gameinfo][seating]")
         REQUIRE_THROWS(gi.plan_seating(1));
     }
 
+    SECTION("Re-planning moves as few players as possible")
+    {
+        gameinfo gi;
+
+        nlohmann::json players = nlohmann::json::array();
+        for(int i(0); i < 8; i++)
+        {
+            players.push_back({ { "player_id", "p" + std::to_string(i) }, { "name", "Player " + std::to_string(i) } });
+        }
+        gi.configure({ { "players", players }, { "table_capacity", 6 } });
+
+        // one table of five
+        gi.plan_seating(5);
+        for(int i(0); i < 5; i++)
+        {
+            gi.add_player("p" + std::to_string(i));
+        }
+
+        nlohmann::json before;
+        gi.dump_state(before);
+
+        // two tables: only two players need to move to the new table to balance 3 and 2
+        auto movements = gi.plan_seating(8);
+        REQUIRE(movements.size() == 2);
+
+        nlohmann::json after;
+        gi.dump_state(after);
+        std::size_t stayed(0);
+        std::vector<std::size_t> counts(2);
+        for(auto it(after["seats"].begin()); it != after["seats"].end(); ++it)
+        {
+            counts[(*it)["table_number"].get<std::size_t>()]++;
+            if(*it == before["seats"][it.key()])
+            {
+                stayed++;
+            }
+        }
+        REQUIRE(stayed == 3);
+        REQUIRE(counts[0] == 3);
+        REQUIRE(counts[1] == 2);
+        for(const auto& m : movements)
+        {
+            REQUIRE(m.from_table_name != m.to_table_name);
+        }
+
+        // and back to one table: the two players at the broken table return
+        REQUIRE(gi.plan_seating(5).size() == 2);
+    }
+
     SECTION("Rebalance seating")
     {
         gameinfo gi;
@@ -323,6 +646,55 @@ TEST_CASE("GameInfo seating management", "[gameinfo][seating]")
         auto movements = gi.rebalance_seating();
         REQUIRE_NOTHROW(movements);
     }
+
+    SECTION("Break and balance tables")
+    {
+        gameinfo gi;
+
+        nlohmann::json players = nlohmann::json::array();
+        for(int i(0); i < 12; i++)
+        {
+            players.push_back({ { "player_id", "p" + std::to_string(i) }, { "name", "Player " + std::to_string(i) } });
+        }
+        gi.configure({ { "players", players }, { "table_capacity", 4 } });
+
+        // three full tables
+        gi.plan_seating(12);
+        for(int i(0); i < 12; i++)
+        {
+            gi.add_player("p" + std::to_string(i));
+        }
+
+        // five players leave, the last table should break and the rest balance at 4 and 3
+        for(int i(0); i < 5; i++)
+        {
+            gi.remove_player("p" + std::to_string(i));
+        }
+        auto movements = gi.rebalance_seating();
+
+        // each player moves at most once, and never to the seat they left
+        std::set<std::string> moved;
+        for(const auto& m : movements)
+        {
+            REQUIRE(moved.insert(m.player_id).second);
+            REQUIRE((m.from_table_name != m.to_table_name || m.from_seat_name != m.to_seat_name));
+        }
+
+        nlohmann::json state;
+        gi.dump_state(state);
+        REQUIRE(state["table_count"] == 2);
+        REQUIRE(state["seats"].size() == 7);
+        REQUIRE(state["empty_seats"].size() == 1);
+
+        std::vector<std::size_t> counts(2);
+        for(const auto& seat : state["seats"])
+        {
+            REQUIRE(seat["table_number"].get<std::size_t>() < 2);
+            counts[seat["table_number"].get<std::size_t>()]++;
+        }
+        REQUIRE(std::max(counts[0], counts[1]) == 4);
+        REQUIRE(std::min(counts[0], counts[1]) == 3);
+    }
 }
 
 TEST_CASE("GameInfo funding management", "[gameinfo][funding]")
@@ -433,6 +805,30 @@ TEST_CASE("GameInfo clock management", "[gameinfo][clock]")
         REQUIRE_NOTHROW(gi.toggle_pause_resume());
     }
 
+    SECTION("A late update catches up on every level that ended")
+    {
+        gameinfo gi;
+        gi.set_clock_override(std::chrono::system_clock::time_point(std::chrono::milliseconds(1500000000000)));
+        nlohmann::json config = {
+            { "blind_levels", { { { "little_blind", 0 }, { "big_blind", 0 } }, { { "little_blind", 25 }, { "big_blind", 50 }, { "duration", 60000 } }, { { "little_blind", 50 }, { "big_blind", 100 }, { "duration", 60000 } }, { { "little_blind", 100 }, { "big_blind", 200 }, { "duration", 60000 } }, { { "little_blind", 200 }, { "big_blind", 400 }, { "duration", 60000 } } } }
+        };
+        gi.configure(config);
+        gi.start();
+
+        nlohmann::json state;
+        gi.dump_state(state);
+        REQUIRE(state.at("current_blind_level") == 1);
+
+        // after a stall (or when replaying the journal) two levels have ended, and both advance in one update
+        gi.set_clock_override(std::chrono::system_clock::time_point(std::chrono::milliseconds(1500000150000)));
+        gi.update();
+        gi.dump_state(state);
+        REQUIRE(state.at("current_blind_level") == 3);
+
+        // the time left carries over, as if each level had ended on time
+        REQUIRE(state.at("end_of_round") == 1500000180000);
+    }
+
     SECTION("Blind level progression")
     {
         gameinfo gi;
@@ -480,6 +876,39 @@ TEST_CASE("GameInfo clock management", "[gameinfo][clock]")
         gi.reset_action_clock();
         REQUIRE_NOTHROW(gi.set_action_clock(-1000)); // Negative values are allowed
     }
+
+    SECTION("Next deadline")
+    {
+        gameinfo gi;
+
+        nlohmann::json config = { { "blind_levels", { { { "little_blind", 0 }, { "big_blind", 0 } }, { { "little_blind", 25 }, { "big_blind", 50 }, { "duration", 60000 } }, { { "little_blind", 50 }, { "big_blind", 100 }, { "duration", 60000 } } } } };
+        gi.configure(config);
+
+        // Nothing scheduled before start
+        REQUIRE(gi.next_deadline() == std::chrono::system_clock::time_point());
+
+        // End of round once started
+        auto now(std::chrono::system_clock::now());
+        gi.start();
+        auto end_of_round(gi.next_deadline());
+        REQUIRE(end_of_round > now + std::chrono::seconds(59));
+        REQUIRE(end_of_round <= std::chrono::system_clock::now() + std::chrono::seconds(60));
+
+        // Action clock expires first
+        gi.set_action_clock(10000);
+        REQUIRE(gi.next_deadline() < end_of_round - std::chrono::seconds(45));
+
+        // Round does not end while paused, but the action clock still expires
+        gi.reset_action_clock();
+        gi.pause();
+        REQUIRE(gi.next_deadline() == std::chrono::system_clock::time_point());
+        gi.set_action_clock(10000);
+        REQUIRE(gi.next_deadline() != std::chrono::system_clock::time_point());
+
+        // Nothing scheduled after stop
+        gi.stop();
+        REQUIRE(gi.next_deadline() == std::chrono::system_clock::time_point());
+    }
 }
 
 TEST_CASE("GameInfo blind level generation", "[gameinfo][blind_generation]")
@@ -0,0 +1,134 @@
+#include "../journal.hpp"
+#include <Catch2/catch.hpp>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <string>
+#include <vector>
+
+static std::string journal_test_path()
+{
+    return "test_journal.journal";
+}
+
+static std::vector<std::string> read_entries(const std::string& path)
+{
+    std::vector<std::string> entries;
+    journal::read(path, [&entries](const std::string& entry) { entries.push_back(entry); });
+    return entries;
+}
+
+TEST_CASE("Journal append and read", "[journal]")
+{
+    auto path(journal_test_path());
+    std::remove(path.c_str());
+
+    SECTION("Missing journal reads as empty")
+    {
+        REQUIRE(read_entries(path).empty());
+    }
+
+    SECTION("Entries are durable after sync, in order")
+    {
+        journal j(path);
+        j.append("first entry");
+        j.append("second {\"entry\":2}");
+        REQUIRE(j.size() == 2);
+
+        j.sync();
+        auto entries(read_entries(path));
+        REQUIRE(entries.size() == 2);
+        REQUIRE(entries[0] == "first entry");
+        REQUIRE(entries[1] == "second {\"entry\":2}");
+    }
+
+    SECTION("Waiting functions run once entries are durable")
+    {
+        journal j(path);
+
+        // nothing waiting: right away
+        auto called(false);
+        j.when_durable([&called]() { called = true; });
+        REQUIRE(called);
+
+        std::promise<std::size_t> durable;
+        j.append("first");
+        j.append("second");
+        j.when_durable([&durable, &path]() { durable.set_value(read_entries(path).size()); });
+        auto future(durable.get_future());
+        REQUIRE(future.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+        REQUIRE(future.get() == 2);
+    }
+
+    SECTION("Rotation moves durable entries aside")
+    {
+        auto previous_path(path + ".previous");
+        {
+            std::ofstream stale(previous_path);
+            stale << "stale\n";
+        }
+        {
+            journal j(path);
+            j.append("before");
+            j.rotate(previous_path);
+            REQUIRE(j.size() == 0);
+            j.append("after");
+        }
+        auto previous(read_entries(previous_path));
+        REQUIRE(previous.size() == 1);
+        REQUIRE(previous[0] == "before");
+        auto current(read_entries(path));
+        REQUIRE(current.size() == 1);
+        REQUIRE(current[0] == "after");
+        std::remove(previous_path.c_str());
+    }
+
+    SECTION("Reopening appends to existing entries")
+    {
+        {
+            journal j(path);
+            j.append("one");
+        }
+        {
+            journal j(path);
+            REQUIRE(j.size() == 0);
+            j.append("two");
+        }
+        auto entries(read_entries(path));
+        REQUIRE(entries.size() == 2);
+        REQUIRE(entries[1] == "two");
+    }
+
+    SECTION("Partial last entry is ignored")
+    {
+        {
+            journal j(path);
+            j.append("complete");
+        }
+        {
+            std::ofstream torn(path, std::ios::app | std::ios::binary);
+            torn << "torn by a cra";
+        }
+        auto entries(read_entries(path));
+        REQUIRE(entries.size() == 1);
+        REQUIRE(entries[0] == "complete");
+    }
+
+    SECTION("Truncate discards entries")
+    {
+        journal j(path);
+        j.append("one");
+        j.sync();
+        j.append("two");
+        j.truncate();
+        REQUIRE(j.size() == 0);
+        j.append("three");
+        j.sync();
+        auto entries(read_entries(path));
+        REQUIRE(entries.size() == 1);
+        REQUIRE(entries[0] == "three");
+    }
+
+    std::remove(path.c_str());
+}
@@ -0,0 +1,75 @@
+#include "../json_file.hpp"
+#include "nlohmann/json.hpp"
+#include <Catch2/catch.hpp>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+static void write_bytes(const std::string& path, const std::string& bytes)
+{
+    std::ofstream stream(path, std::ios::binary);
+    stream << bytes;
+}
+
+TEST_CASE("JSON file formats", "[json_file]")
+{
+    nlohmann::json data { { "name", "Tournament" }, { "players", { { { "player_id", "p0" }, { "name", "Player 0" } } } }, { "table_capacity", 9 }, { "cost", 100.5 } };
+
+    SECTION("Format by file name")
+    {
+        REQUIRE(json_file_format_for("snapshot.cbor") == json_file_format::cbor);
+        REQUIRE(json_file_format_for("snapshot.json") == json_file_format::text);
+        REQUIRE(json_file_format_for("cbor") == json_file_format::text);
+    }
+
+    SECTION("CBOR is tagged and smaller")
+    {
+        auto bytes(serialize_json(data, json_file_format::cbor));
+        REQUIRE(bytes.compare(0, 3, "\xd9\xd9\xf7") == 0);
+        REQUIRE(bytes.size() < serialize_json(data, json_file_format::text).size());
+    }
+
+    SECTION("Round trip in either format, detected by contents")
+    {
+        std::string path("test_json_file.json");
+        for(auto format : { json_file_format::text, json_file_format::cbor })
+        {
+            write_bytes(path, serialize_json(data, format));
+            nlohmann::json loaded;
+            REQUIRE(load_json_file(path, loaded));
+            REQUIRE(loaded == data);
+        }
+        std::remove(path.c_str());
+    }
+
+    SECTION("The file name does not decide the format read")
+    {
+        std::string path("test_json_file.cbor");
+        write_bytes(path, serialize_json(data, json_file_format::text));
+        nlohmann::json loaded;
+        REQUIRE(load_json_file(path, loaded));
+        REQUIRE(loaded == data);
+
+        // without the tag, CBOR is not recognized
+        std::string bytes;
+        nlohmann::json::to_cbor(data, bytes);
+        write_bytes(path, bytes);
+        REQUIRE_THROWS(load_json_file(path, loaded));
+        std::remove(path.c_str());
+    }
+
+    SECTION("Missing file")
+    {
+        nlohmann::json loaded;
+        REQUIRE_FALSE(load_json_file("nonexistent_file.json", loaded));
+    }
+
+    SECTION("Corrupt file")
+    {
+        std::string path("test_json_file.json");
+        write_bytes(path, "{\"name\":");
+        nlohmann::json loaded;
+        REQUIRE_THROWS(load_json_file(path, loaded));
+        std::remove(path.c_str());
+    }
+}
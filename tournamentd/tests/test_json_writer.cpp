@@ -0,0 +1,208 @@
+#include "../gameinfo.hpp"
+#include "../json_writer.hpp"
+#include "nlohmann/json.hpp"
+#include <Catch2/catch.hpp>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+// the document the DOM path broadcasts
+static std::string dumped_state(const gameinfo& gi)
+{
+    nlohmann::json state;
+    gi.dump_state(state);
+    gi.dump_configuration_state(state);
+    gi.dump_derived_state(state);
+    return state.dump();
+}
+
+// contents of a checked-in golden file, without its trailing newline
+static std::string read_golden(const std::string& name)
+{
+    std::ifstream file(std::string(TD_TESTS_DIR) + "/golden/" + name, std::ios::binary);
+    REQUIRE(file.good());
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if(!text.empty() && text.back() == '\n')
+    {
+        text.pop_back();
+    }
+    return text;
+}
+
+static std::string written_state(const gameinfo& gi)
+{
+    std::string text;
+    json_writer writer(text);
+    gi.write_state(writer);
+    return text;
+}
+
+TEST_CASE("JSON writer matches nlohmann::json", "[json_writer]")
+{
+    std::string text;
+
+    SECTION("Scalars")
+    {
+        const double doubles[] = { 0.0, -0.0, 1.0, 0.1, 1.5, -2.25, 1e21, 1e-7, 123456789.125, 3.141592653589793 };
+        for(auto d : doubles)
+        {
+            text.clear();
+            json_writer(text).value(d);
+            REQUIRE(text == nlohmann::json(d).dump());
+        }
+
+        const std::int64_t integers[] = { 0, 1, -1, 42, std::numeric_limits<std::int64_t>::max(), std::numeric_limits<std::int64_t>::min() };
+        for(auto i : integers)
+        {
+            text.clear();
+            json_writer(text).value(i);
+            REQUIRE(text == nlohmann::json(i).dump());
+        }
+
+        text.clear();
+        json_writer(text).value(std::numeric_limits<std::uint64_t>::max());
+        REQUIRE(text == nlohmann::json(std::numeric_limits<std::uint64_t>::max()).dump());
+
+        text.clear();
+        json_writer(text).value(std::numeric_limits<double>::infinity());
+        REQUIRE(text == "null");
+    }
+
+    SECTION("Strings")
+    {
+        const std::string strings[] = { "", "plain", "quote \" backslash \\ slash /", "\b\f\n\r\t", std::string("\x01\x1f\x7f", 3), std::string(1, '\0'), "caf\xc3\xa9" };
+        for(const auto& s : strings)
+        {
+            text.clear();
+            json_writer(text).value(s);
+            REQUIRE(text == nlohmann::json(s).dump());
+        }
+    }
+
+    SECTION("Invalid UTF-8 throws as dump() does")
+    {
+        const std::string strings[] = { "\xff", "caf\xc3", "\xc0\xaf", "\xed\xa0\x80", "\xf4\x90\x80\x80", "ok \xe2\x82" };
+        for(const auto& s : strings)
+        {
+            std::string expected;
+            try
+            {
+                nlohmann::json(s).dump();
+            }
+            catch(const nlohmann::json::type_error& e)
+            {
+                expected = e.what();
+            }
+            REQUIRE_FALSE(expected.empty());
+
+            text.clear();
+            json_writer writer(text);
+            REQUIRE_THROWS_WITH(writer.value(s), expected);
+            REQUIRE_THROWS_AS(json_writer(text).key(s), nlohmann::json::type_error);
+        }
+
+        const std::string valid[] = { "\xc2\x80", "\xe0\xa0\x80", "\xef\xbf\xbf", "\xf0\x90\x80\x80", "\xf4\x8f\xbf\xbf" };
+        for(const auto& s : valid)
+        {
+            text.clear();
+            json_writer(text).value(s);
+            REQUIRE(text == nlohmann::json(s).dump());
+        }
+    }
+
+    SECTION("Nesting")
+    {
+        json_writer writer(text);
+        writer.begin_object();
+        writer.key("a").begin_array().end_array();
+        writer.key("b").begin_array().value(1).begin_object().end_object().begin_array().value(true).value(nullptr).end_array().end_array();
+        writer.key("c").begin_object().key("d").value("e").key("f").raw("[1,2]").end_object();
+        writer.key("g").value(false);
+        writer.end_object();
+
+        auto expected(nlohmann::json::parse(R"({"a":[],"b":[1,{},[true,null]],"c":{"d":"e","f":[1,2]},"g":false})"));
+        REQUIRE(text == expected.dump());
+    }
+
+    SECTION("Unbalanced close")
+    {
+        json_writer writer(text);
+        REQUIRE_THROWS_AS(writer.end_object(), std::logic_error);
+    }
+}
+
+TEST_CASE("Streamed state matches the state document", "[json_writer][gameinfo]")
+{
+    gameinfo gi;
+    gi.set_clock_override(std::chrono::system_clock::time_point(std::chrono::milliseconds(1500000000000)));
+
+    SECTION("Golden: configured but not started")
+    {
+        // seating given explicitly, so the text does not depend on the random engine. only one of the two players is seated and bought in, so nothing depends on hash order either
+        gi.configure({
+            { "name", "Friday \"Night\" Game" },
+            { "background_color", "#000000" },
+            { "players", { { { "player_id", "p1" }, { "name", "Ann" } }, { { "player_id", "p2" }, { "name", "Bob" } } } },
+            { "funding_sources", { { { "name", "Buy-in" }, { "type", 0 }, { "chips", 500 }, { "cost", { { "amount", 20.0 }, { "currency", "USD" } } }, { "commission", { { "amount", 2.5 }, { "currency", "USD" } } } } } },
+            { "available_chips", { { { "color", "red" }, { "denomination", 5 }, { "count_available", 100 } } } },
+            { "table_names", { "A" } },
+            { "table_capacity", 2 },
+            { "seats", { { "p1", { { "table_number", 0 }, { "seat_number", 1 } } } } },
+            { "empty_seats", { { { "table_number", 0 }, { "seat_number", 0 } } } },
+            { "table_count", 1 },
+            { "buyins", { "p1" } },
+            { "unique_entries", { "p1" } },
+            { "entries", { "p1" } },
+            { "payouts", { { { "amount", 17.5 } } } },
+            { "total_chips", 500 },
+            { "total_cost", { { "USD", 20.0 } } },
+            { "total_commission", { { "USD", 2.5 } } }
+        });
+
+        auto text(written_state(gi));
+        REQUIRE(text == dumped_state(gi));
+
+        // any change to this text is a protocol change for clients
+        REQUIRE(text == read_golden("streamed_state.json"));
+    }
+
+    SECTION("Every phase of the clock")
+    {
+        gi.configure({
+            { "players", { { { "player_id", "z9" }, { "name", "Zed" } }, { { "player_id", "a1" }, { "name", "Al\tTab" } }, { { "player_id", "m5" }, { "name", "Mo" } } } },
+            { "funding_sources", { { { "name", "Buy-in" }, { "type", 0 }, { "chips", 100 }, { "cost", { { "amount", 10.0 }, { "currency", "EUR" } } }, { "commission", { { "amount", 1.0 }, { "currency", "USD" } } } } } },
+            { "blind_levels", { { { "little_blind", 0 } }, { { "little_blind", 1 }, { "big_blind", 2 }, { "duration", 60000 }, { "break_duration", 30000 } }, { { "little_blind", 2 }, { "big_blind", 4 }, { "ante", 1 }, { "ante_type", 1 }, { "duration", 60000 } } } },
+            { "table_capacity", 2 }
+        });
+        REQUIRE(written_state(gi) == dumped_state(gi));
+
+        gi.quick_setup(0);
+        REQUIRE(written_state(gi) == dumped_state(gi));
+
+        gi.start();
+        REQUIRE(written_state(gi) == dumped_state(gi));
+
+        // later in the round, with the action clock running
+        gi.set_clock_override(std::chrono::system_clock::time_point(std::chrono::milliseconds(1500000010000)));
+        gi.set_action_clock(15000);
+        REQUIRE(written_state(gi) == dumped_state(gi));
+
+        // on break
+        gi.set_clock_override(std::chrono::system_clock::time_point(std::chrono::milliseconds(1500000070000)));
+        gi.update();
+        REQUIRE(written_state(gi) == dumped_state(gi));
+
+        // paused
+        gi.pause();
+        REQUIRE(written_state(gi) == dumped_state(gi));
+        gi.resume();
+
+        // busted, and rebalanced
+        gi.bust_player("m5");
+        REQUIRE(written_state(gi) == dumped_state(gi));
+    }
+}
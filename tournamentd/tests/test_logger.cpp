@@ -0,0 +1,150 @@
+#include "../logger.hpp"
+#include <Catch2/catch.hpp>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// collects everything logged at the given levels while it exists
+class log_capture
+{
+    std::ostringstream stream;
+    std::streambuf* saved;
+
+public:
+    explicit log_capture(std::initializer_list<ll> levels)
+    {
+        logstream::flush();
+        this->saved = std::cout.rdbuf(this->stream.rdbuf());
+        logstream::set_enabled(levels);
+    }
+
+    ~log_capture()
+    {
+        logstream::flush();
+        logger_enable();
+        std::cout.rdbuf(this->saved);
+    }
+
+    std::string text()
+    {
+        logstream::flush();
+        return this->stream.str();
+    }
+};
+
+static std::size_t count(const std::string& text, const std::string& what)
+{
+    std::size_t n(0);
+    for(auto pos(text.find(what)); pos != std::string::npos; pos = text.find(what, pos + what.size()))
+    {
+        n++;
+    }
+    return n;
+}
+
+TEST_CASE("Logger", "[logger]")
+{
+    SECTION("Writes the time, level, function and message")
+    {
+        log_capture capture({ ll::info });
+        logger(ll::info) << "hello " << 42 << '\n';
+
+        auto text(capture.text());
+        REQUIRE(text.size() > 20);
+        REQUIRE(text[4] == '-');
+        REQUIRE(text.find(" INFO ") != std::string::npos);
+        REQUIRE(text.find(": hello 42\n") != std::string::npos);
+    }
+
+    SECTION("Disabled levels are not formatted")
+    {
+        log_capture capture({ ll::warning, ll::error });
+        auto evaluated(0);
+        auto touch = [&evaluated]()
+        {
+            return ++evaluated;
+        };
+
+        logger(ll::info) << touch() << '\n';
+        REQUIRE(evaluated == 0);
+        logger(ll::warning) << touch() << '\n';
+        REQUIRE(evaluated == 1);
+
+        auto text(capture.text());
+        REQUIRE(text.find(" INFO ") == std::string::npos);
+        REQUIRE(count(text, " WARNING ") == 1);
+    }
+
+    SECTION("Levels can be enabled in any combination")
+    {
+        REQUIRE_FALSE(logstream::enabled(ll::error));
+        logger_enable(ll::error);
+        REQUIRE(logstream::enabled(ll::error));
+        REQUIRE_FALSE(logstream::enabled(ll::warning));
+        REQUIRE_FALSE(logstream::enabled(ll::info));
+        logger_enable(ll::info, ll::warning);
+        REQUIRE_FALSE(logstream::enabled(ll::error));
+        REQUIRE(logstream::enabled(ll::info));
+        REQUIRE(logstream::enabled(ll::warning));
+        logger_enable();
+    }
+
+    SECTION("Every record from every thread is written or counted as dropped, each written one in one piece")
+    {
+        log_capture capture({ ll::info });
+        auto dropped_before(logstream::dropped());
+
+        std::vector<std::thread> threads;
+        for(auto t(0); t < 4; t++)
+        {
+            threads.emplace_back([t]()
+            {
+                // more than one ring holds, so the writer has to keep up or records are dropped
+                for(auto i(0); i < 2000; i++)
+                {
+                    logger(ll::info) << "thread " << t << " record " << i << '\n';
+                }
+            });
+        }
+        for(auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        auto text(capture.text());
+        auto dropped(logstream::dropped() - dropped_before);
+        auto written(count(text, " INFO "));
+        REQUIRE(written + dropped == 8000);
+        REQUIRE(count(text, ": thread ") == written);
+
+        // each pass that dropped records says so
+        auto reports(count(text, " WARNING logger: dropped "));
+        REQUIRE((reports != 0) == (dropped != 0));
+        REQUIRE(count(text, "\n") == written + reports);
+    }
+
+    SECTION("A full ring drops records instead of waiting")
+    {
+        log_capture capture({ ll::info });
+        auto dropped_before(logstream::dropped());
+
+        // bursts of many times the ring size from one thread outrun the writer, which formats every record
+        std::size_t sent(0);
+        while(logstream::dropped() == dropped_before && sent < 1000000)
+        {
+            for(auto i(0); i < 4096; i++)
+            {
+                logger(ll::info) << "record " << sent++ << '\n';
+            }
+            logstream::flush();
+        }
+
+        auto text(capture.text());
+        auto dropped(logstream::dropped() - dropped_before);
+        REQUIRE(dropped != 0);
+        REQUIRE(count(text, ": record ") + dropped == sent);
+        REQUIRE(text.find(" WARNING logger: dropped ") != std::string::npos);
+    }
+}
@@ -0,0 +1,137 @@
+#include "../mpsc_queue.hpp"
+#include <Catch2/catch.hpp>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("MPSC queue", "[mpsc_queue]")
+{
+    SECTION("First in, first out")
+    {
+        mpsc_queue<std::string> queue;
+        int value(0);
+        REQUIRE(queue.empty());
+
+        mpsc_queue<int> numbers;
+        REQUIRE_FALSE(numbers.pop(value));
+        for(int i(0); i < 10; i++)
+        {
+            numbers.push(i);
+        }
+        REQUIRE_FALSE(numbers.empty());
+        for(int i(0); i < 10; i++)
+        {
+            REQUIRE(numbers.pop(value));
+            REQUIRE(value == i);
+        }
+        REQUIRE_FALSE(numbers.pop(value));
+        REQUIRE(numbers.empty());
+
+        queue.push("one");
+        queue.push("two");
+        std::string text;
+        REQUIRE(queue.pop(text));
+        REQUIRE(text == "one");
+        queue.push("three");
+        REQUIRE(queue.pop(text));
+        REQUIRE(text == "two");
+        REQUIRE(queue.pop(text));
+        REQUIRE(text == "three");
+    }
+
+    SECTION("Move-only values, and values left in the queue are destroyed")
+    {
+        auto counted(std::make_shared<int>(0));
+        {
+            mpsc_queue<std::shared_ptr<int>> queue;
+            queue.push(counted);
+            queue.push(counted);
+            REQUIRE(counted.use_count() == 3);
+        }
+        REQUIRE(counted.use_count() == 1);
+
+        mpsc_queue<std::unique_ptr<int>> queue;
+        queue.push(std::unique_ptr<int>(new int(7)));
+        std::unique_ptr<int> value;
+        REQUIRE(queue.pop(value));
+        REQUIRE(*value == 7);
+    }
+
+    SECTION("Many producers, one consumer")
+    {
+        const int producers(4);
+        const int per_producer(10000);
+        mpsc_queue<std::pair<int, int>> queue;
+
+        std::vector<std::thread> threads;
+        for(int p(0); p < producers; p++)
+        {
+            threads.emplace_back([&queue, p, per_producer]()
+            {
+                for(int i(0); i < per_producer; i++)
+                {
+                    queue.push(std::make_pair(p, i));
+                }
+            });
+        }
+
+        // each producer's values arrive complete and in the order pushed
+        std::vector<int> next(producers, 0);
+        int received(0);
+        while(received < producers * per_producer)
+        {
+            std::pair<int, int> value;
+            if(queue.pop(value))
+            {
+                REQUIRE(value.second == next[static_cast<std::size_t>(value.first)]);
+                next[static_cast<std::size_t>(value.first)]++;
+                received++;
+            }
+            else
+            {
+                queue.wait_for(std::chrono::milliseconds(10));
+            }
+        }
+
+        for(auto& thread : threads)
+        {
+            thread.join();
+        }
+        REQUIRE(queue.empty());
+    }
+
+    SECTION("Waiting consumer")
+    {
+        mpsc_queue<int> queue;
+
+        // times out with nothing pushed
+        auto start(std::chrono::steady_clock::now());
+        queue.wait_for(std::chrono::milliseconds(20));
+        REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20));
+
+        // returns right away with something to pop
+        queue.push(1);
+        start = std::chrono::steady_clock::now();
+        queue.wait_for(std::chrono::seconds(10));
+        REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+
+        // wakes when another thread pushes
+        int value(0);
+        REQUIRE(queue.pop(value));
+        std::thread producer([&queue]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            queue.push(2);
+        });
+        start = std::chrono::steady_clock::now();
+        while(!queue.pop(value))
+        {
+            queue.wait_for(std::chrono::seconds(10));
+        }
+        REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+        REQUIRE(value == 2);
+        producer.join();
+    }
+}
@@ -0,0 +1,87 @@
+#include "../number_format.hpp"
+#include <Catch2/catch.hpp>
+#include <locale>
+#include <sstream>
+#include <string>
+
+// numpunct with configurable grouping, to exercise grouping without depending on installed locales
+class test_numpunct : public std::numpunct<char>
+{
+    std::string groups;
+    char sep;
+
+public:
+    test_numpunct(std::string g, char s) : groups(std::move(g)), sep(s)
+    {
+    }
+
+protected:
+    std::string do_grouping() const override
+    {
+        return this->groups;
+    }
+
+    char do_thousands_sep() const override
+    {
+        return this->sep;
+    }
+};
+
+template<typename T>
+static std::string iostream_format(const std::locale& loc, const T& value)
+{
+    std::ostringstream os;
+    os.imbue(loc);
+    os << value;
+    return os.str();
+}
+
+TEST_CASE("Number formatting matches iostreams", "[number_format]")
+{
+    const unsigned long values[] = { 0, 7, 42, 999, 1000, 12345, 100000, 1234567, 4294967295UL };
+
+    SECTION("Integers")
+    {
+        const std::locale locales[] = {
+            std::locale::classic(),
+            std::locale(std::locale::classic(), new test_numpunct("\3", ',')),
+            std::locale(std::locale::classic(), new test_numpunct("\3\2", '.')),
+            std::locale(std::locale::classic(), new test_numpunct("\1\0", ' ')),
+            number_format().locale()
+        };
+
+        for(const auto& loc : locales)
+        {
+            number_format numbers(loc);
+            for(auto value : values)
+            {
+                REQUIRE(numbers.format(value) == iostream_format(loc, value));
+            }
+        }
+    }
+
+    SECTION("Blind levels")
+    {
+        std::locale loc(std::locale::classic(), new test_numpunct("\3", ','));
+        number_format numbers(loc);
+
+        td::blind_level level;
+        level.little_blind = 1000;
+        level.big_blind = 2000;
+        REQUIRE(numbers.format(level) == "1,000/2,000");
+        REQUIRE(numbers.format(level) == iostream_format(loc, level));
+
+        level.ante_type = td::ante_type_t::traditional;
+        level.ante = 250;
+        REQUIRE(numbers.format(level) == "1,000/2,000\nAnte: 250");
+        REQUIRE(numbers.format(level) == iostream_format(loc, level));
+    }
+
+    SECTION("Appending keeps existing text")
+    {
+        number_format numbers(std::locale::classic());
+        std::string text("Players: ");
+        numbers.append(text, 12u);
+        REQUIRE(text == "Players: 12");
+    }
+}
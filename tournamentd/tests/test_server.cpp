@@ -1,10 +1,15 @@
 #include "../server.hpp"
+#include "../socket.hpp"
+#include "../socketstream.hpp"
 #include <Catch2/catch.hpp>
 #include <chrono>
+#include <cstring>
 #include <functional>
 #include <memory>
 #include <sstream>
+#include <string>
 #include <thread>
+#include <vector>
 
 TEST_CASE("Server creation and destruction", "[server][basic]")
 {
@@ -439,3 +444,130 @@ TEST_CASE("Server resource management", "[server][resources][unix_socket]")
         }
     }
 }
+
+TEST_CASE("Server output queues", "[server][queue][unix_socket]")
+{
+    SECTION("Slow client does not block and only receives newest state")
+    {
+        server s;
+        std::string temp_path = "/tmp/test_server_queue_" + std::to_string(std::time(nullptr));
+
+        try
+        {
+            s.listen(temp_path.c_str());
+
+            auto handle_new_client = [](std::ostream&) -> bool
+            {
+                return false;
+            };
+            auto handle_client = [](std::iostream& ios) -> bool
+            {
+                std::string line;
+                if(std::getline(ios, line))
+                {
+                    ios << "echo " << line << std::endl;
+                }
+                return false;
+            };
+
+            // connect a client that does not read
+            unix_socket client(temp_path.c_str(), true);
+            s.poll(handle_new_client, handle_client, 100000);
+            REQUIRE(s.queue_depths().size() == 1);
+
+            // broadcast far more than the socket buffer holds. this must not block
+            auto start = std::chrono::steady_clock::now();
+            for(auto i = 0; i < 100; i++)
+            {
+                s.broadcast(std::to_string(i) + std::string(64 * 1024, 'x'));
+            }
+            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+            REQUIRE(duration.count() < 1000);
+
+            // at most the partially sent message and the newest one stay queued
+            auto depths = s.queue_depths();
+            REQUIRE(depths.size() == 1);
+            REQUIRE(depths[0].messages <= 2);
+            REQUIRE(depths[0].bytes <= 2 * (64 * 1024 + 3));
+
+            // commands still get responses, queued behind the state
+            const char* command = "hello\n";
+            client.send(command, std::strlen(command));
+
+            // read everything. the last state line must be the newest, and the response follows it
+            socketstream ss(client);
+            std::string line;
+            std::string last_state;
+            while(std::getline(ss, line))
+            {
+                if(line.compare(0, 6, "echo h") == 0)
+                {
+                    break;
+                }
+                last_state = line;
+
+                // keep the server flushing while we read
+                s.poll(handle_new_client, handle_client, 0);
+            }
+            REQUIRE(line == "echo hello");
+            REQUIRE(last_state.compare(0, 2, "99") == 0);
+            REQUIRE(s.queue_depths()[0].bytes == 0);
+        }
+        catch(const std::exception& e)
+        {
+            WARN("Server output queue test failed: " << e.what());
+        }
+    }
+}
+
+TEST_CASE("Server line handlers", "[server][lines][unix_socket]")
+{
+    SECTION("Lines are framed in place, split across reads")
+    {
+        server s;
+        std::string temp_path = "/tmp/test_server_lines_" + std::to_string(std::time(nullptr));
+
+        try
+        {
+            s.listen(temp_path.c_str());
+
+            auto handle_new_client = [](server::client_id, std::ostream&) -> bool
+            {
+                return false;
+            };
+            std::vector<std::string> lines;
+            auto handle_line = [&lines](server::client_id, server::line_view line, std::ostream& os) -> bool
+            {
+                lines.emplace_back(line.data, line.size);
+                os << "got " << line.size << std::endl;
+                return false;
+            };
+
+            unix_socket client(temp_path.c_str(), true);
+            s.poll(handle_new_client, handle_line, 100000);
+
+            // one and a half lines, then the rest
+            const char* part1 = "first\nsec";
+            const char* part2 = "ond\r\n\n";
+            client.send(part1, std::strlen(part1));
+            s.poll(handle_new_client, handle_line, 100000);
+            REQUIRE(lines.size() == 1);
+            client.send(part2, std::strlen(part2));
+            s.poll(handle_new_client, handle_line, 100000);
+
+            REQUIRE(lines.size() == 3);
+            REQUIRE(lines[0] == "first");
+            REQUIRE(lines[1] == "second\r");
+            REQUIRE(lines[2].empty());
+
+            socketstream ss(client);
+            std::string response;
+            REQUIRE(std::getline(ss, response));
+            REQUIRE(response == "got 5");
+        }
+        catch(const std::exception& e)
+        {
+            WARN("Server line handler test failed: " << e.what());
+        }
+    }
+}
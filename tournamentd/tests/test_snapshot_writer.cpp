@@ -0,0 +1,72 @@
+#include "../snapshot_writer.hpp"
+#include "nlohmann/json.hpp"
+#include <Catch2/catch.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+static nlohmann::json read_snapshot(const std::string& path)
+{
+    std::ifstream stream(path);
+    REQUIRE(stream.good());
+    nlohmann::json snapshot;
+    stream >> snapshot;
+    return snapshot;
+}
+
+TEST_CASE("Snapshot writer", "[snapshot_writer]")
+{
+    std::string path("test_snapshot_writer.json");
+    std::remove(path.c_str());
+
+    SECTION("Snapshot is written in place")
+    {
+        snapshot_writer writer(path);
+        REQUIRE(writer.durable_sequence() == 0);
+        writer.write({ { "value", 1 } }, 1);
+        writer.flush();
+        REQUIRE(writer.durable_sequence() == 1);
+        REQUIRE(read_snapshot(path).at("value") == 1);
+
+        std::ifstream temp(path + ".tmp");
+        REQUIRE_FALSE(temp.good());
+    }
+
+    SECTION("Starts from an existing snapshot's sequence")
+    {
+        snapshot_writer writer(path, 42);
+        REQUIRE(writer.durable_sequence() == 42);
+    }
+
+    SECTION("Newest snapshot wins")
+    {
+        snapshot_writer writer(path);
+        for(auto i(1); i <= 100; i++)
+        {
+            writer.write({ { "value", i } }, static_cast<std::uint64_t>(i));
+        }
+        writer.flush();
+        REQUIRE(writer.durable_sequence() == 100);
+        REQUIRE(read_snapshot(path).at("value") == 100);
+    }
+
+    SECTION("Queued snapshot is written before stopping")
+    {
+        {
+            snapshot_writer writer(path);
+            writer.write({ { "value", 7 } }, 1);
+        }
+        REQUIRE(read_snapshot(path).at("value") == 7);
+    }
+
+    SECTION("Failed write leaves the sequence alone")
+    {
+        snapshot_writer writer("nonexistent_directory/snapshot.json", 3);
+        writer.write({ { "value", 1 } }, 4);
+        writer.flush();
+        REQUIRE(writer.durable_sequence() == 3);
+    }
+
+    std::remove(path.c_str());
+}
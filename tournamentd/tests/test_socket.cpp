@@ -233,6 +233,147 @@ TEST_CASE("Socket select functionality", "[socket][select][unix_socket]")
     }
 }
 
+TEST_CASE("Socket poller functionality", "[socket][poller][unix_socket]")
+{
+    // exercise both the platform default backend and the portable select backend
+    for(auto force_select : { false, true })
+    {
+        socket_poller poller(force_select);
+        INFO("backend: " << poller.backend());
+
+        SECTION(std::string("Wait with nothing registered ") + (force_select ? "(select)" : "(default)"))
+        {
+            REQUIRE(poller.size() == 0);
+            auto start = std::chrono::steady_clock::now();
+            const auto& ready = poller.wait(10000); // 10ms timeout
+            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+            REQUIRE(ready.empty());
+            REQUIRE(duration.count() >= 5);
+        }
+
+        SECTION(std::string("Readiness of listening and connected sockets ") + (force_select ? "(select)" : "(default)"))
+        {
+            std::string temp_path = "/tmp/test_socket_poller_" + std::to_string(std::time(nullptr));
+
+            try
+            {
+                unix_socket server(temp_path.c_str(), false);
+                server.set_nonblocking(true);
+                poller.add(server);
+                poller.add(server); // adding twice is harmless
+                REQUIRE(poller.size() == 1);
+
+                // non-blocking accept with nothing pending returns an invalid socket
+                REQUIRE_FALSE(server.accept().valid());
+                REQUIRE(poller.wait(1000).empty());
+
+                // connecting makes the listener readable
+                unix_socket client(temp_path.c_str(), true);
+                const auto& ready = poller.wait(1000000);
+                REQUIRE(ready.size() == 1);
+                REQUIRE(ready.front().sock == server);
+                REQUIRE(ready.front().readable);
+
+                auto accepted = server.accept();
+                REQUIRE(accepted.valid());
+                REQUIRE_FALSE(server.accept().valid());
+                poller.add(accepted);
+                REQUIRE(poller.size() == 2);
+
+                // sending data makes the accepted socket readable
+                const char* test_data = "Hello";
+                client.send(test_data, std::strlen(test_data));
+                const auto& ready2 = poller.wait(1000000);
+                REQUIRE(ready2.size() == 1);
+                REQUIRE(ready2.front().sock == accepted);
+                REQUIRE(ready2.front().readable);
+                REQUIRE_FALSE(ready2.front().writable);
+
+                // drain, then nothing should be reported
+                std::array<char, 16> buffer {};
+                REQUIRE(accepted.recv(buffer.data(), buffer.size()) == 5);
+                REQUIRE(poller.wait(1000).empty());
+
+                // writability is only reported on request
+                poller.want_writable(accepted, true);
+                const auto& ready3 = poller.wait(1000000);
+                REQUIRE(ready3.size() == 1);
+                REQUIRE(ready3.front().writable);
+                poller.want_writable(accepted, false);
+
+                // a non-blocking recv with nothing pending would block
+                accepted.set_nonblocking(true);
+                REQUIRE(accepted.recv(buffer.data(), buffer.size()) == 0);
+
+                // removed sockets are never reported
+                poller.remove(accepted);
+                REQUIRE(poller.size() == 1);
+                client.send(test_data, std::strlen(test_data));
+                REQUIRE(poller.wait(1000).empty());
+            }
+            catch(const std::exception& e)
+            {
+                WARN("Socket poller test failed: " << e.what());
+            }
+
+            std::remove(temp_path.c_str());
+        }
+
+        SECTION(std::string("Wake from another thread ") + (force_select ? "(select)" : "(default)"))
+        {
+            // a wake before waiting makes the next wait return at once, with no events, and only that one
+            poller.wake();
+            poller.wake();
+            auto start = std::chrono::steady_clock::now();
+            REQUIRE(poller.wait(10000000).empty());
+            REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+            start = std::chrono::steady_clock::now();
+            REQUIRE(poller.wait(10000).empty());
+            REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(5));
+
+            // a wake from another thread ends a wait in progress
+            std::thread waker([&poller]()
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                poller.wake();
+            });
+            start = std::chrono::steady_clock::now();
+            poller.wait(-1);
+            REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+            waker.join();
+        }
+    }
+}
+
+TEST_CASE("Socket gathering send", "[socket][data][unix_socket]")
+{
+    std::string temp_path = "/tmp/test_socket_sendv_" + std::to_string(std::time(nullptr));
+
+    try
+    {
+        unix_socket server(temp_path.c_str(), false);
+        unix_socket client(temp_path.c_str(), true);
+        auto accepted = server.accept();
+
+        // several buffers go out in one call, in order
+        std::string first("{\"shared\":");
+        std::string second("true}");
+        std::string third("\n");
+        std::array<common_socket::const_buffer, 3> bufs { { { first.data(), first.size() }, { second.data(), second.size() }, { third.data(), third.size() } } };
+        REQUIRE(accepted.send(bufs.data(), bufs.size()) == static_cast<long>(first.size() + second.size() + third.size()));
+
+        std::array<char, 64> buffer {};
+        auto len = client.recv(buffer.data(), buffer.size());
+        REQUIRE(std::string(buffer.data(), static_cast<std::size_t>(len)) == "{\"shared\":true}\n");
+    }
+    catch(const std::exception& e)
+    {
+        WARN("Socket gathering send test failed: " << e.what());
+    }
+
+    std::remove(temp_path.c_str());
+}
+
 TEST_CASE("Socket comparison and equality", "[socket][comparison][unix_socket]")
 {
     SECTION("Socket equality operators")
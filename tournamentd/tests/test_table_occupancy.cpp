@@ -0,0 +1,60 @@
+#include "../table_occupancy.hpp"
+#include <Catch2/catch.hpp>
+#include <vector>
+
+TEST_CASE("Table occupancy counts and extremes", "[table_occupancy]")
+{
+    table_occupancy occupancy;
+    occupancy.resize(3);
+
+    REQUIRE(occupancy.table_count() == 3);
+    REQUIRE(occupancy.fewest() == 0);
+    REQUIRE(occupancy.most() == 0);
+
+    occupancy.add(td::seat(1, 4), 10);
+    occupancy.add(td::seat(1, 0), 11);
+    occupancy.add(td::seat(2, 3), 12);
+
+    SECTION("Fewest and most choose the lowest-numbered table on ties")
+    {
+        REQUIRE(occupancy.count_at(0) == 0);
+        REQUIRE(occupancy.count_at(1) == 2);
+        REQUIRE(occupancy.count_at(2) == 1);
+        REQUIRE(occupancy.fewest() == 0);
+        REQUIRE(occupancy.most() == 1);
+
+        occupancy.add(td::seat(2, 0), 13);
+        REQUIRE(occupancy.most() == 1);
+        occupancy.add(td::seat(0, 0), 14);
+        occupancy.add(td::seat(0, 1), 15);
+        REQUIRE(occupancy.fewest() == 0);
+        REQUIRE(occupancy.most() == 0);
+    }
+
+    SECTION("Players are listed by seat number")
+    {
+        REQUIRE(occupancy.players_at(1) == std::vector<player_handle_t>({ 11, 10 }));
+        REQUIRE(occupancy.player_at(1, 0) == 11);
+        REQUIRE(occupancy.player_at(1, 1) == 10);
+        REQUIRE_THROWS_AS(occupancy.player_at(1, 2), std::out_of_range);
+    }
+
+    SECTION("Removing players updates the extremes")
+    {
+        occupancy.remove(td::seat(1, 4));
+        occupancy.remove(td::seat(1, 0));
+        REQUIRE(occupancy.fewest() == 0);
+        REQUIRE(occupancy.most() == 2);
+        REQUIRE_THROWS_AS(occupancy.remove(td::seat(1, 0)), std::logic_error);
+    }
+
+    SECTION("Only empty tables can be removed")
+    {
+        REQUIRE_THROWS_AS(occupancy.resize(2), std::logic_error);
+        occupancy.remove(td::seat(2, 3));
+        occupancy.resize(2);
+        REQUIRE(occupancy.table_count() == 2);
+        REQUIRE(occupancy.fewest() == 0);
+        REQUIRE(occupancy.most() == 1);
+    }
+}
@@ -1,6 +1,18 @@
+#include "../socket.hpp"
 #include "../tournament.hpp"
+#include "nlohmann/json.hpp"
 #include <Catch2/catch.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 TEST_CASE("Tournament creation and basic operations", "[tournament]")
 {
@@ -47,3 +59,816 @@ TEST_CASE("Tournament creation and basic operations", "[tournament]")
         }
     }
 }
+
+// line-oriented client that runs the tournament loop while it waits for messages
+class pumping_client
+{
+    tournament& tourney;
+    unix_socket sock;
+    std::string buffer;
+
+public:
+    pumping_client(tournament& t, const std::string& path) : tourney(t), sock(path.c_str(), true)
+    {
+        this->sock.set_nonblocking(true);
+    }
+
+    void send(const std::string& command, const nlohmann::json& arg = nlohmann::json::object())
+    {
+        auto line(command + " " + arg.dump() + "\n");
+        REQUIRE(this->sock.send(line.data(), line.size()) == static_cast<long>(line.size()));
+    }
+
+    nlohmann::json receive()
+    {
+        auto deadline(std::chrono::steady_clock::now() + std::chrono::seconds(5));
+        for(;;)
+        {
+            auto nl(this->buffer.find('\n'));
+            if(nl != std::string::npos)
+            {
+                auto line(this->buffer.substr(0, nl));
+                this->buffer.erase(0, nl + 1);
+                return nlohmann::json::parse(line);
+            }
+
+            REQUIRE(std::chrono::steady_clock::now() < deadline);
+            this->tourney.run();
+
+            char buf[65536];
+            auto len(this->sock.recv(buf, sizeof(buf)));
+            REQUIRE(len >= 0);
+            this->buffer.append(buf, static_cast<std::size_t>(len));
+        }
+    }
+
+    // receive messages until the response with the given echo, passing each broadcast to a callback
+    nlohmann::json receive_response(int echo, const std::function<void(const nlohmann::json&)>& on_broadcast)
+    {
+        for(;;)
+        {
+            auto message(this->receive());
+            auto echo_it(message.find("echo"));
+            if(echo_it != message.end() && *echo_it == echo)
+            {
+                return message;
+            }
+            on_broadcast(message);
+        }
+    }
+};
+
+TEST_CASE("Tournament delta broadcasts", "[tournament][delta][unix_socket]")
+{
+    tournament t;
+    t.authorize(1234);
+
+    std::pair<std::string, int> listening;
+    try
+    {
+        listening = t.listen("/tmp");
+    }
+    catch(const std::exception& e)
+    {
+        WARN("Tournament listen failed (expected in some test environments): " << e.what());
+        return;
+    }
+    if(listening.first.empty())
+    {
+        WARN("Tournament is not listening on a unix socket");
+        return;
+    }
+
+    pumping_client full(t, listening.first);
+    pumping_client delta(t, listening.first);
+
+    // full-mode client keeps the last complete document
+    nlohmann::json full_state;
+    auto on_full([&full_state](const nlohmann::json& message)
+    {
+        REQUIRE(message.find("seq") == message.end());
+        full_state = message;
+    });
+
+    // delta-mode client rebuilds the document from keyframes and patches
+    nlohmann::json delta_state;
+    std::uint64_t seq(0);
+    std::size_t patches(0);
+    auto on_delta([&](const nlohmann::json& message)
+    {
+        auto keyframe_it(message.find("keyframe"));
+        if(keyframe_it != message.end())
+        {
+            delta_state = *keyframe_it;
+        }
+        else
+        {
+            REQUIRE(message.at("seq").get<std::uint64_t>() == seq + 1);
+            delta_state.merge_patch(message.at("patch"));
+            patches++;
+        }
+        seq = message.at("seq");
+    });
+
+    // opting in sends a keyframe before the response
+    delta.send("set_broadcast_mode", { { "mode", "delta" }, { "echo", 1 } });
+    auto keyframe(delta.receive());
+    REQUIRE(keyframe.count("keyframe") == 1);
+    on_delta(keyframe);
+    REQUIRE(delta.receive_response(1, on_delta).at("mode") == "delta");
+
+    full.send("get_state", { { "echo", 2 } });
+    full.receive_response(2, on_full);
+
+    // mutate state a few times
+    nlohmann::json config { { "authenticate", 1234 }, { "echo", 3 }, { "players", { { { "player_id", "p1" }, { "name", "Alice" } }, { { "player_id", "p2" }, { "name", "Bob" } }, { { "player_id", "p3" }, { "name", "Charlie" } } } }, { "funding_sources", { { { "name", "Buy-in" }, { "type", 0 }, { "chips", 1500 }, { "cost", { { "amount", 100.0 }, { "currency", "USD" } } } } } }, { "table_capacity", 2 } };
+    full.send("configure", config);
+    full.receive_response(3, on_full);
+    full.send("plan_seating", { { "authenticate", 1234 }, { "echo", 4 }, { "max_expected_players", 3 } });
+    full.receive_response(4, on_full);
+    full.send("seat_player", { { "authenticate", 1234 }, { "echo", 5 }, { "player_id", "p1" } });
+    full.receive_response(5, on_full);
+    full.send("fund_player", { { "authenticate", 1234 }, { "echo", 6 }, { "player_id", "p1" }, { "source_id", 0 } });
+    full.receive_response(6, on_full);
+
+    // both clients now have seen the same broadcasts
+    delta.send("version", { { "echo", 7 } });
+    delta.receive_response(7, on_delta);
+    REQUIRE(patches >= 3);
+    REQUIRE(delta_state == full_state);
+
+    // resync brings the stream up to date, then sends a keyframe in sequence with it
+    delta.send("resync", { { "echo", 8 } });
+    auto resync(delta.receive());
+    while(resync.count("keyframe") == 0)
+    {
+        on_delta(resync);
+        resync = delta.receive();
+    }
+    REQUIRE(resync.at("seq") == seq);
+    REQUIRE(resync.at("keyframe") == delta_state);
+    delta.receive_response(8, on_delta);
+
+    // back to full mode
+    delta.send("set_broadcast_mode", { { "mode", "full" }, { "echo", 9 } });
+    REQUIRE(delta.receive_response(9, on_delta).at("mode") == "full");
+    delta.send("set_broadcast_mode", { { "mode", "bogus" }, { "echo", 10 } });
+    REQUIRE(delta.receive_response(10, on_full).count("error") == 1);
+
+    // a full-mode client's resync is sent to that client alone
+    delta.send("resync", { { "echo", 11 } });
+    REQUIRE(delta.receive() == full_state);
+    delta.receive_response(11, on_full);
+    std::size_t others(0);
+    full.send("version", { { "echo", 12 } });
+    full.receive_response(12, [&others](const nlohmann::json&) { others++; });
+    REQUIRE(others == 0);
+}
+
+TEST_CASE("Tournament topic subscriptions", "[tournament][topics][unix_socket]")
+{
+    tournament t;
+    t.authorize(1234);
+
+    std::pair<std::string, int> listening;
+    try
+    {
+        listening = t.listen("/tmp");
+    }
+    catch(const std::exception& e)
+    {
+        WARN("Tournament listen failed (expected in some test environments): " << e.what());
+        return;
+    }
+    if(listening.first.empty())
+    {
+        WARN("Tournament is not listening on a unix socket");
+        return;
+    }
+
+    pumping_client admin(t, listening.first);
+    pumping_client topics(t, listening.first);
+
+    // topic client keeps the latest content of each topic
+    std::map<std::string, nlohmann::json> received;
+    auto on_topic([&received](const nlohmann::json& message)
+    {
+        auto topic(message.at("topic").get<std::string>());
+        REQUIRE((topic == "seating" || topic == "players"));
+        received[topic] = message.at("state");
+    });
+    auto on_admin([](const nlohmann::json&) {});
+
+    // subscribing sends the current content of each topic before the response
+    topics.send("subscribe", { { "topics", { "seating", "players" } }, { "echo", 1 } });
+    auto response(topics.receive_response(1, on_topic));
+    REQUIRE(response.at("topics") == nlohmann::json({ "seating", "players" }));
+    REQUIRE(received.size() == 2);
+    REQUIRE(received["seating"].count("seats") == 1);
+    REQUIRE(received["seating"].count("current_time") == 0);
+    REQUIRE(received["players"].count("seated_players") == 1);
+
+    // mutate state
+    nlohmann::json config { { "authenticate", 1234 }, { "echo", 2 }, { "players", { { { "player_id", "p1" }, { "name", "Alice" } }, { { "player_id", "p2" }, { "name", "Bob" } } } }, { "table_capacity", 2 } };
+    admin.send("configure", config);
+    admin.receive_response(2, on_admin);
+    admin.send("plan_seating", { { "authenticate", 1234 }, { "echo", 3 }, { "max_expected_players", 2 } });
+    admin.receive_response(3, on_admin);
+    admin.send("seat_player", { { "authenticate", 1234 }, { "echo", 4 }, { "player_id", "p1" } });
+    admin.receive_response(4, on_admin);
+
+    // topic client saw only its topics, and they match the full state
+    topics.send("version", { { "echo", 5 } });
+    topics.receive_response(5, on_topic);
+    admin.send("get_state", { { "echo", 6 } });
+    auto state(admin.receive_response(6, on_admin));
+    REQUIRE(received["seating"].at("seats") == state.at("seats"));
+    REQUIRE(received["players"].at("seated_players") == state.at("seated_players"));
+
+    // unknown topics are rejected, and an empty list stops state broadcasts
+    topics.send("subscribe", { { "topics", { "bogus" } }, { "echo", 7 } });
+    REQUIRE(topics.receive_response(7, on_topic).count("error") == 1);
+    topics.send("subscribe", { { "topics", nlohmann::json::array() }, { "echo", 8 } });
+    topics.receive_response(8, on_topic);
+    auto on_none([](const nlohmann::json&) { FAIL("unexpected broadcast"); });
+    admin.send("seat_player", { { "authenticate", 1234 }, { "echo", 9 }, { "player_id", "p2" } });
+    admin.receive_response(9, on_admin);
+    topics.send("version", { { "echo", 10 } });
+    topics.receive_response(10, on_none);
+}
+
+TEST_CASE("Tournament command dispatch", "[tournament][commands][unix_socket]")
+{
+    tournament t;
+    t.authorize(1234);
+
+    std::pair<std::string, int> listening;
+    try
+    {
+        listening = t.listen("/tmp");
+    }
+    catch(const std::exception& e)
+    {
+        WARN("Tournament listen failed (expected in some test environments): " << e.what());
+        return;
+    }
+    if(listening.first.empty())
+    {
+        WARN("Tournament is not listening on a unix socket");
+        return;
+    }
+
+    pumping_client client(t, listening.first);
+    auto on_broadcast([](const nlohmann::json&) {});
+
+    // commands are case-insensitive
+    client.send("VERSION", { { "echo", 1 } });
+    REQUIRE(client.receive_response(1, on_broadcast).at("server_name") == "tournamentd");
+
+    // output waiting for each client, answered on the I/O thread
+    client.send("get_queue_depths", { { "echo", 100 } });
+    auto depths(client.receive_response(100, on_broadcast).at("queue_depths"));
+    REQUIRE(depths.size() == 1);
+    REQUIRE(depths[0].at("client").is_string());
+    REQUIRE(depths[0].at("messages").is_number_unsigned());
+    REQUIRE(depths[0].at("bytes").is_number_unsigned());
+
+    // unknown commands are rejected
+    client.send("versions", { { "echo", 2 } });
+    REQUIRE(client.receive_response(2, on_broadcast).at("error") == "unknown command");
+
+    // authorization is checked before the handler runs
+    client.send("start_game", { { "echo", 3 } });
+    REQUIRE(client.receive_response(3, on_broadcast).at("error") == "missing authenticate");
+    client.send("get_config", { { "authenticate", 4321 }, { "echo", 4 } });
+    REQUIRE(client.receive_response(4, on_broadcast).at("error") == "unauthorized");
+    client.send("get_config", { { "authenticate", 1234 }, { "echo", 5 } });
+    REQUIRE(client.receive_response(5, on_broadcast).count("error") == 0);
+
+    // player commands, with any kind of echo
+    nlohmann::json config { { "authenticate", 1234 }, { "echo", 6 }, { "players", { { { "player_id", "p1" }, { "name", "Alice" } }, { { "player_id", "p2" }, { "name", "Bob" } } } }, { "funding_sources", { { { "name", "Buy-in" }, { "type", 0 }, { "chips", 1500 }, { "cost", { { "amount", 100.0 }, { "currency", "USD" } } } } } }, { "table_capacity", 2 } };
+    client.send("configure", config);
+    client.receive_response(6, on_broadcast);
+    client.send("plan_seating", { { "authenticate", 1234 }, { "echo", 7 }, { "max_expected_players", 2 } });
+    client.receive_response(7, on_broadcast);
+    client.send("seat_player", { { "authenticate", 1234 }, { "echo", 8 }, { "player_id", "p1" } });
+    REQUIRE(client.receive_response(8, on_broadcast).count("player_seated") == 1);
+    client.send("Fund_Player", { { "authenticate", 1234 }, { "echo", "nine" }, { "player_id", "p1" }, { "source_id", 0 } });
+    auto response(client.receive());
+    while(response.count("echo") == 0)
+    {
+        response = client.receive();
+    }
+    REQUIRE(response.at("echo") == "nine");
+    REQUIRE(response.size() == 1);
+    nlohmann::json structured_echo { { "request", 10 } };
+    client.send("seat_player", { { "authenticate", 1234 }, { "echo", structured_echo }, { "player_id", "p2" } });
+    response = client.receive();
+    while(response.count("echo") == 0)
+    {
+        response = client.receive();
+    }
+    REQUIRE(response.at("echo") == structured_echo);
+    REQUIRE(response.count("player_seated") == 1);
+
+    // malformed arguments are reported as protocol errors, naming the argument
+    client.send("fund_player", { { "authenticate", 1234 }, { "echo", 11 }, { "player_id", "p1" } });
+    REQUIRE(client.receive_response(11, on_broadcast).at("error") == "missing source_id");
+    client.send("bust_player", { { "authenticate", 1234 }, { "echo", 12 }, { "player_id", 1 } });
+    REQUIRE(client.receive_response(12, on_broadcast).at("error") == "argument player_id must be of type string");
+    client.send("unseat_player", { { "authenticate", 4321 }, { "echo", 13 }, { "player_id", "p1" } });
+    REQUIRE(client.receive_response(13, on_broadcast).at("error") == "unauthorized");
+}
+
+TEST_CASE("Tournament batch commands", "[tournament][batch][unix_socket]")
+{
+    tournament t;
+    t.authorize(1234);
+
+    std::pair<std::string, int> listening;
+    try
+    {
+        listening = t.listen("/tmp");
+    }
+    catch(const std::exception& e)
+    {
+        WARN("Tournament listen failed (expected in some test environments): " << e.what());
+        return;
+    }
+    if(listening.first.empty())
+    {
+        WARN("Tournament is not listening on a unix socket");
+        return;
+    }
+
+    pumping_client client(t, listening.first);
+    std::size_t broadcasts(0);
+    nlohmann::json last_broadcast;
+    auto on_broadcast([&](const nlohmann::json& message)
+    {
+        broadcasts++;
+        last_broadcast = message;
+    });
+
+    nlohmann::json players(nlohmann::json::array());
+    for(auto i(0); i < 6; i++)
+    {
+        players.push_back({ { "player_id", "p" + std::to_string(i) }, { "name", "Player " + std::to_string(i) } });
+    }
+    nlohmann::json config { { "authenticate", 1234 }, { "echo", 1 }, { "players", players }, { "funding_sources", { { { "name", "Buy-in" }, { "type", 0 }, { "chips", 1500 }, { "cost", { { "amount", 100.0 }, { "currency", "USD" } } } } } }, { "table_capacity", 3 }, { "rebalance_policy", 1 } };
+    client.send("configure", config);
+    client.receive_response(1, on_broadcast);
+    client.send("plan_seating", { { "authenticate", 1234 }, { "echo", 2 }, { "max_expected_players", 6 } });
+    client.receive_response(2, on_broadcast);
+
+    // seat and fund everyone with one broadcast
+    nlohmann::json commands(nlohmann::json::array());
+    for(auto i(0); i < 6; i++)
+    {
+        auto player_id("p" + std::to_string(i));
+        commands.push_back({ { "command", "seat_player" }, { "player_id", player_id }, { "echo", i * 2 } });
+        commands.push_back({ { "command", "fund_player" }, { "player_id", player_id }, { "source_id", 0 }, { "echo", i * 2 + 1 } });
+    }
+    broadcasts = 0;
+    client.send("batch", { { "authenticate", 1234 }, { "echo", 3 }, { "commands", commands } });
+    auto response(client.receive_response(3, on_broadcast));
+    REQUIRE(broadcasts == 1);
+    REQUIRE(response.count("rolled_back") == 0);
+    REQUIRE(response.at("results").size() == 12);
+    for(std::size_t i(0); i < 12; i++)
+    {
+        REQUIRE(response.at("results")[i].at("echo") == i);
+        REQUIRE(response.at("results")[i].count("error") == 0);
+    }
+    REQUIRE(last_broadcast.at("seats").size() == 6);
+    REQUIRE(last_broadcast.at("buyins").size() == 6);
+
+    // a failure rolls back the whole batch, without a broadcast
+    commands = { { { "command", "bust_player" }, { "player_id", "p0" } }, { { "command", "bust_player" }, { "player_id", "nobody" } } };
+    broadcasts = 0;
+    client.send("batch", { { "authenticate", 1234 }, { "echo", 4 }, { "commands", commands } });
+    response = client.receive_response(4, on_broadcast);
+    REQUIRE(broadcasts == 0);
+    REQUIRE(response.at("rolled_back") == true);
+    REQUIRE(response.at("results").size() == 2);
+    REQUIRE(response.at("results")[1].count("error") == 1);
+    client.send("get_state", { { "echo", 5 } });
+    REQUIRE(client.receive_response(5, on_broadcast).at("buyins").size() == 6);
+
+    // including codes authorized by a configure inside the batch
+    commands = { { { "command", "configure" }, { "authorized_clients", { { { "code", 9999 }, { "name", "Rolled back" } } } } }, { { "command", "bust_player" }, { "player_id", "nobody" } } };
+    client.send("batch", { { "authenticate", 1234 }, { "echo", 50 }, { "commands", commands } });
+    response = client.receive_response(50, on_broadcast);
+    REQUIRE(response.at("rolled_back") == true);
+    REQUIRE(response.at("results")[0].count("error") == 0);
+    client.send("check_authorized", { { "authenticate", 9999 }, { "echo", 51 } });
+    REQUIRE(client.receive_response(51, on_broadcast).at("authorized") == false);
+
+    // or keeps going, rebalancing once at the end
+    commands = { { { "command", "bust_player" }, { "player_id", "p0" } }, { { "command", "quit" } }, { { "command", "bust_player" }, { "player_id", "p1" } }, { { "command", "bust_player" }, { "player_id", "p2" } } };
+    client.send("batch", { { "authenticate", 1234 }, { "echo", 6 }, { "atomic", false }, { "commands", commands } });
+    response = client.receive_response(6, on_broadcast);
+    REQUIRE(response.count("rolled_back") == 0);
+    REQUIRE(response.at("results")[1].at("error") == "command not allowed in batch");
+    REQUIRE(last_broadcast.at("buyins").size() == 3);
+    REQUIRE(last_broadcast.at("table_count") == 1);
+}
+
+TEST_CASE("Tournament journal recovery", "[tournament][journal][unix_socket]")
+{
+    tournament t1;
+    t1.authorize(1234);
+
+    std::pair<std::string, int> listening;
+    try
+    {
+        listening = t1.listen("/tmp");
+    }
+    catch(const std::exception& e)
+    {
+        WARN("Tournament listen failed (expected in some test environments): " << e.what());
+        return;
+    }
+    if(listening.first.empty())
+    {
+        WARN("Tournament is not listening on a unix socket");
+        return;
+    }
+
+    pumping_client client1(t1, listening.first);
+    auto ignore([](const nlohmann::json&) {});
+
+    nlohmann::json players(nlohmann::json::array());
+    for(auto i(0); i < 8; i++)
+    {
+        players.push_back({ { "player_id", "p" + std::to_string(i) }, { "name", "Player " + std::to_string(i) } });
+    }
+    client1.send("configure", { { "authenticate", 1234 }, { "echo", 1 }, { "players", players }, { "table_capacity", 4 } });
+    client1.receive_response(1, ignore);
+    client1.send("plan_seating", { { "authenticate", 1234 }, { "echo", 2 }, { "max_expected_players", 8 } });
+    client1.receive_response(2, ignore);
+    for(auto i(0); i < 8; i++)
+    {
+        client1.send("seat_player", { { "authenticate", 1234 }, { "echo", 3 + i }, { "player_id", "p" + std::to_string(i) } });
+        client1.receive_response(3 + i, ignore);
+    }
+
+    // rejected commands replay as rejected
+    client1.send("bust_player", { { "authenticate", 1234 }, { "echo", 20 }, { "player_id", "nobody" } });
+    REQUIRE(client1.receive_response(20, ignore).count("error") == 1);
+    client1.send("get_state", { { "echo", 21 } });
+    auto state1(client1.receive_response(21, ignore));
+
+    // a second tournament recovers from the first one's snapshot and journal, as if after a crash
+    tournament t2;
+    auto listening2(t2.listen("/tmp"));
+    REQUIRE_FALSE(listening2.first.empty());
+    pumping_client client2(t2, listening2.first);
+    client2.send("get_state", { { "echo", 1 } });
+    auto state2(client2.receive_response(1, ignore));
+    REQUIRE(state2.at("seats") == state1.at("seats"));
+    REQUIRE(state2.at("seated_players") == state1.at("seated_players"));
+
+    // including pre-authorized clients
+    client2.send("get_config", { { "authenticate", 1234 }, { "echo", 2 } });
+    auto config2(client2.receive_response(2, ignore));
+    REQUIRE(config2.count("error") == 0);
+    REQUIRE(config2.at("players").size() == 8);
+}
+
+TEST_CASE("Tournament journal recovery from a configuration file", "[tournament][journal][unix_socket]")
+{
+    // players and the only authorized code come from the file, as with -c
+    nlohmann::json players(nlohmann::json::array());
+    for(auto i(0); i < 4; i++)
+    {
+        players.push_back({ { "player_id", "p" + std::to_string(i) }, { "name", "Player " + std::to_string(i) } });
+    }
+    std::string config_path("test_tournament_config.json");
+    {
+        std::ofstream config_file(config_path);
+        config_file << nlohmann::json { { "authorized_clients", { { { "code", 4321 }, { "name", "From file" } } } }, { "players", players }, { "table_capacity", 4 } }.dump();
+    }
+
+    tournament t1;
+    t1.load_configuration(config_path);
+    std::remove(config_path.c_str());
+
+    std::pair<std::string, int> listening;
+    try
+    {
+        listening = t1.listen("/tmp");
+    }
+    catch(const std::exception& e)
+    {
+        WARN("Tournament listen failed (expected in some test environments): " << e.what());
+        return;
+    }
+    if(listening.first.empty())
+    {
+        WARN("Tournament is not listening on a unix socket");
+        return;
+    }
+
+    pumping_client client1(t1, listening.first);
+    auto ignore([](const nlohmann::json&) {});
+    client1.send("plan_seating", { { "authenticate", 4321 }, { "echo", 1 }, { "max_expected_players", 4 } });
+    REQUIRE(client1.receive_response(1, ignore).count("error") == 0);
+    for(auto i(0); i < 4; i++)
+    {
+        client1.send("seat_player", { { "authenticate", 4321 }, { "echo", 2 + i }, { "player_id", "p" + std::to_string(i) } });
+        REQUIRE(client1.receive_response(2 + i, ignore).count("error") == 0);
+    }
+    client1.send("get_state", { { "echo", 10 } });
+    auto state1(client1.receive_response(10, ignore));
+    REQUIRE(state1.at("seats").size() == 4);
+
+    // no checkpoint yet: the second tournament has only the journal to go on
+    auto* tmpdir(std::getenv("TMPDIR"));
+    std::ifstream snapshot(std::string(tmpdir != nullptr ? tmpdir : "/tmp") + "/tournamentd.snapshot.cbor");
+    REQUIRE_FALSE(snapshot.good());
+
+    tournament t2;
+    auto listening2(t2.listen("/tmp"));
+    REQUIRE_FALSE(listening2.first.empty());
+    pumping_client client2(t2, listening2.first);
+    client2.send("get_state", { { "echo", 1 } });
+    REQUIRE(client2.receive_response(1, ignore).at("seats") == state1.at("seats"));
+    client2.send("get_config", { { "authenticate", 4321 }, { "echo", 2 } });
+    auto config2(client2.receive_response(2, ignore));
+    REQUIRE(config2.count("error") == 0);
+    REQUIRE(config2.at("players").size() == 4);
+}
+
+TEST_CASE("Tournament recovers from an earlier version's JSON snapshot", "[tournament][journal][unix_socket]")
+{
+    auto* tmpdir(std::getenv("TMPDIR"));
+    std::string legacy_path(std::string(tmpdir != nullptr ? tmpdir : "/tmp") + "/tournamentd.snapshot.json");
+    {
+        nlohmann::json players { { { "player_id", "p0" }, { "name", "Player 0" } }, { { "player_id", "p1" }, { "name", "Player 1" } } };
+        std::ofstream legacy(legacy_path);
+        legacy << nlohmann::json { { "authorized_clients", { { { "code", 2468 }, { "name", "Before upgrade" } } } }, { "players", players }, { "table_capacity", 2 } }.dump(4);
+    }
+
+    tournament t;
+    std::pair<std::string, int> listening;
+    try
+    {
+        listening = t.listen("/tmp");
+    }
+    catch(const std::exception& e)
+    {
+        std::remove(legacy_path.c_str());
+        WARN("Tournament listen failed (expected in some test environments): " << e.what());
+        return;
+    }
+    if(listening.first.empty())
+    {
+        std::remove(legacy_path.c_str());
+        WARN("Tournament is not listening on a unix socket");
+        return;
+    }
+
+    pumping_client client(t, listening.first);
+    auto ignore([](const nlohmann::json&) {});
+    client.send("get_config", { { "authenticate", 2468 }, { "echo", 1 } });
+    auto config(client.receive_response(1, ignore));
+    REQUIRE(config.count("error") == 0);
+    REQUIRE(config.at("players").size() == 2);
+    REQUIRE(config.at("table_capacity") == 2);
+}
+
+TEST_CASE("Tournament responses stay in order", "[tournament][commands][unix_socket]")
+{
+    tournament t;
+    t.authorize(1234);
+
+    std::pair<std::string, int> listening;
+    try
+    {
+        listening = t.listen("/tmp");
+    }
+    catch(const std::exception& e)
+    {
+        WARN("Tournament listen failed (expected in some test environments): " << e.what());
+        return;
+    }
+    if(listening.first.empty())
+    {
+        WARN("Tournament is not listening on a unix socket");
+        return;
+    }
+
+    // commands sent together are answered in the order sent, whichever thread runs them
+    unix_socket sock(listening.first.c_str(), true);
+    sock.set_nonblocking(true);
+    std::string lines;
+    lines += "configure {\"authenticate\":1234,\"echo\":1,\"players\":[{\"player_id\":\"p1\",\"name\":\"Alice\"}]}\n";
+    lines += "subscribe {\"echo\":2,\"topics\":[]}\n";
+    lines += "versions {\"echo\":3}\n";
+    lines += "get_state {\"echo\":4}\n";
+    lines += "set_broadcast_mode {\"echo\":5,\"mode\":\"full\"}\n";
+    lines += "seat_player {\"echo\":6,\"player_id\":1}\n";
+    lines += "quit\n";
+    lines += "version {\"echo\":7}\n";
+    REQUIRE(sock.send(lines.data(), lines.size()) == static_cast<long>(lines.size()));
+
+    // every response before quit arrives, nothing after it, then the connection closes
+    std::vector<nlohmann::json> responses;
+    std::string buffer;
+    auto deadline(std::chrono::steady_clock::now() + std::chrono::seconds(5));
+    for(;;)
+    {
+        REQUIRE(std::chrono::steady_clock::now() < deadline);
+        t.run();
+
+        char buf[65536];
+        auto len(sock.recv(buf, sizeof(buf)));
+        if(len < 0)
+        {
+            break;
+        }
+        buffer.append(buf, static_cast<std::size_t>(len));
+        for(auto nl(buffer.find('\n')); nl != std::string::npos; nl = buffer.find('\n'))
+        {
+            auto message(nlohmann::json::parse(buffer.substr(0, nl)));
+            buffer.erase(0, nl + 1);
+            if(message.count("echo") != 0)
+            {
+                responses.push_back(message);
+            }
+        }
+    }
+
+    REQUIRE(responses.size() == 6);
+    for(std::size_t i(0); i < responses.size(); i++)
+    {
+        REQUIRE(responses[i].at("echo") == i + 1);
+    }
+    REQUIRE(responses[0].count("error") == 0);
+    REQUIRE(responses[2].at("error") == "unknown command");
+    REQUIRE(responses[3].at("seated_players").size() == 1);
+    REQUIRE(responses[4].at("mode") == "full");
+    REQUIRE(responses[5].at("error") == "argument player_id must be of type string");
+}
+
+TEST_CASE("Tournament queries read published state", "[tournament][commands][unix_socket]")
+{
+    tournament t;
+    t.authorize(1234);
+
+    std::pair<std::string, int> listening;
+    try
+    {
+        listening = t.listen("/tmp");
+    }
+    catch(const std::exception& e)
+    {
+        WARN("Tournament listen failed (expected in some test environments): " << e.what());
+        return;
+    }
+    if(listening.first.empty())
+    {
+        WARN("Tournament is not listening on a unix socket");
+        return;
+    }
+
+    pumping_client admin(t, listening.first);
+    pumping_client viewer(t, listening.first);
+    auto on_broadcast([](const nlohmann::json&) {});
+
+    nlohmann::json config { { "authenticate", 1234 }, { "echo", 1 }, { "players", { { { "player_id", "p1" }, { "name", "Alice" } }, { { "player_id", "p2" }, { "name", "Bob" } } } }, { "funding_sources", { { { "name", "Buy-in" }, { "type", 0 }, { "chips", 1500 }, { "cost", { { "amount", 100.0 }, { "currency", "USD" } } } } } }, { "available_chips", { { { "denomination", 25 }, { "count_available", 500 } }, { { "denomination", 100 }, { "count_available", 500 } } } }, { "blind_levels", { nlohmann::json::object(), { { "little_blind", 25 }, { "big_blind", 50 }, { "duration", 600000 } } } } };
+    admin.send("configure", config);
+    REQUIRE(admin.receive_response(1, on_broadcast).count("error") == 0);
+
+    // a burst of queries from one client, while another changes the game
+    const int burst(50);
+    for(int i(1); i <= burst; i++)
+    {
+        viewer.send("get_state", { { "echo", i } });
+    }
+    admin.send("seat_player", { { "authenticate", 1234 }, { "echo", 2 }, { "player_id", "p1" } });
+    admin.send("get_state", { { "echo", 3 } });
+
+    // a query sent right after a change sees it
+    REQUIRE(admin.receive_response(2, on_broadcast).count("error") == 0);
+    REQUIRE(admin.receive_response(3, on_broadcast).at("seats").size() == 1);
+
+    // the burst is answered in the order sent
+    for(int i(1); i <= burst; i++)
+    {
+        auto message(viewer.receive());
+        while(message.count("echo") == 0)
+        {
+            message = viewer.receive();
+        }
+        REQUIRE(message.at("echo") == i);
+        REQUIRE(message.count("seats") == 1);
+    }
+
+    // authorization through the API is published too
+    t.authorize(5678);
+    viewer.send("get_config", { { "authenticate", 5678 }, { "echo", burst + 1 } });
+    auto response(viewer.receive_response(burst + 1, on_broadcast));
+    REQUIRE(response.count("error") == 0);
+    REQUIRE(response.at("authorized_clients").size() == 2);
+    REQUIRE(response.at("players").size() == 2);
+
+    viewer.send("gen_blind_levels", { { "authenticate", 4321 }, { "echo", burst + 2 }, { "desired_duration", 3600000 }, { "level_duration", 600000 } });
+    REQUIRE(viewer.receive_response(burst + 2, on_broadcast).at("error") == "unauthorized");
+}
+
+TEST_CASE("Tournament asynchronous commands", "[tournament][commands][unix_socket]")
+{
+    tournament t;
+    t.authorize(1234);
+
+    std::pair<std::string, int> listening;
+    try
+    {
+        listening = t.listen("/tmp");
+    }
+    catch(const std::exception& e)
+    {
+        WARN("Tournament listen failed (expected in some test environments): " << e.what());
+        return;
+    }
+    if(listening.first.empty())
+    {
+        WARN("Tournament is not listening on a unix socket");
+        return;
+    }
+
+    // compute commands are answered whenever ready, so responses are matched by echo. quit still waits for them
+    unix_socket sock(listening.first.c_str(), true);
+    sock.set_nonblocking(true);
+    nlohmann::json config { { "authenticate", 1234 }, { "echo", 1 }, { "funding_sources", { { { "name", "Buy-in" }, { "type", 0 }, { "chips", 1500 }, { "cost", { { "amount", 100.0 }, { "currency", "USD" } } } } } }, { "available_chips", { { { "denomination", 25 }, { "count_available", 500 } }, { { "denomination", 100 }, { "count_available", 500 } } } }, { "blind_levels", { nlohmann::json::object(), { { "little_blind", 25 }, { "big_blind", 50 }, { "duration", 600000 } } } } };
+    std::string lines;
+    lines += "configure " + config.dump() + "\n";
+    lines += "gen_blind_levels {\"authenticate\":1234,\"echo\":2,\"desired_duration\":7200000,\"level_duration\":900000,\"expected_buyins\":10}\n";
+    lines += "chips_for_buyin {\"echo\":3,\"source_id\":0,\"max_expected_players\":2}\n";
+    lines += "version {\"echo\":4}\n";
+    lines += "chips_for_buyin {\"echo\":5,\"source_id\":9,\"max_expected_players\":2}\n";
+    lines += "quit\n";
+    REQUIRE(sock.send(lines.data(), lines.size()) == static_cast<long>(lines.size()));
+
+    std::map<int, nlohmann::json> responses;
+    std::vector<int> ordered;
+    std::string buffer;
+    auto deadline(std::chrono::steady_clock::now() + std::chrono::seconds(5));
+    for(;;)
+    {
+        REQUIRE(std::chrono::steady_clock::now() < deadline);
+        t.run();
+
+        char buf[65536];
+        auto len(sock.recv(buf, sizeof(buf)));
+        if(len < 0)
+        {
+            break;
+        }
+        buffer.append(buf, static_cast<std::size_t>(len));
+        for(auto nl(buffer.find('\n')); nl != std::string::npos; nl = buffer.find('\n'))
+        {
+            auto message(nlohmann::json::parse(buffer.substr(0, nl)));
+            buffer.erase(0, nl + 1);
+            if(message.count("echo") != 0)
+            {
+                auto echo(message.at("echo").get<int>());
+                responses[echo] = message;
+                if(echo == 1 || echo == 4)
+                {
+                    ordered.push_back(echo);
+                }
+            }
+        }
+    }
+
+    // every response arrives before the connection closes, and the others keep their order
+    REQUIRE(responses.size() == 5);
+    REQUIRE(ordered == std::vector<int>({ 1, 4 }));
+    REQUIRE(responses[2].at("blind_levels").size() > 1);
+    REQUIRE(responses[3].at("chips_for_buyin").size() == 2);
+    REQUIRE(responses[4].at("server_name") == "tournamentd");
+    REQUIRE(responses[5].at("error") == "invalid funding source");
+}
+
+TEST_CASE("Tournament command reference is current", "[tournament][commands]")
+{
+    // tournamentd.md sits next to the tests directory
+    std::ifstream file(std::string(TD_TESTS_DIR) + "/../tournamentd.md");
+    REQUIRE(file.good());
+    std::ostringstream doc;
+    doc << file.rdbuf();
+
+    // the generated block, regenerated with tournamentd --commands
+    static const std::string begin_marker("<!-- BEGIN tournamentd --commands -->\n");
+    static const std::string end_marker("<!-- END tournamentd --commands -->");
+    auto text(doc.str());
+    auto begin(text.find(begin_marker));
+    auto end(text.find(end_marker));
+    REQUIRE(begin != std::string::npos);
+    REQUIRE(end != std::string::npos);
+    begin += begin_marker.size();
+    REQUIRE(text.substr(begin, end - begin) == tournament::command_reference());
+}
@@ -0,0 +1,108 @@
+#include "../worker_pool.hpp"
+#include <Catch2/catch.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+TEST_CASE("Worker pool", "[worker_pool]")
+{
+    SECTION("Runs every job posted before it is destroyed")
+    {
+        std::atomic<int> count(0);
+        {
+            worker_pool pool(3);
+            REQUIRE(pool.size() == 3);
+            for(int i(0); i < 1000; i++)
+            {
+                pool.post([&count]()
+                {
+                    count++;
+                });
+            }
+        }
+        REQUIRE(count == 1000);
+    }
+
+    SECTION("At least one thread")
+    {
+        std::atomic<int> count(0);
+        {
+            worker_pool pool(0);
+            REQUIRE(pool.size() == 1);
+            pool.post([&count]()
+            {
+                count++;
+            });
+        }
+        REQUIRE(count == 1);
+    }
+
+    SECTION("Jobs run at the same time")
+    {
+        // each job waits for the other, so this only finishes if both run at once
+        std::mutex mutex;
+        std::condition_variable cv;
+        int arrived(0);
+        std::atomic<int> finished(0);
+        {
+            worker_pool pool(2);
+            for(int i(0); i < 2; i++)
+            {
+                pool.post([&]()
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    arrived++;
+                    cv.notify_all();
+                    if(cv.wait_for(lock, std::chrono::seconds(10), [&arrived] { return arrived == 2; }))
+                    {
+                        finished++;
+                    }
+                });
+            }
+        }
+        REQUIRE(finished == 2);
+    }
+
+    SECTION("A failing job does not stop the pool")
+    {
+        std::atomic<int> count(0);
+        {
+            worker_pool pool(1);
+            pool.post([]()
+            {
+                throw std::runtime_error("job failed");
+            });
+            pool.post([&count]()
+            {
+                count++;
+            });
+        }
+        REQUIRE(count == 1);
+    }
+
+    SECTION("Jobs may post more jobs")
+    {
+        std::atomic<int> count(0);
+        std::atomic<bool> posted(false);
+        {
+            worker_pool pool(2);
+            pool.post([&pool, &count, &posted]()
+            {
+                pool.post([&count]()
+                {
+                    count++;
+                });
+                posted = true;
+            });
+
+            while(!posted)
+            {
+                std::this_thread::yield();
+            }
+        }
+        REQUIRE(count == 1);
+    }
+}
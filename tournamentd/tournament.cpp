@@ -1,67 +1,528 @@
 #include "tournament.hpp"
+#include "command_args.hpp"
+#include "datetime.hpp"
 #include "gameinfo.hpp"
+#include "journal.hpp"
+#include "json_file.hpp"
+#include "json_writer.hpp"
 #include "logger.hpp"
+#include "mpsc_queue.hpp"
 #include "nlohmann/json.hpp"
 #include "scope_timer.hpp"
 #include "server.hpp"
+#include "snapshot_writer.hpp"
+#include "worker_pool.hpp"
 #include <algorithm>
+#include <array>
 #include <cassert>
+#include <cctype>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
-#include <fstream>
-#include <iomanip>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <system_error>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 
-// poll clients for commands, waiting at most 50ms
-static constexpr long SERVER_POLL_TIMEOUT = 50000;
+// poll clients for commands, waiting at most one second so that run() returns regularly
+static constexpr long SERVER_POLL_MAX_TIMEOUT = 1000000;
+
+// the game thread wakes at least this often (microseconds), to check the clock and checkpoint the journal
+static constexpr long GAME_WAIT_MAX_TIMEOUT = 1000000;
+
+// threads answering read-only commands from published state, and threads for those that may compute for a long time
+static constexpr std::size_t QUERY_THREADS = 2;
+static constexpr std::size_t COMPUTE_THREADS = 2;
 
 // default listen port for tournamentd
 static constexpr int DEFAULT_PORT = 25600;
 
+// write a snapshot and truncate the journal after this many journal entries, or this many seconds after the first
+static constexpr std::size_t JOURNAL_CHECKPOINT_ENTRIES = 1000;
+static constexpr long JOURNAL_CHECKPOINT_INTERVAL = 60;
+
+// default interval between full keyframes sent to delta-mode clients
+static constexpr long DEFAULT_KEYFRAME_INTERVAL = 30;
+
+// broadcast channels: complete state documents, sequenced merge patches, and one channel per topic
+static constexpr server::channel_mask CHANNEL_FULL_STATE = server::default_channel;
+static constexpr server::channel_mask CHANNEL_DELTA_STATE = 1 << 1;
+static constexpr std::size_t CHANNEL_FIRST_TOPIC_BIT = 2;
+
+// state broadcast topics, each a subset of the state document
+enum class topic_t : std::size_t
+{
+    clock,
+    round,
+    seating,
+    players,
+    results,
+    funding,
+    config,
+    count
+};
+
+static constexpr std::size_t TOPIC_COUNT = static_cast<std::size_t>(topic_t::count);
+static const char* const TOPIC_NAMES[TOPIC_COUNT] = { "clock", "round", "seating", "players", "results", "funding", "config" };
+static constexpr server::channel_mask CHANNEL_ALL_TOPICS = ((1U << TOPIC_COUNT) - 1) << CHANNEL_FIRST_TOPIC_BIT;
+static constexpr server::channel_mask CHANNEL_ALL_STATE = CHANNEL_FULL_STATE | CHANNEL_DELTA_STATE | CHANNEL_ALL_TOPICS;
+
+static constexpr server::channel_mask topic_channel(std::size_t topic)
+{
+    return 1U << (CHANNEL_FIRST_TOPIC_BIT + topic);
+}
+
+// which topic a state field belongs to. fields not listed are part of config
+static std::size_t topic_for_field(const std::string& field)
+{
+    static const std::unordered_map<std::string, topic_t> topics {
+        { "current_time", topic_t::clock },
+        { "elapsed_time", topic_t::clock },
+        { "action_clock_time_remaining", topic_t::clock },
+        { "running", topic_t::clock },
+        { "time_remaining", topic_t::clock },
+        { "break_time_remaining", topic_t::clock },
+        { "clock_remaining", topic_t::clock },
+        { "on_break", topic_t::clock },
+        { "end_of_round", topic_t::clock },
+        { "end_of_break", topic_t::clock },
+        { "end_of_action_clock", topic_t::clock },
+        { "tournament_start", topic_t::clock },
+        { "paused_time", topic_t::clock },
+        { "current_blind_level", topic_t::round },
+        { "current_round_number_text", topic_t::round },
+        { "current_round_text", topic_t::round },
+        { "next_round_text", topic_t::round },
+        { "seats", topic_t::seating },
+        { "empty_seats", topic_t::seating },
+        { "table_count", topic_t::seating },
+        { "seating_chart", topic_t::seating },
+        { "tables_playing", topic_t::seating },
+        { "seated_players", topic_t::players },
+        { "players_finished", topic_t::players },
+        { "bust_history", topic_t::players },
+        { "buyins", topic_t::players },
+        { "unique_entries", topic_t::players },
+        { "entries", topic_t::players },
+        { "players_left_text", topic_t::players },
+        { "unique_entries_text", topic_t::players },
+        { "entries_text", topic_t::players },
+        { "average_stack_text", topic_t::players },
+        { "results", topic_t::results },
+        { "payouts", topic_t::results },
+        { "total_chips", topic_t::funding },
+        { "total_cost", topic_t::funding },
+        { "total_commission", topic_t::funding },
+        { "total_equity", topic_t::funding },
+        { "funding_sources", topic_t::funding },
+        { "payout_currency", topic_t::funding },
+        { "buyin_text", topic_t::funding }
+    };
+
+    auto it(topics.find(field));
+    return static_cast<std::size_t>(it == topics.end() ? topic_t::config : it->second);
+}
+
+// split a state document into topics
+static std::array<nlohmann::json, TOPIC_COUNT> split_topics(const nlohmann::json& state)
+{
+    std::array<nlohmann::json, TOPIC_COUNT> sections;
+    for(auto& section : sections)
+    {
+        section = nlohmann::json::object();
+    }
+    for(auto it(state.begin()); it != state.end(); ++it)
+    {
+        sections[topic_for_field(it.key())][it.key()] = it.value();
+    }
+    return sections;
+}
+
+// create an RFC 7386 merge patch that transforms source into target
+static nlohmann::json create_merge_patch(const nlohmann::json& source, const nlohmann::json& target)
+{
+    if(!source.is_object() || !target.is_object())
+    {
+        return target;
+    }
+
+    auto patch(nlohmann::json::object());
+
+    // removed members
+    for(auto it(source.begin()); it != source.end(); ++it)
+    {
+        if(target.find(it.key()) == target.end())
+        {
+            patch[it.key()] = nullptr;
+        }
+    }
+
+    // added and changed members
+    for(auto it(target.begin()); it != target.end(); ++it)
+    {
+        auto src_it(source.find(it.key()));
+        if(src_it == source.end())
+        {
+            patch[it.key()] = it.value();
+        }
+        else if(*src_it != it.value())
+        {
+            patch[it.key()] = create_merge_patch(*src_it, it.value());
+        }
+    }
+
+    return patch;
+}
+
+// is character whitespace between command and argument
+static bool is_command_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// compare command input against a lower-case command name, ignoring case of the input (assuming ASCII-encoded input)
+static int compare_command(const char* input, std::size_t size, const char* name)
+{
+    for(std::size_t i(0); i < size; i++, name++)
+    {
+        auto c(static_cast<unsigned char>(::tolower(static_cast<unsigned char>(input[i]))));
+        auto n(static_cast<unsigned char>(*name));
+        if(n == 0 || c > n)
+        {
+            return 1;
+        }
+        if(c < n)
+        {
+            return -1;
+        }
+    }
+    return *name == 0 ? 0 : -1;
+}
+
+// ----- command schemas: arguments and output of each command, documented in tournamentd.md
+
+static constexpr arg_spec batch_input[] = {
+    { "authenticate", arg_type::integer, false, nullptr, "Authentication code, used by any command that does not send its own" },
+    { "commands", arg_type::array, true, nullptr, "Commands to run in order. Each is an object with \"command\" (string) and that command's input. Each is authorized as if sent alone, using the batch's authenticate unless it has its own" },
+    { "atomic", arg_type::boolean, false, "true", "Roll back all commands if any fails. Otherwise keep going after errors" }
+};
+static constexpr arg_spec batch_output[] = {
+    { "results", arg_type::array, false, nullptr, "Output of each command run, in order, including its \"echo\", \"error\" or \"exception\"" },
+    { "rolled_back", arg_type::boolean, false, nullptr, "True if a command failed and the batch was rolled back" },
+    { "players_moved", arg_type::array, false, nullptr, "Any player movements from rebalancing after players busted in the batch" }
+};
+static constexpr arg_spec player_input[] = {
+    { "player_id", arg_type::string, true, nullptr, "Player id" }
+};
+static constexpr arg_spec players_moved_output[] = {
+    { "players_moved", arg_type::array, false, nullptr, "Any player movements that have to happen (rebalancing)" }
+};
+static constexpr arg_spec check_authorized_input[] = {
+    { "authenticate", arg_type::integer, true, nullptr, "Authentication code to check" }
+};
+static constexpr arg_spec check_authorized_output[] = {
+    { "authorized", arg_type::boolean, false, nullptr, "True if the code in authenticate is valid for administration" }
+};
+static constexpr arg_spec chips_for_buyin_input[] = {
+    { "source_id", arg_type::count, true, nullptr, "Funding source to calculate for" },
+    { "max_expected_players", arg_type::count, true, nullptr, "Number of players expected in the tournament" }
+};
+static constexpr arg_spec chips_for_buyin_output[] = {
+    { "chips_for_buyin", arg_type::array, false, nullptr, "Quantities for each chip denomination" }
+};
+static constexpr arg_spec configuration[] = {
+    { "name", arg_type::string, false, nullptr, "Human-readable name for this tournament" },
+    { "players", arg_type::array, false, nullptr, "Each player eligible for this tournament" },
+    { "table_capacity", arg_type::count, false, nullptr, "Number of seats per table" },
+    { "table_names", arg_type::array, false, nullptr, "Available table names for display" },
+    { "funding_sources", arg_type::array, false, nullptr, "Each valid source of funding for this tournament" },
+    { "blind_levels", arg_type::array, false, nullptr, "Description of each blind level" },
+    { "available_chips", arg_type::array, false, nullptr, "Description of each chip color and denomination" },
+    { "available_tables", arg_type::array, false, nullptr, "Description of each named table" },
+    { "payout_policy", arg_type::integer, false, nullptr, "Policy for paying out players (0 = automatic, 1 = forced, 2 = depends on turnout)" },
+    { "payout_currency", arg_type::string, false, nullptr, "Currency used for payouts" },
+    { "automatic_payouts", arg_type::object, false, nullptr, "Parameters for automatic payout structure generation: percent_seats_paid, round_payouts, payout_shape, pay_the_bubble, pay_knockouts" },
+    { "forced_payouts", arg_type::array, false, nullptr, "Force this array of payouts, regardless of number of players" },
+    { "manual_payouts", arg_type::array, false, nullptr, "Manual payout definitions: number of players and an array of payouts. If missing, automatic payouts are calculated" },
+    { "previous_blind_level_hold_duration", arg_type::integer, false, nullptr, "How long after a round starts the previous level command goes to the previous round, rather than restarting it (milliseconds)" },
+    { "rebalance_policy", arg_type::integer, false, nullptr, "Policy for rebalancing tables (0 = manual, 1 = when unbalanced, 2 = shootout)" },
+    { "background_color", arg_type::string, false, nullptr, "Suggested clock user interface color" },
+    { "final_table_policy", arg_type::integer, false, nullptr, "Policy for moving players to the final table (0 = fill in, 1 = randomize)" },
+    { "authorized_clients", arg_type::array, false, nullptr, "Authorized remote device codes and names" }
+};
+static constexpr arg_spec gen_blind_levels_input[] = {
+    { "desired_duration", arg_type::integer, true, nullptr, "Desired total tournament length (milliseconds)" },
+    { "level_duration", arg_type::integer, true, nullptr, "Uniform duration of each level (milliseconds)" },
+    { "expected_buyins", arg_type::count, false, "0", "Expected number of buyins" },
+    { "expected_rebuys", arg_type::count, false, "0", "Expected number of rebuys" },
+    { "expected_addons", arg_type::count, false, "0", "Expected number of addons" },
+    { "break_duration", arg_type::integer, false, "0", "Length of a break whenever chips can be colored up (milliseconds). 0 for no breaks" },
+    { "antes", arg_type::integer, false, "0", "Ante type (0 = none, 1 = traditional, 2 = big blind ante)" },
+    { "ante_sb_ratio", arg_type::number, false, "0.2", "Approximate ratio of ante to small blind" }
+};
+static constexpr arg_spec gen_blind_levels_output[] = {
+    { "blind_levels", arg_type::array, false, nullptr, "Generated blind levels" }
+};
+static constexpr arg_spec get_queue_depths_output[] = {
+    { "queue_depths", arg_type::array, false, nullptr, "For each connected client: \"client\" (its connection), and the \"messages\" and \"bytes\" waiting to be sent to it" }
+};
+static constexpr arg_spec get_state_output[] = {
+    { "seats", arg_type::object, false, nullptr, "Seat assignment for each player id" },
+    { "players_finished", arg_type::array, false, nullptr, "Busted player ids in reverse bust out order, no duplicates" },
+    { "bust_history", arg_type::array, false, nullptr, "Busted player ids in bust out order, can contain duplicates due to rebuys" },
+    { "empty_seats", arg_type::array, false, nullptr, "Empty seat assignments" },
+    { "table_count", arg_type::count, false, nullptr, "Number of tables currently playing" },
+    { "buyins", arg_type::array, false, nullptr, "Player ids who are both currently seated and bought in" },
+    { "unique_entries", arg_type::array, false, nullptr, "Player ids who at one point have bought in" },
+    { "entries", arg_type::array, false, nullptr, "Player ids for each buyin or rebuy" },
+    { "payouts", arg_type::array, false, nullptr, "Payout amounts for each place" },
+    { "total_chips", arg_type::count, false, nullptr, "Count of all tournament chips in play" },
+    { "total_cost", arg_type::object, false, nullptr, "Sum total of all buyins, rebuys and addons, for each currency" },
+    { "total_commission", arg_type::object, false, nullptr, "Sum total of all entry fees, for each currency" },
+    { "total_equity", arg_type::number, false, nullptr, "Sum total of all payouts, in configured payout_currency" },
+    { "running", arg_type::boolean, false, nullptr, "True if the tournament is unpaused" },
+    { "current_blind_level", arg_type::count, false, nullptr, "Current blind level. 0 = planning stage" },
+    { "current_time", arg_type::integer, false, nullptr, "Current time since epoch (milliseconds)" },
+    { "time_remaining", arg_type::integer, false, nullptr, "Time remaining in current level (milliseconds)" },
+    { "break_time_remaining", arg_type::integer, false, nullptr, "Time remaining in current break (milliseconds)" },
+    { "action_clock_time_remaining", arg_type::integer, false, nullptr, "Time remaining on action clock (milliseconds)" },
+    { "elapsed_time", arg_type::integer, false, nullptr, "Tournament time elapsed (milliseconds)" }
+};
+static constexpr arg_spec plan_seating_input[] = {
+    { "max_expected_players", arg_type::count, true, nullptr, "Maximum number of players expected" }
+};
+static constexpr arg_spec quick_setup_input[] = {
+    { "source_id", arg_type::count, false, nullptr, "Funding source to use. If not sent, the first one" }
+};
+static constexpr arg_spec quick_setup_output[] = {
+    { "seated_players", arg_type::array, false, nullptr, "All players and their seats" }
+};
+static constexpr arg_spec seat_player_output[] = {
+    { "player_seated", arg_type::object, false, nullptr, "Player, table, and seat" },
+    { "already_seated", arg_type::object, false, nullptr, "Player, table, and seat, instead of player_seated if the player was already seated" }
+};
+static constexpr arg_spec set_action_clock_input[] = {
+    { "duration", arg_type::integer, false, nullptr, "Duration of countdown (milliseconds). If not sent, clears the countdown" }
+};
+static constexpr arg_spec set_broadcast_mode_input[] = {
+    { "mode", arg_type::string, true, nullptr, "\"full\" for the complete state every broadcast (the default for new clients), \"delta\" for sequenced merge patches with periodic keyframes" }
+};
+static constexpr arg_spec set_broadcast_mode_output[] = {
+    { "mode", arg_type::string, false, nullptr, "The mode now in effect" }
+};
+static constexpr arg_spec blind_level_changed_output[] = {
+    { "blind_level_changed", arg_type::boolean, false, nullptr, "True if the blind level actually changed" }
+};
+static constexpr arg_spec fund_player_input[] = {
+    { "player_id", arg_type::string, true, nullptr, "Player to fund" },
+    { "source_id", arg_type::count, true, nullptr, "Chosen funding source" }
+};
+static constexpr arg_spec start_game_input[] = {
+    { "start_at", arg_type::string, false, nullptr, "Time to start the tournament (ISO 8601, UTC). If not sent, now" }
+};
+static constexpr arg_spec subscribe_input[] = {
+    { "topics", arg_type::array, true, nullptr, "Topic names: clock, round, seating, players, results, funding, config. Empty to stop state broadcasts" }
+};
+static constexpr arg_spec subscribe_output[] = {
+    { "topics", arg_type::array, false, nullptr, "The topics now subscribed" }
+};
+static constexpr arg_spec version_output[] = {
+    { "server_name", arg_type::string, false, nullptr, "\"tournamentd\"" },
+    { "server_version", arg_type::string, false, nullptr, "Version of the server's API" }
+};
+
+// typed fields for the arguments handlers read. each fails to compile unless its schema has the argument, with that type
+namespace batch_args
+{
+    constexpr auto commands(make_arg_field<arg_type::array>(batch_input, "commands"));
+    constexpr auto atomic(make_arg_field<arg_type::boolean>(batch_input, "atomic"));
+}
+namespace player_args
+{
+    constexpr auto player_id(make_arg_field<arg_type::string>(player_input, "player_id"));
+}
+namespace chips_for_buyin_args
+{
+    constexpr auto source_id(make_arg_field<arg_type::count>(chips_for_buyin_input, "source_id"));
+    constexpr auto max_expected_players(make_arg_field<arg_type::count>(chips_for_buyin_input, "max_expected_players"));
+}
+namespace gen_blind_levels_args
+{
+    constexpr auto desired_duration(make_arg_field<arg_type::integer>(gen_blind_levels_input, "desired_duration"));
+    constexpr auto level_duration(make_arg_field<arg_type::integer>(gen_blind_levels_input, "level_duration"));
+    constexpr auto expected_buyins(make_arg_field<arg_type::count>(gen_blind_levels_input, "expected_buyins"));
+    constexpr auto expected_rebuys(make_arg_field<arg_type::count>(gen_blind_levels_input, "expected_rebuys"));
+    constexpr auto expected_addons(make_arg_field<arg_type::count>(gen_blind_levels_input, "expected_addons"));
+    constexpr auto break_duration(make_arg_field<arg_type::integer>(gen_blind_levels_input, "break_duration"));
+    constexpr auto antes(make_arg_field<arg_type::integer>(gen_blind_levels_input, "antes"));
+    constexpr auto ante_sb_ratio(make_arg_field<arg_type::number>(gen_blind_levels_input, "ante_sb_ratio"));
+}
+namespace plan_seating_args
+{
+    constexpr auto max_expected_players(make_arg_field<arg_type::count>(plan_seating_input, "max_expected_players"));
+}
+namespace quick_setup_args
+{
+    constexpr auto source_id(make_arg_field<arg_type::count>(quick_setup_input, "source_id"));
+}
+namespace set_action_clock_args
+{
+    constexpr auto duration(make_arg_field<arg_type::integer>(set_action_clock_input, "duration"));
+}
+namespace set_broadcast_mode_args
+{
+    constexpr auto mode(make_arg_field<arg_type::string>(set_broadcast_mode_input, "mode"));
+}
+namespace fund_player_args
+{
+    constexpr auto player_id(make_arg_field<arg_type::string>(fund_player_input, "player_id"));
+    constexpr auto source_id(make_arg_field<arg_type::count>(fund_player_input, "source_id"));
+}
+namespace start_game_args
+{
+    constexpr auto start_at(make_arg_field<arg_type::string>(start_game_input, "start_at"));
+}
+namespace subscribe_args
+{
+    constexpr auto topics(make_arg_field<arg_type::array>(subscribe_input, "topics"));
+}
+
 struct tournament::impl
 {
+    // accepted authorization codes
+    typedef std::unordered_map<int, td::authorized_client> auth_map;
+
+    // game and authorization codes as of a change, published by the game thread for other threads to read. never modified once published
+    struct published_state
+    {
+        // increases with each publication
+        std::uint64_t version {};
+        std::shared_ptr<const gameinfo> game;
+        auth_map auths;
+    };
+
+    // ----- owned by the game thread, which applies commands in order
+
     // game object
     gameinfo game_info;
 
-    // server to handle remote connections
-    server game_server;
-
     // accepted authorization codes
-    std::unordered_map<int, td::authorized_client> game_auths;
+    auth_map game_auths;
 
-    // snapshot path
+    // snapshot path, and where versions before CBOR snapshots left theirs
     std::string snapshot_path;
+    std::string legacy_snapshot_path;
+
+    // writes snapshots without blocking the run loop
+    std::unique_ptr<snapshot_writer> game_snapshot_writer;
+
+    // journal of commands since the last snapshot, and the journal before it, kept until that snapshot is on disk
+    std::string journal_path;
+    std::string previous_journal_path;
+    std::unique_ptr<journal> game_journal;
+
+    // sequence numbers of the last journal entry, the last entry in the previous journal, and the last entry in a snapshot
+    std::uint64_t journal_sequence {};
+    std::uint64_t previous_journal_sequence {};
+    std::uint64_t checkpoint_sequence {};
+    std::chrono::steady_clock::time_point last_checkpoint { std::chrono::steady_clock::now() };
+
+    // replaying the journal: do not journal or broadcast
+    bool replaying { false };
+
+    // next game deadline or display tick, when state is broadcast without a command (epoch if none)
+    std::chrono::system_clock::time_point next_wakeup;
+
+    // set by the last request before the game thread exits
+    bool stopping { false };
+
+    // version of the last publication, and whether anything changed since
+    std::uint64_t published_version {};
+    bool unpublished { false };
+
+    // ----- shared: written by the game thread, read by any. only accessed through std::atomic_load and std::atomic_store
+
+    // latest published state
+    std::shared_ptr<const published_state> published;
+
+    // ----- owned by the I/O thread (the caller of run), which reads and parses commands, and serializes and sends output
+
+    // server to handle remote connections. the game thread only wakes it
+    server game_server;
+
+    // latest state handed over by the game thread, to broadcast or to run a connection command against
+    std::shared_ptr<const published_state> io_state;
+
+    // clients that sent quit or exit, whose further input is ignored until they are disconnected
+    std::unordered_set<server::client_id> quitting;
+
+    // last state document broadcast, for computing patches
+    nlohmann::json last_state;
+
+    // sequence number of the last delta-mode message, and when the last keyframe went out
+    std::uint64_t state_sequence {};
+    std::chrono::steady_clock::time_point last_keyframe;
+    std::chrono::seconds keyframe_interval { DEFAULT_KEYFRAME_INTERVAL };
+
+    // last content broadcast for each topic
+    std::array<nlohmann::json, TOPIC_COUNT> last_topics;
+
+    // full state text, reused between broadcasts when no document is needed
+    std::string state_text;
 
     // ----- auth check
 
-    bool code_authorized(int code) const
+    static bool code_authorized(const auth_map& auths, int code)
+    {
+        return (auths.find(code) != auths.end());
+    }
+
+    static void ensure_authorized(const auth_map& auths, int code)
     {
-        return (this->game_auths.find(code) != this->game_auths.end());
+        if(!code_authorized(auths, code))
+        {
+            throw td::protocol_error("unauthorized");
+        }
     }
 
-    void ensure_authorized(const nlohmann::json& in) const
+    static void ensure_authorized(const auth_map& auths, const command_args& args)
     {
-        if(!this->code_authorized(in.at("authenticate")))
+        if(!args.has_authenticate())
+        {
+            throw td::protocol_error("missing authenticate");
+        }
+
+        auto code(args.authenticate());
+        if(code < std::numeric_limits<int>::min() || code > std::numeric_limits<int>::max())
         {
             throw td::protocol_error("unauthorized");
         }
+        ensure_authorized(auths, static_cast<int>(code));
     }
 
-    std::vector<td::authorized_client> all_auths() const
+    static std::vector<td::authorized_client> all_auths(const auth_map& auths)
     {
-        std::vector<td::authorized_client> auths;
-        auths.reserve(this->game_auths.size());
-        for(const auto& kv : this->game_auths)
+        std::vector<td::authorized_client> ret;
+        ret.reserve(auths.size());
+        for(const auto& kv : auths)
         {
-            auths.push_back(kv.second);
+            ret.push_back(kv.second);
         }
-        return auths;
+        return ret;
     }
 
     void authorize_from_config(const nlohmann::json& in)
@@ -79,857 +540,1607 @@ struct tournament::impl
         }
     }
 
-    // ----- broadcast helpers
+    // ----- broadcast helpers (I/O thread)
+
+    // the latest state handed over by the game thread, as one document
+    nlohmann::json state_document() const
+    {
+        nlohmann::json state;
+        this->io_state->game->dump_state(state);
+        this->io_state->game->dump_configuration_state(state);
+        this->io_state->game->dump_derived_state(state);
+        return state;
+    }
+
+    // serialize the latest state handed over by the game thread and send it to subscribed clients
+    void broadcast_state()
+    {
+        // with only full-mode clients, nothing needs the document: write the text straight into a reused buffer
+        if(!this->game_server.has_subscribers(CHANNEL_DELTA_STATE) && !this->game_server.has_subscribers(CHANNEL_ALL_TOPICS))
+        {
+            if(this->game_server.has_subscribers(CHANNEL_FULL_STATE))
+            {
+                this->state_text.clear();
+                json_writer writer(this->state_text);
+                this->io_state->game->write_state(writer);
+                this->game_server.broadcast(this->state_text, CHANNEL_FULL_STATE);
+            }
+
+            // delta and topic streams start again from a keyframe
+            this->last_state = nullptr;
+            this->last_topics.fill(nullptr);
+            return;
+        }
+
+        auto bcast(this->state_document());
+
+        // full-mode clients get the whole document every time
+        if(this->game_server.has_subscribers(CHANNEL_FULL_STATE))
+        {
+            this->game_server.broadcast(bcast.dump(), CHANNEL_FULL_STATE);
+        }
+
+        // delta-mode clients get a merge patch against the previous document, or a periodic keyframe
+        if(this->game_server.has_subscribers(CHANNEL_DELTA_STATE))
+        {
+            auto now(std::chrono::steady_clock::now());
+            if(this->last_state.is_null() || now - this->last_keyframe >= this->keyframe_interval)
+            {
+                this->last_keyframe = now;
+                nlohmann::json keyframe { { "seq", ++this->state_sequence }, { "keyframe", bcast } };
+                this->game_server.broadcast(keyframe.dump(), CHANNEL_DELTA_STATE, true);
+            }
+            else
+            {
+                auto patch(create_merge_patch(this->last_state, bcast));
+                if(!patch.empty())
+                {
+                    nlohmann::json delta { { "seq", ++this->state_sequence }, { "patch", std::move(patch) } };
+                    this->game_server.broadcast(delta.dump(), CHANNEL_DELTA_STATE, false);
+                }
+            }
+        }
+
+        // topic subscribers get each topic that changed, serialized once
+        if(this->game_server.has_subscribers(CHANNEL_ALL_TOPICS))
+        {
+            auto sections(split_topics(bcast));
+            for(std::size_t i(0); i < TOPIC_COUNT; i++)
+            {
+                if(!this->game_server.has_subscribers(topic_channel(i)))
+                {
+                    this->last_topics[i] = nullptr;
+                }
+                else if(sections[i] != this->last_topics[i])
+                {
+                    nlohmann::json message { { "topic", TOPIC_NAMES[i] }, { "state", sections[i] } };
+                    this->game_server.broadcast(message.dump(), topic_channel(i));
+                    this->last_topics[i] = std::move(sections[i]);
+                }
+            }
+        }
+        else
+        {
+            this->last_topics.fill(nullptr);
+        }
+
+        this->last_state = std::move(bcast);
+    }
+
+    // send one client a keyframe of the current state, in sequence with the delta stream
+    void send_keyframe(server::client_id client)
+    {
+        // bring the delta stream up to date first, so the next patch applies to this keyframe. only delta clients need the patch
+        auto state(this->state_document());
+        if(!this->last_state.is_null() && this->game_server.has_subscribers(CHANNEL_DELTA_STATE))
+        {
+            auto patch(create_merge_patch(this->last_state, state));
+            if(!patch.empty())
+            {
+                nlohmann::json delta { { "seq", ++this->state_sequence }, { "patch", std::move(patch) } };
+                this->game_server.broadcast(delta.dump(), CHANNEL_DELTA_STATE, false);
+            }
+        }
+        this->last_state = std::move(state);
+
+        nlohmann::json keyframe { { "seq", this->state_sequence }, { "keyframe", this->last_state } };
+        this->game_server.send(client, keyframe.dump(), CHANNEL_DELTA_STATE, true);
+    }
+
+    // send one client the current content of each of the given topics
+    void send_topics(server::client_id client, const nlohmann::json& state, server::channel_mask channels)
+    {
+        auto sections(split_topics(state));
+        for(std::size_t i(0); i < TOPIC_COUNT; i++)
+        {
+            if(channels & topic_channel(i))
+            {
+                nlohmann::json message { { "topic", TOPIC_NAMES[i] }, { "state", sections[i] } };
+                this->game_server.send(client, message.dump(), topic_channel(i));
+            }
+        }
+    }
+
+    // ----- read-only command handlers, run against the game on the game thread (in a batch), or against published state on a worker
+
+    static void handle_cmd_version(nlohmann::json& out)
+    {
+        out["server_name"] = "tournamentd";
+        out["server_version"] = "0.0.9";
+    }
+
+    static void handle_cmd_get_config(const gameinfo& game, const auth_map& auths, nlohmann::json& out)
+    {
+        // pass auth codes back into output
+        out["authorized_clients"] = all_auths(auths);
+        game.dump_configuration(out);
+    }
+
+    static void handle_cmd_get_state(const gameinfo& game, nlohmann::json& out)
+    {
+        game.dump_state(out);
+        game.dump_configuration_state(out);
+        game.dump_derived_state(out);
+    }
+
+    static void handle_cmd_check_authorized(const auth_map& auths, const command_args& args, nlohmann::json& out)
+    {
+        if(!args.has_authenticate())
+        {
+            throw td::protocol_error("missing authenticate");
+        }
+        auto code(args.authenticate());
+        auto authorized(code >= std::numeric_limits<int>::min() && code <= std::numeric_limits<int>::max() && code_authorized(auths, static_cast<int>(code)));
+        logger(ll::debug) << "code " << code << " is " << (authorized ? "authorized\n" : "not authorized\n");
+        out["authorized"] = authorized;
+    }
+
+    static void handle_cmd_chips_for_buyin(const gameinfo& game, const command_args& args, nlohmann::json& out)
+    {
+        auto chips(game.chips_for_buyin(args.get(chips_for_buyin_args::source_id), args.get(chips_for_buyin_args::max_expected_players)));
+        out["chips_for_buyin"] = chips;
+    }
+
+    // ----- command handlers for how a client is sent state, run on the I/O thread
+
+    void handle_cmd_set_broadcast_mode(server::client_id client, const command_args& args, nlohmann::json& out)
+    {
+        const auto& mode(args.get(set_broadcast_mode_args::mode));
+        auto channels(this->game_server.subscriptions(client) & ~CHANNEL_ALL_STATE);
+        if(mode == "full")
+        {
+            this->game_server.subscribe(client, channels | CHANNEL_FULL_STATE);
+        }
+        else if(mode == "delta")
+        {
+            // keyframe first, then the client joins the delta stream
+            this->game_server.subscribe(client, channels);
+            this->send_keyframe(client);
+            this->game_server.subscribe(client, channels | CHANNEL_DELTA_STATE);
+        }
+        else
+        {
+            throw td::protocol_error("unknown broadcast mode");
+        }
+        out["mode"] = mode;
+    }
+
+    void handle_cmd_subscribe(server::client_id client, const command_args& args, nlohmann::json& out)
+    {
+        // validate topics
+        server::channel_mask channels(0);
+        for(const auto& name : args.get(subscribe_args::topics))
+        {
+            auto it(name.is_string() ? std::find(std::begin(TOPIC_NAMES), std::end(TOPIC_NAMES), name.get_ref<const std::string&>()) : std::end(TOPIC_NAMES));
+            if(it == std::end(TOPIC_NAMES))
+            {
+                throw td::protocol_error("unknown topic");
+            }
+            auto topic(static_cast<std::size_t>(it - std::begin(TOPIC_NAMES)));
+            channels |= topic_channel(topic);
+        }
+
+        // topics replace any other state broadcasts
+        this->game_server.subscribe(client, (this->game_server.subscriptions(client) & ~CHANNEL_ALL_STATE) | channels);
+
+        // send current content of each topic right away
+        if(channels != 0)
+        {
+            this->send_topics(client, this->state_document(), channels);
+        }
+
+        out["topics"] = args.get(subscribe_args::topics);
+    }
+
+    // resend current state to this client only, in whatever form it is subscribed to
+    void handle_cmd_resync(server::client_id client, nlohmann::json& /* out */)
+    {
+        auto channels(this->game_server.subscriptions(client));
+        if(channels & CHANNEL_DELTA_STATE)
+        {
+            this->send_keyframe(client);
+        }
+        if(channels & CHANNEL_FULL_STATE)
+        {
+            std::string text;
+            json_writer writer(text);
+            this->io_state->game->write_state(writer);
+            this->game_server.send(client, std::move(text), CHANNEL_FULL_STATE);
+        }
+        if(channels & CHANNEL_ALL_TOPICS)
+        {
+            this->send_topics(client, this->state_document(), channels);
+        }
+    }
+
+    void handle_cmd_get_queue_depths(nlohmann::json& out) const
+    {
+        auto depths(nlohmann::json::array());
+        for(const auto& depth : this->game_server.queue_depths())
+        {
+            depths.push_back({ { "client", depth.client }, { "messages", depth.messages }, { "bytes", depth.bytes } });
+        }
+        out["queue_depths"] = std::move(depths);
+    }
+
+    // ----- command handlers available to authorized clients
+
+    void handle_cmd_configure(const command_args& args, nlohmann::json& out)
+    {
+        // handle auth codes. game_info doesn't handle these
+        this->authorize_from_config(args.input());
+
+        // pass auth codes back into output
+        out["authorized_clients"] = all_auths(this->game_auths);
+
+        // configure
+        this->game_info.configure(args.input());
+        this->game_info.dump_configuration(out);
+    }
+
+    void handle_cmd_start_game(const command_args& args, nlohmann::json& /* out */)
+    {
+        if(args.has(start_game_args::start_at))
+        {
+            this->game_info.start(datetime::from_gm(args.get(start_game_args::start_at)));
+        }
+        else
+        {
+            this->game_info.start();
+        }
+    }
+
+    void handle_cmd_stop_game(nlohmann::json& /* out */)
+    {
+        this->game_info.stop();
+    }
+
+    void handle_cmd_resume_game(nlohmann::json& /* out */)
+    {
+        this->game_info.resume();
+    }
+
+    void handle_cmd_pause_game(nlohmann::json& /* out */)
+    {
+        this->game_info.pause();
+    }
+
+    void handle_cmd_toggle_pause_game(nlohmann::json& /* out */)
+    {
+        this->game_info.toggle_pause_resume();
+    }
+
+    void handle_cmd_set_previous_level(nlohmann::json& out)
+    {
+        auto blind_level_changed(this->game_info.previous_blind_level());
+        out["blind_level_changed"] = blind_level_changed;
+    }
+
+    void handle_cmd_set_next_level(nlohmann::json& out)
+    {
+        auto blind_level_changed(this->game_info.next_blind_level());
+        out["blind_level_changed"] = blind_level_changed;
+    }
+
+    void handle_cmd_set_action_clock(const command_args& args, nlohmann::json& /* out */)
+    {
+        if(args.has(set_action_clock_args::duration))
+        {
+            this->game_info.set_action_clock(static_cast<long>(args.get(set_action_clock_args::duration)));
+        }
+        else
+        {
+            this->game_info.reset_action_clock();
+        }
+    }
+
+    static void handle_cmd_gen_blind_levels(const gameinfo& game, const command_args& args, nlohmann::json& out)
+    {
+        auto antes(args.get(gen_blind_levels_args::antes));
+        if(antes < static_cast<std::int64_t>(td::ante_type_t::none) || antes > static_cast<std::int64_t>(td::ante_type_t::bba))
+        {
+            throw td::protocol_error("unknown ante type");
+        }
+
+        auto levels(game.gen_blind_levels(static_cast<long>(args.get(gen_blind_levels_args::desired_duration)),
+                                          static_cast<long>(args.get(gen_blind_levels_args::level_duration)),
+                                          args.get(gen_blind_levels_args::expected_buyins),
+                                          args.get(gen_blind_levels_args::expected_rebuys),
+                                          args.get(gen_blind_levels_args::expected_addons),
+                                          static_cast<long>(args.get(gen_blind_levels_args::break_duration)),
+                                          static_cast<td::ante_type_t>(antes),
+                                          args.get(gen_blind_levels_args::ante_sb_ratio)));
+        out["blind_levels"] = levels;
+    }
+
+    void handle_cmd_reset_state(nlohmann::json& /* out */)
+    {
+        this->game_info.reset_state();
+    }
+
+    void handle_cmd_fund_player(const command_args& args, nlohmann::json& /* out */)
+    {
+        this->game_info.fund_player(args.get(fund_player_args::player_id), args.get(fund_player_args::source_id));
+    }
+
+    void handle_cmd_plan_seating(const command_args& args, nlohmann::json& out)
+    {
+        auto movements(this->game_info.plan_seating(args.get(plan_seating_args::max_expected_players)));
+        out["players_moved"] = movements;
+    }
+
+    void handle_cmd_seat_player(const command_args& args, nlohmann::json& out)
+    {
+        auto seating(this->game_info.add_player(args.get(player_args::player_id)));
+        out[seating.first] = seating.second;
+    }
+
+    void handle_cmd_unseat_player(const command_args& args, nlohmann::json& /* out */)
+    {
+        this->game_info.remove_player(args.get(player_args::player_id));
+    }
+
+    void handle_cmd_bust_player(const command_args& args, nlohmann::json& out)
+    {
+        auto movements(this->game_info.bust_player(args.get(player_args::player_id)));
+        out["players_moved"] = movements;
+    }
+
+    void handle_cmd_rebalance_seating(nlohmann::json& out)
+    {
+        auto movements(this->game_info.rebalance_seating());
+        out["players_moved"] = movements;
+    }
+
+    void handle_cmd_quick_setup(const command_args& args, nlohmann::json& out)
+    {
+        std::vector<td::seated_player> seated_players;
+
+        if(args.has(quick_setup_args::source_id))
+        {
+            seated_players = this->game_info.quick_setup(args.get(quick_setup_args::source_id));
+        }
+        else
+        {
+            seated_players = this->game_info.quick_setup();
+        }
+        out["seated_players"] = seated_players;
+    }
+
+    // ----- command table
+
+    // command properties
+    enum command_flag : unsigned
+    {
+        // client must send an authorized code in "authenticate"
+        command_requires_auth = 1U << 0,
+
+        // command changes game state
+        command_mutates = 1U << 1,
+
+        // state is broadcast to all clients after the command succeeds
+        command_broadcasts = 1U << 2,
+
+        // client is disconnected (no handler)
+        command_disconnects = 1U << 3,
+
+        // command may not be part of a batch
+        command_unbatchable = 1U << 4,
+
+        // handler gets the whole input object, not just the arguments in its schema
+        command_keeps_input = 1U << 5,
+
+        // handler runs on the I/O thread, which owns client subscriptions, against the state as of the command
+        command_on_io_thread = 1U << 6,
+
+        // query that may compute for a long time: answered on its own workers, and its response sent when ready, not in order
+        command_async = 1U << 7
+    };
+
+    // command handler, given the client sending the command, its parsed arguments and output
+    typedef void (*command_handler)(impl& self, server::client_id client, const command_args& args, nlohmann::json& out);
+
+    // handler for a command that only reads, given the game and authorization codes to read
+    typedef void (*query_handler)(const gameinfo& game, const auth_map& auths, const command_args& args, nlohmann::json& out);
+
+    // a command has a handler or a query handler (or neither, if it disconnects). queries are answered off the game thread
+    struct command
+    {
+        const char* name;
+        unsigned flags;
+        const char* purpose;
+        arg_list input;
+        arg_list output;
+        command_handler handler;
+        query_handler query;
+    };
+
+    // all commands, sorted by name, with their schemas. tournamentd.md is generated from them
+    static std::pair<const command*, const command*> all_commands()
+    {
+        static const arg_list no_args { nullptr, nullptr };
+
+        static const command commands[] =
+        {
+            { "batch", command_mutates | command_unbatchable, "Run several commands as one transaction, with a single rebalance and a single state broadcast at the end", make_arg_list(batch_input), make_arg_list(batch_output), [](impl& self, server::client_id client, const command_args& args, nlohmann::json& out)
+            {
+                self.handle_cmd_batch(client, args, out);
+            }, nullptr },
+            { "bust_player", command_requires_auth | command_mutates | command_broadcasts, "Bust a player out of the tournament", make_arg_list(player_input), make_arg_list(players_moved_output), [](impl& self, server::client_id /* client */, const command_args& args, nlohmann::json& out)
+            {
+                self.handle_cmd_bust_player(args, out);
+            }, nullptr },
+            { "check_authorized", 0, "Check whether a code is authorized to administer the tournament", make_arg_list(check_authorized_input), make_arg_list(check_authorized_output), nullptr, [](const gameinfo& /* game */, const auth_map& auths, const command_args& args, nlohmann::json& out)
+            {
+                handle_cmd_check_authorized(auths, args, out);
+            } },
+            { "chips_for_buyin", command_async, "Given configured chip set and expected number of players, calculate the quantity of each chip needed for starting stack", make_arg_list(chips_for_buyin_input), make_arg_list(chips_for_buyin_output), nullptr, [](const gameinfo& game, const auth_map& /* auths */, const command_args& args, nlohmann::json& out)
+            {
+                handle_cmd_chips_for_buyin(game, args, out);
+            } },
+            { "configure", command_requires_auth | command_mutates | command_broadcasts | command_keeps_input, "Load a configuration into the tournament", make_arg_list(configuration), make_arg_list(configuration), [](impl& self, server::client_id /* client */, const command_args& args, nlohmann::json& out)
+            {
+                self.handle_cmd_configure(args, out);
+            }, nullptr },
+            { "exit", command_disconnects | command_unbatchable, "Disconnect client cleanly (same as quit)", no_args, no_args, nullptr, nullptr },
+            { "fund_player", command_requires_auth | command_mutates | command_broadcasts, "Accept a buyin, rebuy, or addon for a player", make_arg_list(fund_player_input), no_args, [](impl& self, server::client_id /* client */, const command_args& args, nlohmann::json& out)
+            {
+                self.handle_cmd_fund_player(args, out);
+            }, nullptr },
+            { "gen_blind_levels", command_requires_auth | command_async, "Generate progressive blind levels, given available chip denominations", make_arg_list(gen_blind_levels_input), make_arg_list(gen_blind_levels_output), nullptr, [](const gameinfo& game, const auth_map& /* auths */, const command_args& args, nlohmann::json& out)
+            {
+                handle_cmd_gen_blind_levels(game, args, out);
+            } },
+            { "get_config", command_requires_auth, "Dump the server's current configuration", no_args, make_arg_list(configuration), nullptr, [](const gameinfo& game, const auth_map& auths, const command_args& /* args */, nlohmann::json& out)
+            {
+                handle_cmd_get_config(game, auths, out);
+            } },
+            { "get_queue_depths", command_on_io_thread | command_unbatchable, "Report how much output is waiting to be sent to each client, for monitoring. A client with over 1 MB waiting for 30 seconds, or over 16 MB at once, is disconnected", no_args, make_arg_list(get_queue_depths_output), [](impl& self, server::client_id /* client */, const command_args& /* args */, nlohmann::json& out)
+            {
+                self.handle_cmd_get_queue_depths(out);
+            }, nullptr },
+            { "get_state", 0, "Dump the server's current game state", no_args, make_arg_list(get_state_output), nullptr, [](const gameinfo& game, const auth_map& /* auths */, const command_args& /* args */, nlohmann::json& out)
+            {
+                handle_cmd_get_state(game, out);
+            } },
+            { "pause_game", command_requires_auth | command_mutates | command_broadcasts, "Pause the tournament", no_args, no_args, [](impl& self, server::client_id /* client */, const command_args& /* args */, nlohmann::json& out)
+            {
+                self.handle_cmd_pause_game(out);
+            }, nullptr },
+            { "plan_seating", command_requires_auth | command_mutates | command_broadcasts, "Generate an empty, random seating plan, given number of players", make_arg_list(plan_seating_input), make_arg_list(players_moved_output), [](impl& self, server::client_id /* client */, const command_args& args, nlohmann::json& out)
+            {
+                self.handle_cmd_plan_seating(args, out);
+            }, nullptr },
+            { "quick_setup", command_requires_auth | command_mutates | command_broadcasts, "Quickly get a game going. Plan for all players in roster, seat all players and buy them in", make_arg_list(quick_setup_input), make_arg_list(quick_setup_output), [](impl& self, server::client_id /* client */, const command_args& args, nlohmann::json& out)
+            {
+                self.handle_cmd_quick_setup(args, out);
+            }, nullptr },
+            { "quit", command_disconnects | command_unbatchable, "Disconnect client cleanly (same as exit)", no_args, no_args, nullptr, nullptr },
+            { "rebalance_seating", command_requires_auth | command_mutates | command_broadcasts, "Manually try to break and rebalance tables", no_args, make_arg_list(players_moved_output), [](impl& self, server::client_id /* client */, const command_args& /* args */, nlohmann::json& out)
+            {
+                self.handle_cmd_rebalance_seating(out);
+            }, nullptr },
+            { "reset_state", command_requires_auth | command_mutates | command_broadcasts, "Reset all game state to no results, seating, or funding, and stop the clock", no_args, no_args, [](impl& self, server::client_id /* client */, const command_args& /* args */, nlohmann::json& out)
+            {
+                self.handle_cmd_reset_state(out);
+            }, nullptr },
+            { "resume_game", command_requires_auth | command_mutates | command_broadcasts, "Resume a paused tournament", no_args, no_args, [](impl& self, server::client_id /* client */, const command_args& /* args */, nlohmann::json& out)
+            {
+                self.handle_cmd_resume_game(out);
+            }, nullptr },
+            { "resync", command_on_io_thread | command_unbatchable, "Request a keyframe of the current state, e.g. after detecting a gap in delta sequence numbers", no_args, no_args, [](impl& self, server::client_id client, const command_args& /* args */, nlohmann::json& out)
+            {
+                self.handle_cmd_resync(client, out);
+            }, nullptr },
+            { "seat_player", command_requires_auth | command_mutates | command_broadcasts, "Seat a player in the next available seat", make_arg_list(player_input), make_arg_list(seat_player_output), [](impl& self, server::client_id /* client */, const command_args& args, nlohmann::json& out)
+            {
+                self.handle_cmd_seat_player(args, out);
+            }, nullptr },
+            { "set_action_clock", command_requires_auth | command_mutates | command_broadcasts, "Call the clock on a player, starting a countdown timer", make_arg_list(set_action_clock_input), no_args, [](impl& self, server::client_id /* client */, const command_args& args, nlohmann::json& out)
+            {
+                self.handle_cmd_set_action_clock(args, out);
+            }, nullptr },
+            { "set_broadcast_mode", command_on_io_thread | command_unbatchable, "Choose how this client receives state broadcasts. In delta mode, the client is sent a keyframe immediately, then merge patches", make_arg_list(set_broadcast_mode_input), make_arg_list(set_broadcast_mode_output), [](impl& self, server::client_id client, const command_args& args, nlohmann::json& out)
+            {
+                self.handle_cmd_set_broadcast_mode(client, args, out);
+            }, nullptr },
+            { "set_next_level", command_requires_auth | command_mutates | command_broadcasts, "Set the tournament forward one level (unless tournament is in the last round)", no_args, make_arg_list(blind_level_changed_output), [](impl& self, server::client_id /* client */, const command_args& /* args */, nlohmann::json& out)
+            {
+                self.handle_cmd_set_next_level(out);
+            }, nullptr },
+            { "set_previous_level", command_requires_auth | command_mutates | command_broadcasts, "Set the tournament back one level (unless tournament is in the first round, or it's been <2 seconds since set back)", no_args, make_arg_list(blind_level_changed_output), [](impl& self, server::client_id /* client */, const command_args& /* args */, nlohmann::json& out)
+            {
+                self.handle_cmd_set_previous_level(out);
+            }, nullptr },
+            { "start_game", command_requires_auth | command_mutates | command_broadcasts, "Start the tournament", make_arg_list(start_game_input), no_args, [](impl& self, server::client_id /* client */, const command_args& args, nlohmann::json& out)
+            {
+                self.handle_cmd_start_game(args, out);
+            }, nullptr },
+            { "stop_game", command_requires_auth | command_mutates | command_broadcasts, "Stop the tournament", no_args, no_args, [](impl& self, server::client_id /* client */, const command_args& /* args */, nlohmann::json& out)
+            {
+                self.handle_cmd_stop_game(out);
+            }, nullptr },
+            { "subscribe", command_on_io_thread | command_unbatchable, "Receive only the given topics of the state, each sent right away and then whenever it changes. Replaces full or delta broadcasts", make_arg_list(subscribe_input), make_arg_list(subscribe_output), [](impl& self, server::client_id client, const command_args& args, nlohmann::json& out)
+            {
+                self.handle_cmd_subscribe(client, args, out);
+            }, nullptr },
+            { "toggle_pause_game", command_requires_auth | command_mutates | command_broadcasts, "Pause the tournament if running, unpause if not", no_args, no_args, [](impl& self, server::client_id /* client */, const command_args& /* args */, nlohmann::json& out)
+            {
+                self.handle_cmd_toggle_pause_game(out);
+            }, nullptr },
+            { "unseat_player", command_requires_auth | command_mutates | command_broadcasts, "Unseat a player without busting them (as if the player was never in)", make_arg_list(player_input), no_args, [](impl& self, server::client_id /* client */, const command_args& args, nlohmann::json& out)
+            {
+                self.handle_cmd_unseat_player(args, out);
+            }, nullptr },
+            { "version", 0, "Dump the server's version info", no_args, make_arg_list(version_output), nullptr, [](const gameinfo& /* game */, const auth_map& /* auths */, const command_args& /* args */, nlohmann::json& out)
+            {
+                handle_cmd_version(out);
+            } }
+        };
+
+        assert(std::is_sorted(std::begin(commands), std::end(commands), [](const command& a, const command& b) { return std::string(a.name) < b.name; }));
+        assert(std::all_of(std::begin(commands), std::end(commands), [](const command& c) { return !(c.flags & command_async) || c.query != nullptr; }));
+        return std::make_pair(std::begin(commands), std::end(commands));
+    }
+
+    // look up a command by name, ignoring case, returning nullptr if unknown
+    static const command* find_command(const char* name, std::size_t size)
+    {
+        auto commands(all_commands());
+        auto less([size](const command& c, const char* n)
+        {
+            return compare_command(n, size, c.name) > 0;
+        });
+
+        auto it(std::lower_bound(commands.first, commands.second, name, less));
+        if(it == commands.second || compare_command(name, size, it->name) != 0)
+        {
+            return nullptr;
+        }
+        return it;
+    }
+
+    // utility: write one argument or output field of a command reference
+    static void write_arg_reference(std::ostream& os, const arg_spec& spec, bool input)
+    {
+        os << '`' << spec.name << "` (" << arg_type_name(spec.type);
+        if(input)
+        {
+            if(spec.required)
+            {
+                os << ", required";
+            }
+            else if(spec.default_value != nullptr)
+            {
+                os << ", default " << spec.default_value;
+            }
+            else
+            {
+                os << ", optional";
+            }
+        }
+        os << "): " << spec.description << '\n';
+    }
+
+    // markdown list of all commands, their arguments and output
+    static void write_command_reference(std::ostream& os)
+    {
+        auto commands(all_commands());
+        for(auto cmd(commands.first); cmd != commands.second; ++cmd)
+        {
+            os << "- **" << cmd->name << "**: " << cmd->purpose;
+            if(cmd->flags & command_requires_auth)
+            {
+                os << ". Requires authorization";
+            }
+            else if(cmd->flags & command_unbatchable)
+            {
+                os << ". Not allowed in a batch";
+            }
+            if(cmd->flags & command_async)
+            {
+                os << ". Answered asynchronously: the response may follow those to later commands, so match it by `echo`";
+            }
+            os << '\n';
+
+            if(cmd->flags & command_requires_auth)
+            {
+                os << "  - `authenticate` (integer, required): Valid authentication code for a tournament admin\n";
+            }
+            for(auto spec(cmd->input.first); spec != cmd->input.last; ++spec)
+            {
+                os << "  - ";
+                write_arg_reference(os, *spec, true);
+            }
+            for(auto spec(cmd->output.first); spec != cmd->output.last; ++spec)
+            {
+                os << "  - Output: ";
+                write_arg_reference(os, *spec, false);
+            }
+        }
+    }
+
+    // ----- handing work between threads
+
+    // a command line parsed on the I/O thread, or work from the tournament's own API, for the game thread or a query worker
+    struct request
+    {
+        server::client_id client {};
+
+        // numbered in the order its client sent it, so responses go out in that order
+        std::uint64_t sequence {};
+
+        const command* cmd {};
+        command_args args;
+        bool parsed {};
+
+        // the command line as sent, to journal, if the command mutates
+        std::string line;
+
+        // instead of a command, run this. called is resolved by it, or failed if the game thread stops first
+        std::function<void()> call;
+        std::shared_ptr<std::promise<void>> called;
+    };
+
+    // what the game thread and query workers hand back to the I/O thread
+    enum class result_kind
+    {
+        // response to a command, to serialize and send to its client
+        response,
+
+        // state to serialize and broadcast
+        state,
+
+        // a command to run on the I/O thread, against the given state
+        connection,
+
+        // client to disconnect once its responses are sent
+        disconnect,
+
+        // the game thread stopped on an exception, to rethrow from run()
+        failure
+    };
+
+    struct result
+    {
+        result_kind kind { result_kind::response };
+        server::client_id client {};
+        std::uint64_t sequence {};
+
+        // response to an asynchronous command, sent as soon as it arrives
+        bool unordered {};
+
+        nlohmann::json out;
+        std::shared_ptr<const published_state> state;
+        std::unique_ptr<request> forwarded;
+        std::exception_ptr failure;
+    };
+
+    // commands from one client not yet answered. I/O thread
+    struct client_queue
+    {
+        // sequence numbers of the next command to arrive, and the next response to send
+        std::uint64_t next_request {};
+        std::uint64_t next_response {};
+
+        // commands numbered below this went to the game thread. until they are answered, queries follow them there, to see their effects
+        std::uint64_t game_until {};
+
+        // responses that arrived before an earlier one
+        std::map<std::uint64_t, result> held;
+
+        // asynchronous commands not yet answered. these are not numbered
+        std::size_t unordered {};
+
+        // quit once those are answered
+        bool closing {};
+    };
+
+    // only clients with commands in flight have a queue. I/O thread
+    std::unordered_map<server::client_id, client_queue> client_queues;
+
+    // I/O thread to game thread, and back. whoever hands anything back wakes the server's poll
+    mpsc_queue<request> requests;
+    mpsc_queue<result> results;
+
+    // applies requests and keeps the clock. started once the journal is replayed
+    std::thread game_thread;
+
+    // set once the game thread has stopped, with its exception if it failed. calls fail from then on instead of waiting
+    std::mutex game_mutex;
+    bool game_stopped { false };
+    std::exception_ptr game_failure;
+
+    // answer read-only commands from published state, and separately those that may take long. declared after everything their jobs use, so they finish them first
+    worker_pool query_workers { QUERY_THREADS };
+    worker_pool compute_workers { COMPUTE_THREADS };
+
+    // hand a result to the I/O thread. game thread or query worker
+    void post(result&& r)
+    {
+        this->results.push(std::move(r));
+        this->game_server.wake();
+    }
+
+    // publish a copy of the game and authorization codes, for threads other than the game thread to read. game thread
+    std::shared_ptr<const published_state> publish()
+    {
+        std::shared_ptr<published_state> state(std::make_shared<published_state>());
+        state->version = ++this->published_version;
+        state->game = this->game_info.snapshot();
+        state->auths = this->game_auths;
+
+        std::shared_ptr<const published_state> ret(std::move(state));
+        std::atomic_store(&this->published, ret);
+        this->unpublished = false;
+        return ret;
+    }
+
+    // publish, and hand the I/O thread the published state to serialize and broadcast. game thread
+    void publish_state()
+    {
+        if(this->replaying)
+        {
+            return;
+        }
+
+        result r;
+        r.kind = result_kind::state;
+        r.state = this->publish();
+        this->post(std::move(r));
+    }
+
+    // answer a read-only command from published state on a worker, handing back its response. any thread
+    void post_query(std::shared_ptr<const published_state> state, request&& req)
+    {
+        auto async((req.cmd->flags & command_async) != 0);
+        std::shared_ptr<request> query(std::make_shared<request>(std::move(req)));
+        (async ? this->compute_workers : this->query_workers).post([this, state, query, async]()
+        {
+            result r;
+            r.client = query->client;
+            r.sequence = query->sequence;
+            r.unordered = async;
+            run_query(*state, *query, r.out);
+            this->post(std::move(r));
+        });
+    }
+
+    // run a function on the game thread, in order with commands, and wait for it to run and its changes to be published
+    // inline if the game thread is not running
+    void call(const std::function<void()>& fn)
+    {
+        if(!this->game_thread.joinable())
+        {
+            fn();
+            this->publish();
+            return;
+        }
+
+        std::shared_ptr<std::promise<void>> done(std::make_shared<std::promise<void>>());
+        request req;
+        req.called = done;
+        req.call = [this, &fn, done]()
+        {
+            // if it fails part way, the run loop publishes what it changed
+            this->unpublished = true;
+            try
+            {
+                fn();
+                this->publish();
+                done->set_value();
+            }
+            catch(...)
+            {
+                done->set_exception(std::current_exception());
+            }
+        };
+
+        {
+            // a stopped game thread would never run it
+            std::lock_guard<std::mutex> lock(this->game_mutex);
+            if(this->game_stopped)
+            {
+                if(this->game_failure)
+                {
+                    std::rethrow_exception(this->game_failure);
+                }
+                throw std::runtime_error("game thread stopped");
+            }
+            this->requests.push(std::move(req));
+        }
+        done->get_future().get();
+    }
+
+    // run a command's handler, or its query handler against the live game
+    void run_handler(const command& cmd, server::client_id client, const command_args& args, nlohmann::json& out)
+    {
+        if(cmd.query != nullptr)
+        {
+            cmd.query(this->game_info, this->game_auths, args, out);
+        }
+        else
+        {
+            cmd.handler(*this, client, args, out);
+        }
+    }
+
+    // check authorization and run a command, without broadcasting
+    void execute(const command& cmd, server::client_id client, const command_args& args, nlohmann::json& out)
+    {
+        if(cmd.flags & command_requires_auth)
+        {
+            ensure_authorized(this->game_auths, args);
+        }
+        this->run_handler(cmd, client, args, out);
+    }
+
+    void handle_cmd_batch(server::client_id client, const command_args& batch, nlohmann::json& out)
+    {
+        const auto& commands(batch.get(batch_args::commands));
+        auto atomic(batch.get(batch_args::atomic));
+        auto broadcast(false);
+        auto results(nlohmann::json::array());
+
+        // authorized codes are kept outside gameinfo, so they are saved here to roll back to
+        auth_map saved_auths;
+        if(atomic)
+        {
+            saved_auths = this->game_auths;
+        }
+
+        this->game_info.begin_batch(atomic);
+        for(const auto& item : commands)
+        {
+            // each command gets its own output, echo and errors
+            nlohmann::json result;
+            try
+            {
+                auto name_it(item.is_object() ? item.find("command") : item.end());
+                auto cmd(name_it != item.end() && name_it->is_string() ? find_command(name_it->get_ref<const std::string&>().data(), name_it->get_ref<const std::string&>().size()) : nullptr);
+
+                command_args args;
+                auto parsed(args.parse(cmd != nullptr ? cmd->input : arg_list {}, cmd != nullptr && (cmd->flags & command_keeps_input), item));
+                if(args.has_echo())
+                {
+                    result["echo"] = args.echo();
+                }
+
+                if(cmd == nullptr)
+                {
+                    throw td::protocol_error("unknown command");
+                }
+                if(cmd->flags & command_unbatchable)
+                {
+                    throw td::protocol_error("command not allowed in batch");
+                }
+                if(!parsed)
+                {
+                    throw td::protocol_error(args.error().c_str());
+                }
+
+                // commands use the batch's authentication unless they send their own
+                if(batch.has_authenticate() && !args.has_authenticate())
+                {
+                    args.set_authenticate(batch.authenticate());
+                }
+
+                this->execute(*cmd, client, args, result);
+                broadcast = broadcast || (cmd->flags & command_broadcasts);
+            }
+            catch(const td::protocol_error& e)
+            {
+                result["error"] = e.what();
+            }
+            catch(const std::exception& e)
+            {
+                result["exception"] = e.what();
+            }
+
+            auto failed(result.find("error") != result.end() || result.find("exception") != result.end());
+            results.push_back(std::move(result));
+
+            if(failed && atomic)
+            {
+                logger(ll::warning) << "batch command " << results.size() << " failed, rolling back\n";
+                this->game_info.roll_back_batch();
+                this->game_auths = std::move(saved_auths);
+                out["rolled_back"] = true;
+                broadcast = false;
+                break;
+            }
+        }
+
+        auto movements(this->game_info.end_batch());
+        if(!movements.empty())
+        {
+            out["players_moved"] = movements;
+        }
+        out["results"] = std::move(results);
+
+        // one broadcast for the whole batch
+        if(broadcast)
+        {
+            this->publish_state();
+        }
+    }
+
+    // handler for new client
+    bool handle_new_client(server::client_id /* client_id */, std::ostream& /* client */) const
+    {
+        return false;
+    }
+
+    // handler for input from existing client. I/O thread
+    bool handle_client_input(server::client_id client_id, server::line_view line, std::ostream& /* client */)
+    {
+        // get a line of input
+        //
+        // note: this was probably the most problematic line of the entire codebase.
+        //
+        // we want to consume all available lines of input, but we do not want to block if there is no input ready.
+        // with just an if() statement, we only read the first line available and ignore the rest.
+        // with just a while() statement, we keep trying the read even when there is no input ready, blocking!
+        // third try: check input availability first with peek(), only read if something is ready.
+        // fourth try: peek() also tries to fill the buffer and will block. implement a non-blocking peek
+        // fifth try: back to a single if() and getline(). moved the loop outside of handle_client_input
+        // sixth try: the server frames input and only calls us with a complete line buffered, so getline never blocks
+        // seventh try: the server hands us each complete line in place in its receive buffer. nothing to read, nothing to copy
+        // eighth try: we parse the line and hand the command to the game thread. the response comes back later, in order
+        // ninth try: queries skip the game thread, and are answered from published state. responses still go out in order
+        auto* const end(line.data + line.size);
+
+        // find start of command
+        auto* cmd0(std::find_if_not(line.data, end, is_command_space));
+        if(cmd0 != end && this->quitting.find(client_id) == this->quitting.end())
+        {
+            request req;
+            req.client = client_id;
+            this->parse_command(cmd0, end, req);
+
+            // asynchronous commands are answered whenever ready, so they do not take a place in line
+            auto& queue(this->client_queues[client_id]);
+            auto async(req.cmd != nullptr && (req.cmd->flags & command_async));
+            if(async)
+            {
+                queue.unordered++;
+            }
+            else
+            {
+                req.sequence = queue.next_request++;
+            }
+
+            // responses to commands already sent go out before the client is disconnected
+            if(req.cmd != nullptr && (req.cmd->flags & command_disconnects))
+            {
+                this->quitting.insert(client_id);
+            }
+
+            if(req.cmd != nullptr && req.cmd->query != nullptr && queue.next_response >= queue.game_until)
+            {
+                // nothing this client sent is still on the game thread, so the latest published state includes all of it
+                this->post_query(std::atomic_load(&this->published), std::move(req));
+            }
+            else
+            {
+                if(!async)
+                {
+                    queue.game_until = req.sequence + 1;
+                }
+                this->requests.push(std::move(req));
+            }
+        }
+
+        return false;
+    }
+
+    // find a command and parse its arguments, from a client or the journal
+    void parse_command(const char* const cmd0, const char* const end, request& req) const
+    {
+        // find end of command and start of argument
+        auto* cmd1(std::find_if(cmd0, end, is_command_space));
+        auto* arg0(std::find_if_not(cmd1, end, is_command_space));
+
+        // look up command
+        req.cmd = find_command(cmd0, static_cast<std::size_t>(cmd1 - cmd0));
+
+        // arguments are parsed straight into their types, checked against the command's schema (just echo if unknown)
+        req.parsed = req.args.parse(req.cmd != nullptr ? req.cmd->input : arg_list {}, req.cmd != nullptr && (req.cmd->flags & command_keeps_input), arg0, end);
+
+        if(req.cmd != nullptr && (req.cmd->flags & command_mutates))
+        {
+            req.line.assign(cmd0, end);
+        }
+    }
+
+    // apply one request from the I/O thread, handing back its response. game thread
+    void handle_request(request& req)
+    {
+        if(req.call)
+        {
+            req.call();
+            return;
+        }
+
+        // state published after every change is current here, so queries need nothing more from the game thread
+        if(req.cmd != nullptr && req.cmd->query != nullptr)
+        {
+            this->post_query(std::atomic_load(&this->published), std::move(req));
+            return;
+        }
+
+        result r;
+        r.client = req.client;
+        r.sequence = req.sequence;
+        if(req.cmd != nullptr && (req.cmd->flags & command_disconnects))
+        {
+            r.kind = result_kind::disconnect;
+        }
+        else if(req.cmd != nullptr && req.parsed && (req.cmd->flags & command_on_io_thread))
+        {
+            r.kind = result_kind::connection;
+            r.state = std::atomic_load(&this->published);
+            r.forwarded.reset(new request(std::move(req)));
+        }
+        else
+        {
+            this->apply_command(req, r.out);
+
+            // publish anything the command changed, even if it then failed, before its response can reach the client
+            // the client's next query may skip the game thread and read published state directly
+            if(this->unpublished)
+            {
+                this->publish();
+            }
+
+            // a change is acknowledged only once its journal entry is durable. the journal syncs on its own thread, and posts the response then
+            if(this->game_journal && req.cmd != nullptr && (req.cmd->flags & command_mutates))
+            {
+                std::shared_ptr<result> held(std::make_shared<result>(std::move(r)));
+                this->game_journal->when_durable([this, held]()
+                {
+                    this->post(std::move(*held));
+                });
+                return;
+            }
+        }
+        this->post(std::move(r));
+    }
+
+    // run one parsed command, from a client or the journal. game thread
+    void apply_command(const request& req, nlohmann::json& out)
+    {
+        try
+        {
+            scope_timer timer;
+
+            // copy "echo" attribute to output, if sent. This will allow clients to correlate requests with responses
+            if(req.args.has_echo())
+            {
+                out["echo"] = req.args.echo();
+            }
+
+            if(req.cmd == nullptr)
+            {
+                throw td::protocol_error("unknown command");
+            }
+
+            // set message for timer
+            timer.set_message(std::string("command ") + req.cmd->name + " handled in: ");
+
+            // bad arguments are reported without running anything
+            if(!req.parsed)
+            {
+                out["error"] = req.args.error();
+                logger(ll::warning) << "bad arguments for command " << req.cmd->name << ": " << req.args.error() << '\n';
+                return;
+            }
 
-    void broadcast_state() const
-    {
-        nlohmann::json bcast;
-        this->game_info.dump_state(bcast);
-        this->game_info.dump_configuration_state(bcast);
-        this->game_info.dump_derived_state(bcast);
-        this->game_server.broadcast(bcast.dump());
-    }
+            if(req.cmd->flags & command_requires_auth)
+            {
+                ensure_authorized(this->game_auths, req.args);
+            }
 
-    // ----- command handlers available to anyone
+            if(req.cmd->flags & command_mutates)
+            {
+                // published once it has run, whether or not it succeeds
+                this->unpublished = true;
 
-    void handle_cmd_version(nlohmann::json& out) const
-    {
-        out["server_name"] = "tournamentd";
-        out["server_version"] = "0.0.9";
-    }
+                // record the command before running it, so that replay fails the same way if it fails
+                this->journal_command(req.line.data(), req.line.data() + req.line.size());
 
-    void handle_cmd_get_config(nlohmann::json& out) const
-    {
-        // pass auth codes back into output
-        out["authorized_clients"] = this->all_auths();
-        this->game_info.dump_configuration(out);
-    }
+                // bring clock-driven state up to the time of the command, as replay will
+                this->game_info.update();
+            }
 
-    void handle_cmd_get_state(nlohmann::json& out) const
-    {
-        this->game_info.dump_state(out);
-        this->game_info.dump_configuration_state(out);
-        this->game_info.dump_derived_state(out);
-    }
+            // call command handler
+            this->run_handler(*req.cmd, req.client, req.args, out);
 
-    void handle_cmd_check_authorized(const nlohmann::json& in, nlohmann::json& out) const
-    {
-        const auto& code(in.at("authenticate"));
-        const auto& authorized(this->code_authorized(code));
-        logger(ll::debug) << "code " << code << " is " << (authorized ? "authorized\n" : "not authorized\n");
-        out["authorized"] = authorized;
+            if(req.cmd->flags & command_broadcasts)
+            {
+                this->publish_state();
+            }
+        }
+        catch(const td::protocol_error& e)
+        {
+            out["error"] = e.what();
+            logger(ll::warning) << "caught protocol error while processing command: " << e.what() << '\n';
+        }
+        catch(const std::exception& e)
+        {
+            out["exception"] = e.what();
+            logger(ll::warning) << "caught a non protocol error exception while processing command: " << e.what() << '\n';
+        }
     }
 
-    void handle_cmd_chips_for_buyin(const nlohmann::json& in, nlohmann::json& out) const
+    // answer a read-only command from published state. query worker
+    static void run_query(const published_state& state, const request& req, nlohmann::json& out)
     {
-        auto chips(this->game_info.chips_for_buyin(in.at("source_id"), in.at("max_expected_players")));
-        out["chips_for_buyin"] = chips;
-    }
+        try
+        {
+            scope_timer timer;
+            timer.set_message(std::string("query ") + req.cmd->name + " handled in: ");
 
-    // ----- command handlers available to authorized clients
+            // copy "echo" attribute to output, if sent
+            if(req.args.has_echo())
+            {
+                out["echo"] = req.args.echo();
+            }
 
-    void handle_cmd_configure(const nlohmann::json& in, nlohmann::json& out)
-    {
-        // handle auth codes. game_info doesn't handle these
-        this->authorize_from_config(in);
+            // bad arguments are reported without running anything
+            if(!req.parsed)
+            {
+                out["error"] = req.args.error();
+                logger(ll::warning) << "bad arguments for command " << req.cmd->name << ": " << req.args.error() << '\n';
+                return;
+            }
 
-        // pass auth codes back into output
-        out["authorized_clients"] = this->all_auths();
+            if(req.cmd->flags & command_requires_auth)
+            {
+                ensure_authorized(state.auths, req.args);
+            }
 
-        // configure
-        this->game_info.configure(in);
-        this->game_info.dump_configuration(out);
+            req.cmd->query(*state.game, state.auths, req.args, out);
+        }
+        catch(const td::protocol_error& e)
+        {
+            out["error"] = e.what();
+            logger(ll::warning) << "caught protocol error while processing command: " << e.what() << '\n';
+        }
+        catch(const std::exception& e)
+        {
+            out["exception"] = e.what();
+            logger(ll::warning) << "caught a non protocol error exception while processing command: " << e.what() << '\n';
+        }
     }
 
-    void handle_cmd_start_game(const nlohmann::json& in, nlohmann::json& /* out */)
+    // run a command that changes how its client is sent state, against the state handed over with it. I/O thread
+    void run_connection_command(const request& req)
     {
-        auto start_at_it(in.find("start_at"));
-        if(start_at_it != in.end())
+        nlohmann::json out;
+        if(req.args.has_echo())
         {
-            this->game_info.start(*start_at_it);
+            out["echo"] = req.args.echo();
         }
-        else
+
+        try
         {
-            this->game_info.start();
+            req.cmd->handler(*this, req.client, req.args, out);
+        }
+        catch(const td::protocol_error& e)
+        {
+            out["error"] = e.what();
+            logger(ll::warning) << "caught protocol error while processing command: " << e.what() << '\n';
+        }
+        catch(const std::exception& e)
+        {
+            out["exception"] = e.what();
+            logger(ll::warning) << "caught a non protocol error exception while processing command: " << e.what() << '\n';
         }
-    }
 
-    void handle_cmd_stop_game(const nlohmann::json& /* in */, nlohmann::json& /* out */)
-    {
-        this->game_info.stop();
+        this->game_server.respond(req.client, out.dump());
     }
 
-    void handle_cmd_resume_game(const nlohmann::json& /* in */, nlohmann::json& /* out */)
+    // take over published state, unless already holding newer state. I/O thread
+    void adopt_state(const std::shared_ptr<const published_state>& state)
     {
-        this->game_info.resume();
+        if(!this->io_state || state->version > this->io_state->version)
+        {
+            this->io_state = state;
+        }
     }
 
-    void handle_cmd_pause_game(const nlohmann::json& /* in */, nlohmann::json& /* out */)
+    // act on a response to a client, once those before it are sent. I/O thread
+    void send_response(result& r)
     {
-        this->game_info.pause();
+        switch(r.kind)
+        {
+        case result_kind::response:
+            this->game_server.respond(r.client, r.out.dump());
+            break;
+        case result_kind::connection:
+            this->adopt_state(r.state);
+            this->run_connection_command(*r.forwarded);
+            break;
+        case result_kind::disconnect:
+        {
+            auto it(this->client_queues.find(r.client));
+            if(it != this->client_queues.end() && it->second.unordered > 0)
+            {
+                it->second.closing = true;
+            }
+            else
+            {
+                this->quitting.erase(r.client);
+                this->game_server.close(r.client);
+            }
+            break;
+        }
+        default:
+            break;
+        }
     }
 
-    void handle_cmd_toggle_pause_game(const nlohmann::json& /* in */, nlohmann::json& /* out */)
+    // send the response to an asynchronous command right away, and disconnect its client if it was waiting to quit. I/O thread
+    void deliver_unordered(result&& r)
     {
-        this->game_info.toggle_pause_resume();
-    }
+        this->game_server.respond(r.client, r.out.dump());
 
-    void handle_cmd_set_previous_level(const nlohmann::json& /* in */, nlohmann::json& out)
-    {
-        auto blind_level_changed(this->game_info.previous_blind_level());
-        out["blind_level_changed"] = blind_level_changed;
+        auto it(this->client_queues.find(r.client));
+        if(it == this->client_queues.end())
+        {
+            return;
+        }
+
+        auto& queue(it->second);
+        queue.unordered--;
+        if(queue.unordered == 0 && queue.closing)
+        {
+            queue.closing = false;
+            this->quitting.erase(r.client);
+            this->game_server.close(r.client);
+        }
+        this->forget_if_idle(it);
     }
 
-    void handle_cmd_set_next_level(const nlohmann::json& /* in */, nlohmann::json& out)
+    // forget a client with nothing in flight. I/O thread
+    void forget_if_idle(std::unordered_map<server::client_id, client_queue>::iterator it)
     {
-        auto blind_level_changed(this->game_info.next_blind_level());
-        out["blind_level_changed"] = blind_level_changed;
+        if(it->second.next_response == it->second.next_request && it->second.unordered == 0)
+        {
+            this->client_queues.erase(it);
+        }
     }
 
-    void handle_cmd_set_action_clock(const nlohmann::json& in, nlohmann::json& /* out */)
+    // send a response in the order its client sent the command, holding it back if an earlier one is still being answered. I/O thread
+    void deliver_response(result&& r)
     {
-        auto duration_it(in.find("duration"));
-        if(duration_it != in.end())
+        auto it(this->client_queues.find(r.client));
+        if(it == this->client_queues.end())
         {
-            this->game_info.set_action_clock(*duration_it);
+            return;
         }
-        else
+
+        auto& queue(it->second);
+        if(r.sequence != queue.next_response)
         {
-            this->game_info.reset_action_clock();
+            queue.held.emplace(r.sequence, std::move(r));
+            return;
         }
-    }
 
-    void handle_cmd_gen_blind_levels(const nlohmann::json& in, nlohmann::json& out) const
-    {
-        auto levels(this->game_info.gen_blind_levels(in.at("desired_duration"),
-                                                     in.at("level_duration"),
-                                                     in.value("expected_buyins", std::size_t { 0 }),
-                                                     in.value("expected_rebuys", std::size_t { 0 }),
-                                                     in.value("expected_addons", std::size_t { 0 }),
-                                                     in.value("break_duration", 0L),
-                                                     in.value("antes", td::ante_type_t::none),
-                                                     in.value("ante_sb_ratio", 0.2)));
-        out["blind_levels"] = levels;
-    }
+        this->send_response(r);
+        queue.next_response++;
+        while(!queue.held.empty() && queue.held.begin()->first == queue.next_response)
+        {
+            this->send_response(queue.held.begin()->second);
+            queue.held.erase(queue.held.begin());
+            queue.next_response++;
+        }
 
-    void handle_cmd_reset_state(const nlohmann::json& /* in */, nlohmann::json& /* out */)
-    {
-        this->game_info.reset_state();
+        this->forget_if_idle(it);
     }
 
-    void handle_cmd_fund_player(const nlohmann::json& in, nlohmann::json& /* out */)
+    // serialize and send everything handed back. I/O thread
+    void deliver_results()
     {
-        this->game_info.fund_player(in.at("player_id"), in.at("source_id"));
+        result r;
+        while(this->results.pop(r))
+        {
+            switch(r.kind)
+            {
+            case result_kind::state:
+                this->adopt_state(r.state);
+                this->broadcast_state();
+                break;
+            case result_kind::failure:
+                std::rethrow_exception(r.failure);
+            default:
+                if(r.unordered)
+                {
+                    this->deliver_unordered(std::move(r));
+                }
+                else
+                {
+                    this->deliver_response(std::move(r));
+                }
+                break;
+            }
+        }
     }
 
-    void handle_cmd_plan_seating(const nlohmann::json& in, nlohmann::json& out)
-    {
-        auto movements(this->game_info.plan_seating(in.at("max_expected_players")));
-        out["players_moved"] = movements;
-    }
+    // ----- journal
 
-    void handle_cmd_seat_player(const nlohmann::json& in, nlohmann::json& out)
+    // append a journal entry: sequence number, time (milliseconds since epoch), and the command line, separated by spaces
+    void journal_entry(const std::string& line)
     {
-        auto seating(this->game_info.add_player(in.at("player_id")));
-        out[seating.first] = seating.second;
+        this->journal_command(line.data(), line.data() + line.size());
     }
 
-    void handle_cmd_unseat_player(const nlohmann::json& in, nlohmann::json& /* out */)
+    void journal_command(const char* first, const char* last)
     {
-        this->game_info.remove_player(in.at("player_id"));
+        if(this->game_journal && !this->replaying)
+        {
+            auto now(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()));
+            this->game_journal->append(std::to_string(++this->journal_sequence) + ' ' + std::to_string(now.count()) + ' ' + std::string(first, last));
+        }
     }
 
-    void handle_cmd_bust_player(const nlohmann::json& in, nlohmann::json& out)
+    // replay entries of one journal file not already in the loaded snapshot, at the times they were first run
+    // returns the highest sequence number in the file
+    std::uint64_t replay_journal(const std::string& path, std::size_t& replayed)
     {
-        auto movements(this->game_info.bust_player(in.at("player_id")));
-        out["players_moved"] = movements;
-    }
+        std::uint64_t last_sequence(0);
+        journal::read(path, [&](const std::string& entry)
+        {
+            try
+            {
+                auto space0(entry.find(' '));
+                auto space1(entry.find(' ', space0 + 1));
+                auto sequence(std::stoull(entry.substr(0, space0)));
+                last_sequence = std::max<std::uint64_t>(last_sequence, sequence);
+                if(sequence <= this->checkpoint_sequence)
+                {
+                    return;
+                }
 
-    void handle_cmd_rebalance_seating(const nlohmann::json& /* in */, nlohmann::json& out)
-    {
-        auto movements(this->game_info.rebalance_seating());
-        out["players_moved"] = movements;
+                auto ms(std::stoll(entry.substr(space0 + 1, space1 - space0 - 1)));
+                this->game_info.set_clock_override(std::chrono::system_clock::time_point(std::chrono::milliseconds(ms)));
+
+                auto* first(entry.data() + space1 + 1);
+                auto* last(entry.data() + entry.size());
+                static const std::string authorize_prefix("authorize ");
+                static const std::string configuration_prefix("configuration ");
+                if(entry.compare(space1 + 1, authorize_prefix.size(), authorize_prefix) == 0)
+                {
+                    // pre-authorization of a code through the API, not a client command
+                    auto in(nlohmann::json::parse(first + authorize_prefix.size(), last));
+                    this->authorize(in.at("code").get<int>());
+                }
+                else if(entry.compare(space1 + 1, configuration_prefix.size(), configuration_prefix) == 0)
+                {
+                    // configuration loaded from a file through the API, not a client command
+                    this->apply_configuration(nlohmann::json::parse(first + configuration_prefix.size(), last));
+                }
+                else
+                {
+                    request req;
+                    this->parse_command(first, last, req);
+                    nlohmann::json out;
+                    this->apply_command(req, out);
+                }
+                replayed++;
+            }
+            catch(const std::exception& e)
+            {
+                logger(ll::warning) << "skipping bad journal entry: " << e.what() << '\n';
+            }
+        });
+        return last_sequence;
     }
 
-    void handle_cmd_quick_setup(const nlohmann::json& in, nlohmann::json& out)
+    // replay the previous and current journals on top of the loaded snapshot
+    std::size_t replay_journals()
     {
-        std::vector<td::seated_player> seated_players;
+        std::size_t replayed(0);
+        this->replaying = true;
+        this->previous_journal_sequence = this->replay_journal(this->previous_journal_path, replayed);
+        auto last_sequence(this->replay_journal(this->journal_path, replayed));
+        this->game_info.set_clock_override(std::chrono::system_clock::time_point());
+        this->replaying = false;
 
-        auto source_it(in.find("source_id"));
-        if(source_it != in.end())
-        {
-            seated_players = this->game_info.quick_setup(*source_it);
-        }
-        else
+        // keep numbering after every entry seen, replayed or not
+        this->journal_sequence = std::max({ this->checkpoint_sequence, this->previous_journal_sequence, last_sequence });
+
+        if(replayed > 0)
         {
-            seated_players = this->game_info.quick_setup();
+            logger(ll::info) << "replayed " << replayed << " journal entries from " << this->journal_path << '\n';
         }
-        out["seated_players"] = seated_players;
+        return replayed;
     }
 
-    // handler for new client
-    bool handle_new_client(std::ostream& /* client */) const
+    // queue a full snapshot of configuration and state for the writer thread
+    // the journal is rotated once the previous journal's entries are all in a snapshot on disk
+    void write_checkpoint()
     {
-        return false;
+        // get the snapshot (config + state + what is needed to replay the journal after it)
+        nlohmann::json snapshot;
+        this->game_info.dump_configuration(snapshot);
+        this->game_info.dump_state(snapshot);
+        this->game_info.dump_random_state(snapshot);
+        snapshot["authorized_clients"] = all_auths(this->game_auths);
+        snapshot["journal_sequence"] = this->journal_sequence;
+
+        if(this->game_journal && this->game_snapshot_writer->durable_sequence() >= this->previous_journal_sequence)
+        {
+            // the current journal becomes the previous journal, kept until this snapshot is on disk. the journal's thread moves it
+            this->game_journal->rotate(this->previous_journal_path);
+            this->previous_journal_sequence = this->journal_sequence;
+        }
+
+        this->game_snapshot_writer->write(std::move(snapshot), this->journal_sequence);
+        this->checkpoint_sequence = this->journal_sequence;
+        this->last_checkpoint = std::chrono::steady_clock::now();
     }
 
-    // handler for input from existing client
-    bool handle_client_input(std::iostream& client)
+    // checkpoint every so often. journal entries are made durable on the journal's own thread
+    void persist()
     {
-        std::string input;
-        // get a line of input
-        //
-        // note: this is probably the most problematic line of the entire codebase.
-        //
-        // we want to consume all available lines of input, but we do not want to block if there is no input ready.
-        // with just an if() statement, we only read the first line available and ignore the rest.
-        // with just a while() statement, we keep trying the read even when there is no input ready, blocking!
-        // third try: check input availability first with peek(), only read if something is ready.
-        // fourth try: peek() also tries to fill the buffer and will block. implement a non-blocking peek
-        // fifth try: back to a single if() and getline(). moved the loop outside of handle_client_input
-        if(std::getline(client, input))
+        if(!this->game_journal)
         {
-            // find start of command
-            static const char* whitespace(" \t\r\n");
-            auto cmd0(input.find_first_not_of(whitespace));
-            if(cmd0 != std::string::npos)
-            {
-                // build up output
-                nlohmann::json out;
-
-                try
-                {
-                    scope_timer timer;
-
-                    // find end of command
-                    auto cmd1(input.find_first_of(whitespace, cmd0));
-                    if(cmd1 != std::string::npos)
-                    {
-                        nlohmann::json in;
-                        auto cmd(input.substr(cmd0, cmd1));
-                        auto pos(input.find_first_not_of(whitespace, cmd1));
-                        if(pos != std::string::npos)
-                        {
-                            auto arg(input.substr(pos, std::string::npos));
-                            in = nlohmann::json::parse(arg);
-                        }
-
-                        // convert command to lower-case for hashing (use ::tolower, assuming ASCII-encoded input)
-                        std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
-
-                        // copy "echo" attribute to output, if sent. This will allow clients to correlate requests with responses
-                        auto echo_it(in.find("echo"));
-                        if(echo_it != in.end())
-                        {
-                            out["echo"] = *echo_it;
-                        }
-
-                        // set message for timer
-                        timer.set_message("command " + cmd + " handled in: ");
-
-                        // call command handler
-                        if(cmd == "quit" || cmd == "exit")
-                        {
-                            /*
-                             command:
-                             quit (or exit)
-
-                             purpose:
-                             Disconnect client cleanly
-
-                             input:
-                             (none)
-
-                             output:
-                             (none)
-                             */
-                            return true;
-                        }
-                        else if(cmd == "check_authorized")
-                        {
-                            /*
-                             command:
-                             check_authorized
-
-                             purpose:
-                             Check whether a code is authorized to administer the tournament
-
-                             input:
-                             authenticate (integer): Authentication code to check
-
-                             output:
-                             authorized (bool): True if code is valid for administration (warning this can be exploited, should turn this off)
-                             */
-                            this->handle_cmd_check_authorized(in, out);
-                        }
-                        else if(cmd == "version")
-                        {
-                            /*
-                             command:
-                             version
-
-                             purpose:
-                             Dump the server's version info
-
-                             input:
-                             (none)
-
-                             output:
-                             server_name (string): "tournamentd"
-                             server_version (string): Description of server's API version
-                             */
-                            this->handle_cmd_version(out);
-                        }
-                        else if(cmd == "get_config")
-                        {
-                            /*
-                             command:
-                             get_config
-
-                             purpose:
-                             Dump the server's current configuration
-
-                             input:
-                             (none)
-
-                             output:
-                             name (string): Human-readable name of this tournament
-                             players (array): Each player eligible for this tournament
-                             table_capacity (integer): Number of seats per table
-                             table_names (array): Available table names for display
-                             funding_sources (array): Each valid source of funding for this tournament
-                             blind_levels (array): Description of each blind level
-                             available_chips (array): Description of each chip color and denomination
-                             available_tables (array): Description of each named table
-                             payout_policy (integer): Policy for paying out players (0 = automatic, 1 = forced, 2 = depends on turnout)
-                             payout_currency (string): Currency used for payouts
-                             automatic_payouts (object): Parameters for automatic payout structure generation:
-                                 percent_seats_paid (float): Proportion of players (buyins) paid out
-                                 round_payouts (bool): Round payoffs to integer values
-                                 payout_shape (float): How "flat" to make the payout structure. 0 = all places paid the same, 1 = winner takes all
-                                 pay_the_bubble (float): How much to pay the bubble (usually 0)
-                                 pay_knockouts (float): How much to set aside for each knockout
-                             forced_payouts (array): Force this array of payouts, regardless of number of players
-                             manual_payouts (array): Manual payout definitions: number of players and an array of payouts, if missing, automatic payouts are calculated
-                             previous_blind_level_hold_duration (integer): How long after round starts should prev command go to the previous round (rather than restart)? (ms)
-                             rebalance_policy (integer): Policy for rebalancing tables (0 = manual, 1 = when unbalanced, 2 = shootout)
-                             background_color (string): Suggested clock user interface color
-                             final_table_policy (integer): Policy for moving players to the final table (0 = fill in, 1 = randomize)
-                             authorized_clients (array): List of authorized remote device codes and names
-                             */
-                            this->ensure_authorized(in);
-                            this->handle_cmd_get_config(out);
-                        }
-                        else if(cmd == "get_state")
-                        {
-                            /*
-                             command:
-                             get_state
-
-                             purpose:
-                             Dump the server's current game state
-
-                             input:
-                             (none)
-
-                             output:
-                             seats (array): Seat assignment for each player id
-                             players_finished (array): busted player ids in reverse bust out order, no duplicates
-                             bust_history (array): Busted player ids in bust out order, can contain duplicates due to rebuys
-                             empty_seats (array): Empty seat assignments
-                             table_count (integer): Number of tables currently playing
-                             buyins (array): Player ids who are both currently seated and bought in
-                             unique_entries (array): Player ids who at one point have bought in
-                             entries (array): Player ids for each buyin or rebuy
-                             payouts (array): Payout amounts for each place
-                             total_chips (integer): Count of all tournament chips in play
-                             total_cost (array): Sum total of all buyins, rebuys and addons, for each currency
-                             total_commission (array): Sum total of all entry fees, for each currency
-                             total_equity (double): Sum total of all payouts, in configured payout_currency
-                             running (bool): True if the tournament is unpaused
-                             current_blind_level (integer): Current blind level. 0 = planning stage
-                             current_time (integer): Current time since epoch (milliseconds)
-                             time_remaining (integer): Time remaining in current level (milliseconds)
-                             break_time_remaining (integer): Time remaining in current break (milliseconds)
-                             action_clock_time_remaining (integer): Time remaining on action clock (milliseconds)
-                             elapsed (integer): Tournament time elapsed (milliseconds)
-                             */
-                            this->handle_cmd_get_state(out);
-                        }
-                        else if(cmd == "chips_for_buyin")
-                        {
-                            /*
-                             command:
-                             chips_for_buyin
-
-                             purpose:
-                             Given configured chip set and expected number of players, calculate the quantity of each chip needed for starting stack
-
-                             input:
-                             source_id (funding source id): Funding source to calculate for
-                             max_expected_players (integer): Number of players expected in the tournament
-
-                             output:
-                             chips_for_buyin (array): Quantities for each chip denomination
-                             */
-                            this->handle_cmd_chips_for_buyin(in, out);
-                        }
-                        else if(cmd == "configure")
-                        {
-                            /*
-                             command:
-                             configure
-
-                             purpose:
-                             Load a configuration into the tournament
-
-                             input:
-                             authenticate (integer): Valid authentication code for a tournament admin
-                             name (optional, string): Human-readable name for this tournament
-                             players (optional, array): Each player eligible for this tournament
-                             table_capacity (optional, integer): Number of seats per table
-                             table_names (optional, array): Available table names for display
-                             funding_sources (optional, array): Each valid source of funding for this tournament
-                             blind_levels (optional, array): Description of each blind level
-                             available_chips (optional, array): Description of each chip color and denomination
-                             available_tables (optional, array): Description of each named table
-                             payout_policy (optional, integer): Policy for paying out players (0 = automatic, 1 = forced, 2 = depends on turnout)
-                             payout_currency (optional, string): Currency used for payouts
-                             automatic_payouts (optional, object): Parameters for automatic payout structure generation:
-                                 percent_seats_paid (float): Proportion of players (buyins) paid out
-                                 round_payouts (bool): Round payoffs to integer values
-                                 payout_shape (float): How "flat" to make the payout structure. 0 = all places paid the same, 1 = winner takes all
-                                 pay_the_bubble (float): How much to pay the bubble (usually 0)
-                                 pay_knockouts (float): How much to set aside for each knockout
-                             forced_payouts (optional, array): Force this array of payouts, regardless of number of players
-                             manual_payouts (optional, array): Manual payout definitions: number of players and an array of payouts, if missing, automatic payouts are calculated
-                             previous_blind_level_hold_duration (optional, integer): How long after round starts should prev command go to the previous round (rather than restart)? (ms)
-                             rebalance_policy (optional, integer): Policy for rebalancing tables (0 = manual, 1 = when unbalanced, 2 = shootout)
-                             background_color (optional, string): Suggested clock user interface color
-                             final_table_policy (optional, integer): Policy for moving players to the final table (0 = fill in, 1 = randomize)
-                             authorized_clients (optional, array): List of authorized remote device codes and names
-
-                             output:
-                             (none)
-                             */
-                            this->ensure_authorized(in);
-                            this->handle_cmd_configure(in, out);
-                            this->broadcast_state();
-                        }
-                        else if(cmd == "reset_state")
-                        {
-                            /*
-                             command:
-                             reset_state
-
-                             purpose:
-                             Resets all game state to no results, seating, funding, and stops the clock
-
-                             input:
-                             authenticate (integer): Valid authentication code for a tournament admin
-
-                             output:
-                             (none)
-                             */
-                            this->ensure_authorized(in);
-                            this->handle_cmd_reset_state(in, out);
-                            this->broadcast_state();
-                        }
-                        else if(cmd == "start_game")
-                        {
-                            /*
-                             command:
-                             start_game
-
-                             purpose:
-                             Start the tournament
-
-                             input:
-                             authenticate (integer): Valid authentication code for a tournament admin
-                             start_at (optional, date): Time to start the tournament
-
-                             output:
-                             (none)
-                             */
-                            this->ensure_authorized(in);
-                            this->handle_cmd_start_game(in, out);
-                            this->broadcast_state();
-                        }
-                        else if(cmd == "stop_game")
-                        {
-                            /*
-                             command:
-                             stop_game
-
-                             purpose:
-                             Stop the tournament
-
-                             input:
-                             authenticate (integer): Valid authentication code for a tournament admin
-
-                             output:
-                             (none)
-                             */
-                            this->ensure_authorized(in);
-                            this->handle_cmd_stop_game(in, out);
-                            this->broadcast_state();
-                        }
-                        else if(cmd == "resume_game")
-                        {
-                            /*
-                             command:
-                             resume_game
-
-                             purpose:
-                             Resume a paused tournament
-
-                             input:
-                             authenticate (integer): Valid authentication code for a tournament admin
-
-                             output:
-                             (none)
-                             */
-                            this->ensure_authorized(in);
-                            this->handle_cmd_resume_game(in, out);
-                            this->broadcast_state();
-                        }
-                        else if(cmd == "pause_game")
-                        {
-                            /*
-                             command:
-                             pause_game
-
-                             purpose:
-                             Pause the tournament
-
-                             input:
-                             authenticate (integer): Valid authentication code for a tournament admin
-
-                             output:
-                             (none)
-                             */
-                            this->ensure_authorized(in);
-                            this->handle_cmd_pause_game(in, out);
-                            this->broadcast_state();
-                        }
-                        else if(cmd == "toggle_pause_game")
-                        {
-                            /*
-                             command:
-                             toggle_pause_game
-
-                             purpose:
-                             Pause the tournament if running, unpause if not
-
-                             input:
-                             authenticate (integer): Valid authentication code for a tournament admin
-
-                             output:
-                             (none)
-                             */
-                            this->ensure_authorized(in);
-                            this->handle_cmd_toggle_pause_game(in, out);
-                            this->broadcast_state();
-                        }
-                        else if(cmd == "set_previous_level")
-                        {
-                            /*
-                             command:
-                             set_previous_level
-
-                             purpose:
-                             Set the tournament back one level (unless tournament is in the first round, or it's been <2 seconds since set back)
-
-                             input:
-                             authenticate (integer): Valid authentication code for a tournament admin
-
-                             output:
-                             blind_level_changed (bool): True if the blind level actually changed
-                             */
-                            this->ensure_authorized(in);
-                            this->handle_cmd_set_previous_level(in, out);
-                            this->broadcast_state();
-                        }
-                        else if(cmd == "set_next_level")
-                        {
-                            /*
-                             command:
-                             set_next_level
-
-                             purpose:
-                             Set the tournament forward one level (unless tournament is in the last round)
-
-                             input:
-                             authenticate (integer): Valid authentication code for a tournament admin
-
-                             output:
-                             blind_level_changed (bool): True if the blind level actually changed
-                             */
-                            this->ensure_authorized(in);
-                            this->handle_cmd_set_next_level(in, out);
-                            this->broadcast_state();
-                        }
-                        else if(cmd == "set_action_clock")
-                        {
-                            /*
-                             command:
-                             set_action_clock
-
-                             purpose:
-                             Call the clock on a player, starting a countdown timer
-
-                             input:
-                             authenticate (integer): Valid authentication code for a tournament admin
-                             duration (optional, integer): Duration of countdown (milliseconds). If not set, clears the countdown
-
-                             output:
-                             (none)
-                             */
-                            this->ensure_authorized(in);
-                            this->handle_cmd_set_action_clock(in, out);
-                            this->broadcast_state();
-                        }
-                        else if(cmd == "gen_blind_levels")
-                        {
-                            /*
-                             command:
-                             gen_blind_levels
-
-                             purpose:
-                             Generate progressive blind levels, given available chip denominations
-
-                             input:
-                             authenticate (integer): Valid authentication code for a tournament admin
-                             desired_duration (integer): Desired total tournament length (milliseconds)
-                             level_duration (integer): Uniform duraiton for each level (milliseconds)
-                             chips_in_play (integer): Estimated number of total chips in play including buyins, rebuys, and addons
-                             break_duration (optional, integer): Length of break whenever we can chip up (defaults to no break)
-                             antes (optional, enum): 0: No ante, 1: Traditional ante, 2: Big Blind Ante
-                             ante_sb_ratio (optional, float): Approx. ratio between ante and small blind (defaults to 1:5)
-
-                             output:
-                             (none)
-                             */
-                            this->ensure_authorized(in);
-                            this->handle_cmd_gen_blind_levels(in, out);
-                        }
-                        else if(cmd == "fund_player")
-                        {
-                            /*
-                             command:
-                             fund_player
-
-                             purpose:
-                             Accept a buyin, rebuy, or addon for a player
-
-                             input:
-                             authenticate (integer): Valid authentication code for a tournament admin
-                             player_id (player id): Player to fund
-                             source_id (funding source id): Chosen funding source
-
-                             output:
-                             (none)
-                             */
-                            this->ensure_authorized(in);
-                            this->handle_cmd_fund_player(in, out);
-                            this->broadcast_state();
-                        }
-                        else if(cmd == "plan_seating")
-                        {
-                            /*
-                             command:
-                             plan_seating
-
-                             purpose:
-                             Generate an empty, random seating plan, given number of players
-
-                             input:
-                             authenticate (integer): Valid authentication code for a tournament admin
-                             max_expected_players (integer): Maximum number of players expected
-
-                             output:
-                             players_moved (array): Any player movements that have to happen
-                             */
-                            this->ensure_authorized(in);
-                            this->handle_cmd_plan_seating(in, out);
-                            this->broadcast_state();
-                        }
-                        else if(cmd == "seat_player")
-                        {
-                            /*
-                             command:
-                             seat_player
-
-                             purpose:
-                             Seat a player in the next available seat
-
-                             input:
-                             authenticate (integer): Valid authentication code for a tournament admin
-                             player_id (player id): Player to seat
-
-                             output:
-                             player_seated (object): Player, table, and seat
-                             - or -
-                             already_seated (object): Player, table, and seat
-                             */
-                            this->ensure_authorized(in);
-                            this->handle_cmd_seat_player(in, out);
-                            this->broadcast_state();
-                        }
-                        else if(cmd == "unseat_player")
-                        {
-                            /*
-                             command:
-                             unseat_player
-
-                             purpose:
-                             Unseat a player without busting him (as if player was never in)
-
-                             input:
-                             authenticate (integer): Valid authentication code for a tournament admin
-                             player_id (player id): Player to unseat
-
-                             output:
-                             (none)
-                             */
-                            this->ensure_authorized(in);
-                            this->handle_cmd_unseat_player(in, out);
-                            this->broadcast_state();
-                        }
-                        else if(cmd == "bust_player")
-                        {
-                            /*
-                             command:
-                             bust_player
-
-                             purpose:
-                             Bust a player out of the tournament
-
-                             input:
-                             authenticate (integer): Valid authentication code for a tournament admin
-                             player_id (player id): Player to bust
-
-                             output:
-                             players_moved (array): Any player movements that have to happen (rebalancing)
-                             */
-                            this->ensure_authorized(in);
-                            this->handle_cmd_bust_player(in, out);
-                            this->broadcast_state();
-                        }
-                        else if(cmd == "rebalance_seating")
-                        {
-                            /*
-                             command:
-                             rebalance_seating
-
-                             purpose:
-                             Manually try to break and rebalance tables
-
-                             input:
-                             authenticate (integer): Valid authentication code for a tournament admin
-
-                             output:
-                             players_moved (array): Any player movements that have to happen
-                             */
-                            this->ensure_authorized(in);
-                            this->handle_cmd_rebalance_seating(in, out);
-                            this->broadcast_state();
-                        }
-                        else if(cmd == "quick_setup")
-                        {
-                            /*
-                             command:
-                             quick_setup
-
-                             purpose:
-                             Quickly get a game going. Plan for all players in roster, seat all players
-                             and buy them in with the first configured uyin
-
-                             input:
-                             authenticate (integer): Valid authentication code for a tournament admin
-                             source_id (optional,funding source id): Funding source to use (default: first one)
-
-                             output:
-                             seated_players (array): List of all players and their seats
-                             */
-                            this->ensure_authorized(in);
-                            this->handle_cmd_quick_setup(in, out);
-                            this->broadcast_state();
-                        }
-                        else
-                        {
-                            throw td::protocol_error("unknown command");
-                        }
-                    }
-                }
-                catch(const td::protocol_error& e)
-                {
-                    out["error"] = e.what();
-                    logger(ll::warning) << "caught protocol error while processing command: " << e.what() << '\n';
-                }
-                catch(const std::exception& e)
-                {
-                    out["exception"] = e.what();
-                    logger(ll::warning) << "caught a non protocol error exception while processing command: " << e.what() << '\n';
-                }
+            return;
+        }
 
-                client << out << std::endl;
+        try
+        {
+            auto entries(this->journal_sequence - this->checkpoint_sequence);
+            if(entries >= JOURNAL_CHECKPOINT_ENTRIES || (entries > 0 && std::chrono::steady_clock::now() - this->last_checkpoint >= std::chrono::seconds(JOURNAL_CHECKPOINT_INTERVAL)))
+            {
+                this->write_checkpoint();
             }
         }
-
-        return false;
+        catch(const std::exception& e)
+        {
+            logger(ll::error) << "failed to checkpoint journal: " << e.what() << '\n';
+        }
     }
 
     int authorize(int code)
     {
         logger(ll::info) << "client " << code << " pre-authorized to administer this tournament\n";
+        this->journal_entry("authorize " + nlohmann::json { { "code", code } }.dump());
         this->game_auths.emplace(code, td::authorized_client(code, "Pre-authorized client"));
         return code;
     }
 
-    static std::string get_snapshot_path()
+    static std::string get_temp_path(const char* filename)
     {
         // look in environment for better temp dir
         auto* tmpdir(std::getenv("TMPDIR"));
         if(tmpdir != nullptr)
         {
-            return std::string(tmpdir) + "/tournamentd.snapshot.json";
+            return std::string(tmpdir) + "/" + filename;
         }
         else
         {
-            return "/tmp/tournamentd.snapshot.json";
+            return std::string("/tmp/") + filename;
         }
     }
 
-    void load_snapshot()
+    // returns true if the snapshot came from legacy_snapshot_path
+    bool load_snapshot()
     {
+        auto legacy(false);
         try
         {
             // try loading existing snapshot (to recover after accidental exits, crashes, etc.
-            this->load_configuration(this->snapshot_path);
-            logger(ll::info) << "loaded snapshot from " << this->snapshot_path << '\n';
+            // fall back to a JSON snapshot left by an earlier version, so a crash across an upgrade is not lost
+            nlohmann::json snapshot;
+            auto loaded(load_json_file(this->snapshot_path, snapshot));
+            if(!loaded && load_json_file(this->legacy_snapshot_path, snapshot))
+            {
+                loaded = true;
+                legacy = true;
+            }
+
+            if(loaded)
+            {
+                // handle auth codes. game_info doesn't handle these
+                this->authorize_from_config(snapshot);
+
+                // configure, and restore the random engine so journaled commands replay identically
+                this->game_info.configure(snapshot);
+                this->game_info.load_random_state(snapshot);
+
+                // journal entries up to here are already in the snapshot
+                this->checkpoint_sequence = snapshot.value("journal_sequence", std::uint64_t(0));
+                logger(ll::info) << "loaded snapshot from " << (legacy ? this->legacy_snapshot_path : this->snapshot_path) << '\n';
+            }
         }
         catch(const std::exception& e)
         {
-            logger(ll::debug) << "did not load snapshot from " << this->snapshot_path << ": " << e.what() << '\n';
+            logger(ll::debug) << "did not load snapshot from " << (legacy ? this->legacy_snapshot_path : this->snapshot_path) << ": " << e.what() << '\n';
+            legacy = false;
         }
+        return legacy;
     }
 
-    void remove_snapshot() const
+    void remove_snapshot()
     {
-        // remove any snapshot
+        // finish writing, then remove any snapshot and journals
+        this->game_snapshot_writer.reset();
+        this->game_journal.reset();
+        std::remove(this->journal_path.c_str());
+        std::remove(this->previous_journal_path.c_str());
         std::remove(this->snapshot_path.c_str());
+        std::remove(this->legacy_snapshot_path.c_str());
         logger(ll::info) << "removed snapshot at " << this->snapshot_path << " because we are cleanly shutting down\n";
     }
 
 public:
-    impl() : snapshot_path(get_snapshot_path())
+    impl() : snapshot_path(get_temp_path("tournamentd.snapshot.cbor")), legacy_snapshot_path(get_temp_path("tournamentd.snapshot.json")), journal_path(get_temp_path("tournamentd.journal")), previous_journal_path(journal_path + ".previous")
     {
-        this->load_snapshot();
+        // recover after accidental exits, crashes, etc.: latest snapshot, then everything journaled since
+        auto legacy(this->load_snapshot());
+        auto replayed(this->replay_journals());
+        this->game_snapshot_writer.reset(new snapshot_writer(this->snapshot_path, this->checkpoint_sequence));
+
+        try
+        {
+            this->game_journal.reset(new journal(this->journal_path));
+            if(replayed > 0 || legacy)
+            {
+                // a legacy snapshot is carried over to the current format straight away
+                this->write_checkpoint();
+            }
+            else
+            {
+                // everything journaled is already in the snapshot
+                this->game_journal->truncate();
+                std::remove(this->previous_journal_path.c_str());
+                this->previous_journal_sequence = 0;
+            }
+        }
+        catch(const std::exception& e)
+        {
+            logger(ll::error) << "running without a journal: " << e.what() << '\n';
+            this->game_journal.reset();
+        }
+
+        this->publish();
+        this->game_thread = std::thread(&impl::run_game, this);
     }
 
     ~impl()
     {
+        // stop the game thread once it has applied everything already sent
+        request stop;
+        stop.call = [this]()
+        {
+            this->stopping = true;
+        };
+        this->requests.push(std::move(stop));
+        this->game_thread.join();
+
         this->remove_snapshot();
     }
 
@@ -976,65 +2187,132 @@ public:
     {
         // TODO: Consider whether this should throw an exception for non-existent files
         // Currently it silently ignores missing files, which may not be the desired behavior
-        std::ifstream config_stream(filename);
-        if(config_stream.good())
+        nlohmann::json config;
+        if(load_json_file(filename, config))
         {
-            nlohmann::json config;
-            config_stream >> config;
-
-            // handle auth codes. game_info doesn't handle these
-            this->authorize_from_config(config);
-
-            // configure
-            this->game_info.configure(config);
+            // journaled like a command, so recovery does not depend on the file or on a checkpoint
+            this->journal_entry("configuration " + config.dump());
+            this->apply_configuration(config);
         }
     }
 
-    // update/poll loop
-    bool update_and_poll()
+    void apply_configuration(const nlohmann::json& config)
     {
-        // update state
-        this->game_info.update();
+        // handle auth codes. game_info doesn't handle these
+        this->authorize_from_config(config);
 
-        // report to clients if running
-        if(this->game_info.is_started())
+        // configure
+        this->game_info.configure(config);
+    }
+
+    // game thread: apply requests in order, and broadcast whenever the clock needs it
+    void run_game()
+    {
+        std::exception_ptr failure;
+        try
         {
-            scope_timer timer;
-            timer.set_message("broadcast_state: ");
+            while(!this->stopping)
+            {
+                // commands publish before answering. this catches a call that failed part way
+                request req;
+                while(!this->stopping && this->requests.pop(req))
+                {
+                    this->handle_request(req);
+                    if(this->unpublished)
+                    {
+                        this->publish();
+                    }
+                }
+
+                // update state
+                auto now(std::chrono::system_clock::now());
+                this->game_info.update();
+
+                // report to clients when a deadline or display tick is due
+                if(this->next_wakeup != std::chrono::system_clock::time_point() && now >= this->next_wakeup)
+                {
+                    scope_timer timer;
+                    timer.set_message("publish_state: ");
+
+                    // send to clients
+                    this->publish_state();
+                }
+
+                // schedule the next wakeup: the next game deadline, or the next whole second while running
+                this->next_wakeup = this->game_info.next_deadline();
+                if(this->game_info.is_started())
+                {
+                    auto next_second(std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()) + std::chrono::seconds(1)));
+                    if(this->next_wakeup == std::chrono::system_clock::time_point() || next_second < this->next_wakeup)
+                    {
+                        this->next_wakeup = next_second;
+                    }
+                }
 
-            // send to clients
-            this->broadcast_state();
+                // checkpoint if due
+                this->persist();
+
+                // sleep until then, or until a request arrives
+                auto timeout(GAME_WAIT_MAX_TIMEOUT);
+                if(this->next_wakeup != std::chrono::system_clock::time_point())
+                {
+                    // round up so that we do not wake just before the deadline
+                    auto remaining(std::chrono::duration_cast<std::chrono::microseconds>(this->next_wakeup - now) + std::chrono::microseconds(1));
+                    timeout = std::max(0L, std::min(timeout, static_cast<long>(remaining.count())));
+                }
+                if(!this->stopping)
+                {
+                    this->requests.wait_for(std::chrono::microseconds(timeout));
+                }
+            }
+        }
+        catch(const std::exception& e)
+        {
+            logger(ll::error) << "game thread stopped: " << e.what() << '\n';
+            failure = std::current_exception();
+            result r;
+            r.kind = result_kind::failure;
+            r.failure = failure;
+            this->post(std::move(r));
         }
 
-        // poll clients for commands
-        auto greeter([this](std::ostream& client)
+        // nothing queued will run now. refuse later calls, and fail those already waiting
         {
-            return handle_new_client(client);
-        });
-        auto handler([this](std::iostream& client)
+            std::lock_guard<std::mutex> lock(this->game_mutex);
+            this->game_stopped = true;
+            this->game_failure = failure;
+        }
+        if(!failure)
         {
-            return handle_client_input(client);
-        });
-        auto quit(this->game_server.poll(greeter, handler, SERVER_POLL_TIMEOUT));
-
-        // snapshot if state is dirty
-        if(this->game_info.state_is_dirty())
+            failure = std::make_exception_ptr(std::runtime_error("game thread stopped"));
+        }
+        request req;
+        while(this->requests.pop(req))
         {
-            // try opening the file
-            std::ofstream snapshot_stream(this->snapshot_path);
-            if(snapshot_stream.good())
+            if(req.called)
             {
-                snapshot_stream << std::setw(4);
-
-                // get the snapshot (config + state)
-                nlohmann::json snapshot;
-                this->game_info.dump_configuration(snapshot);
-                this->game_info.dump_state(snapshot);
-                snapshot_stream << snapshot;
-
-                logger(ll::info) << "saved snapshot to " << this->snapshot_path << '\n';
+                req.called->set_exception(failure);
             }
         }
+    }
+
+    // I/O loop: read and parse commands for the game thread, and send whatever it handed back
+    bool poll_clients()
+    {
+        this->deliver_results();
+
+        // poll clients for commands, returning early when the game thread has something to send
+        auto greeter([this](server::client_id client_id, std::ostream& client)
+        {
+            return handle_new_client(client_id, client);
+        });
+        auto handler([this](server::client_id client_id, server::line_view line, std::ostream& client)
+        {
+            return handle_client_input(client_id, line, client);
+        });
+        auto quit(this->game_server.poll(greeter, handler, SERVER_POLL_MAX_TIMEOUT));
+
+        this->deliver_results();
 
         // return whether or not the server should quit
         return quit;
@@ -1049,14 +2327,23 @@ tournament::~tournament() = default;
 
 int tournament::authorize(int code)
 {
-    return this->pimpl->authorize(code);
+    this->pimpl->call([this, code]()
+    {
+        this->pimpl->authorize(code);
+    });
+    return code;
 }
 
 // listen for clients on any available service, returning the unix socket path and port
 std::pair<std::string, int> tournament::listen(const char* unix_socket_directory)
 {
     // warn if no authorized clients - tournament will not be configurable or controllable
-    if(this->pimpl->game_auths.empty())
+    auto unauthorized(false);
+    this->pimpl->call([this, &unauthorized]()
+    {
+        unauthorized = this->pimpl->game_auths.empty();
+    });
+    if(unauthorized)
     {
         logger(ll::warning) << "no authorized clients configured, so tournament will not be configurable or controllable.";
     }
@@ -1088,14 +2375,31 @@ std::pair<std::string, int> tournament::listen(const char* unix_socket_directory
 // load configuration from file
 void tournament::load_configuration(const std::string& filename)
 {
-    this->pimpl->load_configuration(filename);
+    this->pimpl->call([this, &filename]()
+    {
+        this->pimpl->load_configuration(filename);
+    });
+}
+
+// set how often delta-mode clients get a full keyframe
+void tournament::set_keyframe_interval(long seconds)
+{
+    this->pimpl->keyframe_interval = std::chrono::seconds(seconds);
+}
+
+// markdown reference of all commands, their arguments and output, as included in tournamentd.md
+std::string tournament::command_reference()
+{
+    std::ostringstream os;
+    impl::write_command_reference(os);
+    return os.str();
 }
 
 bool tournament::run()
 {
     try
     {
-        return this->pimpl->update_and_poll();
+        return this->pimpl->poll_clients();
     }
     catch(const std::system_error& e)
     {
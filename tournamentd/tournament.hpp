@@ -29,6 +29,13 @@ public:
     // load configuration from file
     void load_configuration(const std::string& filename);
 
-    // Run one iteration of the tournament run loop
+    // set how often delta-mode clients get a full keyframe
+    void set_keyframe_interval(long seconds);
+
+    // Run one iteration of the I/O loop: read commands, and send responses and state
+    // commands themselves are applied in order on a game thread, started on construction, and queries answered on worker threads
     bool run();
+
+    // markdown reference of all commands, their arguments and output, as included in tournamentd.md
+    static std::string command_reference();
 };
@@ -1,4 +1,5 @@
 #include "types.hpp"
+#include "json_writer.hpp"
 
 #include <utility>
 
@@ -473,6 +474,83 @@ void td::to_json(nlohmann::json& j, const td::seating_chart_entry& p)
     }
 }
 
+// ----- json_writer output, keys in sorted order as nlohmann::json writes them
+
+void td::write_json(json_writer& w, const std::chrono::system_clock::time_point& p)
+{
+    w.value(std::chrono::duration_cast<std::chrono::milliseconds>(p.time_since_epoch()).count());
+}
+
+void td::write_json(json_writer& w, const td::chip& p)
+{
+    w.begin_object();
+    if(!p.color.empty())
+    {
+        w.key("color").value(p.color);
+    }
+    if(p.count_available > 0)
+    {
+        w.key("count_available").value(p.count_available);
+    }
+    w.key("denomination").value(p.denomination);
+    w.end_object();
+}
+
+void td::write_json(json_writer& w, const td::table& p)
+{
+    w.begin_object();
+    if(!p.table_name.empty())
+    {
+        w.key("table_name").value(p.table_name);
+    }
+    w.end_object();
+}
+
+void td::write_json(json_writer& w, const td::monetary_value& p)
+{
+    w.begin_object();
+    w.key("amount").value(p.amount);
+    if(!p.currency.empty())
+    {
+        w.key("currency").value(p.currency);
+    }
+    w.end_object();
+}
+
+void td::write_json(json_writer& w, const td::monetary_value_nocurrency& p)
+{
+    w.begin_object();
+    w.key("amount").value(p.amount);
+    w.end_object();
+}
+
+void td::write_json(json_writer& w, const td::funding_source& p)
+{
+    w.begin_object();
+    w.key("chips").value(p.chips);
+    w.key("commission");
+    td::write_json(w, p.commission);
+    w.key("cost");
+    td::write_json(w, p.cost);
+    w.key("equity");
+    td::write_json(w, p.equity);
+    if(p.forbid_after_blind_level != std::numeric_limits<std::size_t>::max())
+    {
+        w.key("forbid_after_blind_level").value(p.forbid_after_blind_level);
+    }
+    w.key("name").value(p.name);
+    w.key("type").value(static_cast<int>(p.type));
+    w.end_object();
+}
+
+void td::write_json(json_writer& w, const td::seat& p)
+{
+    w.begin_object();
+    w.key("seat_number").value(p.seat_number);
+    w.key("table_number").value(p.table_number);
+    w.end_object();
+}
+
 // ----- ostream insertion
 
 // funding_source_type_t to stream
@@ -7,6 +7,8 @@
 #include <string>
 #include <vector>
 
+class json_writer;
+
 // convert datetime to and from json
 void to_json(nlohmann::json& j, const datetime& p);
 void from_json(const nlohmann::json& j, datetime& p);
@@ -323,6 +325,15 @@ namespace td
     };
     void to_json(nlohmann::json& j, const td::automatic_payout_parameters& p); // TODO: Needed?
     void from_json(const nlohmann::json& j, td::automatic_payout_parameters& p);
+
+    // write straight to JSON text, the same text as dumping to_json's result
+    void write_json(json_writer& w, const std::chrono::system_clock::time_point& p);
+    void write_json(json_writer& w, const td::chip& p);
+    void write_json(json_writer& w, const td::table& p);
+    void write_json(json_writer& w, const td::monetary_value& p);
+    void write_json(json_writer& w, const td::monetary_value_nocurrency& p);
+    void write_json(json_writer& w, const td::funding_source& p);
+    void write_json(json_writer& w, const td::seat& p);
 }
 
 // stream insertion
@@ -0,0 +1,98 @@
+#include "worker_pool.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct worker_pool::impl
+{
+    // guards everything below it
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::function<void()>> jobs;
+    bool stopping {};
+
+    // declared last, so everything they use exists before they start
+    std::vector<std::thread> threads;
+
+    explicit impl(std::size_t count)
+    {
+        count = std::max(count, std::size_t(1));
+        this->threads.reserve(count);
+        for(std::size_t i(0); i < count; i++)
+        {
+            this->threads.emplace_back(&impl::run, this);
+        }
+    }
+
+    ~impl()
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->wake.notify_all();
+        for(auto& thread : this->threads)
+        {
+            thread.join();
+        }
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        for(;;)
+        {
+            this->wake.wait(lock, [this] { return this->stopping || !this->jobs.empty(); });
+            if(this->jobs.empty())
+            {
+                // stopping, nothing left to run
+                return;
+            }
+
+            auto job(std::move(this->jobs.front()));
+            this->jobs.pop_front();
+            lock.unlock();
+
+            try
+            {
+                job();
+            }
+            catch(const std::exception& e)
+            {
+                logger(ll::error) << "worker job failed: " << e.what() << '\n';
+            }
+
+            // release anything the job holds before waiting again
+            job = nullptr;
+            lock.lock();
+        }
+    }
+};
+
+worker_pool::worker_pool(std::size_t threads) : pimpl(new impl(threads))
+{
+}
+
+worker_pool::~worker_pool() = default;
+
+// queue a job for the first free thread
+void worker_pool::post(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->pimpl->mutex);
+        this->pimpl->jobs.push_back(std::move(job));
+    }
+    this->pimpl->wake.notify_one();
+}
+
+// number of threads
+std::size_t worker_pool::size() const
+{
+    return this->pimpl->threads.size();
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+// runs jobs on a fixed set of background threads, taken in the order posted, several at once
+class worker_pool
+{
+    // pimpl
+    struct impl;
+    std::unique_ptr<impl> pimpl;
+
+public:
+    // start the given number of threads (at least one)
+    explicit worker_pool(std::size_t threads);
+
+    // finish every job already posted, then stop
+    ~worker_pool();
+
+    // Non-copyable, non-movable (manages unique resources)
+    worker_pool(const worker_pool&) = delete;
+    worker_pool& operator=(const worker_pool&) = delete;
+    worker_pool(worker_pool&&) = delete;
+    worker_pool& operator=(worker_pool&&) = delete;
+
+    // queue a job for the first free thread. any thread may post. an exception thrown by a job is logged and dropped
+    void post(std::function<void()> job);
+
+    // number of threads
+    std::size_t size() const;
+};